@@ -0,0 +1,578 @@
+/* createfs.c - Builds a filesystem image from a directory of files
+ *
+ * Usage: createfs -i <dir> -o <image> [-n inodes] [-f free blocks] [-g files] [-z]
+ *			[-O order file] [-a align] [-m manifest]
+ *
+ * The image keeps the layout of the original ECE391 images (4 kB boot block,
+ * 4 kB inodes, 4 kB data blocks) but sets FS_MAGIC in the boot block and adds
+ * inode and data block bitmaps and a root directory stored in an inode, so it
+ * can hold far more than 63 files:
+ *
+ *	block 0						boot block
+ *	inode_bitmap_start ...		one bit per inode
+ *	data_bitmap_start ...		one bit per data block
+ *	inode_start ...				num_inodes inodes, inode 0 is reserved and
+ *								inode 1 holds the directory
+ *	data_start ...				data blocks, the last -f of them free
+ *
+ * -z writes the image compressed instead (see lz4.h in the kernel): a header,
+ * an index of where each block's frame starts, then each block as an LZ4
+ * block, stored as is if it doesn't shrink, or left out if it is all zeros.
+ *
+ * -n reserves inodes beyond the ones the files need (64 by default) so the
+ * kernel can create more, and -g adds that many small generated files
+ * (gen00000 ...) to the image, for testing directories with thousands of
+ * entries.
+ *
+ * Each file's data blocks are contiguous, so the kernel reads a file as one
+ * run. Directory entries and inodes are sorted by name, but data is laid out
+ * in access order: the files named in the -O file (one per line) first, in
+ * that order, then executables, then everything else by name. Executables
+ * start on a multiple of -a blocks (1 by default); every block is already a
+ * page, and data block 0 is aligned the same way by reserving extra inodes.
+ * -m writes a manifest listing where each file went and its checksum.
+ *
+ * The image depends only on the options and the files' names and contents
+ * (no timestamps, nothing from readdir order, padding zeroed), so building
+ * twice gives the same bytes. fsck checks an image.
+ *
+ * vim:ts=4 noexpandtab
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Must match student-distrib/filesystem/filesystem_structs.h */
+#define BLOCK_SIZE 4096
+#define DENTRY_SIZE 64
+#define MAX_FILENAME_LENGTH 32
+#define NUM_DATA_BLOCK_ADDR 1023
+#define FS_MAGIC 0x32534633
+#define BITS_PER_BLOCK (BLOCK_SIZE * 8)
+
+#define FILE_TYPE_RTC 0
+#define FILE_TYPE_DIR 1
+#define FILE_TYPE_REGULAR 2
+
+#define RESERVED_INODE 0
+#define DIR_INODE 1
+#define FIRST_FILE_INODE 2
+
+#define DEFAULT_FREE_BLOCKS 256
+
+/* Must match student-distrib/filesystem/lz4.h */
+#define LZ4_IMAGE_MAGIC 0x49345A4C
+#define LZ4_IMAGE_HEADER_SIZE 16
+
+/* LZ4 block format limits: matches are at least 4 bytes, the last match
+ * starts at least 12 bytes before the end and the last 5 bytes are literals */
+#define LZ4_MIN_MATCH 4
+#define LZ4_MF_LIMIT 12
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 12
+#define DEFAULT_EXTRA_INODES 64
+
+/* FNV-1a, for the manifest checksums */
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME 16777619U
+
+/* Sort ranks after the -O files: executables, then the rest */
+#define RANK_EXEC 0xFFFFFFFE
+#define RANK_OTHER 0xFFFFFFFF
+
+typedef struct dentry {
+	char filename[MAX_FILENAME_LENGTH];
+	uint32_t file_type;
+	uint32_t inode_num;
+	uint8_t reserved[24];
+} dentry_t;
+
+typedef struct boot_block {
+	uint32_t num_dir_entries;
+	uint32_t num_inodes;
+	uint32_t num_data_blocks;
+	uint32_t magic;
+	uint32_t dir_inode;
+	uint32_t inode_bitmap_start;
+	uint32_t data_bitmap_start;
+	uint32_t inode_start;
+	uint32_t data_start;
+	uint8_t reserved[28];
+} boot_block_t;
+
+typedef struct inode {
+	uint32_t length;
+	uint32_t data_blocks[NUM_DATA_BLOCK_ADDR];
+} inode_t;
+
+/* A file going into the image */
+typedef struct file {
+	char name[MAX_FILENAME_LENGTH + 1];
+	char* path;			/* NULL for generated files */
+	uint32_t length;
+	uint32_t gen;		/* number of a generated file */
+	uint32_t exec;		/* starts with the ELF magic */
+	uint32_t rank;		/* data placement order, see compare_placement */
+	uint32_t inode;
+} file_t;
+
+static file_t* files;
+static uint32_t num_files, files_size;
+
+static void usage(const char* prog) {
+	fprintf(stderr, "usage: %s -i <dir> -o <image> [-n inodes] [-f free blocks] [-g files] [-z]\n"
+		"\t[-O order file] [-a align] [-m manifest]\n", prog);
+	exit(1);
+}
+
+static uint32_t blocks_for(uint32_t bytes) {
+	return (bytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+static void add_file(const char* name, char* path, uint32_t length, uint32_t gen) {
+	file_t* f;
+
+	if(num_files == files_size) {
+		files_size = files_size ? files_size * 2 : 64;
+		if(!(files = realloc(files, files_size * sizeof(file_t)))) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	f = &files[num_files++];
+	memset(f, 0, sizeof(*f));
+	/* Names longer than a dentry are cut short, like the original createfs */
+	strncpy(f->name, name, MAX_FILENAME_LENGTH);
+	f->path = path;
+	f->length = length;
+	f->gen = gen;
+}
+
+static int compare_files(const void* a, const void* b) {
+	return strcmp(((const file_t*) a)->name, ((const file_t*) b)->name);
+}
+
+/* Access order first, then by name so ties can't depend on qsort */
+static int compare_placement(const void* a, const void* b) {
+	const file_t *fa = *(const file_t* const*) a, *fb = *(const file_t* const*) b;
+
+	if(fa->rank != fb->rank) return fa->rank < fb->rank ? -1 : 1;
+	return strcmp(fa->name, fb->name);
+}
+
+static file_t* find_file(const char* name) {
+	size_t len = strlen(name);
+	file_t key;
+
+	memset(&key, 0, sizeof(key));
+	memcpy(key.name, name, len < MAX_FILENAME_LENGTH ? len : MAX_FILENAME_LENGTH);
+	return bsearch(&key, files, num_files, sizeof(file_t), compare_files);
+}
+
+/* Ranks the files named in path by their line number */
+static void read_order(const char* path) {
+	char line[256];
+	uint32_t rank = 0;
+	file_t* f;
+	FILE* in;
+
+	if(!(in = fopen(path, "r"))) {
+		perror(path);
+		exit(1);
+	}
+	while(fgets(line, sizeof(line), in)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if(!line[0] || line[0] == '#') continue;
+		if(!(f = find_file(line))) {
+			fprintf(stderr, "%s: no file named %s\n", path, line);
+			exit(1);
+		}
+		if(f->rank > rank) f->rank = rank++;
+	}
+	fclose(in);
+}
+
+/* Marks files starting with the ELF magic, which execute loads */
+static void find_executables(void) {
+	uint8_t magic[4];
+	uint32_t i;
+	FILE* f;
+
+	for(i = 0; i < num_files; ++i) {
+		files[i].rank = RANK_OTHER;
+		if(!files[i].path || !(f = fopen(files[i].path, "rb"))) continue;
+		files[i].exec = fread(magic, 1, 4, f) == 4 && !memcmp(magic, "\177ELF", 4);
+		if(files[i].exec) files[i].rank = RANK_EXEC;
+		fclose(f);
+	}
+}
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t* p, uint32_t len) {
+	for(; len; --len) hash = (hash ^ *p++) * FNV_PRIME;
+	return hash;
+}
+
+/* Contents of the n-th generated file */
+static uint32_t gen_contents(uint32_t n, char* buf) {
+	return sprintf(buf, "generated file %u\n", n);
+}
+
+static void scan_dir(const char* dir) {
+	struct dirent* ent;
+	struct stat st;
+	char* path;
+	DIR* d;
+
+	if(!(d = opendir(dir))) {
+		perror(dir);
+		exit(1);
+	}
+	while((ent = readdir(d))) {
+		if(ent->d_name[0] == '.') continue;
+		if(!(path = malloc(strlen(dir) + strlen(ent->d_name) + 2))) {
+			perror("malloc");
+			exit(1);
+		}
+		sprintf(path, "%s/%s", dir, ent->d_name);
+		if(stat(path, &st) || !S_ISREG(st.st_mode)) {
+			free(path);
+			continue;
+		}
+		if(st.st_size > (off_t) NUM_DATA_BLOCK_ADDR * BLOCK_SIZE) {
+			fprintf(stderr, "%s: too large for one inode\n", path);
+			exit(1);
+		}
+		add_file(ent->d_name, path, st.st_size, 0);
+	}
+	closedir(d);
+}
+
+static void set_bit(uint8_t* bits, uint32_t i) {
+	bits[i / 8] |= 1 << (i % 8);
+}
+
+static uint32_t read32(const uint8_t* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* Writes a literal or match length of 15 or more as 255-valued bytes */
+static uint32_t lz4_put_length(uint8_t* dst, uint32_t len) {
+	uint32_t n = 0;
+	for(; len >= 255; len -= 255) dst[n++] = 255;
+	dst[n++] = len;
+	return n;
+}
+
+/* Emits one sequence: literals [anchor, anchor + lit), then a match of
+ * match_len bytes offset bytes back (match_len 0 for the last sequence) */
+static uint32_t lz4_put_sequence(uint8_t* dst, const uint8_t* lit, uint32_t lit_len,
+		uint32_t offset, uint32_t match_len) {
+	uint32_t n = 1;
+
+	dst[0] = (lit_len >= 15 ? 15 : lit_len) << 4;
+	if(lit_len >= 15) n += lz4_put_length(dst + n, lit_len - 15);
+	memcpy(dst + n, lit, lit_len);
+	n += lit_len;
+	if(!match_len) return n;
+
+	dst[n++] = offset & 0xFF;
+	dst[n++] = offset >> 8;
+	match_len -= LZ4_MIN_MATCH;
+	dst[0] |= match_len >= 15 ? 15 : match_len;
+	if(match_len >= 15) n += lz4_put_length(dst + n, match_len - 15);
+	return n;
+}
+
+/* Greedy LZ4 block compressor. dst must hold len + len / 255 + 16 bytes */
+static uint32_t lz4_compress(const uint8_t* src, uint32_t len, uint8_t* dst) {
+	int32_t table[1 << LZ4_HASH_BITS];
+	uint32_t ip = 0, anchor = 0, out = 0, h, ref, match_len;
+
+	memset(table, 0xFF, sizeof(table));
+	while(len > LZ4_MF_LIMIT && ip < len - LZ4_MF_LIMIT) {
+		h = (read32(src + ip) * 2654435761U) >> (32 - LZ4_HASH_BITS);
+		ref = table[h];
+		table[h] = ip;
+		if(table[h] == -1 || ref == (uint32_t) -1 || ip - ref > LZ4_MAX_OFFSET ||
+				read32(src + ref) != read32(src + ip)) {
+			ip++;
+			continue;
+		}
+
+		match_len = LZ4_MIN_MATCH;
+		while(ip + match_len < len - LZ4_LAST_LITERALS && src[ref + match_len] == src[ip + match_len])
+			match_len++;
+		out += lz4_put_sequence(dst + out, src + anchor, ip - anchor, ip - ref, match_len);
+		ip += match_len;
+		anchor = ip;
+	}
+	return out + lz4_put_sequence(dst + out, src + anchor, len - anchor, 0, 0);
+}
+
+/* Writes the image as a header, block index and one frame per block */
+static int write_compressed(FILE* f, const uint8_t* image, uint32_t num_blocks, uint32_t* out_bytes) {
+	uint8_t header[LZ4_IMAGE_HEADER_SIZE], frame[BLOCK_SIZE + BLOCK_SIZE / 255 + 16];
+	uint32_t* index = calloc(num_blocks + 1, sizeof(uint32_t));
+	uint32_t data_offset = LZ4_IMAGE_HEADER_SIZE + (num_blocks + 1) * sizeof(uint32_t);
+	const uint8_t* block;
+	uint32_t i, j, n, pos = 0;
+
+	if(!index) return -1;
+
+	/* Frames go after the index, so write them first and come back for it */
+	if(fseek(f, data_offset, SEEK_SET)) return -1;
+	for(i = 0; i < num_blocks; ++i) {
+		block = image + i * BLOCK_SIZE;
+		index[i] = pos;
+		for(j = 0; j < BLOCK_SIZE && !block[j]; ++j) continue;
+		if(j == BLOCK_SIZE) continue;
+
+		n = lz4_compress(block, BLOCK_SIZE, frame);
+		if(n >= BLOCK_SIZE) {
+			n = BLOCK_SIZE;
+			memcpy(frame, block, BLOCK_SIZE);
+		}
+		if(fwrite(frame, 1, n, f) != n) return -1;
+		pos += n;
+	}
+	index[num_blocks] = pos;
+
+	memset(header, 0, sizeof(header));
+	((uint32_t*) header)[0] = LZ4_IMAGE_MAGIC;
+	((uint32_t*) header)[1] = num_blocks;
+	((uint32_t*) header)[2] = data_offset;
+	if(fseek(f, 0, SEEK_SET) || fwrite(header, 1, sizeof(header), f) != sizeof(header) ||
+			fwrite(index, sizeof(uint32_t), num_blocks + 1, f) != num_blocks + 1) return -1;
+
+	*out_bytes = data_offset + pos;
+	free(index);
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	const char *in_dir = NULL, *out_path = NULL, *order_path = NULL, *manifest_path = NULL;
+	uint32_t extra_inodes = DEFAULT_EXTRA_INODES, free_blocks = DEFAULT_FREE_BLOCKS, gen_files = 0;
+	uint32_t compress = 0, align = 1, out_bytes;
+	uint32_t num_inodes, num_entries, used_blocks, data_blocks, total_blocks;
+	uint32_t inode_bitmap_blocks, data_bitmap_blocks, data_start, next_block, i, j, n;
+	file_t** placement;
+	uint8_t *image, *inode_bits, *data_bits;
+	boot_block_t* boot;
+	dentry_t* dir;
+	inode_t* inode;
+	char gen_name[MAX_FILENAME_LENGTH + 1], gen_buf[BLOCK_SIZE];
+	FILE* f;
+	int opt;
+
+	while((opt = getopt(argc, argv, "i:o:n:f:g:zO:a:m:")) != -1) {
+		switch(opt) {
+			case 'i': in_dir = optarg; break;
+			case 'o': out_path = optarg; break;
+			case 'n': extra_inodes = strtoul(optarg, NULL, 0); break;
+			case 'f': free_blocks = strtoul(optarg, NULL, 0); break;
+			case 'g': gen_files = strtoul(optarg, NULL, 0); break;
+			case 'z': compress = 1; break;
+			case 'O': order_path = optarg; break;
+			case 'a': align = strtoul(optarg, NULL, 0); break;
+			case 'm': manifest_path = optarg; break;
+			default: usage(argv[0]);
+		}
+	}
+	if(!in_dir || !out_path || !align) usage(argv[0]);
+
+	scan_dir(in_dir);
+	for(i = 0; i < gen_files; ++i) {
+		sprintf(gen_name, "gen%05u", i);
+		add_file(gen_name, NULL, gen_contents(i, gen_buf), i);
+	}
+	qsort(files, num_files, sizeof(file_t), compare_files);
+	for(i = 1; i < num_files; ++i) {
+		if(!strcmp(files[i].name, files[i - 1].name)) {
+			fprintf(stderr, "duplicate name %s\n", files[i].name);
+			return 1;
+		}
+	}
+	for(i = 0; i < num_files; ++i) files[i].inode = FIRST_FILE_INODE + i;
+
+	/* Decide where data goes */
+	find_executables();
+	if(order_path) read_order(order_path);
+	if(!(placement = malloc(num_files * sizeof(file_t*) + 1))) {
+		perror("malloc");
+		return 1;
+	}
+	for(i = 0; i < num_files; ++i) placement[i] = &files[i];
+	qsort(placement, num_files, sizeof(file_t*), compare_placement);
+
+	/* ".", "rtc", then the files */
+	num_entries = num_files + 2;
+	if(num_entries > NUM_DATA_BLOCK_ADDR * (BLOCK_SIZE / DENTRY_SIZE)) {
+		fprintf(stderr, "too many files for one directory\n");
+		return 1;
+	}
+	num_inodes = FIRST_FILE_INODE + num_files + extra_inodes;
+
+	/* Lay out the data: the directory, then the files in placement order,
+	 * leaving the blocks skipped to align executables free */
+	used_blocks = blocks_for(num_entries * DENTRY_SIZE);
+	next_block = used_blocks;
+	for(i = 0; i < num_files; ++i) {
+		if(placement[i]->exec && next_block % align) {
+			next_block += align - next_block % align;
+		}
+		next_block += blocks_for(placement[i]->length);
+		used_blocks += blocks_for(placement[i]->length);
+	}
+	data_blocks = next_block + free_blocks;
+
+	/* Reserve extra inodes until data block 0 is aligned too */
+	for(;;) {
+		inode_bitmap_blocks = blocks_for((num_inodes + 7) / 8);
+		data_bitmap_blocks = blocks_for((data_blocks + 7) / 8);
+		data_start = 1 + inode_bitmap_blocks + data_bitmap_blocks + num_inodes;
+		if(data_start % align == 0) break;
+		num_inodes += align - data_start % align;
+	}
+
+	total_blocks = 1 + inode_bitmap_blocks + data_bitmap_blocks + num_inodes + data_blocks;
+	if(!(image = calloc(total_blocks, BLOCK_SIZE))) {
+		perror("calloc");
+		return 1;
+	}
+
+	boot = (boot_block_t*) image;
+	boot->num_dir_entries = num_entries;
+	boot->num_inodes = num_inodes;
+	boot->num_data_blocks = next_block;
+	boot->magic = FS_MAGIC;
+	boot->dir_inode = DIR_INODE;
+	boot->inode_bitmap_start = 1;
+	boot->data_bitmap_start = boot->inode_bitmap_start + inode_bitmap_blocks;
+	boot->inode_start = boot->data_bitmap_start + data_bitmap_blocks;
+	boot->data_start = boot->inode_start + num_inodes;
+
+	/* Bits past the last item are marked used so they are never handed out */
+	inode_bits = image + boot->inode_bitmap_start * BLOCK_SIZE;
+	data_bits = image + boot->data_bitmap_start * BLOCK_SIZE;
+	for(i = num_inodes; i < inode_bitmap_blocks * BITS_PER_BLOCK; ++i) set_bit(inode_bits, i);
+	for(i = data_blocks; i < data_bitmap_blocks * BITS_PER_BLOCK; ++i) set_bit(data_bits, i);
+	set_bit(inode_bits, RESERVED_INODE);
+	set_bit(inode_bits, DIR_INODE);
+
+#define INODE(n) ((inode_t*) (image + (boot->inode_start + (n)) * BLOCK_SIZE))
+#define DATA(b) (image + (boot->data_start + (b)) * BLOCK_SIZE)
+
+	/* Directory first so it is contiguous */
+	next_block = 0;
+	inode = INODE(DIR_INODE);
+	inode->length = num_entries * DENTRY_SIZE;
+	for(j = 0; j < blocks_for(inode->length); ++j) {
+		set_bit(data_bits, next_block);
+		inode->data_blocks[j] = next_block++;
+	}
+
+	/* Then each file's data in placement order */
+	for(i = 0; i < num_files; ++i) {
+		file_t* file = placement[i];
+
+		if(file->exec && next_block % align) next_block += align - next_block % align;
+		inode = INODE(file->inode);
+		inode->length = file->length;
+		set_bit(inode_bits, file->inode);
+		for(j = 0; j < blocks_for(file->length); ++j) {
+			set_bit(data_bits, next_block);
+			inode->data_blocks[j] = next_block++;
+		}
+
+		if(!file->path) {
+			/* One block at most */
+			gen_contents(file->gen, (char*) DATA(inode->data_blocks[0]));
+			continue;
+		}
+		if(!(f = fopen(file->path, "rb"))) {
+			perror(file->path);
+			return 1;
+		}
+		for(j = 0; j < blocks_for(file->length); ++j) {
+			n = file->length - j * BLOCK_SIZE;
+			if(n > BLOCK_SIZE) n = BLOCK_SIZE;
+			if(fread(DATA(inode->data_blocks[j]), 1, n, f) != n) {
+				fprintf(stderr, "%s: short read\n", file->path);
+				return 1;
+			}
+		}
+		fclose(f);
+	}
+
+	/* Directory entries, written into the directory inode's blocks */
+	dir = calloc(num_entries, sizeof(dentry_t));
+	if(!dir) {
+		perror("calloc");
+		return 1;
+	}
+	strcpy(dir[0].filename, ".");
+	dir[0].file_type = FILE_TYPE_DIR;
+	dir[0].inode_num = DIR_INODE;
+	strcpy(dir[1].filename, "rtc");
+	dir[1].file_type = FILE_TYPE_RTC;
+	dir[1].inode_num = RESERVED_INODE;
+	for(i = 0; i < num_files; ++i) {
+		memcpy(dir[i + 2].filename, files[i].name, MAX_FILENAME_LENGTH);
+		dir[i + 2].file_type = FILE_TYPE_REGULAR;
+		dir[i + 2].inode_num = files[i].inode;
+	}
+	inode = INODE(DIR_INODE);
+	for(j = 0; j < blocks_for(inode->length); ++j) {
+		n = inode->length - j * BLOCK_SIZE;
+		if(n > BLOCK_SIZE) n = BLOCK_SIZE;
+		memcpy(DATA(inode->data_blocks[j]), (uint8_t*) dir + j * BLOCK_SIZE, n);
+	}
+
+	if(!(f = fopen(out_path, "wb"))) {
+		perror(out_path);
+		return 1;
+	}
+	out_bytes = total_blocks * BLOCK_SIZE;
+	if(compress ? write_compressed(f, image, total_blocks, &out_bytes) :
+			fwrite(image, BLOCK_SIZE, total_blocks, f) != total_blocks) {
+		perror(out_path);
+		return 1;
+	}
+	fclose(f);
+
+	/* Manifest: one line per file in placement order */
+	if(manifest_path) {
+		if(!(f = fopen(manifest_path, "w"))) {
+			perror(manifest_path);
+			return 1;
+		}
+		fprintf(f, "# blocks %u inodes %u data_start %u data_blocks %u align %u image_fnv %08x\n",
+			total_blocks, num_inodes, boot->data_start, data_blocks, align,
+			fnv1a(FNV_OFFSET, image, total_blocks * BLOCK_SIZE));
+		fprintf(f, "# inode type length first_block blocks fnv name\n");
+		for(i = 0; i < num_files; ++i) {
+			inode = INODE(placement[i]->inode);
+			n = FNV_OFFSET;
+			for(j = 0; j < blocks_for(inode->length); ++j) {
+				n = fnv1a(n, DATA(inode->data_blocks[j]), inode->length - j * BLOCK_SIZE > BLOCK_SIZE ?
+					BLOCK_SIZE : inode->length - j * BLOCK_SIZE);
+			}
+			fprintf(f, "%u %s %u %u %u %08x %s\n", placement[i]->inode, placement[i]->exec ? "exec" : "file",
+				inode->length, inode->length ? boot->data_start + inode->data_blocks[0] : 0,
+				blocks_for(inode->length), n, placement[i]->name);
+		}
+		fclose(f);
+	}
+
+	printf("%s: %u files, %u inodes (%u free), %u data blocks (%u free), %u blocks total\n",
+		out_path, num_files, num_inodes, num_inodes - FIRST_FILE_INODE - num_files,
+		data_blocks, data_blocks - used_blocks, total_blocks);
+	if(compress) printf("%s: compressed to %u of %u bytes\n", out_path, out_bytes, total_blocks * BLOCK_SIZE);
+	return 0;
+}
@@ -0,0 +1,401 @@
+/* fsck.c - Checks a filesystem image without mounting it
+ *
+ * Usage: fsck <image>
+ *
+ * Reads an image written by createfs, compressed (-z) or not, or one in the
+ * original ECE391 format, and checks that:
+ *
+ *	- the boot block layout fits the image and matches what the kernel accepts
+ *	- directory entries have unique, non-empty names, a valid type and an
+ *	  inode that is in range and in use
+ *	- each file's length fits in an inode and each of its blocks is in range
+ *	  and belongs to no other file
+ *	- the bitmaps mark every inode and data block in use (FS_MAGIC images),
+ *	  bits set for items nothing uses are reported as leaks
+ *
+ * Prints what it finds and exits with 1 if the image has errors, leaks alone
+ * are only warnings.
+ *
+ * vim:ts=4 noexpandtab
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Must match student-distrib/filesystem/filesystem_structs.h */
+#define BLOCK_SIZE 4096
+#define DENTRY_SIZE 64
+#define MAX_FILENAME_LENGTH 32
+#define NUM_DATA_BLOCK_ADDR 1023
+#define MAX_FILE_SIZE (NUM_DATA_BLOCK_ADDR * BLOCK_SIZE)
+#define MAX_FILES (BLOCK_SIZE / DENTRY_SIZE - 1)
+#define FS_MAGIC 0x32534633
+#define BITS_PER_BLOCK (BLOCK_SIZE * 8)
+
+#define FILE_TYPE_RTC 0
+#define FILE_TYPE_DIR 1
+#define FILE_TYPE_REGULAR 2
+
+/* Must match student-distrib/filesystem/lz4.h */
+#define LZ4_IMAGE_MAGIC 0x49345A4C
+#define LZ4_IMAGE_HEADER_SIZE 16
+#define LZ4_MIN_MATCH 4
+
+/* Reports beyond this many of one kind are only counted */
+#define MAX_REPORTS 20
+
+typedef struct dentry {
+	char filename[MAX_FILENAME_LENGTH];
+	uint32_t file_type;
+	uint32_t inode_num;
+	uint8_t reserved[24];
+} dentry_t;
+
+typedef struct boot_block {
+	uint32_t num_dir_entries;
+	uint32_t num_inodes;
+	uint32_t num_data_blocks;
+	uint32_t magic;
+	uint32_t dir_inode;
+	uint32_t inode_bitmap_start;
+	uint32_t data_bitmap_start;
+	uint32_t inode_start;
+	uint32_t data_start;
+	uint8_t reserved[28];
+	dentry_t dentries[MAX_FILES];
+} boot_block_t;
+
+typedef struct inode {
+	uint32_t length;
+	uint32_t data_blocks[NUM_DATA_BLOCK_ADDR];
+} inode_t;
+
+static uint8_t* image;
+static uint32_t image_blocks;
+static boot_block_t* boot;
+static uint32_t errors, leaks;
+
+/* Data blocks the files can address, and which inode owns each */
+static uint32_t data_count;
+static uint32_t* block_owner;
+static uint8_t* inode_seen;
+
+#define INODE(n) ((inode_t*) (image + (boot->inode_start + (n)) * BLOCK_SIZE))
+#define DATA(b) (image + (boot->data_start + (b)) * BLOCK_SIZE)
+
+static void error(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void error(const char* fmt, ...) {
+	va_list ap;
+
+	if(errors++ >= MAX_REPORTS) return;
+	va_start(ap, fmt);
+	printf("error: ");
+	vprintf(fmt, ap);
+	printf("\n");
+	va_end(ap);
+}
+
+static uint32_t blocks_for(uint32_t bytes) {
+	return (bytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+static int test_bit(const uint8_t* bits, uint32_t i) {
+	return bits[i / 8] & (1 << (i % 8));
+}
+
+/* Same decoder as the kernel's lz4_decompress */
+static int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len) {
+	uint32_t ip = 0, op = 0, len, offset;
+	uint8_t token, b;
+
+	while(ip < src_len) {
+		token = src[ip++];
+		len = token >> 4;
+		if(len == 0xF) {
+			do {
+				if(ip >= src_len) return -1;
+				b = src[ip++];
+				len += b;
+			} while(b == 0xFF);
+		}
+		if(len > src_len - ip || len > dst_len - op) return -1;
+		memcpy(dst + op, src + ip, len);
+		ip += len;
+		op += len;
+		if(ip == src_len) break;
+
+		if(src_len - ip < 2) return -1;
+		offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		if(!offset || offset > op) return -1;
+
+		len = token & 0xF;
+		if(len == 0xF) {
+			do {
+				if(ip >= src_len) return -1;
+				b = src[ip++];
+				len += b;
+			} while(b == 0xFF);
+		}
+		len += LZ4_MIN_MATCH;
+		if(len > dst_len - op) return -1;
+		for(; len; --len, ++op) dst[op] = dst[op - offset];
+	}
+	return op;
+}
+
+/* Replaces a compressed image with its blocks */
+static int decompress_image(uint8_t* file, uint32_t size) {
+	uint32_t* hdr = (uint32_t*) file;
+	uint32_t num_blocks = hdr[1], data_offset = hdr[2], *index = hdr + LZ4_IMAGE_HEADER_SIZE / 4;
+	uint32_t i, len;
+
+	if(size < LZ4_IMAGE_HEADER_SIZE || num_blocks > (size - LZ4_IMAGE_HEADER_SIZE) / 4 - 1 ||
+			data_offset < LZ4_IMAGE_HEADER_SIZE + (num_blocks + 1) * 4 || data_offset > size) {
+		printf("error: bad compressed image header\n");
+		return -1;
+	}
+	if(!(image = calloc(num_blocks ? num_blocks : 1, BLOCK_SIZE))) {
+		perror("calloc");
+		return -1;
+	}
+	for(i = 0; i < num_blocks; ++i) {
+		if(index[i] > index[i + 1] || index[i + 1] > size - data_offset) {
+			printf("error: bad index entry for block %u\n", i);
+			return -1;
+		}
+		len = index[i + 1] - index[i];
+		if(len == BLOCK_SIZE) {
+			memcpy(image + i * BLOCK_SIZE, file + data_offset + index[i], BLOCK_SIZE);
+		} else if(len && lz4_decompress(file + data_offset + index[i], len,
+				image + i * BLOCK_SIZE, BLOCK_SIZE) != BLOCK_SIZE) {
+			printf("error: block %u doesn't decompress\n", i);
+			return -1;
+		}
+	}
+	image_blocks = num_blocks;
+	printf("compressed image: %u bytes for %u blocks\n", size, num_blocks);
+	return 0;
+}
+
+static int load_image(const char* path) {
+	uint8_t* file;
+	long size;
+	FILE* f;
+
+	if(!(f = fopen(path, "rb")) || fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+			fseek(f, 0, SEEK_SET)) {
+		perror(path);
+		return -1;
+	}
+	if(!(file = calloc(size + BLOCK_SIZE, 1)) || fread(file, 1, size, f) != (size_t) size) {
+		perror(path);
+		return -1;
+	}
+	fclose(f);
+
+	if(size >= 4 && *(uint32_t*) file == LZ4_IMAGE_MAGIC) return decompress_image(file, size);
+	if(size % BLOCK_SIZE) printf("warning: image is not a whole number of blocks\n");
+	image = file;
+	image_blocks = size / BLOCK_SIZE;
+	return 0;
+}
+
+/* Checks the boot block fields the same way filesystem_mount does */
+static int check_layout(void) {
+	if(image_blocks < 1) {
+		error("image has no boot block");
+		return -1;
+	}
+	boot = (boot_block_t*) image;
+
+	if(boot->magic == FS_MAGIC) {
+		if(boot->inode_bitmap_start < 1 || boot->data_bitmap_start <= boot->inode_bitmap_start ||
+				boot->inode_start <= boot->data_bitmap_start ||
+				boot->data_start != boot->inode_start + boot->num_inodes ||
+				boot->dir_inode >= boot->num_inodes ||
+				boot->num_inodes > (boot->data_bitmap_start - boot->inode_bitmap_start) * BITS_PER_BLOCK) {
+			error("bad layout in boot block");
+			return -1;
+		}
+		data_count = (boot->inode_start - boot->data_bitmap_start) * BITS_PER_BLOCK;
+	} else {
+		boot->dir_inode = 0;
+		boot->inode_start = 1;
+		boot->data_start = 1 + boot->num_inodes;
+		data_count = BITS_PER_BLOCK;
+		if(boot->num_dir_entries > MAX_FILES) {
+			error("%u directory entries, the boot block holds %u", boot->num_dir_entries, MAX_FILES);
+			return -1;
+		}
+		if(boot->num_inodes > BITS_PER_BLOCK) {
+			error("too many inodes (%u)", boot->num_inodes);
+			return -1;
+		}
+	}
+
+	if(boot->data_start > image_blocks || boot->num_data_blocks > image_blocks - boot->data_start) {
+		error("%u data blocks from block %u don't fit in %u blocks", boot->num_data_blocks,
+			boot->data_start, image_blocks);
+		return -1;
+	}
+	if(data_count > image_blocks - boot->data_start) data_count = image_blocks - boot->data_start;
+
+	printf("%s image: %u blocks, %u inodes from block %u, %u data blocks from block %u\n",
+		boot->magic == FS_MAGIC ? "FS_MAGIC" : "original", image_blocks, boot->num_inodes,
+		boot->inode_start, data_count, boot->data_start);
+	return 0;
+}
+
+/* Checks an inode's length and blocks and claims the blocks for it */
+static void check_inode(uint32_t n, const char* name) {
+	inode_t* inode = INODE(n);
+	uint32_t i, b;
+
+	if(inode_seen[n]) return;
+	inode_seen[n] = 1;
+
+	if(inode->length > MAX_FILE_SIZE) {
+		error("%s: inode %u length %u is larger than %u", name, n, inode->length, MAX_FILE_SIZE);
+		return;
+	}
+	for(i = 0; i < blocks_for(inode->length); ++i) {
+		b = inode->data_blocks[i];
+		if(b >= data_count) {
+			error("%s: inode %u block %u is data block %u, past the last (%u)", name, n, i, b, data_count);
+		} else if(block_owner[b]) {
+			error("%s: inode %u block %u is data block %u, already used by inode %u",
+				name, n, i, b, block_owner[b] - 1);
+		} else {
+			block_owner[b] = n + 1;
+		}
+	}
+}
+
+/* Checks each directory entry and the inodes they name */
+static void check_dentries(dentry_t* dir, uint32_t count) {
+	char name[MAX_FILENAME_LENGTH + 1];
+	uint32_t i, j, dot = 0;
+
+	for(i = 0; i < count; ++i) {
+		memcpy(name, dir[i].filename, MAX_FILENAME_LENGTH);
+		name[MAX_FILENAME_LENGTH] = '\0';
+
+		if(!name[0]) error("entry %u has no name", i);
+		for(j = 0; j < i; ++j) {
+			if(!strncmp(dir[i].filename, dir[j].filename, MAX_FILENAME_LENGTH)) {
+				error("entry %u: %s is also entry %u", i, name, j);
+				break;
+			}
+		}
+
+		switch(dir[i].file_type) {
+			case FILE_TYPE_RTC:
+				break;
+			case FILE_TYPE_DIR:
+				if(strcmp(name, ".") || dir[i].inode_num != boot->dir_inode)
+					error("entry %u: %s is a directory that isn't the root", i, name);
+				dot = 1;
+				break;
+			case FILE_TYPE_REGULAR:
+				if(dir[i].inode_num >= boot->num_inodes) {
+					error("entry %u: %s has inode %u, past the last (%u)", i, name,
+						dir[i].inode_num, boot->num_inodes);
+				} else if(boot->magic == FS_MAGIC && dir[i].inode_num == boot->dir_inode) {
+					error("entry %u: %s uses the directory's inode", i, name);
+				} else if(inode_seen[dir[i].inode_num]) {
+					error("entry %u: %s shares inode %u with another entry", i, name, dir[i].inode_num);
+				} else {
+					check_inode(dir[i].inode_num, name);
+				}
+				break;
+			default:
+				error("entry %u: %s has bad type %u", i, name, dir[i].file_type);
+		}
+	}
+	if(!dot) printf("warning: no \".\" entry\n");
+}
+
+/* Compares a bitmap on the image with what the files use */
+static void check_bitmap(const char* what, uint32_t start, uint32_t count, uint32_t (*used)(uint32_t)) {
+	const uint8_t* bits = image + start * BLOCK_SIZE;
+	uint32_t i, set, in_use;
+
+	for(i = 0; i < count; ++i) {
+		set = test_bit(bits, i) != 0;
+		in_use = used(i);
+		if(in_use && !set) {
+			error("%s %u is in use but free in the bitmap", what, i);
+		} else if(set && !in_use) {
+			if(leaks++ < MAX_REPORTS) printf("leak: %s %u is marked used but nothing uses it\n", what, i);
+		}
+	}
+}
+
+static uint32_t inode_used(uint32_t i) {
+	return i == 0 || inode_seen[i];
+}
+
+static uint32_t block_used(uint32_t b) {
+	return block_owner[b] != 0;
+}
+
+int main(int argc, char** argv) {
+	inode_t* dir_inode;
+	dentry_t* dir;
+	uint32_t i, n, used = 0;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s <image>\n", argv[0]);
+		return 2;
+	}
+	if(load_image(argv[1]) || check_layout()) return 1;
+
+	block_owner = calloc(data_count + 1, sizeof(uint32_t));
+	inode_seen = calloc(boot->num_inodes + 1, 1);
+	if(!block_owner || !inode_seen) {
+		perror("calloc");
+		return 1;
+	}
+
+	if(boot->magic == FS_MAGIC) {
+		/* The directory's dentries are the data of its inode */
+		check_inode(boot->dir_inode, "directory");
+		if(errors) return 1;
+		dir_inode = INODE(boot->dir_inode);
+		if(dir_inode->length % DENTRY_SIZE)
+			error("directory length %u isn't a whole number of entries", dir_inode->length);
+		if(dir_inode->length / DENTRY_SIZE != boot->num_dir_entries)
+			error("boot block says %u entries, the directory holds %u", boot->num_dir_entries,
+				dir_inode->length / DENTRY_SIZE);
+		n = dir_inode->length / DENTRY_SIZE;
+		if(!(dir = calloc(n + 1, sizeof(dentry_t)))) {
+			perror("calloc");
+			return 1;
+		}
+		for(i = 0; i < blocks_for(dir_inode->length); ++i) {
+			memcpy((uint8_t*) dir + i * BLOCK_SIZE, DATA(dir_inode->data_blocks[i]),
+				dir_inode->length - i * BLOCK_SIZE > BLOCK_SIZE ? BLOCK_SIZE : dir_inode->length - i * BLOCK_SIZE);
+		}
+		check_dentries(dir, n);
+
+		check_bitmap("inode", boot->inode_bitmap_start, boot->num_inodes, inode_used);
+		check_bitmap("data block", boot->data_bitmap_start, data_count, block_used);
+	} else {
+		check_dentries(boot->dentries, boot->num_dir_entries);
+		for(i = 0; i < data_count; ++i) {
+			if(block_owner[i] && i >= boot->num_data_blocks)
+				error("data block %u is used but past num_data_blocks (%u)", i, boot->num_data_blocks);
+		}
+	}
+
+	for(i = 0; i < data_count; ++i) used += block_owner[i] != 0;
+	if(errors > MAX_REPORTS) printf("... %u errors in all\n", errors);
+	if(leaks > MAX_REPORTS) printf("... %u leaks in all\n", leaks);
+	printf("%s: %u data blocks in use, %u errors, %u leaks\n", argv[1], used, errors, leaks);
+	return errors ? 1 : 0;
+}
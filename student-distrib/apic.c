@@ -0,0 +1,254 @@
+/* apic.c - Functions to interact with the local APIC and the I/O APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "i8259.h"
+#include "lib.h"
+#include "idt.h"
+#include "paging.h"
+#include "x86_desc.h"
+
+/* PIT channel 2, used once to measure the local APIC timer */
+#define PIT_CH2_DATA        0x42
+#define PIT_COMMAND         0x43
+#define PIT_CH2_ONESHOT     0xB0	/* channel 2, lobyte/hibyte, mode 0 */
+#define PIT_HZ              1193182
+#define PIT_GATE_PORT       0x61
+#define PIT_GATE            0x01
+#define PIT_SPEAKER         0x02
+#define PIT_OUT             0x20
+#define CALIBRATE_DIVISOR   100		/* measure over 1/100 s */
+
+/* IMCR, which routes interrupts around the 8259 on MP-spec machines */
+#define IMCR_SELECT_PORT    0x22
+#define IMCR_DATA_PORT      0x23
+#define IMCR_SELECT         0x70
+#define IMCR_APIC           0x01
+
+uint32_t apic_enabled = 0;
+
+static volatile uint32_t* lapic;
+static volatile uint32_t* ioapic = (volatile uint32_t*) IOAPIC_BASE;
+static uint32_t ioapic_pins;
+static uint32_t lapic_id;
+static uint32_t timer_rate;
+
+/* Local APIC registers are 32 bits, 16 bytes apart */
+static inline uint32_t lapic_read(uint32_t reg) {
+	return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+	lapic[reg / 4] = value;
+}
+
+static uint32_t ioapic_read(uint32_t reg) {
+	ioapic[IOAPIC_IOREGSEL / 4] = reg;
+	return ioapic[IOAPIC_IOWIN / 4];
+}
+
+static void ioapic_write(uint32_t reg, uint32_t value) {
+	ioapic[IOAPIC_IOREGSEL / 4] = reg;
+	ioapic[IOAPIC_IOWIN / 4] = value;
+}
+
+/*
+ * ioapic_pin
+ *	  DESCRIPTION: Finds the I/O APIC pin an ISA IRQ arrives on
+ *	  INPUTS: irq_num -- IRQ as numbered on the 8259
+ *	  OUTPUTS: pin number
+ *	  SIDE EFFECTS: None
+ */
+static uint32_t ioapic_pin(uint32_t irq_num) {
+	return irq_num == 0 ? IOAPIC_PIT_PIN : irq_num;
+}
+
+/*
+ * ioapic_route
+ *	  DESCRIPTION: Points an IRQ's pin at the vector the 8259 would have used,
+ *				   on this CPU, leaving it masked
+ *	  INPUTS: irq_num -- ISA IRQ
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Writes a redirection entry
+ */
+static void ioapic_route(uint32_t irq_num) {
+	uint32_t pin = ioapic_pin(irq_num), low;
+
+	low = (ICW2_MASTER + irq_num) | REDIR_MASKED;
+	if(IOAPIC_LEVEL_IRQS & (1 << irq_num)) low |= REDIR_LEVEL;
+	ioapic_write(IOAPIC_REG_REDIR + 2 * pin + 1, lapic_id << REDIR_DEST_SHIFT);
+	ioapic_write(IOAPIC_REG_REDIR + 2 * pin, low);
+}
+
+/*
+ * lapic_calibrate
+ *	  DESCRIPTION: Counts local APIC timer ticks over 10 ms of PIT channel 2,
+ *				   which is polled so interrupts don't have to be on
+ *	  INPUTS: None
+ *	  OUTPUTS: timer counts per second at TIMER_DIVIDE_16
+ *	  SIDE EFFECTS: Runs the timer one-shot and masked, leaves the speaker off
+ */
+static uint32_t lapic_calibrate(void) {
+	uint32_t count = PIT_HZ / CALIBRATE_DIVISOR, gate;
+
+	gate = (inb(PIT_GATE_PORT) & ~PIT_SPEAKER) & ~PIT_GATE;
+	outb(gate, PIT_GATE_PORT);
+	outb(PIT_CH2_ONESHOT, PIT_COMMAND);
+	outb(count & 0xFF, PIT_CH2_DATA);
+	outb(count >> 8, PIT_CH2_DATA);
+
+	lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+	lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+
+	/* Raising the gate starts the count */
+	outb(gate | PIT_GATE, PIT_GATE_PORT);
+	lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+	while(!(inb(PIT_GATE_PORT) & PIT_OUT));
+	count = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+
+	lapic_write(LAPIC_TIMER_INIT, 0);
+	outb(gate, PIT_GATE_PORT);
+	return count * CALIBRATE_DIVISOR;
+}
+
+/*
+ * apic_init
+ *	  DESCRIPTION: Enables the local APIC and routes the ISA IRQs through the
+ *				   I/O APIC to the vectors the 8259 used, then masks the 8259.
+ *				   Nothing changes if either APIC is missing
+ *	  INPUTS: None
+ *	  OUTPUTS: 0 if interrupts now go through the APICs, -1 otherwise
+ *	  SIDE EFFECTS: Maps the APIC page, installs the spurious vector
+ */
+int32_t apic_init(void) {
+	uint32_t regs[4], base, flags, i;
+
+	cpuid(CPUID_FEATURES, regs);
+	if(!(regs[3] & CPUID_EDX_APIC)) return -1;
+
+	base = (uint32_t) rdmsr(MSR_APIC_BASE) & APIC_BASE_MASK;
+	if(base / FOUR_MB != IOAPIC_BASE / FOUR_MB) return -1; /* not where the I/O APIC is mapped */
+	brute_add_page(IOAPIC_BASE);
+	page_directory[IOAPIC_BASE / FOUR_MB].page_cache_disabled = 1;	/* registers, not memory */
+	flush_tlb();
+	lapic = (volatile uint32_t*) base;
+
+	/* An absent I/O APIC reads as all ones */
+	ioapic_pins = ((ioapic_read(IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+	if(ioapic_pins < 2 * PIC_SIZE || ioapic_pins > 240) return -1;
+
+	cli_and_save(flags);
+	wrmsr(MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+	lapic_id = lapic_read(LAPIC_ID) >> 24;
+
+	SET_IDT_ENTRY(idt[APIC_SPURIOUS_VECTOR], &apic_spurious);
+	idt[APIC_SPURIOUS_VECTOR].present = 1;
+
+	lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+	lapic_write(LAPIC_TPR, 0);
+	lapic_write(LAPIC_LVT_LINT0, LVT_MASKED);	/* the 8259's ExtINT line */
+	lapic_write(LAPIC_LVT_LINT1, LVT_NMI);
+	lapic_write(LAPIC_LVT_ERROR, LVT_MASKED);
+	lapic_write(LAPIC_ESR, 0);
+	timer_rate = lapic_calibrate();
+
+	for(i = 0; i < 2 * PIC_SIZE; ++i) {
+		if(i != 2) ioapic_route(i); /* pin 2 is the PIT's, IRQ 2 never fires */
+	}
+
+	/* Take the 8259 out of the path */
+	outb(0xFF, MASTER_8259_PORT+1);
+	outb(0xFF, SLAVE_8259_PORT+1);
+	outb(IMCR_SELECT, IMCR_SELECT_PORT);
+	outb(IMCR_APIC, IMCR_DATA_PORT);
+
+	apic_enabled = 1;
+	lapic_write(LAPIC_EOI, 0);
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+ * apic_eoi
+ *	  DESCRIPTION: Sends end-of-interrupt to the local APIC, which passes it
+ *				   on to the I/O APIC for level-triggered pins
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: One MMIO write
+ */
+void apic_eoi(void) {
+	lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+ * apic_enable_irq
+ *	  DESCRIPTION: Unmasks an IRQ's redirection entry, or the timer's LVT entry
+ *	  INPUTS: irq_num -- IRQ to unmask
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Writes the low half of the entry, no read back needed
+ *				   since ioapic_route set the rest
+ */
+void apic_enable_irq(uint32_t irq_num) {
+	uint32_t low;
+
+	if(irq_num == APIC_TIMER_IRQ) {
+		lapic_write(LAPIC_LVT_TIMER, lapic_read(LAPIC_LVT_TIMER) & ~LVT_MASKED);
+		return;
+	}
+	low = ICW2_MASTER + irq_num;
+	if(IOAPIC_LEVEL_IRQS & (1 << irq_num)) low |= REDIR_LEVEL;
+	ioapic_write(IOAPIC_REG_REDIR + 2 * ioapic_pin(irq_num), low);
+}
+
+/*
+ * apic_disable_irq
+ *	  DESCRIPTION: Masks an IRQ's redirection entry, or the timer's LVT entry
+ *	  INPUTS: irq_num -- IRQ to mask
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Writes the low half of the entry
+ */
+void apic_disable_irq(uint32_t irq_num) {
+	uint32_t low;
+
+	if(irq_num == APIC_TIMER_IRQ) {
+		lapic_write(LAPIC_LVT_TIMER, lapic_read(LAPIC_LVT_TIMER) | LVT_MASKED);
+		return;
+	}
+	low = (ICW2_MASTER + irq_num) | REDIR_MASKED;
+	if(IOAPIC_LEVEL_IRQS & (1 << irq_num)) low |= REDIR_LEVEL;
+	ioapic_write(IOAPIC_REG_REDIR + 2 * ioapic_pin(irq_num), low);
+}
+
+/*
+ * apic_timer_start
+ *	  DESCRIPTION: Runs the local APIC timer periodically at about hz, or
+ *				   stops it. Its interrupts arrive as APIC_TIMER_IRQ once
+ *				   a handler is registered there
+ *	  INPUTS: hz -- interrupts per second, 0 to stop
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Keeps the LVT entry's mask bit
+ */
+void apic_timer_start(uint32_t hz) {
+	uint32_t masked;
+
+	if(!apic_enabled) return;
+	masked = lapic_read(LAPIC_LVT_TIMER) & LVT_MASKED;
+	lapic_write(LAPIC_TIMER_INIT, 0);
+	if(!hz) return;
+
+	lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+	lapic_write(LAPIC_LVT_TIMER, (ICW2_MASTER + APIC_TIMER_IRQ) | LVT_PERIODIC | masked);
+	lapic_write(LAPIC_TIMER_INIT, timer_rate / hz);
+}
+
+/*
+ * apic_timer_rate
+ *	  DESCRIPTION: Reports the calibrated timer frequency
+ *	  INPUTS: None
+ *	  OUTPUTS: counts per second, 0 if the APICs aren't in use
+ *	  SIDE EFFECTS: None
+ */
+uint32_t apic_timer_rate(void) {
+	return apic_enabled ? timer_rate : 0;
+}
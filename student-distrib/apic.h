@@ -0,0 +1,86 @@
+/* apic.h - Defines used in interactions with the local APIC and the
+ * I/O APIC, which replace the 8259 when the machine has them
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+
+/* Default physical addresses, both in the 4 MB page at 0xFEC00000 */
+#define IOAPIC_BASE         0xFEC00000
+#define LAPIC_DEFAULT_BASE  0xFEE00000
+
+/* IA32_APIC_BASE MSR: base address and global enable */
+#define MSR_APIC_BASE       0x1B
+#define APIC_BASE_ENABLE    0x800
+#define APIC_BASE_MASK      0xFFFFF000
+
+/* CPUID leaf 1 EDX bit for an on-chip local APIC */
+#define CPUID_EDX_APIC      (1 << 9)
+
+/* Local APIC registers (offsets from the base) */
+#define LAPIC_ID            0x020
+#define LAPIC_VERSION       0x030
+#define LAPIC_TPR           0x080
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ESR           0x280
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_LVT_ERROR     0x370
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE  0x3E0
+
+#define LAPIC_SVR_ENABLE    0x100
+#define LVT_MASKED          (1 << 16)
+#define LVT_PERIODIC        (1 << 17)
+#define LVT_NMI             (4 << 8)
+#define TIMER_DIVIDE_16     0x3
+
+/* I/O APIC registers, selected through IOREGSEL and accessed in IOWIN */
+#define IOAPIC_IOREGSEL     0x00
+#define IOAPIC_IOWIN        0x10
+#define IOAPIC_REG_VERSION  0x01
+#define IOAPIC_REG_REDIR    0x10	/* two registers per pin */
+
+/* Redirection entry bits, the rest are 0: fixed delivery, physical destination */
+#define REDIR_LEVEL         (1 << 15)
+#define REDIR_MASKED        (1 << 16)
+#define REDIR_DEST_SHIFT    24
+
+/* ISA IRQs that are PCI interrupt links on the PIIX, so level-triggered
+ *	(the overrides QEMU's MADT lists) */
+#define IOAPIC_LEVEL_IRQS   ((1 << 5) | (1 << 9) | (1 << 10) | (1 << 11))
+
+/* The PIT is wired to I/O APIC pin 2, the 8259 cascade's place */
+#define IOAPIC_PIT_PIN      2
+
+/* IRQ numbers past the 16 ISA ones, their vectors continue from 0x2F */
+#define APIC_TIMER_IRQ      16
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/* Nonzero once apic_init has moved interrupts off the 8259 */
+extern uint32_t apic_enabled;
+
+/* Switches to the APICs if present, returns 0 if it did, -1 to keep the 8259 */
+int32_t apic_init(void);
+
+/* Interrupt controller operations for i8259.c while apic_enabled */
+void apic_eoi(void);
+void apic_enable_irq(uint32_t irq_num);
+void apic_disable_irq(uint32_t irq_num);
+
+/* Periodic local APIC timer on APIC_TIMER_IRQ, 0 stops it */
+void apic_timer_start(uint32_t hz);
+
+/* Timer counts per second measured against the PIT, 0 without a local APIC */
+uint32_t apic_timer_rate(void);
+
+/* Spurious interrupt entry, defined in irq.S */
+extern void apic_spurious();
+
+#endif /* _APIC_H */
@@ -0,0 +1,498 @@
+#include "ata.h"
+#include "pci.h"
+#include "../i8259.h"
+#include "../lib.h"
+#include "../klog.h"
+
+/* Primary channel of the legacy IDE controller */
+#define ATA_IO              0x1F0
+#define ATA_CTRL            0x3F6
+#define ATA_IRQ             14
+
+/* Task file registers (offsets from ATA_IO) */
+#define REG_DATA            0
+#define REG_ERROR           1
+#define REG_SECCOUNT        2
+#define REG_LBA0            3
+#define REG_LBA1            4
+#define REG_LBA2            5
+#define REG_DRIVE           6
+#define REG_STATUS          7
+#define REG_COMMAND         7
+
+#define STATUS_ERR          0x01
+#define STATUS_DRQ          0x08
+#define STATUS_DF           0x20
+#define STATUS_BSY          0x80
+
+#define CTRL_NIEN           0x02
+
+#define DRIVE_LBA           0xE0
+#define DRIVE_SLAVE         0x10
+
+#define CMD_READ_PIO        0x20
+#define CMD_WRITE_PIO       0x30
+#define CMD_READ_DMA        0xC8
+#define CMD_WRITE_DMA       0xCA
+#define CMD_FLUSH           0xE7
+#define CMD_IDENTIFY        0xEC
+
+/* IDENTIFY words holding the number of LBA28 sectors */
+#define IDENT_LBA_LOW       60
+#define IDENT_LBA_HIGH      61
+
+/* Bus master registers (offsets from BAR4) */
+#define BM_COMMAND          0
+#define BM_STATUS           2
+#define BM_PRDT             4
+
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08 /* device to memory */
+#define BM_STATUS_ACTIVE    0x01
+#define BM_STATUS_ERR       0x02
+#define BM_STATUS_IRQ       0x04
+
+#define ENABLE_BUS_MASTERING 4
+
+/* PIIX3/PIIX4 IDE functions (the chipsets qemu emulates) */
+#define VENDOR_ID           0x8086
+#define PIIX3_IDE_ID        0x7010
+#define PIIX4_IDE_ID        0x7111
+
+#define NUM_DRIVES          2
+
+/* A single command moves at most 256 sectors */
+#define ATA_MAX_BLOCKS      (256 / SECTORS_PER_BLOCK)
+
+/* Each PRD may not cross a 64 kB boundary, a 128 kB transfer needs at most 3 */
+#define NUM_PRDS            8
+#define PRD_BOUNDARY        0x10000
+#define PRD_EOT             0x8000
+
+/* Iterations to wait for the drive before giving up */
+#define ATA_TIMEOUT         1000000
+
+typedef struct __attribute__((packed)) prd {
+    uint32_t addr;
+    uint16_t count; // 0 means 64 kB
+    uint16_t flags;
+} prd_t;
+
+typedef struct ata_drive {
+    uint8_t present;
+    uint32_t num_sectors;
+} ata_drive_t;
+
+static pci_device_t device;
+static uint32_t bm_base;
+static uint8_t use_dma;
+
+static ata_drive_t drives[NUM_DRIVES];
+static const int8_t* drive_names[NUM_DRIVES] = {"hda1", "hdb1"};
+
+/* The filesystem partition */
+static uint8_t part_drive;
+static uint32_t part_start;
+
+static prd_t prdt[NUM_PRDS] __attribute__((aligned(64)));
+
+/* Request being serviced and requests waiting, sorted by block */
+static block_request_t* active;
+static block_request_t* queue;
+static uint32_t head_pos; // block after the last one transferred
+
+/* Progress of the active PIO request, which moves a sector per interrupt */
+static uint8_t* pio_buf;
+static uint32_t pio_left; // sectors still to transfer
+static uint8_t pio_flushing;
+
+/* Driver statistics */
+static uint32_t num_requests, num_dma, num_pio, blocks_read, blocks_written;
+
+static int32_t ata_submit(block_dev_t* dev, block_request_t* req);
+static void ata_poll(block_dev_t* dev);
+
+static block_dev_t ata_dev = {
+    .submit = ata_submit,
+    .poll = ata_poll,
+    .map = NULL,
+};
+
+// Waits the 400ns the drive needs to update its status after a command
+static void ata_delay(void) {
+    inb(ATA_CTRL);
+    inb(ATA_CTRL);
+    inb(ATA_CTRL);
+    inb(ATA_CTRL);
+}
+
+// Waits for BSY to clear, returns the status or -1 on timeout
+static int32_t ata_wait_ready(void) {
+    uint32_t i, status;
+    for (i = 0; i < ATA_TIMEOUT; i++) {
+        status = inb(ATA_IO + REG_STATUS);
+        if (!(status & STATUS_BSY)) return status;
+    }
+    return -1;
+}
+
+// Waits until the drive wants data, returns -1 on error or timeout
+static int32_t ata_wait_drq(void) {
+    uint32_t i, status;
+    for (i = 0; i < ATA_TIMEOUT; i++) {
+        status = inb(ATA_IO + REG_STATUS);
+        if (status & (STATUS_ERR | STATUS_DF)) return -1;
+        if (!(status & STATUS_BSY) && (status & STATUS_DRQ)) return 0;
+    }
+    return -1;
+}
+
+// Selects a drive and loads the LBA28 address and sector count
+static int32_t ata_setup(uint8_t drive, uint32_t lba, uint32_t sectors) {
+    outb(DRIVE_LBA | (drive ? DRIVE_SLAVE : 0) | ((lba >> 24) & 0x0F), ATA_IO + REG_DRIVE);
+    ata_delay();
+    if (ata_wait_ready() == -1) return -1;
+    outb(sectors & 0xFF, ATA_IO + REG_SECCOUNT); // 256 is sent as 0
+    outb(lba & 0xFF, ATA_IO + REG_LBA0);
+    outb((lba >> 8) & 0xFF, ATA_IO + REG_LBA1);
+    outb((lba >> 16) & 0xFF, ATA_IO + REG_LBA2);
+    return 0;
+}
+
+// Moves one sector between buf and the data register
+static void ata_pio_sector(uint8_t* buf, uint8_t write) {
+    if (write) {
+        asm volatile ("cld; rep outsw"
+                : "+S"(buf)
+                : "d"(ATA_IO + REG_DATA), "c"(SECTOR_SIZE / 2)
+                : "memory", "cc");
+    } else {
+        asm volatile ("cld; rep insw"
+                : "+D"(buf)
+                : "d"(ATA_IO + REG_DATA), "c"(SECTOR_SIZE / 2)
+                : "memory", "cc");
+    }
+}
+
+// Transfers sectors by programmed I/O, polling the drive. Only for probing,
+// requests use the interrupt driven ata_pio_step
+static int32_t ata_pio(uint8_t drive, uint32_t lba, uint32_t sectors, uint8_t* buf, uint8_t write) {
+    uint32_t i;
+
+    if (ata_setup(drive, lba, sectors)) return -1;
+    outb(write ? CMD_WRITE_PIO : CMD_READ_PIO, ATA_IO + REG_COMMAND);
+    ata_delay();
+
+    for (i = 0; i < sectors; i++, buf += SECTOR_SIZE) {
+        if (ata_wait_drq()) return -1;
+        ata_pio_sector(buf, write);
+    }
+
+    if (write) {
+        outb(CMD_FLUSH, ATA_IO + REG_COMMAND);
+        ata_delay();
+    }
+    if (ata_wait_ready() & (STATUS_ERR | STATUS_DF)) return -1;
+    return 0;
+}
+
+// Points the PRD table at a buffer, splitting it at 64 kB boundaries
+static void ata_build_prdt(uint32_t addr, uint32_t size) {
+    uint32_t i, len;
+    for (i = 0; size; i++) {
+        len = PRD_BOUNDARY - (addr & (PRD_BOUNDARY - 1));
+        if (len > size) len = size;
+        prdt[i].addr = addr;
+        prdt[i].count = len & 0xFFFF;
+        prdt[i].flags = 0;
+        addr += len;
+        size -= len;
+    }
+    prdt[i - 1].flags = PRD_EOT;
+}
+
+// Ends a request that never reached the drive
+static void ata_fail(block_request_t* req) {
+    req->status = BLOCK_ERROR;
+    req->done = 1;
+    if (req->callback) req->callback(req);
+}
+
+// Starts the next queued request, C-LOOK order (interrupts must be off)
+static void ata_start(void) {
+    block_request_t **link, **pick;
+    block_request_t* req;
+    uint32_t lba, sectors;
+
+    while (!active && queue) {
+        // First request at or after the head, wrap to the lowest block if none
+        pick = &queue;
+        for (link = &queue; *link; link = &(*link)->next) {
+            if ((*link)->block >= head_pos) {
+                pick = link;
+                break;
+            }
+        }
+        req = *pick;
+        *pick = req->next;
+        req->next = NULL;
+
+        lba = part_start + req->block * SECTORS_PER_BLOCK;
+        sectors = req->count * SECTORS_PER_BLOCK;
+        head_pos = req->block + req->count;
+        if (req->write) blocks_written += req->count;
+        else blocks_read += req->count;
+
+        if (!use_dma) {
+            // No bus master: the drive interrupts for each sector, reads
+            // once it has one ready and writes once it has taken one
+            num_pio++;
+            if (ata_setup(part_drive, lba, sectors)) {
+                ata_fail(req);
+                continue;
+            }
+            pio_buf = req->buf;
+            pio_left = sectors;
+            pio_flushing = 0;
+            outb(req->write ? CMD_WRITE_PIO : CMD_READ_PIO, ATA_IO + REG_COMMAND);
+            if (req->write) {
+                // The first sector goes as soon as the drive asks for it
+                ata_delay();
+                if (ata_wait_drq()) {
+                    ata_fail(req);
+                    continue;
+                }
+                ata_pio_sector(pio_buf, 1);
+                pio_buf += SECTOR_SIZE;
+                pio_left--;
+            }
+            active = req;
+            continue;
+        }
+
+        num_dma++;
+        ata_build_prdt((uint32_t)req->buf, req->count * BLOCK_SIZE);
+        outl((uint32_t)prdt, bm_base + BM_PRDT);
+        outb(req->write ? 0 : BM_CMD_READ, bm_base + BM_COMMAND);
+        outb(BM_STATUS_ERR | BM_STATUS_IRQ, bm_base + BM_STATUS); // write 1 to clear
+
+        if (ata_setup(part_drive, lba, sectors)) {
+            ata_fail(req);
+            continue;
+        }
+        active = req;
+        outb(req->write ? CMD_WRITE_DMA : CMD_READ_DMA, ATA_IO + REG_COMMAND);
+        outb((req->write ? 0 : BM_CMD_READ) | BM_CMD_START, bm_base + BM_COMMAND);
+    }
+}
+
+// Ends the active request and starts the next (interrupts must be off)
+static void ata_finish(int32_t status) {
+    block_request_t* req = active;
+
+    active = NULL;
+    req->status = status;
+    req->done = 1;
+
+    // Keep the drive busy before running the callback
+    ata_start();
+    if (req->callback) req->callback(req);
+}
+
+// Moves the active PIO request on by a sector if the drive is ready for it,
+// issuing the cache flush after the last sector of a write
+static void ata_pio_step(void) {
+    uint32_t status;
+
+    if (inb(ATA_CTRL) & STATUS_BSY) return; // alternate status, doesn't acknowledge
+    status = inb(ATA_IO + REG_STATUS); // acknowledges the drive's interrupt
+    if (status & (STATUS_ERR | STATUS_DF)) {
+        ata_finish(BLOCK_ERROR);
+        return;
+    }
+
+    if (pio_flushing) {
+        ata_finish(BLOCK_OK);
+    } else if (pio_left) {
+        if (!(status & STATUS_DRQ)) return;
+        ata_pio_sector(pio_buf, active->write);
+        pio_buf += SECTOR_SIZE;
+        pio_left--;
+        if (!pio_left && !active->write) ata_finish(BLOCK_OK);
+    } else {
+        // The drive has taken the last sector of a write
+        pio_flushing = 1;
+        outb(CMD_FLUSH, ATA_IO + REG_COMMAND);
+    }
+}
+
+// Finishes the active request, or a sector of it, if the drive is done.
+// Shared by the irq handler and ata_poll, so it runs with interrupts off
+static void ata_complete(void) {
+    uint32_t flags, bm_status, status;
+
+    cli_and_save(flags);
+
+    if (active && !use_dma) {
+        ata_pio_step();
+        restore_flags(flags);
+        return;
+    }
+
+    bm_status = inb(bm_base + BM_STATUS);
+    if (!active || !(bm_status & BM_STATUS_IRQ)) {
+        restore_flags(flags);
+        return;
+    }
+
+    outb(0, bm_base + BM_COMMAND); // stop the engine
+    status = inb(ATA_IO + REG_STATUS); // also acknowledges the drive's interrupt
+    outb(BM_STATUS_ERR | BM_STATUS_IRQ, bm_base + BM_STATUS);
+
+    ata_finish(((status & (STATUS_ERR | STATUS_DF)) || (bm_status & BM_STATUS_ERR)) ? BLOCK_ERROR : BLOCK_OK);
+
+    restore_flags(flags);
+}
+
+static void ata_interrupt(void) {
+    if (!active) {
+        inb(ATA_IO + REG_STATUS); // spurious, just acknowledge it
+        return;
+    }
+    ata_complete();
+}
+
+static void ata_poll(block_dev_t* dev) {
+    ata_complete();
+}
+
+/* static int32_t ata_submit(block_dev_t* dev, block_request_t* req);
+ * Inputs: dev - the partition device
+ *			req - list of requests to queue
+ * Return Value: BLOCK_OK, or BLOCK_ERROR if a request is out of range or too large
+ * Function: Sorts the requests into the queue and starts one if the drive is idle
+ */
+static int32_t ata_submit(block_dev_t* dev, block_request_t* req) {
+    block_request_t **link, *r, *next;
+    uint32_t flags;
+
+    for (r = req; r; r = r->next) {
+        if (!r->count || r->count > ATA_MAX_BLOCKS) return BLOCK_ERROR;
+        if (r->block + r->count > dev->num_blocks) return BLOCK_ERROR;
+    }
+
+    cli_and_save(flags);
+    for (r = req; r; r = next) {
+        next = r->next;
+        num_requests++;
+        for (link = &queue; *link && (*link)->block <= r->block; link = &(*link)->next);
+        r->next = *link;
+        *link = r;
+    }
+    ata_start();
+    restore_flags(flags);
+
+    return BLOCK_OK;
+}
+
+// Sends IDENTIFY to a drive, returns the number of sectors or 0 if absent
+static uint32_t ata_identify(uint8_t drive) {
+    uint16_t ident[SECTOR_SIZE / 2];
+    uint32_t i, status;
+
+    outb(DRIVE_LBA | (drive ? DRIVE_SLAVE : 0), ATA_IO + REG_DRIVE);
+    ata_delay();
+    outb(0, ATA_IO + REG_SECCOUNT);
+    outb(0, ATA_IO + REG_LBA0);
+    outb(0, ATA_IO + REG_LBA1);
+    outb(0, ATA_IO + REG_LBA2);
+    outb(CMD_IDENTIFY, ATA_IO + REG_COMMAND);
+    ata_delay();
+
+    status = inb(ATA_IO + REG_STATUS);
+    if (status == 0 || status == 0xFF) return 0; // nothing there
+    if (ata_wait_ready() == -1) return 0;
+    // ATAPI and SATA devices set these, we only talk to ATA disks
+    if (inb(ATA_IO + REG_LBA1) || inb(ATA_IO + REG_LBA2)) return 0;
+    if (ata_wait_drq()) return 0;
+
+    for (i = 0; i < SECTOR_SIZE / 2; i++) {
+        ident[i] = inw(ATA_IO + REG_DATA);
+    }
+    return ident[IDENT_LBA_LOW] | ((uint32_t)ident[IDENT_LBA_HIGH] << 16);
+}
+
+// Looks for the filesystem partition in a drive's MBR
+static int32_t ata_find_partition(uint8_t drive) {
+    uint8_t mbr[SECTOR_SIZE];
+    uint32_t start, num_sectors;
+
+    if (ata_pio(drive, 0, 1, mbr, 0)) return -1;
+    if (mbr_find_partition(mbr, FS_PART_TYPE, &start, &num_sectors)) return -1;
+    if (start + num_sectors > drives[drive].num_sectors) return -1;
+
+    part_drive = drive;
+    part_start = start;
+    ata_dev.name = drive_names[drive];
+    ata_dev.num_blocks = num_sectors / SECTORS_PER_BLOCK;
+    return 0;
+}
+
+/* block_dev_t* ata_init(void);
+ * Inputs: none
+ * Return Value: block device for the filesystem partition, NULL if there is none
+ * Function: Probes the primary IDE channel for a disk with a partition of type
+ *				FS_PART_TYPE and sets up bus master DMA if the controller has it
+ */
+block_dev_t* ata_init(void) {
+    uint8_t drive;
+
+    // Nothing on the channel if the status register floats
+    if (inb(ATA_IO + REG_STATUS) == 0xFF) return NULL;
+
+    // Poll during probing
+    outb(CTRL_NIEN, ATA_CTRL);
+
+    for (drive = 0; drive < NUM_DRIVES; drive++) {
+        drives[drive].num_sectors = ata_identify(drive);
+        drives[drive].present = drives[drive].num_sectors != 0;
+    }
+    for (drive = 0; drive < NUM_DRIVES; drive++) {
+        if (drives[drive].present && !ata_find_partition(drive)) break;
+    }
+    if (drive == NUM_DRIVES) return NULL;
+
+    // Bus mastering lives in BAR4 of the IDE function
+    use_dma = 0;
+    if (!find_device(&device, VENDOR_ID, PIIX3_IDE_ID) || !find_device(&device, VENDOR_ID, PIIX4_IDE_ID)) {
+        if (device.bar[4].is_port && device.bar_addr[4]) {
+            bm_base = device.bar_addr[4];
+            device.command |= ENABLE_BUS_MASTERING;
+            pci_update(&device, PCI_COMMAND_OFFSET);
+            use_dma = 1;
+        }
+    }
+
+    active = NULL;
+    queue = NULL;
+    head_pos = 0;
+
+    // DMA and PIO requests both complete by interrupt
+    inb(ATA_IO + REG_STATUS);
+    outb(0, ATA_CTRL);
+    register_interrupt_handler(ATA_IRQ, ata_interrupt);
+
+    klog(KLOG_INFO, "ata: %s, %u blocks at lba %u, %s\n", ata_dev.name, ata_dev.num_blocks,
+            part_start, use_dma ? "dma" : "pio");
+    return &ata_dev;
+}
+
+/* void ata_print_stats(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Prints how many requests the driver has serviced and how
+ */
+void ata_print_stats(void) {
+    printf("ata: %u requests (%u dma, %u pio), %u blocks read, %u blocks written\n",
+            num_requests, num_dma, num_pio, blocks_read, blocks_written);
+}
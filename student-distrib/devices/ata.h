@@ -0,0 +1,10 @@
+#ifndef ATA_H
+#define ATA_H
+
+#include "../lib.h"
+#include "../filesystem/block_dev.h"
+
+block_dev_t* ata_init(void);
+void ata_print_stats(void);
+
+#endif /* ATA_H */
@@ -4,9 +4,15 @@
 #include "../paging.h"
 #include "../i8259.h"
 #include "../lib.h"
+#include "../softirq.h"
+#include "../trace.h"
+#include "../klog.h"
 
 static pci_device_t device;
 
+// Runs receive_packet after the interrupt, with interrupts on
+static tasklet_t rx_tasklet;
+
 #define VENDOR_ID           0x8086
 #define DEVICE_ID           0x100E
 
@@ -164,7 +170,7 @@ static uint16_t read_eeprom(uint8_t addr) {
 }
 
 // TODO
-static void receive_packet(void) {
+static void receive_packet(uint32_t arg) {
     uint32_t counter;
     while (1) {
         counter = rx_counter;
@@ -172,6 +178,7 @@ static void receive_packet(void) {
         // (order doesn't really matter, because we only take one interrupt at a time)
         if (rx_descs[counter].status_DD && rx_descs[counter].status_EOP) {
             //printf("Parsing packet\n");
+            tracepoint(TRACE_RX, counter, rx_descs[counter].length, 0, 0);
             parse_packet((uint8_t*)rx_descs[counter].addr_low);
             rx_descs[counter].status_DD = 0;
         } else {
@@ -186,16 +193,16 @@ static void receive_packet(void) {
 // TODO
 static void e1000_interrupt(void) {
     uint32_t status;
-    status = in(REG_ICR);
+    status = in(REG_ICR); // reading ICR acknowledges the interrupt
     if (status & INT_RXT0) {
-        receive_packet();
+        tasklet_schedule(&rx_tasklet);
     }
     if (status & INT_RXO) {
-        printf("ICR: 0x%x\n", status);
+        klog(KLOG_ERR, "e1000: ICR 0x%x\n", status);
         die("Rx overflow!\n");
     }
     if (status & INT_RXSEQ) {
-        printf("ICR: 0x%x\n", status);
+        klog(KLOG_ERR, "e1000: ICR 0x%x\n", status);
         die("Rx error!\n");
     }
 }
@@ -246,7 +253,7 @@ int e1000_init(void) {
 
     // Reset e1000
     out(REG_CTRL, CTRL_RST);
-    printf("Reset e1000\n"); // wait (lol)
+    klog(KLOG_DEBUG, "e1000: reset\n"); // wait (lol)
     while (in(REG_CTRL) & CTRL_RST);
 
     // Set link up3
@@ -265,6 +272,7 @@ int e1000_init(void) {
     // Clear interrupts
     in(REG_ICR);
     // Register interrupt handler
+    tasklet_init(&rx_tasklet, receive_packet, 0);
     register_interrupt_handler(device.int_line, e1000_interrupt);
 
     // MTA
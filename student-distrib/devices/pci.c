@@ -1,4 +1,5 @@
 #include "../lib.h"
+#include "../klog.h"
 #include "pci.h"
 
 #define OFFSET_MASK_LOW 0x03
@@ -58,29 +59,34 @@ uint8_t pci_read_byte(uint32_t bus, uint32_t slot, uint32_t func, uint32_t offse
 
 // TODO
 int find_device(pci_device_t* dev, uint16_t vendor, uint16_t device) {
-  uint32_t bus, slot, func=0;
+  uint32_t bus, slot, func, num_funcs;
   uint32_t i;
   uint32_t n = (device << 16) | vendor;
   for (bus = 0; bus < 256; bus++) {
     for (slot = 0; slot < 32; slot++) {
-      if (pci_read_long(bus, slot, func, /* device/vendor id */ 0) == n) {
-        dev->bus = bus;
-        dev->slot = slot;
-        dev->func = func;
-        for (i = 0; i < 16; i++) {
-          dev->regs[i] = pci_read_long(bus, slot, func, i);
-        }
-        for (i = 0; i < 6; i++) {
-          if (dev->bar[i].is_port) {
-            dev->bar_addr[i] = dev->bar[i].value & PCI_BAR_PORT;
-          } else {
-            dev->bar_addr[i] = dev->bar[i].value & PCI_BAR_MEM;
+      // Only multi-function devices (e.g. the PIIX IDE controller) have functions 1-7
+      if ((pci_read_long(bus, slot, 0, 0) & 0xFFFF) == PCI_NO_VENDOR) continue;
+      num_funcs = (pci_read_long(bus, slot, 0, PCI_HEADER_REG) & PCI_MULTI_FUNCTION) ? 8 : 1;
+      for (func = 0; func < num_funcs; func++) {
+        if (pci_read_long(bus, slot, func, /* device/vendor id */ 0) == n) {
+          dev->bus = bus;
+          dev->slot = slot;
+          dev->func = func;
+          for (i = 0; i < 16; i++) {
+            dev->regs[i] = pci_read_long(bus, slot, func, i);
+          }
+          for (i = 0; i < 6; i++) {
+            if (dev->bar[i].is_port) {
+              dev->bar_addr[i] = dev->bar[i].value & PCI_BAR_PORT;
+            } else {
+              dev->bar_addr[i] = dev->bar[i].value & PCI_BAR_MEM;
+            }
           }
+          return 0;
         }
-        return 0;
       }
     }
   }
-  printf("Bummer\n");
+  klog(KLOG_DEBUG, "pci: no device %x:%x\n", vendor, device);
   return -1;
 }
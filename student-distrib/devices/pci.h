@@ -32,6 +32,10 @@
 
 #define PCI_INTERRUPT_LINE_OFFSET 0x3F
 
+#define PCI_HEADER_REG 0x3
+#define PCI_MULTI_FUNCTION 0x800000
+#define PCI_NO_VENDOR 0xFFFF
+
 uint32_t pci_read_long(uint32_t bus, uint32_t slot, uint32_t func, uint32_t reg);
 uint16_t pci_read_short(uint32_t bus, uint32_t slot, uint32_t func, uint32_t offset);
 uint8_t pci_read_byte(uint32_t bus, uint32_t slot, uint32_t func, uint32_t offset);
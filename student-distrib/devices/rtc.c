@@ -4,13 +4,17 @@
 
 #include "../i8259.h"
 #include "../lib.h"
+#include "../softirq.h"
 
 #include "devices.h"
 #include "rtc.h"
+#include "time_page.h"
 
-file_ops_t file_ops_rtc = {rtc_read, rtc_write, rtc_open, rtc_close};
+file_ops_t file_ops_rtc = {rtc_read, rtc_write, rtc_open, rtc_close,
+                           NULL, NULL, NULL, NULL, NULL, NULL, NULL, rtc_poll};
 
 static void rtc_handler();
+static void rtc_run_timers(void);
 static int32_t get_new_freq(const void* buf);
 
 static uint32_t counter = 0;
@@ -30,7 +34,8 @@ uint32_t num_handlers = 0;
  *    DESCRIPTION: Initializes the RTC at IRQ 8
  *    INPUTS: None
  *    OUTPUTS: None
- *    SIDE EFFECTS: Adds rtc_handler to IRQ 8 handler
+ *    SIDE EFFECTS: Adds rtc_handler to IRQ 8 handler, rtc_run_timers to
+ *                  the timer softirq
  */
 void rtc_init() {
   uint8_t prev, rate;
@@ -47,6 +52,7 @@ void rtc_init() {
   outb(REG_A, RTC_REG);
   outb((prev & 0xF0) | rate, RTC_DATA); // USE 0xF0 to bitmask
 
+  open_softirq(SOFTIRQ_TIMER, rtc_run_timers);
   register_interrupt_handler(RTC_IRQ, (void*) rtc_handler);
 }
 
@@ -55,22 +61,44 @@ void rtc_init() {
  *    DESCRIPTION: Handler for RTC interrupts
  *    INPUTS: None
  *    OUTPUTS: None
- *    SIDE EFFECTS: Reads RTC reg C and calls test_interrupts
+ *    SIDE EFFECTS: Reads RTC reg C, raises the timer softirq if any
+ *                  callbacks are waiting
  */
 static void rtc_handler() {
   ++counter;
+  time_page_tick(counter);
 
+  // Expired callbacks run after the EOI, with interrupts on
+  if (num_handlers) raise_softirq(SOFTIRQ_TIMER);
+
+  // Need to read data or it won't unmask
+  outb(REG_C, RTC_REG);
+  inb(RTC_DATA);
+}
+
+/*
+ * rtc_run_timers
+ *    DESCRIPTION: Timer softirq, calls and removes every expired callback
+ *    INPUTS: None
+ *    OUTPUTS: None
+ *    SIDE EFFECTS: Callbacks run with interrupts on and may register more
+ */
+static void rtc_run_timers(void) {
+  handler_t h;
+  uint32_t flags;
   int i;
+
+  cli_and_save(flags);
   for (i = 0; i < num_handlers; ++i) {
     if (handlers[i].time < counter) {
-      handlers[i].function(handlers[i].arg);
+      h = handlers[i];
       handlers[i--] = handlers[--num_handlers];
+      restore_flags(flags);
+      h.function(h.arg);
+      cli_and_save(flags);
     }
   }
-
-  // Need to read data or it won't unmask
-  outb(REG_C, RTC_REG);
-  inb(RTC_DATA);
+  restore_flags(flags);
 }
 
 /*
@@ -103,14 +131,14 @@ int32_t rtc_close(int32_t fd) {
  * rtc_read
  *    DESCRIPTION: read function for RTC driver
  *    INPUTS: None
- *    OUTPUTS: None
+ *    OUTPUTS: 0, -EAGAIN if the fd is O_NONBLOCK and its period hasn't passed
  *    SIDE EFFECTS: wait until interrupt happens
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
   int32_t curr_fd = fd;
   uint32_t c = fd_table[curr_fd].file_pos;
-  fd_table[curr_fd].flags &= LOW_BITS;
-  uint32_t f = fd_table[curr_fd].flags;
+  uint32_t f = fd_table[curr_fd].flags & LOW_BITS;
+  if((fd_table[curr_fd].flags & O_NONBLOCK) && !(f < counter - c)) return -EAGAIN;
   while(1) {
    if(f < counter - c) break;
   }
@@ -134,7 +162,7 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
   for(i = 0; rate > 1; ++i) rate = rate >> 1; // Find pwer of 2
 
   for(i = (16-RTC_MAX-i); i > 0; i--) rate *= 2; // 16 is the maximum exponent
-  fd_table[fd].flags = rate;
+  fd_table[fd].flags = (fd_table[fd].flags & ~LOW_BITS) | rate;
   return 0;
 }
 
@@ -154,6 +182,43 @@ uint32_t rtc_wait(uint32_t duration_ms) {
   return counter + (duration_ms*OS_RTC_MAX)/1000;
 }
 
+/*
+ * rtc_read_ready
+ *    DESCRIPTION: checks whether rtc_read on fd would return without waiting
+ *    INPUTS: fd -- file descriptor of an open RTC
+ *    OUTPUTS: 1 if the fd's period has passed, 0 otherwise
+ *    SIDE EFFECTS: None
+ */
+int32_t rtc_read_ready(int32_t fd) {
+  return (fd_table[fd].flags & LOW_BITS) < counter - fd_table[fd].file_pos;
+}
+
+/*
+ * rtc_poll
+ *    DESCRIPTION: poll operation for the RTC, writes only set the rate
+ *    INPUTS: fd -- file descriptor of an open RTC
+ *            events -- POLLIN and/or POLLOUT
+ *    OUTPUTS: POLLOUT if asked for, POLLIN if asked for and the period has passed
+ *    SIDE EFFECTS: None
+ */
+int32_t rtc_poll(int32_t fd, int32_t events) {
+  int32_t revents = events & POLLOUT;
+
+  if (rtc_read_ready(fd)) revents |= events & POLLIN;
+  return revents;
+}
+
+/*
+ * rtc_get_ticks
+ *    DESCRIPTION: returns the number of RTC interrupts since boot
+ *    INPUTS: None
+ *    OUTPUTS: ticks at OS_RTC_MAX Hz
+ *    SIDE EFFECTS: None
+ */
+uint32_t rtc_get_ticks(void) {
+  return counter;
+}
+
 // TODO
 uint32_t rtc_check(uint32_t stop) {
   return stop > counter;
@@ -161,10 +226,14 @@ uint32_t rtc_check(uint32_t stop) {
 
 // TODO
 uint32_t rtc_register_handler(void(*function)(uint32_t), uint32_t arg, uint32_t wait) {
+  uint32_t flags;
+
+  cli_and_save(flags);
   int n = num_handlers++;
   int t = rtc_wait(wait);
   handlers[n].function = function;
   handlers[n].arg = arg;
   handlers[n].time = t;
+  restore_flags(flags);
   return t;
 }
@@ -0,0 +1,182 @@
+/* time_page.c - Keeps the shared time page current from the RTC interrupt
+ * vim:ts=4 noexpandtab
+ */
+
+#include "../lib.h"
+#include "../paging.h"
+#include "../idt.h"				/* For sysenter_enabled */
+#include "devices.h"			/* For rtc_get_ticks */
+#include "rtc.h"
+#include "time_page.h"
+
+/* CMOS clock registers */
+#define CMOS_SECONDS 0x00
+#define CMOS_MINUTES 0x02
+#define CMOS_HOURS 0x04
+#define CMOS_DAY 0x07
+#define CMOS_MONTH 0x08
+#define CMOS_YEAR 0x09
+#define REG_A_UPDATING 0x80
+#define REG_B_24_HOUR 0x02
+#define REG_B_BINARY 0x04
+#define HOUR_PM 0x80
+
+/* Also the slowest TSC rate tsc_us_mult handles, its quotient must fit in 32 bits */
+#define US_PER_SEC 1000000
+
+#define SECS_PER_DAY 86400
+
+static time_page_t page __attribute__((aligned(FOUR_KB)));
+
+/* TSC at the start of the current second, for calibration */
+static uint32_t second_tsc;
+static uint8_t second_started = 0;
+
+/* Cycles halted in poll since boot */
+static uint64_t idle_cycles = 0;
+
+/* Days before the first of each month in a non-leap year */
+static const uint16_t month_days[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+/* static uint8_t cmos_read(uint8_t reg, uint8_t reg_b);
+ * Inputs: reg - CMOS clock register
+ *			reg_b - status register B, for the number format
+ * Return Value: the register's value in binary
+ * Function: Reads a clock register, converting from BCD if needed
+ */
+static uint8_t cmos_read(uint8_t reg, uint8_t reg_b) {
+	uint8_t val;
+
+	outb(reg, RTC_REG);
+	val = inb(RTC_DATA);
+	if(reg_b & REG_B_BINARY) return val;
+	return (val & ~HOUR_PM & 0xF0) / 16 * 10 + (val & 0x0F) + (val & HOUR_PM);
+}
+
+/* static uint32_t cmos_wall_time(void);
+ * Inputs: none
+ * Return Value: seconds since 1970
+ * Function: Reads the date and time once the clock isn't mid-update. The
+ *				clock keeps a two digit year, taken to be in 2000-2099
+ */
+static uint32_t cmos_wall_time(void) {
+	uint32_t sec, min, hour, day, month, year, days, y;
+	uint8_t reg_b;
+
+	do {
+		outb(REG_A, RTC_REG);
+	} while(inb(RTC_DATA) & REG_A_UPDATING);
+
+	outb(REG_B, RTC_REG);
+	reg_b = inb(RTC_DATA);
+
+	sec = cmos_read(CMOS_SECONDS, reg_b);
+	min = cmos_read(CMOS_MINUTES, reg_b);
+	hour = cmos_read(CMOS_HOURS, reg_b);
+	day = cmos_read(CMOS_DAY, reg_b);
+	month = cmos_read(CMOS_MONTH, reg_b);
+	year = 2000 + cmos_read(CMOS_YEAR, reg_b);
+
+	/* 12 hour clock: 12 AM is 0, PM sets the top bit */
+	if(!(reg_b & REG_B_24_HOUR)) {
+		if((hour & ~HOUR_PM) == 12) hour &= HOUR_PM;
+		if(hour & HOUR_PM) hour = (hour & ~HOUR_PM) + 12;
+	}
+	if(month < 1 || month > 12) month = 1;
+
+	days = month_days[month - 1] + day - 1;
+	if(month > 2 && year % 4 == 0) days++;
+	for(y = 1970; y < year; ++y) days += y % 4 == 0 ? 366 : 365;
+
+	return days * SECS_PER_DAY + hour * 3600 + min * 60 + sec;
+}
+
+/* static uint32_t tsc_us_mult(uint32_t hz);
+ * Inputs: hz - TSC cycles per second, more than US_PER_SEC
+ * Return Value: 2^32 * US_PER_SEC / hz
+ * Function: Divides a 64-bit numerator with one divl, there is no libgcc
+ *				for a 64-bit division
+ */
+static uint32_t tsc_us_mult(uint32_t hz) {
+	uint32_t q, r;
+
+	asm ("divl %4" : "=a"(q), "=d"(r) : "a"(0), "d"(US_PER_SEC), "rm"(hz));
+	return q;
+}
+
+/* void time_page_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Starts the page at the CMOS time and maps it read-only for user
+ *				programs. The TSC rate is measured over the first full second.
+ *				Must follow idt_init, which decides how syscalls are made
+ */
+void time_page_init(void) {
+	uint64_t tsc = rdtsc();
+
+	memset(&page, 0, sizeof(page));
+	page.tick_hz = TIME_PAGE_HZ;
+	page.ticks = rtc_get_ticks();
+	page.tsc_lo = (uint32_t) tsc;
+	page.tsc_hi = (uint32_t) (tsc >> 32);
+	page.idle_lo = (uint32_t) idle_cycles;
+	page.idle_hi = (uint32_t) (idle_cycles >> 32);
+	page.wall_sec = cmos_wall_time();
+	page.features = sysenter_enabled ? TIME_PAGE_SYSENTER : 0;
+
+	map_shared_frame(TIME_PAGE_INDEX, &page, 0);
+}
+
+/* void time_page_tick(uint32_t ticks);
+ * Inputs: ticks - RTC interrupts since boot
+ * Return Value: none
+ * Function: Advances the page by one tick, runs in the RTC interrupt. Each
+ *				TIME_PAGE_HZ ticks the TSC rate is measured again
+ */
+void time_page_tick(uint32_t ticks) {
+	uint64_t tsc = rdtsc();
+	uint32_t hz;
+
+	page.seq++;
+	asm volatile ("" : : : "memory");
+
+	page.ticks = ticks;
+	page.tsc_lo = (uint32_t) tsc;
+	page.tsc_hi = (uint32_t) (tsc >> 32);
+
+	if(++page.wall_tick == TIME_PAGE_HZ) {
+		page.wall_tick = 0;
+		page.wall_sec++;
+
+		/* The first second started whenever init ran, so it's skipped */
+		hz = (uint32_t) tsc - second_tsc;
+		if(second_started && hz > US_PER_SEC) {
+			page.tsc_hz = hz;
+			page.tsc_us_mult = tsc_us_mult(hz);
+		}
+		second_tsc = (uint32_t) tsc;
+		second_started = 1;
+	}
+
+	asm volatile ("" : : : "memory");
+	page.seq++;
+}
+
+/* void time_page_idle(uint32_t cycles);
+ * Inputs: cycles - time the CPU just spent in hlt
+ * Return Value: none
+ * Function: Accumulates idle time, published on the next tick. Interrupts
+ *				must be off so the tick doesn't see half an update
+ */
+void time_page_idle(uint32_t cycles) {
+	idle_cycles += cycles;
+}
+
+/* const time_page_t* time_page_get(void);
+ * Inputs: none
+ * Return Value: kernel address of the time page
+ * Function: Lets the kernel read the page without going through its user mapping
+ */
+const time_page_t* time_page_get(void) {
+	return &page;
+}
@@ -0,0 +1,47 @@
+/* time_page.h - Read-only page the kernel keeps the time in, mapped into
+ *				every process so reading the clock needs no syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef TIME_PAGE_H
+#define TIME_PAGE_H
+
+#include "../types.h"
+
+/* Updates per second, one per RTC interrupt (see RTC_MAX) */
+#define TIME_PAGE_HZ 1024
+
+/* Bits of features */
+#define TIME_PAGE_SYSENTER 0x1	/* syscalls may use sysenter, else int $0x80 */
+
+/* Layout shared with user programs (ece391support.h). The kernel makes seq
+ *	odd while it updates the page, so a reader retries if seq was odd or
+ *	changed while it copied the fields */
+typedef struct time_page {
+	volatile uint32_t seq;
+	uint32_t tick_hz;			/* TIME_PAGE_HZ */
+	uint32_t ticks;				/* RTC interrupts since boot */
+	uint32_t tsc_lo;			/* time-stamp counter at the last tick */
+	uint32_t tsc_hi;
+	uint32_t tsc_hz;			/* cycles per second, 0 until calibrated */
+	uint32_t tsc_us_mult;		/* microseconds = (cycles * tsc_us_mult) >> 32 */
+	uint32_t wall_sec;			/* seconds since 1970 (UTC, from the CMOS clock) */
+	uint32_t wall_tick;			/* ticks into wall_sec */
+	uint32_t idle_lo;			/* cycles the CPU spent halted in poll, as of the last tick */
+	uint32_t idle_hi;
+	uint32_t features;			/* TIME_PAGE_*, set once at boot */
+} time_page_t;
+
+/* Reads the CMOS clock and maps the page at TIME_PAGE_ADDR */
+void time_page_init(void);
+
+/* Called from the RTC interrupt with the new tick count */
+void time_page_tick(uint32_t ticks);
+
+/* Adds halted cycles to idle_lo/idle_hi, with interrupts off */
+void time_page_idle(uint32_t cycles);
+
+/* Kernel address of the page */
+const time_page_t* time_page_get(void);
+
+#endif /* TIME_PAGE_H */
@@ -0,0 +1,374 @@
+/* uart.c - 16550 UART driver. Writers fill a ring and the transmit FIFO is
+ *				refilled 16 bytes at a time from its empty interrupt; the
+ *				receive FIFO interrupts at 14 bytes or when the line goes
+ *				quiet, so a byte costs a fraction of an interrupt each way
+ * vim:ts=4 noexpandtab
+ */
+
+#include "../lib.h"
+#include "../i8259.h"
+#include "../tty.h"
+#include "../tasks/tasks.h"
+#include "../tasks/screen.h"
+#include "../filesystem/devfs.h"
+#include "../filesystem/filesystem.h" // For fd_table
+#include "uart.h"
+
+#define COM1                0x3F8
+
+// Registers, offsets from COM1
+#define REG_DATA            0 // DLL with LCR_DLAB set
+#define REG_IER             1 // DLM with LCR_DLAB set
+#define REG_IIR             2 // read
+#define REG_FCR             2 // write
+#define REG_LCR             3
+#define REG_MCR             4
+#define REG_LSR             5
+
+#define IER_RX              0x01 // data available or receive timeout
+#define IER_TX              0x02 // transmit FIFO empty
+#define IER_LINE            0x04 // receive errors
+
+#define IIR_NONE            0x01 // no interrupt pending
+#define IIR_FIFO            0xC0 // FIFOs work, a 16550A and not a 16450 or 16550
+
+#define FCR_SETUP           0xC7 // enable, clear both FIFOs, interrupt at 14 received bytes
+#define LCR_DLAB            0x80
+#define LCR_8N1             0x03
+#define MCR_RUN             0x0B // DTR, RTS and OUT2, which connects the IRQ
+#define MCR_LOOPBACK        0x1E // RTS, OUT1, OUT2 and loopback, for the probe
+
+#define LSR_DR              0x01 // data ready
+#define LSR_ERRORS          0x1E // overrun, parity, framing, break
+#define LSR_THRE            0x20 // transmit FIFO empty
+#define LSR_TEMT            0x40 // transmitter idle
+
+#define DIVISOR             1 // 115200 baud, the fastest
+#define PROBE_BYTE          0xAE
+
+// Polls of LSR before deciding the port won't drain, and spins a writer
+//  waits for the transmit interrupt before sending by polling instead
+#define POLL_SPINS          100000
+#define WAIT_SPINS          (1 << 22)
+
+#define ESC                 0x1B
+#define DEL                 0x7F
+
+volatile uint32_t uart_console = 0;
+
+static uint32_t present = 0;
+static uint32_t fifo_size = 1;
+
+static uint8_t tx_ring[UART_TX_RING];
+static volatile uint32_t tx_head = 0, tx_tail = 0;
+static uint32_t tx_busy = 0; // the transmit FIFO has bytes and will interrupt when empty
+
+static uint8_t rx_ring[UART_RX_RING];
+static volatile uint32_t rx_head = 0, rx_tail = 0;
+static uint32_t rx_readers = 0; // open dev/ttyS0 fds, which take input from the terminal
+static uint32_t esc_state = 0; // 1 after ESC, 2 after ESC [
+
+static uart_stats_t stats;
+
+static void uart_interrupt(void);
+static int32_t uart_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t uart_write(int32_t fd, const void* buf, int32_t nbytes);
+static int32_t uart_open(const uint8_t* filename);
+static int32_t uart_close(int32_t fd);
+static int32_t uart_poll(int32_t fd, int32_t events);
+
+static file_ops_t file_ops_uart = {uart_read, uart_write, uart_open, uart_close,
+						NULL, NULL, NULL, NULL, NULL, NULL, NULL, uart_poll};
+
+/* int32_t uart_init(void);
+ * Inputs: none
+ * Return Value: 0 if COM1 is there, -1 otherwise
+ * Function: Checks the port with a loopback test, sets it to 115200 8N1 with
+ *				the FIFOs on, and turns on its interrupts and the console
+ */
+int32_t uart_init(void) {
+    uint32_t iir;
+
+    outb(0, COM1 + REG_IER);
+    outb(LCR_DLAB, COM1 + REG_LCR);
+    outb(DIVISOR & 0xFF, COM1 + REG_DATA);
+    outb(DIVISOR >> 8, COM1 + REG_IER);
+    outb(LCR_8N1, COM1 + REG_LCR);
+    outb(FCR_SETUP, COM1 + REG_FCR);
+
+    outb(MCR_LOOPBACK, COM1 + REG_MCR);
+    outb(PROBE_BYTE, COM1 + REG_DATA);
+    if (inb(COM1 + REG_DATA) != PROBE_BYTE) return -1;
+    outb(MCR_RUN, COM1 + REG_MCR);
+
+    iir = inb(COM1 + REG_IIR);
+    fifo_size = ((iir & IIR_FIFO) == IIR_FIFO) ? UART_FIFO_SIZE : 1;
+    while (inb(COM1 + REG_LSR) & LSR_DR) inb(COM1 + REG_DATA);
+
+    present = 1;
+    register_interrupt_handler(UART_IRQ, uart_interrupt);
+    outb(IER_RX | IER_TX | IER_LINE, COM1 + REG_IER);
+    uart_console = 1;
+
+    devfs_register((const uint8_t*)"ttyS0", &file_ops_uart);
+    return 0;
+}
+
+/* static void uart_start_tx(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Moves up to a FIFO's worth of bytes from the ring to the port,
+ *				with interrupts off. The FIFO must be empty
+ */
+static void uart_start_tx(void) {
+    uint32_t n;
+
+    for (n = 0; n < fifo_size && tx_head != tx_tail; n++) {
+        outb(tx_ring[tx_head % UART_TX_RING], COM1 + REG_DATA);
+        tx_head++;
+    }
+    tx_busy = (n != 0);
+    stats.tx_bytes += n;
+}
+
+/* static void uart_poll_tx(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Waits for the transmit FIFO to empty and refills it, for when
+ *				the interrupt can't come because interrupts are off
+ */
+static void uart_poll_tx(void) {
+    uint32_t spins, head = tx_head;
+
+    for (spins = 0; !(inb(COM1 + REG_LSR) & LSR_THRE) && spins < POLL_SPINS; spins++);
+    uart_start_tx();
+    stats.tx_polled += tx_head - head;
+}
+
+/* void uart_putc(uint8_t c);
+ * Inputs: c - byte to send
+ * Return Value: none
+ * Function: Adds c to the transmit ring, starting the FIFO if it was idle.
+ *				A full ring drains by interrupt while the caller waits, or
+ *				by polling if interrupts are off or the interrupt is late
+ */
+void uart_putc(uint8_t c) {
+    uint32_t flags, head, spins;
+
+    if (!present) return;
+
+    cli_and_save(flags);
+    while (tx_tail - tx_head >= UART_TX_RING) {
+        if (flags & EFLAGS_IF) {
+            stats.tx_waits++;
+            head = tx_head;
+            restore_flags(flags);
+            for (spins = 0; tx_head == head && spins < WAIT_SPINS; spins++);
+            cli_and_save(flags);
+            if (tx_head != head) continue;
+        }
+        uart_poll_tx();
+    }
+    tx_ring[tx_tail % UART_TX_RING] = c;
+    tx_tail++;
+    if (!tx_busy) uart_start_tx();
+    restore_flags(flags);
+}
+
+/* void uart_puts(const int8_t* s);
+ * Inputs: s - string
+ * Return Value: none
+ * Function: Sends s for a terminal, which wants "\r\n" to end a line
+ */
+void uart_puts(const int8_t* s) {
+    for (; *s; s++) {
+        if (*s == '\n') uart_putc('\r');
+        uart_putc(*s);
+    }
+}
+
+/* void uart_flush(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Polls until the ring and the transmitter are empty
+ */
+void uart_flush(void) {
+    uint32_t flags, spins;
+
+    if (!present) return;
+
+    cli_and_save(flags);
+    while (tx_head != tx_tail) uart_poll_tx();
+    for (spins = 0; !(inb(COM1 + REG_LSR) & LSR_TEMT) && spins < POLL_SPINS; spins++);
+    restore_flags(flags);
+}
+
+/* void uart_get_stats(uart_stats_t* out);
+ * Inputs: out - filled in
+ * Return Value: none
+ * Function: Copies out the counts
+ */
+void uart_get_stats(uart_stats_t* out) {
+    memcpy(out, &stats, sizeof(stats));
+}
+
+/* static void uart_input(uint8_t c);
+ * Inputs: c - received byte
+ * Return Value: none
+ * Function: Types c into the terminal being viewed, as the keyboard does.
+ *				A terminal sends DEL for backspace, "\r" for enter and
+ *				"ESC [ A" and "ESC [ B" for the up and down arrows
+ */
+static void uart_input(uint8_t c) {
+    change_process_screen(view_screen);
+    if (esc_state == 1) {
+        esc_state = (c == '[') ? 2 : 0;
+    } else if (esc_state == 2) {
+        if (c == 'A') history_up();
+        else if (c == 'B') history_down();
+        // Other sequences end at their first letter
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '~') esc_state = 0;
+    } else if (c == ESC) {
+        esc_state = 1;
+    } else if (c == DEL || c == '\b') {
+        tty_backspace();
+    } else {
+        tty_sendchar(c == '\r' ? '\n' : c);
+    }
+    change_process_screen(current_task);
+}
+
+/* static void uart_interrupt(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Handles each reason the port is interrupting until none is left.
+ *				Received bytes go to dev/ttyS0 while it is open, to the
+ *				terminal otherwise
+ */
+static void uart_interrupt(void) {
+    uint32_t iir, lsr, rounds;
+    uint8_t c;
+
+    stats.interrupts++;
+    for (rounds = 0; rounds < POLL_SPINS; rounds++) {
+        iir = inb(COM1 + REG_IIR);
+        if (iir & IIR_NONE) break;
+
+        // Reading LSR clears a line status interrupt
+        while ((lsr = inb(COM1 + REG_LSR)) & (LSR_DR | LSR_ERRORS)) {
+            if (lsr & LSR_ERRORS) stats.rx_errors++;
+            if (!(lsr & LSR_DR)) continue;
+            c = inb(COM1 + REG_DATA);
+            stats.rx_bytes++;
+            if (rx_readers) {
+                if (rx_tail - rx_head < UART_RX_RING) {
+                    rx_ring[rx_tail % UART_RX_RING] = c;
+                    rx_tail++;
+                } else {
+                    stats.rx_dropped++;
+                }
+            } else if (uart_console) {
+                uart_input(c);
+            }
+        }
+
+        // Reading IIR cleared an empty FIFO interrupt, refill it
+        if (tx_busy && (lsr & LSR_THRE)) uart_start_tx();
+    }
+}
+
+/* static int32_t uart_open(const uint8_t* filename);
+ * Inputs: filename - the fd, as for the rtc
+ * Return Value: 0
+ * Function: Sends what is received to readers of the file instead of the
+ *				terminal until it is closed
+ */
+static int32_t uart_open(const uint8_t* filename) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    rx_readers++;
+    restore_flags(flags);
+    return 0;
+}
+
+/* static int32_t uart_close(int32_t fd);
+ * Inputs: fd - file descriptor
+ * Return Value: 0
+ * Function: Gives input back to the terminal after the last close
+ */
+static int32_t uart_close(int32_t fd) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (rx_readers) rx_readers--;
+    if (!rx_readers) rx_head = rx_tail;
+    restore_flags(flags);
+    return 0;
+}
+
+/* static int32_t uart_read(int32_t fd, void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor
+ *			buf - filled in
+ *			nbytes - size of buf
+ * Return Value: bytes read, -1 for a bad buffer or nothing received with
+ *		interrupts off, -EAGAIN for nothing received and an O_NONBLOCK fd
+ * Function: Waits for at least one byte, then returns what has arrived up
+ *				to nbytes
+ */
+static int32_t uart_read(int32_t fd, void* buf, int32_t nbytes) {
+    uint32_t flags, n;
+
+    if (!buf || nbytes < 0) return -1;
+    if (!nbytes) return 0;
+
+    cli_and_save(flags);
+    while (rx_head == rx_tail) {
+        if (fd_table[fd].flags & O_NONBLOCK) {
+            restore_flags(flags);
+            return -EAGAIN;
+        }
+        if (!(flags & EFLAGS_IF)) {
+            restore_flags(flags);
+            return -1;
+        }
+        restore_flags(flags);
+        while (rx_head == rx_tail);
+        cli_and_save(flags);
+    }
+    for (n = 0; n < (uint32_t) nbytes && rx_head != rx_tail; n++) {
+        ((uint8_t*) buf)[n] = rx_ring[rx_head % UART_RX_RING];
+        rx_head++;
+    }
+    restore_flags(flags);
+    return n;
+}
+
+/* static int32_t uart_write(int32_t fd, const void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor
+ *			buf - bytes to send, unchanged
+ *			nbytes - their count
+ * Return Value: nbytes, -1 for a bad buffer
+ * Function: Queues the bytes, waiting only while the ring is full
+ */
+static int32_t uart_write(int32_t fd, const void* buf, int32_t nbytes) {
+    int32_t i;
+
+    if (!buf || nbytes < 0) return -1;
+    for (i = 0; i < nbytes; i++) uart_putc(((const uint8_t*) buf)[i]);
+    return nbytes;
+}
+
+/* static int32_t uart_poll(int32_t fd, int32_t events);
+ * Inputs: fd - file descriptor
+ *			events - POLLIN and/or POLLOUT
+ * Return Value: the events that wouldn't wait
+ * Function: Reads wait for a byte, writes for room in the ring
+ */
+static int32_t uart_poll(int32_t fd, int32_t events) {
+    int32_t revents = 0;
+
+    if (rx_head != rx_tail) revents |= events & POLLIN;
+    if (tx_tail - tx_head < UART_TX_RING) revents |= events & POLLOUT;
+    return revents;
+}
@@ -0,0 +1,50 @@
+/* uart.h - 16550 UART on COM1: interrupt driven transmit and receive rings
+ *			in front of the 16 byte FIFOs, used as a serial console, a sink
+ *			for the kernel log and "dev/ttyS0"
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef UART_H
+#define UART_H
+
+#include "../types.h"
+
+#define UART_IRQ 4
+
+/* Bytes the rings hold, powers of two */
+#define UART_TX_RING 4096
+#define UART_RX_RING 256
+
+/* Bytes the transmit FIFO takes after each empty interrupt */
+#define UART_FIFO_SIZE 16
+
+typedef struct uart_stats {
+	uint32_t tx_bytes;			/* written to the transmit FIFO */
+	uint32_t rx_bytes;			/* read from the receive FIFO */
+	uint32_t interrupts;
+	uint32_t tx_polled;			/* bytes sent by polling, with interrupts off */
+	uint32_t tx_waits;			/* times a writer waited for room in the ring */
+	uint32_t rx_dropped;		/* received with the ring full */
+	uint32_t rx_errors;			/* overrun, parity, framing errors and breaks */
+} uart_stats_t;
+
+/* Output to the console also goes out the port, and input from it is typed
+ * into the terminal being viewed. Set by uart_init if there is a port */
+extern volatile uint32_t uart_console;
+
+/* Finds and sets up the port, 0 if there is one */
+int32_t uart_init(void);
+
+/* Queues a byte to send. Waits for room if the ring is full, or sends
+ * some by polling if interrupts are off, so nothing is dropped */
+void uart_putc(uint8_t c);
+
+/* uart_putc for each character, with "\n" sent as "\r\n" */
+void uart_puts(const int8_t* s);
+
+/* Sends everything queued by polling, for a kernel about to stop */
+void uart_flush(void);
+
+void uart_get_stats(uart_stats_t* out);
+
+#endif /* UART_H */
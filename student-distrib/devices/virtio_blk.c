@@ -0,0 +1,357 @@
+#include "virtio_blk.h"
+#include "pci.h"
+#include "../i8259.h"
+#include "../lib.h"
+#include "../klog.h"
+
+static pci_device_t device;
+
+#define VENDOR_ID           0x1AF4
+#define DEVICE_ID           0x1001 // transitional virtio-blk, legacy interface
+
+#define ENABLE_BUS_MASTERING 4
+
+// Legacy virtio registers (offsets from BAR0)
+#define REG_DEVICE_FEATURES 0x00
+#define REG_GUEST_FEATURES  0x04
+#define REG_QUEUE_PFN       0x08
+#define REG_QUEUE_SIZE      0x0C
+#define REG_QUEUE_SELECT    0x0E
+#define REG_QUEUE_NOTIFY    0x10
+#define REG_STATUS          0x12
+#define REG_ISR             0x13
+#define REG_CAPACITY        0x14 // 64 bit, in sectors
+
+#define STATUS_ACKNOWLEDGE  0x01
+#define STATUS_DRIVER       0x02
+#define STATUS_DRIVER_OK    0x04
+#define STATUS_FAILED       0x80
+
+#define ISR_QUEUE           0x01
+
+#define DESC_F_NEXT         0x01
+#define DESC_F_WRITE        0x02 // device writes this buffer
+
+#define USED_F_NO_NOTIFY    0x01
+
+#define BLK_T_IN            0
+#define BLK_T_OUT           1
+
+#define BLK_S_OK            0
+
+// Largest queue we have room for, and the legacy ring alignment
+#define QUEUE_MAX           256
+#define QUEUE_ALIGN         FOUR_KB
+
+// Each request is a header, data and status descriptor
+#define DESCS_PER_REQ       3
+#define MAX_INFLIGHT        64
+#define VIRTIO_MAX_BLOCKS   32
+
+typedef struct __attribute__((packed)) virtq_desc {
+    uint32_t addr_low;
+    uint32_t addr_high; // zero for us
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} virtq_desc_t;
+
+typedef struct __attribute__((packed)) virtq_avail {
+    uint16_t flags;
+    volatile uint16_t idx;
+    uint16_t ring[];
+} virtq_avail_t;
+
+typedef struct __attribute__((packed)) virtq_used_elem {
+    uint32_t id;
+    uint32_t len;
+} virtq_used_elem_t;
+
+typedef struct __attribute__((packed)) virtq_used {
+    volatile uint16_t flags;
+    volatile uint16_t idx;
+    virtq_used_elem_t ring[];
+} virtq_used_t;
+
+typedef struct __attribute__((packed)) blk_req_header {
+    uint32_t type;
+    uint32_t reserved;
+    uint32_t sector_low;
+    uint32_t sector_high;
+} blk_req_header_t;
+
+// Per request state, slot i owns descriptors DESCS_PER_REQ*i onwards
+typedef struct virtio_slot {
+    blk_req_header_t header;
+    volatile uint8_t status;
+    block_request_t* req;
+} virtio_slot_t;
+
+// desc table, avail ring and (page aligned) used ring for QUEUE_MAX entries
+static uint8_t queue_mem[4 * FOUR_KB] __attribute__((aligned(FOUR_KB)));
+
+static virtq_desc_t* descs;
+static virtq_avail_t* avail;
+static virtq_used_t* used;
+static uint16_t queue_size;
+static uint16_t last_used;
+
+static virtio_slot_t slots[MAX_INFLIGHT];
+static uint32_t num_slots;
+static uint32_t free_slots;  // bitmap
+static block_request_t* waiting; // requests with no free slot yet
+
+static uint32_t io_base;
+static uint32_t part_start;
+
+/* Driver statistics */
+static uint32_t num_requests, num_kicks, num_interrupts, max_inflight, inflight;
+
+static int32_t virtio_blk_submit(block_dev_t* dev, block_request_t* req);
+static void virtio_blk_poll(block_dev_t* dev);
+
+static block_dev_t virtio_dev = {
+    .name = "vda1",
+    .submit = virtio_blk_submit,
+    .poll = virtio_blk_poll,
+    .map = NULL,
+};
+
+// Tells the device new requests are available unless it asked not to be told
+static void virtio_kick(void) {
+    if (used->flags & USED_F_NO_NOTIFY) return;
+    num_kicks++;
+    outw(0, io_base + REG_QUEUE_NOTIFY);
+}
+
+// Puts a request on the available ring (interrupts must be off, a slot must be free)
+static void virtio_queue(block_request_t* req, uint32_t sector) {
+    uint32_t slot, d;
+    virtio_slot_t* s;
+
+    for (slot = 0; !(free_slots & (1 << slot)); slot++);
+    free_slots &= ~(1 << slot);
+    s = &slots[slot];
+    s->req = req;
+    s->status = 0xFF;
+    s->header.type = req->write ? BLK_T_OUT : BLK_T_IN;
+    s->header.reserved = 0;
+    s->header.sector_low = sector;
+    s->header.sector_high = 0;
+
+    d = slot * DESCS_PER_REQ;
+    descs[d].addr_low = (uint32_t)&s->header;
+    descs[d].addr_high = 0;
+    descs[d].len = sizeof(blk_req_header_t);
+    descs[d].flags = DESC_F_NEXT;
+    descs[d].next = d + 1;
+
+    descs[d + 1].addr_low = (uint32_t)req->buf;
+    descs[d + 1].addr_high = 0;
+    descs[d + 1].len = req->count * BLOCK_SIZE;
+    descs[d + 1].flags = DESC_F_NEXT | (req->write ? 0 : DESC_F_WRITE);
+    descs[d + 1].next = d + 2;
+
+    descs[d + 2].addr_low = (uint32_t)&s->status;
+    descs[d + 2].addr_high = 0;
+    descs[d + 2].len = 1;
+    descs[d + 2].flags = DESC_F_WRITE;
+    descs[d + 2].next = 0;
+
+    avail->ring[avail->idx % queue_size] = d;
+    // The device must see the descriptors before the new index
+    asm volatile ("" : : : "memory");
+    avail->idx++;
+
+    if (++inflight > max_inflight) max_inflight = inflight;
+}
+
+// Moves waiting requests onto the ring while there are free slots
+// Returns nonzero if anything was queued (interrupts must be off)
+static uint32_t virtio_fill(void) {
+    block_request_t* req;
+    uint32_t queued = 0;
+
+    while (waiting && free_slots) {
+        req = waiting;
+        waiting = req->next;
+        req->next = NULL;
+        virtio_queue(req, part_start + req->block * SECTORS_PER_BLOCK);
+        queued++;
+    }
+    return queued;
+}
+
+// Completes every request the device has finished with.
+// Shared by the irq handler and virtio_blk_poll, so it runs with interrupts off
+static void virtio_complete(void) {
+    uint32_t flags, slot;
+    block_request_t* req;
+    block_request_t* done = NULL;
+
+    cli_and_save(flags);
+
+    while (last_used != used->idx) {
+        slot = used->ring[last_used % queue_size].id / DESCS_PER_REQ;
+        last_used++;
+
+        req = slots[slot].req;
+        req->status = slots[slot].status == BLK_S_OK ? BLOCK_OK : BLOCK_ERROR;
+        slots[slot].req = NULL;
+        free_slots |= 1 << slot;
+        inflight--;
+
+        req->next = done;
+        done = req;
+    }
+
+    // Refill the ring before running callbacks, one kick for the lot
+    if (virtio_fill()) virtio_kick();
+
+    while (done) {
+        req = done;
+        done = req->next;
+        req->next = NULL;
+        req->done = 1;
+        if (req->callback) req->callback(req);
+    }
+
+    restore_flags(flags);
+}
+
+static void virtio_blk_interrupt(void) {
+    // Reading the ISR acknowledges the interrupt (the line may be shared)
+    if (!(inb(io_base + REG_ISR) & ISR_QUEUE)) return;
+    num_interrupts++;
+    virtio_complete();
+}
+
+static void virtio_blk_poll(block_dev_t* dev) {
+    virtio_complete();
+}
+
+/* static int32_t virtio_blk_submit(block_dev_t* dev, block_request_t* req);
+ * Inputs: dev - the partition device
+ *			req - list of requests to queue
+ * Return Value: BLOCK_OK, or BLOCK_ERROR if a request is out of range or too large
+ * Function: Puts as many requests on the ring as there are free slots and
+ *				notifies the device once for the whole list
+ */
+static int32_t virtio_blk_submit(block_dev_t* dev, block_request_t* req) {
+    block_request_t **tail, *r;
+    uint32_t flags;
+
+    for (r = req; r; r = r->next) {
+        if (!r->count || r->count > VIRTIO_MAX_BLOCKS) return BLOCK_ERROR;
+        if (r->block + r->count > dev->num_blocks) return BLOCK_ERROR;
+    }
+
+    cli_and_save(flags);
+    // Keep submission order behind anything already waiting
+    for (tail = &waiting; *tail; tail = &(*tail)->next);
+    *tail = req;
+    for (r = req; r; r = r->next) num_requests++;
+    if (virtio_fill()) virtio_kick();
+    restore_flags(flags);
+
+    return BLOCK_OK;
+}
+
+// Reads a block starting at any sector synchronously (used before the partition is known)
+static int32_t virtio_read_raw(uint32_t sector, uint8_t* buf) {
+    block_request_t req;
+    uint32_t flags;
+
+    req.count = 1;
+    req.buf = buf;
+    req.write = 0;
+    req.done = 0;
+    req.callback = NULL;
+    req.next = NULL;
+
+    cli_and_save(flags);
+    virtio_queue(&req, sector);
+    virtio_kick();
+    restore_flags(flags);
+
+    while (!req.done) virtio_complete();
+    return req.status;
+}
+
+/* block_dev_t* virtio_blk_init(void);
+ * Inputs: none
+ * Return Value: block device for the filesystem partition, NULL if there is none
+ * Function: Sets up the first virtqueue of a virtio-blk device and looks for
+ *				an MBR partition of type FS_PART_TYPE on it
+ */
+block_dev_t* virtio_blk_init(void) {
+    static uint8_t block0[BLOCK_SIZE] __attribute__((aligned(16)));
+    uint32_t i, num_sectors, start;
+
+    // Find PCI device
+    if (find_device(&device, VENDOR_ID, DEVICE_ID)) return NULL;
+
+    // The legacy interface lives in an I/O BAR0
+    if (!device.bar[0].is_port) return NULL;
+    io_base = device.bar_addr[0];
+
+    // Enable bus mastering
+    device.command |= ENABLE_BUS_MASTERING;
+    pci_update(&device, PCI_COMMAND_OFFSET);
+
+    // Reset, then tell the device we know how to drive it
+    outb(0, io_base + REG_STATUS);
+    outb(STATUS_ACKNOWLEDGE, io_base + REG_STATUS);
+    outb(STATUS_ACKNOWLEDGE | STATUS_DRIVER, io_base + REG_STATUS);
+
+    // We don't need any optional features
+    inl(io_base + REG_DEVICE_FEATURES);
+    outl(0, io_base + REG_GUEST_FEATURES);
+
+    // Lay out queue 0: descriptors, available ring, then the used ring on a page boundary
+    outw(0, io_base + REG_QUEUE_SELECT);
+    queue_size = inw(io_base + REG_QUEUE_SIZE);
+    if (!queue_size || queue_size > QUEUE_MAX) {
+        outb(STATUS_FAILED, io_base + REG_STATUS);
+        return NULL;
+    }
+    memset(queue_mem, 0, sizeof(queue_mem));
+    descs = (virtq_desc_t*)queue_mem;
+    avail = (virtq_avail_t*)(queue_mem + queue_size * sizeof(virtq_desc_t));
+    used = (virtq_used_t*)(((uint32_t)&avail->ring[queue_size + 1] + QUEUE_ALIGN - 1) & ~(QUEUE_ALIGN - 1));
+    outl((uint32_t)queue_mem / FOUR_KB, io_base + REG_QUEUE_PFN);
+    last_used = 0;
+
+    num_slots = queue_size / DESCS_PER_REQ;
+    if (num_slots > MAX_INFLIGHT) num_slots = MAX_INFLIGHT;
+    free_slots = 0;
+    for (i = 0; i < num_slots; i++) free_slots |= 1 << i;
+    waiting = NULL;
+
+    outb(STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK, io_base + REG_STATUS);
+
+    // Find the filesystem partition (polled, interrupts aren't on yet)
+    num_sectors = inl(io_base + REG_CAPACITY); // ignore the high half, LBA is 32 bit here
+    if (virtio_read_raw(0, block0) != BLOCK_OK) return NULL;
+    if (mbr_find_partition(block0, FS_PART_TYPE, &start, &i)) return NULL;
+    if (start + i > num_sectors) return NULL;
+    part_start = start;
+    virtio_dev.num_blocks = i / SECTORS_PER_BLOCK;
+
+    inb(io_base + REG_ISR);
+    register_interrupt_handler(device.int_line, virtio_blk_interrupt);
+
+    klog(KLOG_INFO, "virtio-blk: %s, %u blocks at lba %u, queue size %u\n", virtio_dev.name,
+            virtio_dev.num_blocks, part_start, queue_size);
+    return &virtio_dev;
+}
+
+/* void virtio_blk_print_stats(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Prints how many requests were batched into each doorbell kick
+ */
+void virtio_blk_print_stats(void) {
+    printf("virtio-blk: %u requests, %u kicks, %u interrupts, max %u in flight\n",
+            num_requests, num_kicks, num_interrupts, max_inflight);
+}
@@ -0,0 +1,10 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "../lib.h"
+#include "../filesystem/block_dev.h"
+
+block_dev_t* virtio_blk_init(void);
+void virtio_blk_print_stats(void);
+
+#endif /* VIRTIO_BLK_H */
@@ -0,0 +1,98 @@
+/* bitmap.c - Allocation bitmaps for inodes and data blocks, held either
+ *				in memory or in device blocks read through the buffer cache
+ * vim:ts=4 noexpandtab
+ */
+
+#include "filesystem.h"
+
+/* static uint8_t* bitmap_page(fs_bitmap_t* map, uint32_t page, buffer_t** b);
+ * Inputs: map - bitmap
+ *			page - which BITS_PER_BLOCK bits are wanted
+ *			b - set to the pinned buffer holding the page, NULL for in-memory bitmaps
+ * Return Value: pointer to the page's bits, NULL on I/O error
+ * Function: Finds the bytes holding bits [page * BITS_PER_BLOCK, (page + 1) * BITS_PER_BLOCK)
+ */
+static uint8_t* bitmap_page(fs_bitmap_t* map, uint32_t page, buffer_t** b) {
+	*b = NULL;
+	if(map->mem) return map->mem + page * BLOCK_SIZE;
+	if(!(*b = bread(map->start_block + page))) return NULL;
+	return (*b)->data;
+}
+
+/* int32_t bitmap_test(fs_bitmap_t* map, uint32_t index);
+ * Inputs: map - bitmap
+ *			index - item to look up
+ * Return Value: 1 if the item is in use (or out of range), 0 if free
+ * Function: Reads one bit of the bitmap
+ */
+int32_t bitmap_test(fs_bitmap_t* map, uint32_t index) {
+	buffer_t* b;
+	uint8_t* bits;
+	int32_t ret;
+
+	if(index >= map->count) return 1;
+	if(!(bits = bitmap_page(map, index / BITS_PER_BLOCK, &b))) return 1;
+	index %= BITS_PER_BLOCK;
+	ret = (bits[index / 8] >> (index % 8)) & 0x1;
+	if(b) brelse(b);
+	return ret;
+}
+
+/* void bitmap_set(fs_bitmap_t* map, uint32_t index, uint8_t used);
+ * Inputs: map - bitmap
+ *			index - item to mark
+ *			used - 1 to mark the item in use, 0 to free it
+ * Return Value: none
+ * Function: Writes one bit of the bitmap, freeing an item below the search
+ *				hint moves the hint back so it is found again
+ */
+void bitmap_set(fs_bitmap_t* map, uint32_t index, uint8_t used) {
+	buffer_t* b;
+	uint8_t* bits;
+	uint32_t bit;
+
+	if(index >= map->count) return;
+	if(!(bits = bitmap_page(map, index / BITS_PER_BLOCK, &b))) return;
+	bit = index % BITS_PER_BLOCK;
+	if(used) bits[bit / 8] |= 0x1 << (bit % 8);
+	else bits[bit / 8] &= ~(0x1 << (bit % 8));
+	if(b) {
+		bwrite(b);
+		brelse(b);
+	}
+	if(!used && index < map->hint) map->hint = index;
+}
+
+/* int32_t bitmap_alloc(fs_bitmap_t* map);
+ * Inputs: map - bitmap
+ * Return Value: index of the item claimed, -1 if every item is in use
+ * Function: Claims the lowest free item at or after the search hint,
+ *				checking 32 items at a time
+ */
+int32_t bitmap_alloc(fs_bitmap_t* map) {
+	buffer_t* b;
+	uint32_t* words;
+	uint32_t page, word, bit, index;
+
+	for(page = map->hint / BITS_PER_BLOCK; page * BITS_PER_BLOCK < map->count; ++page) {
+		if(!(words = (uint32_t*) bitmap_page(map, page, &b))) return -1;
+
+		word = (page == map->hint / BITS_PER_BLOCK) ? (map->hint % BITS_PER_BLOCK) / 32 : 0;
+		for(; word < BLOCK_SIZE / 4; ++word) {
+			if(words[word] == 0xFFFFFFFF) continue;
+			for(bit = 0; words[word] & (0x1 << bit); ++bit) continue;
+
+			index = page * BITS_PER_BLOCK + word * 32 + bit;
+			if(index >= map->count) break;
+			words[word] |= 0x1 << bit;
+			if(b) {
+				bwrite(b);
+				brelse(b);
+			}
+			map->hint = index + 1;
+			return index;
+		}
+		if(b) brelse(b);
+	}
+	return -1;
+}
@@ -0,0 +1,87 @@
+/* block_dev.c - Helpers for issuing requests to block devices
+ * vim:ts=4 noexpandtab
+ */
+
+#include "block_dev.h"
+
+#define MBR_SIGNATURE_OFFSET 510
+#define MBR_SIGNATURE 0xAA55
+#define MBR_PART_OFFSET 446
+#define MBR_NUM_PARTS 4
+
+/* Partition table entry */
+typedef struct __attribute__((packed)) mbr_part {
+	uint8_t status;
+	uint8_t chs_first[3];
+	uint8_t type;
+	uint8_t chs_last[3];
+	uint32_t lba_start;
+	uint32_t num_sectors;
+} mbr_part_t;
+
+/* int32_t block_wait(block_dev_t* dev, block_request_t* req);
+ * Inputs: dev - device the request was submitted to
+ *			req - request to wait on
+ * Return Value: status of the request (BLOCK_OK or BLOCK_ERROR)
+ * Function: Spins until the request completes. Drivers are polled on every
+ *				iteration since we may be called with the device's irq masked
+ *				(from another handler or before interrupts are enabled)
+ */
+int32_t block_wait(block_dev_t* dev, block_request_t* req) {
+	while(!req->done) {
+		if(dev->poll) dev->poll(dev);
+	}
+	return req->status;
+}
+
+/* int32_t block_rw(block_dev_t* dev, uint32_t block, uint32_t count, void* buf, uint8_t write);
+ * Inputs: dev - device to access
+ *			block - first block to transfer
+ *			count - number of blocks to transfer
+ *			buf - count * BLOCK_SIZE byte buffer in kernel memory
+ *			write - 1 to write buf to the device, 0 to read into buf
+ * Return Value: BLOCK_OK on success, BLOCK_ERROR on failure
+ * Function: Submits a single request and waits for it to finish
+ */
+int32_t block_rw(block_dev_t* dev, uint32_t block, uint32_t count, void* buf, uint8_t write) {
+	block_request_t req;
+
+	if(block + count > dev->num_blocks || block + count < block) return BLOCK_ERROR;
+
+	req.block = block;
+	req.count = count;
+	req.buf = buf;
+	req.write = write;
+	req.done = 0;
+	req.status = BLOCK_OK;
+	req.callback = NULL;
+	req.priv = NULL;
+	req.next = NULL;
+
+	if(dev->submit(dev, &req) == BLOCK_ERROR) return BLOCK_ERROR;
+	return block_wait(dev, &req);
+}
+
+/* int32_t mbr_find_partition(const uint8_t* mbr, uint8_t type, uint32_t* lba_start, uint32_t* num_sectors);
+ * Inputs: mbr - first sector of a disk
+ *			type - partition type to look for
+ *			lba_start - set to the first sector of the partition
+ *			num_sectors - set to the size of the partition in sectors
+ * Return Value: 0 if a partition was found, -1 otherwise
+ * Function: Searches the primary partitions of an MBR. The partition must
+ *				start on a block boundary so blocks don't straddle sectors
+ */
+int32_t mbr_find_partition(const uint8_t* mbr, uint8_t type, uint32_t* lba_start, uint32_t* num_sectors) {
+	const mbr_part_t* part = (const mbr_part_t*)(mbr + MBR_PART_OFFSET);
+	uint32_t i;
+
+	if(*(const uint16_t*)(mbr + MBR_SIGNATURE_OFFSET) != MBR_SIGNATURE) return -1;
+
+	for(i = 0; i < MBR_NUM_PARTS; ++i, ++part) {
+		if(part->type != type || part->lba_start % SECTORS_PER_BLOCK) continue;
+		*lba_start = part->lba_start;
+		*num_sectors = part->num_sectors;
+		return 0;
+	}
+	return -1;
+}
@@ -0,0 +1,130 @@
+/* block_dev.h - Defines the block device interface and the buffer cache
+ *				that sits between block devices and the filesystem
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef BLOCK_DEV_H
+#define BLOCK_DEV_H
+
+#include "../lib.h"
+#include "filesystem_structs.h"
+
+/* Number of 4 kB buffers held by the buffer cache */
+#define BCACHE_NUM_BUFFERS 64
+
+/* Most blocks bread_run reads at once */
+#define BCACHE_MAX_RUN 16
+
+/* How often dirty buffers are written back (in ms) */
+#define BCACHE_FLUSH_MS 2000
+
+/* MBR partition type the filesystem partition is marked with */
+#define FS_PART_TYPE 0x7F
+
+/* Disks are addressed in 512 byte sectors */
+#define SECTOR_SIZE 512
+#define SECTORS_PER_BLOCK (BLOCK_SIZE / SECTOR_SIZE)
+
+/* Block request status codes */
+#define BLOCK_OK 0
+#define BLOCK_ERROR -1
+
+/*** Block device interface ***/
+
+/* A single read or write of 'count' consecutive BLOCK_SIZE blocks.
+ * NOTE: buf must be in identity-mapped kernel memory since drivers DMA into it */
+typedef struct block_request {
+	uint32_t block;				/* first block of the transfer */
+	uint32_t count;				/* number of blocks to transfer */
+	void* buf;					/* count * BLOCK_SIZE byte buffer */
+	uint8_t write;				/* 1 to write buf to the device, 0 to read into buf */
+	volatile uint8_t done;		/* set by the driver when the request completes */
+	int32_t status;				/* BLOCK_OK or BLOCK_ERROR, valid once done is set */
+	void (*callback)(struct block_request*);	/* called on completion (may be in irq context) */
+	void* priv;					/* for use by whoever submitted the request */
+	struct block_request* next;	/* used by drivers to queue requests */
+} block_request_t;
+
+/* Block device operations table */
+typedef struct block_dev {
+	const int8_t* name;
+	uint32_t num_blocks;		/* size of the device in BLOCK_SIZE blocks */
+	/* Queues a list of requests linked through next (so drivers can start them
+	 *	together), returns BLOCK_ERROR and queues none of them if any is invalid */
+	int32_t (*submit)(struct block_dev* dev, block_request_t* req);
+	/* Completes finished requests without relying on interrupts (may be NULL) */
+	void (*poll)(struct block_dev* dev);
+	/* Returns a direct pointer to a block for memory-backed devices, for
+	 *	reading only (may be NULL) */
+	void* (*map)(struct block_dev* dev, uint32_t block);
+	void* priv;					/* driver data */
+} block_dev_t;
+
+/* Synchronously reads or writes blocks on a device */
+int32_t block_rw(block_dev_t* dev, uint32_t block, uint32_t count, void* buf, uint8_t write);
+
+/* Waits for a submitted request to finish */
+int32_t block_wait(block_dev_t* dev, block_request_t* req);
+
+/* Finds a partition of the given type in an MBR sector */
+int32_t mbr_find_partition(const uint8_t* mbr, uint8_t type, uint32_t* lba_start, uint32_t* num_sectors);
+
+/* Creates a block device over a filesystem image in memory */
+block_dev_t* ramdisk_init(uint32_t base_addr, uint32_t end_addr);
+
+
+/*** Buffer cache ***/
+
+/* A cached copy of one block of the mounted device */
+typedef struct buffer {
+	uint32_t block;				/* block number held by this buffer */
+	uint8_t valid;				/* data has been read from the device */
+	uint8_t dirty;				/* data must be written back before eviction */
+	uint8_t writing;			/* a write-back of this buffer is in flight */
+	uint32_t refcount;			/* number of users, pinned while nonzero */
+	struct buffer *prev, *next;	/* LRU list, head is most recently used */
+	block_request_t req;		/* request used for write-back */
+	uint8_t* data;				/* BLOCK_SIZE bytes of block data */
+} buffer_t;
+
+/* Buffer cache statistics */
+typedef struct bcache_stats {
+	uint32_t hits;				/* bread calls satisfied from the cache */
+	uint32_t misses;			/* bread calls that went to the device */
+	uint32_t writebacks;		/* blocks written back to the device */
+	uint32_t flushes;			/* completed flushes */
+	uint32_t last_flush_cycles;	/* latency of the last flush */
+	uint32_t max_flush_cycles;	/* worst flush latency seen */
+} bcache_stats_t;
+
+/* Attaches the cache to the device holding the filesystem */
+void bcache_init(block_dev_t* dev);
+
+/* Returns a pinned buffer holding the given block */
+buffer_t* bread(uint32_t block);
+
+/* Returns pinned buffers for a run of consecutive blocks, reading the misses together */
+int32_t bread_run(uint32_t block, uint32_t count, buffer_t** bufs);
+
+/* Returns the address of a run of uncached blocks on a memory-backed device, or NULL */
+void* bmap_run(uint32_t block, uint32_t count);
+
+/* Marks a buffer as modified so it will be written back */
+void bwrite(buffer_t* buf);
+
+/* Unpins a buffer returned by bread */
+void brelse(buffer_t* buf);
+
+/* Writes back all dirty buffers and waits for them to finish */
+void bcache_sync(void);
+
+/* Fills in the current cache statistics */
+void bcache_get_stats(bcache_stats_t* stats);
+
+/* Prints read-hit ratio and flush latency */
+void bcache_print_stats(void);
+
+/* Device currently attached to the buffer cache */
+extern block_dev_t* fs_dev;
+
+#endif /* BLOCK_DEV_H */
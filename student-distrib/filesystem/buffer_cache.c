@@ -0,0 +1,430 @@
+/* buffer_cache.c - LRU write-back cache of filesystem blocks
+ * vim:ts=4 noexpandtab
+ */
+
+#include "block_dev.h"
+#include "../devices/devices.h" /* For rtc_register_handler */
+
+/* Block number used to mark a buffer that holds nothing */
+#define NO_BLOCK 0xFFFFFFFF
+
+/* Device the filesystem is mounted on */
+block_dev_t* fs_dev = NULL;
+
+static buffer_t buffers[BCACHE_NUM_BUFFERS];
+static uint8_t buffer_data[BCACHE_NUM_BUFFERS][BLOCK_SIZE] __attribute__((aligned(FOUR_KB)));
+
+/* Sentinel of the LRU list: lru.next is the most recently used buffer,
+ *	lru.prev is the least recently used */
+static buffer_t lru;
+
+static bcache_stats_t stats;
+
+/* Number of write-backs of the current flush still in flight */
+static volatile uint32_t flush_outstanding = 0;
+static uint64_t flush_start;
+
+static void bcache_flush(void);
+static void bcache_periodic_flush(uint32_t arg);
+
+/* static void lru_remove(buffer_t* b);
+ * Inputs: b - buffer to unlink
+ * Return Value: none
+ * Function: Removes a buffer from the LRU list (interrupts must be off)
+ */
+static void lru_remove(buffer_t* b) {
+	b->prev->next = b->next;
+	b->next->prev = b->prev;
+}
+
+/* static void lru_push_front(buffer_t* b);
+ * Inputs: b - buffer to link
+ * Return Value: none
+ * Function: Makes a buffer the most recently used (interrupts must be off)
+ */
+static void lru_push_front(buffer_t* b) {
+	b->next = lru.next;
+	b->prev = &lru;
+	lru.next->prev = b;
+	lru.next = b;
+}
+
+/* void bcache_init(block_dev_t* dev);
+ * Inputs: dev - device holding the filesystem
+ * Return Value: none
+ * Function: Empties the cache, attaches it to dev and starts periodic write-back
+ */
+void bcache_init(block_dev_t* dev) {
+	static uint8_t flush_started = 0;
+	uint32_t i;
+
+	fs_dev = dev;
+	memset(&stats, 0, sizeof(stats));
+
+	lru.next = lru.prev = &lru;
+	for(i = 0; i < BCACHE_NUM_BUFFERS; ++i) {
+		buffers[i].block = NO_BLOCK;
+		buffers[i].valid = 0;
+		buffers[i].dirty = 0;
+		buffers[i].writing = 0;
+		buffers[i].refcount = 0;
+		buffers[i].data = buffer_data[i];
+		lru_push_front(&buffers[i]);
+	}
+
+	if(!flush_started) {
+		flush_started = 1;
+		rtc_register_handler(bcache_periodic_flush, 0, BCACHE_FLUSH_MS);
+	}
+}
+
+/* buffer_t* bread(uint32_t block);
+ * Inputs: block - block number on the mounted device
+ * Return Value: pinned buffer holding the block, NULL on I/O error
+ * Function: Looks the block up in the cache, reading it from the device
+ *				into the least recently used free buffer on a miss
+ */
+buffer_t* bread(uint32_t block) {
+	buffer_t* b;
+	return bread_run(block, 1, &b) == 1 ? b : NULL;
+}
+
+/* static buffer_t* bcache_claim(uint32_t block, uint8_t* hit, buffer_t** victim);
+ * Inputs: block - block number on the mounted device
+ *			hit - set to 1 if the block was already cached
+ *			victim - set to a dirty buffer that must be written back first
+ * Return Value: pinned buffer for the block, NULL if every buffer is pinned
+ *			or the buffer to recycle is dirty
+ * Function: Finds the block's buffer, or recycles the least recently used
+ *				free buffer for it (interrupts must be off). A dirty buffer
+ *				keeps its block and is marked writing, so it stays readable
+ *				and nobody else recycles it until the caller has written it
+ *				back and tried again
+ */
+static buffer_t* bcache_claim(uint32_t block, uint8_t* hit, buffer_t** victim) {
+	buffer_t* b;
+
+	*victim = NULL;
+
+	/* Hit: the block is cached (or being read in by someone else) */
+	for(b = lru.next; b != &lru; b = b->next) {
+		if(b->block == block && (b->valid || b->refcount)) {
+			b->refcount++;
+			lru_remove(b);
+			lru_push_front(b);
+			stats.hits++;
+			*hit = 1;
+			return b;
+		}
+	}
+
+	/* Miss: recycle the least recently used buffer nobody is using */
+	for(b = lru.prev; b != &lru; b = b->prev) {
+		if(!b->refcount && !b->writing) break;
+	}
+	if(b == &lru) return NULL; /* Every buffer is pinned */
+
+	if(b->valid && b->dirty) {
+		b->dirty = 0;
+		b->writing = 1;
+		*victim = b;
+		return NULL;
+	}
+	b->block = block;
+	b->valid = 0;
+	b->dirty = 0;
+	b->refcount = 1;
+	lru_remove(b);
+	lru_push_front(b);
+	stats.misses++;
+	*hit = 0;
+	return b;
+}
+
+/* int32_t bread_run(uint32_t block, uint32_t count, buffer_t** bufs);
+ * Inputs: block - first block number on the mounted device
+ *			count - number of consecutive blocks, at most BCACHE_MAX_RUN
+ *			bufs - filled with a pinned buffer for each block
+ * Return Value: number of blocks read (fewer than count if buffers run
+ *			out), -1 on I/O error, in which case no buffers are left pinned
+ * Function: Like bread for a run of blocks, except that the blocks missing
+ *				from the cache are read with a single submit so the driver
+ *				can start them all at once
+ */
+int32_t bread_run(uint32_t block, uint32_t count, buffer_t** bufs) {
+	block_request_t reqs[BCACHE_MAX_RUN];
+	block_request_t* list = NULL;
+	uint32_t flags, i;
+	uint8_t hit[BCACHE_MAX_RUN];
+	buffer_t* victim;
+	int32_t ret = 0, status;
+
+	if(!count || count > BCACHE_MAX_RUN) return -1;
+
+	/* Settle for a shorter run if too many buffers are pinned or a dirty
+		one can't be written back */
+	cli_and_save(flags);
+	for(i = 0; i < count; ++i) {
+		if((bufs[i] = bcache_claim(block + i, &hit[i], &victim))) continue;
+		if(!victim) break;
+
+		/* Write back the old contents before the buffer is relabelled */
+		restore_flags(flags);
+		status = block_rw(fs_dev, victim->block, 1, victim->data, 1);
+		cli_and_save(flags);
+		victim->writing = 0;
+		if(status != BLOCK_OK) {
+			victim->dirty = 1;
+			break;
+		}
+		stats.writebacks++;
+		i--; /* Claim again, the buffer is clean now */
+	}
+	restore_flags(flags);
+	if(!(count = i)) return -1;
+
+	for(i = count; i-- > 0;) {
+		if(hit[i]) continue;
+		reqs[i].block = block + i;
+		reqs[i].count = 1;
+		reqs[i].buf = bufs[i]->data;
+		reqs[i].write = 0;
+		reqs[i].done = 0;
+		reqs[i].status = BLOCK_OK;
+		reqs[i].callback = NULL;
+		reqs[i].priv = NULL;
+		reqs[i].next = list;
+		list = &reqs[i];
+	}
+
+	if(list && fs_dev->submit(fs_dev, list) == BLOCK_ERROR) {
+		for(; list; list = list->next) {
+			list->status = BLOCK_ERROR;
+			list->done = 1;
+		}
+	}
+
+	for(i = 0; i < count; ++i) {
+		if(!hit[i]) {
+			if(block_wait(fs_dev, &reqs[i]) == BLOCK_OK) bufs[i]->valid = 1;
+			else {
+				cli_and_save(flags);
+				bufs[i]->block = NO_BLOCK;
+				restore_flags(flags);
+				ret = -1;
+			}
+			continue;
+		}
+		while(!bufs[i]->valid) {
+			/* Other reader failed, give up too */
+			if(bufs[i]->block != block + i) {
+				ret = -1;
+				break;
+			}
+		}
+	}
+
+	if(ret) {
+		for(i = 0; i < count; ++i) brelse(bufs[i]);
+		return -1;
+	}
+	return count;
+}
+
+/* void* bmap_run(uint32_t block, uint32_t count);
+ * Inputs: block - first block number on the mounted device
+ *			count - number of consecutive blocks
+ * Return Value: address of the blocks in memory, NULL if they can't be used in place
+ * Function: For memory-backed devices, returns where a run of blocks lives
+ *				so it can be copied in one go, provided the blocks are
+ *				contiguous in memory and none is cached (the cached copy
+ *				may be newer). The pointer is only valid until the next write
+ */
+void* bmap_run(uint32_t block, uint32_t count) {
+	uint32_t flags, i;
+	uint8_t* addr;
+	buffer_t* b;
+
+	if(!fs_dev || !fs_dev->map || !(addr = fs_dev->map(fs_dev, block))) return NULL;
+	for(i = 1; i < count; ++i) {
+		if(fs_dev->map(fs_dev, block + i) != addr + i * BLOCK_SIZE) return NULL;
+	}
+
+	cli_and_save(flags);
+	for(b = lru.next; b != &lru; b = b->next) {
+		if(b->block - block < count && (b->valid || b->refcount)) {
+			restore_flags(flags);
+			return NULL;
+		}
+	}
+	restore_flags(flags);
+	return addr;
+}
+
+/* void bwrite(buffer_t* buf);
+ * Inputs: buf - pinned buffer whose data was modified
+ * Return Value: none
+ * Function: Marks the buffer dirty, it is written back by the next flush
+ */
+void bwrite(buffer_t* buf) {
+	buf->dirty = 1;
+}
+
+/* void brelse(buffer_t* buf);
+ * Inputs: buf - buffer returned by bread
+ * Return Value: none
+ * Function: Unpins the buffer so it can be evicted
+ */
+void brelse(buffer_t* buf) {
+	uint32_t flags;
+	cli_and_save(flags);
+	buf->refcount--;
+	restore_flags(flags);
+}
+
+/* static void bcache_write_done(block_request_t* req);
+ * Inputs: req - completed write-back request
+ * Return Value: none
+ * Function: Completion callback for write-backs, records the flush latency
+ *				once the last write of a flush finishes
+ */
+static void bcache_write_done(block_request_t* req) {
+	buffer_t* b = (buffer_t*) req->priv;
+	uint32_t cycles;
+
+	b->writing = 0;
+	if(req->status != BLOCK_OK) b->dirty = 1; /* Try again next flush */
+	else stats.writebacks++;
+
+	if(--flush_outstanding == 0) {
+		cycles = (uint32_t)(rdtsc() - flush_start);
+		stats.flushes++;
+		stats.last_flush_cycles = cycles;
+		if(cycles > stats.max_flush_cycles) stats.max_flush_cycles = cycles;
+	}
+}
+
+/* static void bcache_flush(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Queues a write-back of every dirty buffer without waiting for
+ *				them, does nothing if the previous flush is still in flight
+ */
+static void bcache_flush(void) {
+	uint32_t flags, i;
+	block_request_t* list = NULL;
+	buffer_t* b;
+
+	if(!fs_dev) return;
+
+	cli_and_save(flags);
+	if(flush_outstanding) {
+		restore_flags(flags);
+		return;
+	}
+
+	/* Gather every dirty buffer into one list so the driver can start them together */
+	for(i = BCACHE_NUM_BUFFERS; i-- > 0;) {
+		b = &buffers[i];
+		if(!b->valid || !b->dirty || b->writing) continue;
+		b->dirty = 0;
+		b->writing = 1;
+		b->req.block = b->block;
+		b->req.count = 1;
+		b->req.buf = b->data;
+		b->req.write = 1;
+		b->req.done = 0;
+		b->req.status = BLOCK_OK;
+		b->req.callback = bcache_write_done;
+		b->req.priv = b;
+		b->req.next = list;
+		list = &b->req;
+		flush_outstanding++;
+	}
+	if(!list) {
+		restore_flags(flags);
+		return;
+	}
+
+	flush_start = rdtsc();
+	flush_outstanding++; /* Keeps early completions from ending the flush */
+	if(fs_dev->submit(fs_dev, list) == BLOCK_ERROR) {
+		for(; list; list = list->next) {
+			b = (buffer_t*) list->priv;
+			b->writing = 0;
+			b->dirty = 1;
+		}
+		flush_outstanding = 0;
+		restore_flags(flags);
+		return;
+	}
+
+	if(--flush_outstanding == 0) {
+		stats.flushes++;
+		stats.last_flush_cycles = (uint32_t)(rdtsc() - flush_start);
+		if(stats.last_flush_cycles > stats.max_flush_cycles)
+			stats.max_flush_cycles = stats.last_flush_cycles;
+	}
+	restore_flags(flags);
+}
+
+/* static void bcache_periodic_flush(uint32_t arg);
+ * Inputs: arg - unused
+ * Return Value: none
+ * Function: RTC callback that starts a flush and re-arms itself
+ */
+static void bcache_periodic_flush(uint32_t arg) {
+	bcache_flush();
+	rtc_register_handler(bcache_periodic_flush, 0, BCACHE_FLUSH_MS);
+}
+
+/* void bcache_sync(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Writes back every dirty buffer and waits until they are on the device
+ */
+void bcache_sync(void) {
+	uint32_t i;
+	uint8_t dirty;
+
+	if(!fs_dev) return;
+	do {
+		/* Wait out any flush already in flight, then start ours */
+		while(flush_outstanding) {
+			if(fs_dev->poll) fs_dev->poll(fs_dev);
+		}
+		bcache_flush();
+		while(flush_outstanding) {
+			if(fs_dev->poll) fs_dev->poll(fs_dev);
+		}
+
+		dirty = 0;
+		for(i = 0; i < BCACHE_NUM_BUFFERS; ++i) {
+			if(buffers[i].valid && buffers[i].dirty) dirty = 1;
+		}
+	} while(dirty);
+}
+
+/* void bcache_get_stats(bcache_stats_t* out);
+ * Inputs: out - filled with the cache statistics
+ * Return Value: none
+ * Function: Copies out the cache statistics
+ */
+void bcache_get_stats(bcache_stats_t* out) {
+	memcpy(out, &stats, sizeof(stats));
+}
+
+/* void bcache_print_stats(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Prints the read-hit ratio (to 0.1%) and flush latency
+ */
+void bcache_print_stats(void) {
+	uint32_t total = stats.hits + stats.misses;
+	uint32_t permille = total ? (stats.hits * 1000) / total : 0;
+
+	printf("bcache [%s]: %u hits, %u misses, hit ratio %u.%u%%\n",
+		fs_dev ? fs_dev->name : "none", stats.hits, stats.misses, permille / 10, permille % 10);
+	printf("bcache: %u write-backs, %u flushes, last flush %u cycles, max %u cycles\n",
+		stats.writebacks, stats.flushes, stats.last_flush_cycles, stats.max_flush_cycles);
+}
@@ -0,0 +1,88 @@
+/* devfs.c - Device directory "dev". Each file is a name and an operations
+ *			table a kernel module registers, lookups never touch the device
+ * vim:ts=4 noexpandtab
+ */
+
+#include "filesystem.h"
+#include "devfs.h"
+
+typedef struct devfs_file {
+  uint8_t name[MAX_FILENAME_LENGTH];
+  file_ops_t* fops;
+} devfs_file_t;
+
+static devfs_file_t devfs_files[DEVFS_MAX_FILES];
+static uint32_t devfs_count = 0;
+
+/* const uint8_t* devfs_path(const uint8_t* fname);
+ * Inputs: fname - file name as passed to open
+ * Return Value: the name below the mount point, NULL if fname isn't in devfs
+ * Function: Matches "dev/<name>"
+ */
+const uint8_t* devfs_path(const uint8_t* fname) {
+  if(strncmp((const int8_t*)fname, (const int8_t*)DEVFS_MOUNT, DEVFS_MOUNT_LEN)) return NULL;
+  if(fname[DEVFS_MOUNT_LEN] == '/') return fname + DEVFS_MOUNT_LEN + 1;
+  return NULL;
+}
+
+/* int32_t devfs_register(const uint8_t* name, file_ops_t* fops);
+ * Inputs: name - file name below the mount point
+ *			fops - operations for the file, open gets the fd
+ * Return Value: inode number of the file, -1 if the name is bad or devfs is full
+ * Function: Makes the file visible as "dev/<name>"
+ */
+int32_t devfs_register(const uint8_t* name, file_ops_t* fops) {
+  dentry_t dentry;
+
+  if(!name[0] || strlen((const int8_t*)name) > MAX_FILENAME_LENGTH || !fops) return -1;
+  if(devfs_count >= DEVFS_MAX_FILES || !devfs_lookup(name, &dentry)) return -1;
+
+  strncpy((int8_t*)devfs_files[devfs_count].name, (const int8_t*)name, MAX_FILENAME_LENGTH);
+  devfs_files[devfs_count].fops = fops;
+  return devfs_count++;
+}
+
+/* int32_t devfs_lookup(const uint8_t* name, dentry_t* dentry);
+ * Inputs: name - file name below the mount point
+ *			dentry - filled with the file's entry
+ * Return Value: 0 for success, -1 if there is no such file
+ * Function: Makes a registered file look like a directory entry, with
+ *				file_type FILE_TYPE_DEV so open picks its operations
+ */
+int32_t devfs_lookup(const uint8_t* name, dentry_t* dentry) {
+  uint32_t i;
+
+  for(i = 0; i < devfs_count; ++i) {
+	if(strncmp((const int8_t*)devfs_files[i].name, (const int8_t*)name, MAX_FILENAME_LENGTH)) continue;
+	memset(dentry, 0, sizeof(*dentry));
+	memcpy(dentry->filename, devfs_files[i].name, MAX_FILENAME_LENGTH);
+	dentry->file_type = FILE_TYPE_DEV;
+	dentry->inode_num = i;
+	return 0;
+  }
+  return -1;
+}
+
+/* int32_t devfs_stat(uint32_t inode, stat_t* buf);
+ * Inputs: inode - inode number of a registered file
+ *			buf - filled with the file's information
+ * Return Value: 0 for success, -1 if there is no such file
+ * Function: Device files have no length or blocks
+ */
+int32_t devfs_stat(uint32_t inode, stat_t* buf) {
+  if(inode >= devfs_count) return -1;
+  buf->inode_num = inode;
+  buf->file_type = FILE_TYPE_DEV;
+  buf->length = 0;
+  buf->blocks = 0;
+  return 0;
+}
+
+/* file_ops_t* devfs_fops(uint32_t inode);
+ * Inputs: inode - inode number from devfs_lookup
+ * Return Value: the file's operations, NULL if there is no such file
+ * Function: Looks up the table open should install
+ */
+file_ops_t* devfs_fops(uint32_t inode) {
+  return inode < devfs_count ? devfs_files[inode].fops : NULL;
+}
@@ -0,0 +1,32 @@
+/* devfs.h - Defines the device directory "dev", whose files are kernel
+ *			interfaces registered at boot rather than data on a device
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef DEVFS_H
+#define DEVFS_H
+
+#include "filesystem_structs.h"
+
+/* Name of the mount point, files in it are opened as "dev/<name>" */
+#define DEVFS_MOUNT "dev"
+#define DEVFS_MOUNT_LEN 3
+
+/* Number of files that can be registered */
+#define DEVFS_MAX_FILES 16
+
+/* Returns the part of fname below the mount point, NULL if fname isn't in devfs */
+const uint8_t* devfs_path(const uint8_t* fname);
+
+/* Adds a file, returns its inode number or -1 if devfs is full.
+ *	open is called with the fd as its argument, as for the rtc */
+int32_t devfs_register(const uint8_t* name, file_ops_t* fops);
+
+/* Directory operations on names below the mount point */
+int32_t devfs_lookup(const uint8_t* name, dentry_t* dentry);
+int32_t devfs_stat(uint32_t inode, stat_t* buf);
+
+/* Operations table of a registered file, NULL if there is none */
+file_ops_t* devfs_fops(uint32_t inode);
+
+#endif /* DEVFS_H */
@@ -4,10 +4,164 @@
  */
 
 #include "filesystem.h"
+#include "tmpfs.h"
+#include "devfs.h"
+#include "../klog.h"
+
+/* Name lookups go through a hash index of the directory built at mount,
+ *	chained through dir_hash_next by dentry index */
+#define DIR_HASH_BUCKETS 4096
+#define DIR_NO_ENTRY 0xFFFF
+
+static uint16_t dir_hash_head[DIR_HASH_BUCKETS];
+static uint16_t dir_hash_next[MAX_DIR_ENTRIES];
+
+/* Dentries read per call when scanning the directory */
+#define DIR_READ_BATCH 16
+
+/* static uint32_t dir_hash(const uint8_t* name);
+ * Inputs: name - file name, not necessarily NUL terminated at MAX_FILENAME_LENGTH
+ * Return Value: hash bucket for the name
+ * Function: FNV-1a hash of the name
+ */
+static uint32_t dir_hash(const uint8_t* name) {
+  uint32_t i, h = 2166136261U;
+  for(i = 0; i < MAX_FILENAME_LENGTH && name[i]; ++i) {
+	h = (h ^ name[i]) * 16777619U;
+  }
+  return h % DIR_HASH_BUCKETS;
+}
+
+/* static int32_t dir_read_entries(uint32_t index, dentry_t* d, uint32_t n);
+ * Inputs: index - first entry to read
+ *			d - array filled with the entries
+ *			n - number of entries to read
+ * Return Value: number of entries read, -1 for failure
+ * Function: Reads entries from the boot block, or from the directory inode on
+ *				images that have one
+ */
+static int32_t dir_read_entries(uint32_t index, dentry_t* d, uint32_t n) {
+  int32_t bytes;
+
+  if(index >= root.num_dir_entries) return 0;
+  if(n > root.num_dir_entries - index) n = root.num_dir_entries - index;
+
+  if(root.magic != FS_MAGIC) {
+	memcpy(d, &root.dentries[index], n * DENTRY_SIZE);
+	return n;
+  }
+  bytes = read_data(root.dir_inode, index * DENTRY_SIZE, (uint8_t*) d, n * DENTRY_SIZE);
+  return bytes < 0 ? -1 : bytes / DENTRY_SIZE;
+}
+
+/* static int32_t dir_write_entry(uint32_t index, const dentry_t* d);
+ * Inputs: index - entry to write, at most one past the last entry
+ *			d - new contents of the entry
+ * Return Value: 0 for success, -1 for failure
+ * Function: Writes an entry, growing the directory inode if needed. Entries in
+ *				the boot block reach the device on the next write_boot_block
+ */
+static int32_t dir_write_entry(uint32_t index, const dentry_t* d) {
+  if(index >= max_dir_entries()) return -1;
+
+  if(root.magic != FS_MAGIC) {
+	memcpy(&root.dentries[index], d, DENTRY_SIZE);
+	return 0;
+  }
+  return write_data(root.dir_inode, index * DENTRY_SIZE, (const uint8_t*) d, DENTRY_SIZE)
+	== DENTRY_SIZE ? 0 : -1;
+}
+
+/* static void dir_hash_insert(uint32_t index, const uint8_t* name);
+ * Inputs: index - entry holding name
+ *			name - file name of the entry
+ * Return Value: none
+ * Function: Adds an entry to the name index
+ */
+static void dir_hash_insert(uint32_t index, const uint8_t* name) {
+  uint32_t h = dir_hash(name);
+  dir_hash_next[index] = dir_hash_head[h];
+  dir_hash_head[h] = index;
+}
+
+/* static void dir_hash_remove(uint32_t index, const uint8_t* name);
+ * Inputs: index - entry holding name
+ *			name - file name of the entry
+ * Return Value: none
+ * Function: Removes an entry from the name index
+ */
+static void dir_hash_remove(uint32_t index, const uint8_t* name) {
+  uint16_t* link = &dir_hash_head[dir_hash(name)];
+  while(*link != DIR_NO_ENTRY) {
+	if(*link == index) {
+	  *link = dir_hash_next[index];
+	  return;
+	}
+	link = &dir_hash_next[*link];
+  }
+}
+
+/* static int32_t dir_lookup(const uint8_t* fname, dentry_t* dentry);
+ * Inputs: fname - name of the file
+ *			dentry - filled with the file's entry
+ * Return Value: index of the entry, -1 if there is no such file
+ * Function: Finds a file through the name index, reading only the entries
+ *				whose names hash to the same bucket
+ */
+static int32_t dir_lookup(const uint8_t* fname, dentry_t* dentry) {
+  uint16_t i;
+
+  // don't match empty filename
+  if(fname[0] == '\0') return -1;
+
+  for(i = dir_hash_head[dir_hash(fname)]; i != DIR_NO_ENTRY; i = dir_hash_next[i]) {
+	if(dir_read_entries(i, dentry, 1) != 1) continue;
+	if(!strncmp((int8_t*)fname, (int8_t*)dentry->filename, MAX_FILENAME_LENGTH)) return i;
+  }
+  return -1;
+}
+
+/* int32_t directory_init(void);
+ * Inputs: none
+ * Return Value: 0 for success, -1 if the directory is too large or unreadable
+ * Function: Builds the name index from the entries of the root directory
+ */
+int32_t directory_init(void) {
+  dentry_t batch[DIR_READ_BATCH];
+  uint32_t pos = 0;
+  int32_t i, n;
+
+  memset(dir_hash_head, 0xFF, sizeof(dir_hash_head)); /* DIR_NO_ENTRY */
+
+  if(root.num_dir_entries > max_dir_entries()) {
+	klog(KLOG_ERR, "filesystem: directory has too many entries\n");
+	return -1;
+  }
+
+  while(pos < root.num_dir_entries) {
+	if((n = dir_read_entries(pos, batch, DIR_READ_BATCH)) <= 0) return -1;
+	for(i = 0; i < n; ++i, ++pos) {
+	  if(check_valid_file_type(batch[i].file_type) && batch[i].filename[0])
+		dir_hash_insert(pos, batch[i].filename);
+	}
+  }
+  return 0;
+}
+
+/* uint32_t max_dir_entries(void);
+ * Inputs: none
+ * Return Value: number of entries the root directory can hold
+ * Function: The boot block holds MAX_FILES entries, a directory inode holds
+ *				as many as fit in the largest file
+ */
+uint32_t max_dir_entries(void) {
+  return root.magic == FS_MAGIC ? MAX_DIR_ENTRIES : MAX_FILES;
+}
 
 /*** File Operations for Directories ***/
 
-file_ops_t file_ops_dir = {directory_read, directory_write, directory_open, directory_close};
+file_ops_t file_ops_dir = {directory_read, directory_write, directory_open, directory_close,
+						directory_lseek, NULL, NULL, directory_getdents, directory_fstat};
 
 /* int32_t directory_open(const uint8_t* path);
  * Inputs: path - name of directory to be opened
@@ -32,14 +186,15 @@ int32_t directory_close(int32_t fd) {
  * Inputs: fd - file descriptor of directory to read from
  *			buf - buffer for filename to be read 
  *			nbytes - number of bytes to read
- * Return Value: number of bytes read
+ * Return Value: number of bytes read, 0 at the end of the directory
  * Function: Reads the next filename from the directory 
  */
 int32_t directory_read(int32_t fd, void* buf, int32_t nbytes) {
-  if (fd_table[fd].file_pos == root.num_inodes) return -1;
+  dentry_t d;
+  if (read_dentry_by_index(fd_table[fd].file_pos, &d)) return 0;
   if(nbytes > MAX_FILENAME_LENGTH) nbytes = MAX_FILENAME_LENGTH;
-  int32_t n = strlcpy(buf, (const int8_t*)root.dentries[fd_table[fd].file_pos].filename, nbytes);
-  memcpy((char*)buf, (char*)root.dentries[fd_table[fd].file_pos].filename, nbytes);
+  int32_t n = strlcpy(buf, (const int8_t*)d.filename, nbytes);
+  memcpy((char*)buf, (char*)d.filename, nbytes);
 
   fd_table[fd].file_pos += 0x01;
 
@@ -53,6 +208,78 @@ int32_t directory_read(int32_t fd, void* buf, int32_t nbytes) {
     return nbytes; // return # of bytes read*/
 }
 
+/* int32_t directory_lseek(int32_t fd, int32_t offset, int32_t whence);
+ * Inputs: fd - file descriptor of directory
+ *			offset - entry index relative to whence
+ *			whence - SEEK_SET or SEEK_CUR
+ * Return Value: new entry index, -1 for failure
+ * Function: Moves to a directory entry, lseek(fd, 0, SEEK_SET) rewinds
+ */
+int32_t directory_lseek(int32_t fd, int32_t offset, int32_t whence) {
+  int32_t base;
+  if(whence == SEEK_SET) base = 0;
+  else if(whence == SEEK_CUR) base = fd_table[fd].file_pos;
+  else return -1;
+
+  if(base + offset < 0 || base + offset > max_dir_entries()) return -1;
+  fd_table[fd].file_pos = base + offset;
+  return fd_table[fd].file_pos;
+}
+
+/* int32_t directory_getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor of directory to read from
+ *			buf - array of records to fill
+ *			nbytes - size of buf in bytes
+ * Return Value: number of bytes filled (a multiple of sizeof(dirent_t)), 0 at the
+ *			end of the directory, -1 if buf can't hold a single record
+ * Function: Reads as many entries as fit in buf, including each file's length,
+ *				so listing a directory takes one call instead of one per name
+ */
+int32_t directory_getdents(int32_t fd, dirent_t* buf, int32_t nbytes) {
+  dentry_t batch[DIR_READ_BATCH];
+  uint32_t pos = fd_table[fd].file_pos;
+  int32_t count = 0, max = nbytes / (int32_t)sizeof(dirent_t);
+  int32_t i, n;
+  stat_t st;
+
+  if(max <= 0) return -1;
+
+  while(pos < root.num_dir_entries && count < max) {
+	n = max - count;
+	if(n > DIR_READ_BATCH) n = DIR_READ_BATCH;
+	if((n = dir_read_entries(pos, batch, n)) <= 0) break;
+
+	for(i = 0; i < n; ++i, ++pos) {
+	  if(!check_valid_file_type(batch[i].file_type) || !batch[i].filename[0]) continue;
+
+	  stat_dentry(&batch[i], &st);
+	  buf[count].inode_num = st.inode_num;
+	  buf[count].length = st.length;
+	  buf[count].file_type = st.file_type;
+	  memcpy(buf[count].name, batch[i].filename, MAX_FILENAME_LENGTH);
+	  buf[count].name[MAX_FILENAME_LENGTH] = '\0';
+	  ++count;
+	}
+  }
+
+  fd_table[fd].file_pos = pos;
+  return count * sizeof(dirent_t);
+}
+
+/* int32_t directory_fstat(int32_t fd, stat_t* buf);
+ * Inputs: fd - file descriptor of directory
+ *			buf - filled with the directory's information
+ * Return Value: 0
+ * Function: Reports the root directory, its length is its number of entries
+ */
+int32_t directory_fstat(int32_t fd, stat_t* buf) {
+  buf->inode_num = 0;
+  buf->file_type = FILE_TYPE_DIR;
+  buf->length = root.num_dir_entries;
+  buf->blocks = 0;
+  return 0;
+}
+
 /* int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes);
  * Inputs: fd - file descriptor of directory to write to
  *			buf - buffer of filename to create in the directory
@@ -69,47 +296,58 @@ int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes) {
  *			dentry - pointer to dir-entry that will be filled by 
  *					the dir-entry of the input file
  * Return Value: 0 for success, -1 for failure
- * Function: Loops through the root directory and search for file with 
- *				file name 'fname'
+ * Function: Looks up the file with file name 'fname' in the root directory,
+ *				or in tmpfs or devfs for names under their mount points
  */
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry) {
-    int32_t i;
-    // don't match empty filename
-    if (fname[0]=='\0') return -1;
-
-	/* Iterate through all dentries in root directory */
-    for(i = 0; i < MAX_FILES; ++i) {
-    	/* Directory entry does not exist */
-        if(!check_valid_file_type(root.dentries[i].file_type)) 
-        	continue;
-        
-        /* File name matches */
-        if(!strncmp((char*)fname, (char*)root.dentries[i].filename, 32)) {
-            memcpy(dentry, &(root.dentries[i]), DENTRY_SIZE);
-            return 0;
-        }
-    }
-
-    return -1;
+    const uint8_t* tmp_name;
+    if((tmp_name = tmpfs_path(fname))) return tmpfs_lookup(tmp_name, dentry);
+    if((tmp_name = devfs_path(fname))) return devfs_lookup(tmp_name, dentry);
+    return dir_lookup(fname, dentry) == -1 ? -1 : 0;
 }
 
 /* int32_t read_dentry_by_index(int32_t index, dentry_t* dentry); 
- * Inputs: index - index of dir-entry in boot block
+ * Inputs: index - index of dir-entry in the root directory
  *			dentry - pointer to dir-entry that will be filled by 
  *					the dir-entry of the input file
  * Return Value: 0 for success, -1 for failure
- * Function: Retrieves the index-th entry in the boot-block's 
- *				dir-entry list
+ * Function: Retrieves the index-th entry in the root directory
  */
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry) {
-    if(!check_valid_file_type(root.dentries[index].file_type)) {
+    if(index >= root.num_dir_entries) return -1;
+    if(dir_read_entries(index, dentry, 1) != 1) return -1;
+    if(!check_valid_file_type(dentry->file_type)) {
         return -1;
     }
-	if(root.dentries[index].filename[0] == 0) return -1;
-    memcpy(dentry, &(root.dentries[index]), DENTRY_SIZE);
+	if(dentry->filename[0] == 0) return -1;
 	return 0;
 }
 
+/* int32_t stat_dentry(const dentry_t* dentry, stat_t* buf);
+ * Inputs: dentry - directory entry of the file
+ *			buf - filled with the file's information
+ * Return Value: 0 for success, -1 if the inode can't be read
+ * Function: Looks up a regular file's length in its inode, other file types
+ *				have no data so their length is 0
+ */
+int32_t stat_dentry(const dentry_t* dentry, stat_t* buf) {
+  buffer_t* b;
+
+  if(dentry->file_type == FILE_TYPE_TMPFS) return tmpfs_stat(dentry->inode_num, buf);
+  if(dentry->file_type == FILE_TYPE_DEV) return devfs_stat(dentry->inode_num, buf);
+
+  buf->inode_num = dentry->inode_num;
+  buf->file_type = dentry->file_type;
+  buf->length = 0;
+  buf->blocks = 0;
+  if(dentry->file_type != FILE_TYPE_REGULAR) return 0;
+
+  if(!(b = bread(INODE_BLOCK(dentry->inode_num)))) return -1;
+  buf->length = ((inode_t*) b->data)->length;
+  buf->blocks = (buf->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  brelse(b);
+  return 0;
+}
 
 /* uint8_t check_valid_file_type(uint32_t file_type);
  * Inputs: file_type - a file type
@@ -128,50 +366,95 @@ uint8_t check_valid_file_type(uint32_t file_type) {
 	return 0;
 }
 
+/* int32_t new_dentry(const uint8_t* fname);
+ * Inputs: fname - name of the file to create
+ * Return Value: 0 for success, -1 if the directory or inode table is full
+ * Function: Claims a free inode for an empty regular file and appends its
+ *				entry to the root directory, or creates the file in tmpfs
+ */
 int32_t new_dentry(const uint8_t* fname) {
-  int32_t i, j;
-  for(i = 0; i < MAX_FILES; ++i) {
-	if(!root.dentries[i].filename[0]) {
-	  strcpy(&root.dentries[i].filename, fname);
-	  root.dentries[i].file_type = FILE_TYPE_REGULAR;
-	  // Find a free inode
-	  for(j = 1; j < 30; ++j) {
-		if(!inode_base[j].length) break;
-	  }
+  const uint8_t* tmp_name;
+  dentry_t d;
+  buffer_t* b;
+  int32_t inode;
 
-	  root.dentries[i].inode_num = j; // won't be len 0 for long
-	  break;
-	}
+  if((tmp_name = tmpfs_path(fname))) return tmpfs_create(tmp_name);
+  if(devfs_path(fname)) return -1; /* only the kernel adds device files */
+
+  if(!fname[0] || root.num_dir_entries >= max_dir_entries()) return -1;
+  if((inode = bitmap_alloc(&inode_bitmap)) == -1) return -1;
+
+  // Inodes freed by remove_dentry are already empty, but don't trust the image
+  if(!(b = bread(INODE_BLOCK(inode)))) {
+	bitmap_set(&inode_bitmap, inode, 0);
+	return -1;
+  }
+  ((inode_t*) b->data)->length = 0;
+  bwrite(b);
+  brelse(b);
+
+  memset(&d, 0, sizeof(d));
+  strncpy((int8_t*)d.filename, (const int8_t*)fname, MAX_FILENAME_LENGTH);
+  d.file_type = FILE_TYPE_REGULAR;
+  d.inode_num = inode;
+  if(dir_write_entry(root.num_dir_entries, &d)) {
+	bitmap_set(&inode_bitmap, inode, 0);
+	return -1;
   }
+
+  dir_hash_insert(root.num_dir_entries, d.filename);
+  root.num_dir_entries++;
+  write_boot_block();
   return 0;
 }
 
+/* int32_t remove_dentry(const uint8_t* fname);
+ * Inputs: fname - name of the file to remove
+ * Return Value: 0 for success, -1 if there is no such file
+ * Function: Frees the file's inode and data blocks, then moves the last
+ *				directory entry into its slot to keep the directory packed.
+ *				Names under the tmpfs mount point are removed from tmpfs
+ */
 int32_t remove_dentry(const uint8_t* fname) {
-  int32_t i, j;
-  for(i = 0; i < MAX_FILES; ++i) {
-	if(!strncmp((char*)fname, (char*)root.dentries[i].filename, 32)) {
-	  // clear out inode
-	  for(j = 0; j < (inode_base[root.dentries[i].inode_num].length / FOUR_KB) + 1; ++j) {
-		data_block_bitmap[inode_base[root.dentries[i].inode_num].data_blocks[j]] = 0;
-	  }
-	  inode_base[root.dentries[i].inode_num].length = 0;
+  const uint8_t* tmp_name;
+  int32_t i, last;
+  uint32_t j;
+  buffer_t* b;
+  inode_t* inode;
+  dentry_t d, moved;
 
-	  // clear dentry
-	  memset(root.dentries[i].filename, 0, 32);
-	  root.dentries[i].file_type = 0;
-	  root.dentries[i].inode_num = 0;
-	  break;
+  if((tmp_name = tmpfs_path(fname))) return tmpfs_remove(tmp_name);
+  if(devfs_path(fname)) return -1;
+
+  if((i = dir_lookup(fname, &d)) == -1) return -1;
+
+  if(d.file_type == FILE_TYPE_REGULAR) {
+	// clear out inode
+	if((b = bread(INODE_BLOCK(d.inode_num)))) {
+	  inode = (inode_t*) b->data;
+	  for(j = 0; j < (inode->length + BLOCK_SIZE - 1) / BLOCK_SIZE; ++j) {
+		bitmap_set(&data_bitmap, inode->data_blocks[j], 0);
+	  }
+	  inode->length = 0;
+	  bwrite(b);
+	  brelse(b);
 	}
+	bitmap_set(&inode_bitmap, d.inode_num, 0);
   }
+  dir_hash_remove(i, d.filename);
 
-  // if this wasn't the last dentry
-  dentry_t d;
-  j = i+1; 
-  for(; read_dentry_by_index(j, &d) != -1; ++j) continue;
-  j -= 1;
-  memcpy(&root.dentries[i], &root.dentries[j], sizeof(dentry_t));
-
-  memset(root.dentries[j].filename, 0, 32);
-  root.dentries[j].file_type = 0;
-  root.dentries[j].inode_num = 0;
+  // if this wasn't the last dentry, move the last one into its place
+  last = root.num_dir_entries - 1;
+  if(i != last && dir_read_entries(last, &moved, 1) == 1) {
+	dir_hash_remove(last, moved.filename);
+	dir_write_entry(i, &moved);
+	dir_hash_insert(i, moved.filename);
+  }
+
+  memset(&d, 0, sizeof(d));
+  dir_write_entry(last, &d);
+  root.num_dir_entries = last;
+
+  write_boot_block();
+  return 0;
 }
@@ -0,0 +1,194 @@
+/* fdtable.c - Per-process file descriptor tables over the open file table.
+ *			Drivers are called with an open file, the index into fd_table,
+ *			so descriptors made by dup and dup2 share its position and flags
+ * vim:ts=4 noexpandtab
+ */
+
+#include "filesystem.h"
+#include "fdtable.h"
+#include "../lib.h"
+#include "../paging.h"		/* For frame_alloc */
+
+fdtable_t kernel_fds;
+fdtable_t* current_fds = &kernel_fds;
+
+/* Descriptors referring to each open file, 0 if the entry is free */
+static uint16_t file_refs[NUM_OPEN_FILES];
+
+#define FD_BIT(fd) (1U << ((fd) % 32))
+#define FD_IS_OPEN(t, fd) ((t)->used[(fd) / 32] & FD_BIT(fd))
+
+/* int32_t file_alloc(void);
+ * Inputs: None
+ * Return Value: free open file with one reference and cleared fields,
+ *		-1 if every one is in use
+ * Function: Takes the lowest unused entry of fd_table
+ */
+int32_t file_alloc(void) {
+	uint32_t flags;
+	int32_t file;
+
+	cli_and_save(flags);
+	for(file = 0; file < NUM_OPEN_FILES; ++file) {
+		if(!file_refs[file]) {
+			file_refs[file] = 1;
+			memset(&fd_table[file], 0, sizeof(fd_t));
+			restore_flags(flags);
+			return file;
+		}
+	}
+	restore_flags(flags);
+	return -1;
+}
+
+/* void file_get(int32_t file);
+ * Inputs: file - open file
+ * Return Value: None
+ * Function: Adds a reference, for a new descriptor sharing the file
+ */
+void file_get(int32_t file) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	file_refs[file]++;
+	restore_flags(flags);
+}
+
+/* void file_put(int32_t file);
+ * Inputs: file - open file
+ * Return Value: None
+ * Function: Drops a reference, calling the file's close operation and
+ *				freeing the entry with the last one. The entry keeps its
+ *				last reference until close returns, so file_alloc can't
+ *				hand it out while it is being torn down
+ */
+void file_put(int32_t file) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(file_refs[file] > 1) {
+		file_refs[file]--;
+		restore_flags(flags);
+		return;
+	}
+	restore_flags(flags);
+
+	if(fd_table[file].fops_table) (fd_table[file].fops_table->close)(file);
+	fd_table[file].fops_table = NULL;
+
+	cli_and_save(flags);
+	file_refs[file] = 0;
+	restore_flags(flags);
+}
+
+/* uint32_t file_count_free(void);
+ * Inputs: None
+ * Return Value: number of entries file_alloc can still hand out
+ * Function: Counts unreferenced open files
+ */
+uint32_t file_count_free(void) {
+	uint32_t file, count = 0;
+
+	for(file = 0; file < NUM_OPEN_FILES; ++file)
+		if(!file_refs[file]) count++;
+	return count;
+}
+
+/* void fdtable_init(fdtable_t* t);
+ * Inputs: t - table, in a new pcb or kernel_fds
+ * Return Value: None
+ * Function: Marks every descriptor closed
+ */
+void fdtable_init(fdtable_t* t) {
+	memset(t, 0, sizeof(fdtable_t));
+}
+
+/* void fdtable_release(fdtable_t* t);
+ * Inputs: t - table of an exiting process
+ * Return Value: None
+ * Function: Puts the file of every open descriptor and frees the overflow
+ *				page, leaving the table empty
+ */
+void fdtable_release(fdtable_t* t) {
+	int32_t fd, file;
+
+	for(fd = 0; fd < MAX_FDS; ++fd)
+		if((file = fd_remove(t, fd)) >= 0) file_put(file);
+	if(t->overflow) frame_free(t->overflow);
+	t->overflow = NULL;
+}
+
+/* static int32_t fd_lookup(fdtable_t* t, int32_t fd);
+ * Inputs: t - table
+ *			fd - descriptor
+ * Return Value: its open file, -1 if fd is out of range or not open
+ * Function: Reads the inline slot or the overflow page
+ */
+static int32_t fd_lookup(fdtable_t* t, int32_t fd) {
+	if(fd < 0 || fd >= MAX_FDS || !FD_IS_OPEN(t, fd)) return -1;
+	if(fd < FD_INLINE) return t->inline_files[fd];
+	return t->overflow[fd - FD_INLINE];
+}
+
+/* int32_t fd_file(int32_t fd);
+ * Inputs: fd - descriptor passed to a syscall
+ * Return Value: its open file in the current table, -1 if it isn't open
+ * Function: Looks fd up in current_fds
+ */
+int32_t fd_file(int32_t fd) {
+	return fd_lookup(current_fds, fd);
+}
+
+/* int32_t fd_lowest_free(fdtable_t* t, int32_t from);
+ * Inputs: t - table
+ *			from - lowest descriptor wanted
+ * Return Value: lowest descriptor not open that is at least from, -1 if none
+ * Function: Skips through the bitmap a word at a time
+ */
+int32_t fd_lowest_free(fdtable_t* t, int32_t from) {
+	uint32_t w, free;
+
+	if(from < 0) from = 0;
+	for(w = from / 32; w < FD_WORDS; ++w) {
+		free = ~t->used[w];
+		if(w == from / 32) free &= ~0U << (from % 32);
+		if(free) return w * 32 + __builtin_ctz(free);
+	}
+	return -1;
+}
+
+/* int32_t fd_install(fdtable_t* t, int32_t fd, int32_t file);
+ * Inputs: t - table
+ *			fd - descriptor, open or not
+ *			file - open file, whose reference the table takes over
+ * Return Value: fd, -1 if it is out of range or no page could be had for
+ *		it, in which case the caller still holds the reference
+ * Function: Points fd at file, putting the file fd had open
+ */
+int32_t fd_install(fdtable_t* t, int32_t fd, int32_t file) {
+	int32_t old;
+
+	if(fd < 0 || fd >= MAX_FDS) return -1;
+	if(fd >= FD_INLINE && !t->overflow && !(t->overflow = frame_alloc())) return -1;
+
+	old = fd_remove(t, fd);
+	if(fd < FD_INLINE) t->inline_files[fd] = file;
+	else t->overflow[fd - FD_INLINE] = file;
+	t->used[fd / 32] |= FD_BIT(fd);
+	if(old >= 0) file_put(old);
+	return fd;
+}
+
+/* int32_t fd_remove(fdtable_t* t, int32_t fd);
+ * Inputs: t - table
+ *			fd - descriptor
+ * Return Value: the open file fd had, whose reference passes to the caller,
+ *		-1 if fd wasn't open
+ * Function: Marks fd closed
+ */
+int32_t fd_remove(fdtable_t* t, int32_t fd) {
+	int32_t file = fd_lookup(t, fd);
+
+	if(file >= 0) t->used[fd / 32] &= ~FD_BIT(fd);
+	return file;
+}
@@ -0,0 +1,55 @@
+/* fdtable.h - Defines per-process file descriptor tables. A descriptor names
+ *			an open file, an entry of fd_table that any number of
+ *			descriptors may share
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef FDTABLE_H
+#define FDTABLE_H
+
+#include "filesystem_structs.h"
+
+/* Descriptors kept in the table itself, the rest go in a page allocated
+ * when the first of them is opened */
+#define FD_INLINE 8
+
+/* Descriptors a process can have open */
+#define MAX_FDS 1024
+#define FD_WORDS (MAX_FDS / 32)
+
+/* Lowest descriptor open, pipe and dup hand out, 0 and 1 are STDIN/STDOUT */
+#define FD_FIRST_FREE 2
+
+typedef struct fdtable {
+	uint32_t used[FD_WORDS];			/* bit per descriptor, set while it is open */
+	uint16_t inline_files[FD_INLINE];	/* open file of each descriptor below FD_INLINE */
+	uint16_t* overflow;					/* open files of the rest, NULL until one is opened */
+} fdtable_t;
+
+/* Table of the running process, or of the kernel before any process runs */
+extern fdtable_t* current_fds;
+extern fdtable_t kernel_fds;
+
+/* Open files: allocated with one reference, closed when the last is put */
+int32_t file_alloc(void);
+void file_get(int32_t file);
+void file_put(int32_t file);
+uint32_t file_count_free(void);
+
+/* Empties a table / closes every descriptor in it and frees its page */
+void fdtable_init(fdtable_t* t);
+void fdtable_release(fdtable_t* t);
+
+/* Open file of a descriptor in the current table, -1 if it isn't open */
+int32_t fd_file(int32_t fd);
+
+/* Lowest descriptor from from up that isn't open, -1 if none */
+int32_t fd_lowest_free(fdtable_t* t, int32_t from);
+
+/* Points fd at file, taking over a reference; whatever fd had open is put */
+int32_t fd_install(fdtable_t* t, int32_t fd, int32_t file);
+
+/* Closes fd without putting its file, which is returned, -1 if not open */
+int32_t fd_remove(fdtable_t* t, int32_t fd);
+
+#endif /* FDTABLE_H */
@@ -5,9 +5,11 @@
 
 
 #include "filesystem.h"
+#include "../trace.h"
 
 /* Definition of file operations table for regular files */
-file_ops_t file_ops_regular = {file_read, file_write, file_open, file_close};
+file_ops_t file_ops_regular = {file_read, file_write, file_open, file_close, file_lseek, file_pread, file_pwrite, NULL, file_fstat,
+								file_readv, file_writev};
 
 /* int32_t file_open(const uint8_t* filename);
  * Inputs: filename - name of file to be opened
@@ -27,56 +29,252 @@ int32_t file_close(int32_t fd) {
     return 0;
 }
 
+/* static int32_t file_truncate(uint32_t inode);
+ * Inputs: inode - inode number of the file to empty
+ * Return Value: 0 for success, -1 for failure
+ * Function: Frees all of the file's data blocks and sets its length to 0
+ */
+static int32_t file_truncate(uint32_t inode) {
+  inode_t* curr_inode;
+  buffer_t* inode_buf;
+  uint32_t data_block_count, i;
+
+  if(!(inode_buf = bread(INODE_BLOCK(inode)))) return -1;
+  curr_inode = (inode_t*) inode_buf->data;
+
+  data_block_count = (curr_inode->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  for(i = 0; i < data_block_count; ++i) {
+	bitmap_set(&data_bitmap, curr_inode->data_blocks[i], 0);
+  }
+  curr_inode->length = 0;
+  bwrite(inode_buf);
+  brelse(inode_buf);
+  return 0;
+}
+
 /* int32_t file_write(int32_t fd);
  * Inputs: fd - file descriptor of file to write to
  *			buf - buffer of string to write to the file
  *			nbytes - number of bytes in the string to write
- * Return Value: 0 for success, -1 for failure
- * Function: Appends buf to the end of a file
+ * Return Value: number of bytes written, -1 for failure
+ * Function: Replaces the contents of the file with buf
  */
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes) {
-  inode_t* curr_inode;
-  uint32_t data_block_count, data_addr, i, remaining_data, j;
+  /* Check before the old contents are thrown away */
+  if(nbytes < 0 || nbytes > MAX_FILE_SIZE) return -1;
 
-  curr_inode = &inode_base[fd_table[fd].inode_num];
+  // (1) free all data blocks
+  if(file_truncate(fd_table[fd].inode_num)) return -1;
 
-  if(curr_inode->length != 0) {
-	// (1) free all data blocks
-	data_block_count = (curr_inode->length / FOUR_KB) + 1;
-	for(i = 0; i < data_block_count; ++i) {
-	  data_block_bitmap[curr_inode->data_blocks[i]] = 0;
-	}
+  // (2) copy buf into newly allocated blocks
+  return write_data(fd_table[fd].inode_num, 0, buf, nbytes);
+}
+
+/* int32_t file_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+ * Inputs: fd - file descriptor of file to read from
+ *			iov - buffers to fill, in order
+ *			iovcnt - number of buffers
+ * Return Value: number of bytes read, -1 for failure
+ * Function: Reads at file_pos into the buffers in one pass over the file
+ *				and moves file_pos forward by the bytes read
+ */
+int32_t file_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+  int32_t bytes_read = read_datav(fd_table[fd].inode_num, fd_table[fd].file_pos, iov, iovcnt);
+  if(bytes_read < 0) return -1;
+  fd_table[fd].file_pos += bytes_read;
+  return bytes_read;
+}
+
+/* int32_t file_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+ * Inputs: fd - file descriptor of file to write to
+ *			iov - buffers to write, in order
+ *			iovcnt - number of buffers
+ * Return Value: number of bytes written, -1 for failure
+ * Function: Like file_write, replaces the contents of the file with the
+ *				buffers joined together
+ */
+int32_t file_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+  uint32_t written = 0, total = 0;
+  int32_t i, n;
+
+  /* Check the joined size before the old contents are thrown away */
+  for(i = 0; i < iovcnt; ++i) {
+	if(iov[i].len > MAX_FILE_SIZE - total) return -1;
+	total += iov[i].len;
   }
 
-  curr_inode->length = nbytes;
-  /*
-  for(i = 15; i < NUM_DATA_BLOCK_ADDR; ++i) {
-	if(!data_block_bitmap[i]) break;
+  if(file_truncate(fd_table[fd].inode_num)) return -1;
+
+  for(i = 0; i < iovcnt; ++i) {
+	if((n = write_data(fd_table[fd].inode_num, written, iov[i].base, iov[i].len)) < 0) break;
+	written += n;
+	if(n < iov[i].len) break; /* device is full */
   }
-  curr_inode->data_blocks[0] = i;
+  return (written || i == iovcnt) ? written : -1;
+}
 
-  // Get addr to start copying into
-  data_addr = &data_base[curr_inode->data_blocks[0]];
-  // Add data until end of current data block
-  memcpy(data_addr, buf, nbytes);*/
+/* int32_t file_lseek(int32_t fd, int32_t offset, int32_t whence);
+ * Inputs: fd - file descriptor of file to seek in
+ *			offset - byte offset relative to whence
+ *			whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * Return Value: new file position, -1 for failure
+ * Function: Moves file_pos, which may go past the end of the file
+ */
+int32_t file_lseek(int32_t fd, int32_t offset, int32_t whence) {
+  buffer_t* inode_buf;
+  int32_t base;
 
-  remaining_data = nbytes;
-  for(i = 0; i < data_block_count; ++i) {
-	for(j = 15; j < NUM_DATA_BLOCK_ADDR; ++j) {
-	  if(!data_block_bitmap[j]) break;
+  switch(whence) {
+	case SEEK_SET:
+	  base = 0;
+	  break;
+	case SEEK_CUR:
+	  base = fd_table[fd].file_pos;
+	  break;
+	case SEEK_END:
+	  if(!(inode_buf = bread(INODE_BLOCK(fd_table[fd].inode_num)))) return -1;
+	  base = ((inode_t*) inode_buf->data)->length;
+	  brelse(inode_buf);
+	  break;
+	default:
+	  return -1;
+  }
+
+  /* Bound offset before adding so the sum can't overflow */
+  if(offset < -base || offset > MAX_FILE_SIZE - base) return -1;
+  fd_table[fd].file_pos = base + offset;
+  return fd_table[fd].file_pos;
+}
+
+/* int32_t file_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+ * Inputs: fd - file descriptor of file to read from
+ *			buf - buffer for data read from the file
+ *			nbytes - number of bytes to read
+ *			offset - byte offset in the file to read from
+ * Return Value: number of bytes read, -1 for failure
+ * Function: Reads at offset without moving file_pos
+ */
+int32_t file_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset) {
+  if(nbytes < 0) return -1;
+  return read_data(fd_table[fd].inode_num, offset, buf, nbytes);
+}
+
+/* int32_t file_pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+ * Inputs: fd - file descriptor of file to write to
+ *			buf - data to write
+ *			nbytes - number of bytes to write
+ *			offset - byte offset in the file to write at
+ * Return Value: number of bytes written, -1 for failure
+ * Function: Overwrites bytes in place, growing the file if needed, without
+ *				moving file_pos
+ */
+int32_t file_pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset) {
+  if(nbytes < 0) return -1;
+  return write_data(fd_table[fd].inode_num, offset, buf, nbytes);
+}
+
+/* int32_t file_fstat(int32_t fd, stat_t* buf);
+ * Inputs: fd - file descriptor of an open regular file
+ *			buf - filled with the file's information
+ * Return Value: 0 for success, -1 for failure
+ * Function: Reads the length straight from the inode
+ */
+int32_t file_fstat(int32_t fd, stat_t* buf) {
+  dentry_t d;
+  d.inode_num = fd_table[fd].inode_num;
+  d.file_type = FILE_TYPE_REGULAR;
+  return stat_dentry(&d, buf);
+}
+
+/* static int32_t alloc_data_block(void);
+ * Inputs: none
+ * Return Value: index of a free data block, -1 if the device is full
+ * Function: Claims the lowest free data block, growing root.num_data_blocks
+ *				if it lies past the end of the image
+ */
+static int32_t alloc_data_block(void) {
+  int32_t j;
+  if((j = bitmap_alloc(&data_bitmap)) == -1) return -1;
+
+  if(j >= root.num_data_blocks) {
+	root.num_data_blocks = j + 1;
+	write_boot_block();
+  }
+  return j;
+}
+
+/* int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+ * Inputs: inode - inode number of the file to write to
+ *			offset - byte offset from the beginning of the file to start writing at
+ *			buf - data to write
+ *			length - number of bytes to write
+ * Return Value: number of bytes written (less than length if the device fills up),
+ *			-1 for failure
+ * Function: Counterpart of read_data. Only the blocks holding bytes [offset, offset + length)
+ *				are touched; blocks between the old end of file and offset are zero filled
+ */
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length) {
+  buffer_t *inode_buf, *data_buf;
+  inode_t* inode_block;
+  uint32_t num_blocks, last_block, block_num, block_offset, chunk, old_length;
+  uint32_t written = 0;
+  int32_t j;
+
+  if(offset > MAX_FILE_SIZE || length > MAX_FILE_SIZE - offset) return -1;
+  if(!length) return 0;
+
+  if(!(inode_buf = bread(INODE_BLOCK(inode)))) return -1;
+  inode_block = (inode_t*) inode_buf->data;
+  old_length = inode_block->length;
+  num_blocks = (old_length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  /* Clear the stale tail of the old last block if we leave a gap after it */
+  if(offset > old_length && old_length % BLOCK_SIZE) {
+	if((data_buf = bread(DATA_BLOCK(inode_block->data_blocks[num_blocks - 1])))) {
+	  memset(data_buf->data + old_length % BLOCK_SIZE, 0, BLOCK_SIZE - old_length % BLOCK_SIZE);
+	  bwrite(data_buf);
+	  brelse(data_buf);
 	}
-	curr_inode->data_blocks[i] = j;
-	data_addr = &data_base[curr_inode->data_blocks[i]];
-	if(remaining_data <= FOUR_KB) {
-	  memcpy(data_addr, buf, remaining_data);
+  }
+
+  /* Allocate zeroed blocks up to the one holding the last byte */
+  last_block = (offset + length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  while(num_blocks < last_block) {
+	if((j = alloc_data_block()) == -1) break;
+	if(!(data_buf = bread(DATA_BLOCK(j)))) {
+	  bitmap_set(&data_bitmap, j, 0);
 	  break;
 	}
+	memset(data_buf->data, 0, BLOCK_SIZE);
+	bwrite(data_buf);
+	brelse(data_buf);
+	inode_block->data_blocks[num_blocks++] = j;
+  }
 
-	buf += FOUR_KB;
-	remaining_data -= FOUR_KB;
+  /* Copy into each block in turn */
+  block_num = offset / BLOCK_SIZE;
+  block_offset = offset % BLOCK_SIZE;
+  while(written < length && block_num < num_blocks) {
+	if(!(data_buf = bread(DATA_BLOCK(inode_block->data_blocks[block_num])))) break;
+	chunk = BLOCK_SIZE - block_offset;
+	if(chunk > length - written) chunk = length - written;
+	memcpy(data_buf->data + block_offset, buf + written, chunk);
+	bwrite(data_buf);
+	brelse(data_buf);
+
+	written += chunk;
+	block_offset = 0;
+	block_num++;
   }
 
-  return 0;
+  /* The file ends at the last byte written, or at the last allocated block
+   * if the device filled up before we got to offset */
+  if(offset + written > old_length) inode_block->length = offset + written;
+  if(inode_block->length > num_blocks * BLOCK_SIZE) inode_block->length = num_blocks * BLOCK_SIZE;
+  bwrite(inode_buf);
+  brelse(inode_buf);
+
+  return written;
 }
 
 /* int32_t file_read(int32_t fd, void* buf, int32_t nbytes);
@@ -87,7 +285,9 @@ int32_t file_write(int32_t fd, const void* buf, int32_t nbytes) {
  * Function: Reads data from the file and moves the file_pos forward by the bytes read
  */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes) {
-	uint32_t bytes_read = read_data(fd_table[fd].inode_num, fd_table[fd].file_pos, buf, nbytes);
+	int32_t bytes_read = read_data(fd_table[fd].inode_num, fd_table[fd].file_pos, buf, nbytes);
+	tracepoint(TRACE_FILE_READ, fd_table[fd].inode_num, fd_table[fd].file_pos, nbytes, bytes_read);
+	if(bytes_read < 0) return -1;
     fd_table[fd].file_pos += bytes_read;	/* Increment file position */
 	return bytes_read;
 }
@@ -98,57 +298,104 @@ int32_t file_read(int32_t fd, void* buf, int32_t nbytes) {
  *			offset - byte offset from the beginning of the file to begin reading from
  *			buf - buffer for string to be read from file
  *			nbytes - number of bytes to read 
- * Return Value: number of bytes read
- * Function: Loops through the data blocks of the file until 'length' bytes are read 
- *				or the end of file is reached
+ * Return Value: number of bytes read, -1 if the inode can't be read
+ * Function: Reads into a single buffer, see read_datav
  */
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
-    int32_t block_num;
-    uint32_t num_bytes_read = 0;
-    inode_t inode_block = inode_base[inode];
-    void* current_block;
-    const int32_t LAST_BLOCK_MAX_OFFSET = inode_block.length % BLOCK_SIZE;
-    const int32_t NUM_BLOCKS = inode_block.length / BLOCK_SIZE + 
-		(LAST_BLOCK_MAX_OFFSET == 0 ? 0 : 1); /* Don't forget last non-whole block */
-	
-    block_num = offset / BLOCK_SIZE;
-    offset %= BLOCK_SIZE;
-
-	/* Loop through data blocks until length bytes are read or end of file reached */
-    while(1) {
-        current_block = &(data_base[inode_block.data_blocks[block_num]]);
-        
-        /* We have reached the end of the file if we are past the last block 
-        	or are past the last byte on the last block */
-        if((block_num >= NUM_BLOCKS) || 
-        		((block_num == NUM_BLOCKS - 1) && (offset >= LAST_BLOCK_MAX_OFFSET))) {
-        	break;
-        }
-        
-        /* If we are in the last block but don't have enough bytes left to fill the buffer */
-        else if((block_num == NUM_BLOCKS - 1) && (offset + length >= LAST_BLOCK_MAX_OFFSET)) {
-        	/* Note that offset < LAST_BLOCK_MAX_OFFSET because of the previous if statement */
-        	memcpy(buf, current_block+offset, LAST_BLOCK_MAX_OFFSET-offset);
-        	num_bytes_read += LAST_BLOCK_MAX_OFFSET - offset;
-        	break;
+    iovec_t iov;
+    iov.base = buf;
+    iov.len = length;
+    return read_datav(inode, offset, &iov, 1);
+}
+
+/* static void iov_scatter(const iovec_t** iov, uint32_t* iov_off, const uint8_t* src, uint32_t n);
+ * Inputs: iov - current iovec, advanced past the ones that fill up
+ *			iov_off - bytes of the current iovec already filled
+ *			src - data to copy
+ *			n - number of bytes to copy, no more than the iovecs have room for
+ * Return Value: none
+ * Function: Copies src across the iovecs, one memcpy per iovec touched
+ */
+static void iov_scatter(const iovec_t** iov, uint32_t* iov_off, const uint8_t* src, uint32_t n) {
+    uint32_t chunk;
+
+    while(n) {
+        chunk = (*iov)->len - *iov_off;
+        if(chunk > n) chunk = n;
+        memcpy((uint8_t*) (*iov)->base + *iov_off, src, chunk);
+        src += chunk;
+        n -= chunk;
+        *iov_off += chunk;
+        if(*iov_off == (*iov)->len) {
+            (*iov)++;
+            *iov_off = 0;
         }
-        
-        /* Check if the current block contains enough bytes to fill the buffer */
-        if(length < BLOCK_SIZE-offset) {
-            memcpy(buf, current_block+offset, length);
-            num_bytes_read += length;
-            break;
+    }
+}
+
+/* int32_t read_datav(uint32_t inode, uint32_t offset, const iovec_t* iov, int32_t iovcnt);
+ * Inputs: inode - inode number of the file to have data read from
+ *			offset - byte offset from the beginning of the file to begin reading from
+ *			iov - buffers to fill, in order
+ *			iovcnt - number of buffers
+ * Return Value: number of bytes read, -1 if the inode can't be read
+ * Function: Reads until the buffers are full or the end of file is reached.
+ *				The inode is used in place in the cache, and data blocks that
+ *				are consecutive on the device are handled a run at a time:
+ *				copied in one piece straight from memory-backed devices, or
+ *				read into the cache with a single request otherwise
+ */
+int32_t read_datav(uint32_t inode, uint32_t offset, const iovec_t* iov, int32_t iovcnt) {
+    buffer_t* bufs[BCACHE_MAX_RUN];
+    buffer_t* inode_buf;
+    inode_t* inode_block;
+    uint32_t length = 0, num_bytes_read = 0, iov_off = 0;
+    uint32_t num_blocks, block_num, block_offset, run, chunk, left, n, i;
+    const uint8_t* src;
+    int32_t got;
+
+    for(i = 0; i < iovcnt; ++i) length += iov[i].len;
+
+    if(!(inode_buf = bread(INODE_BLOCK(inode)))) return -1;
+    inode_block = (inode_t*) inode_buf->data;
+
+    /* Stop at the end of the file */
+    if(offset >= inode_block->length) length = 0;
+    else if(length > inode_block->length - offset) length = inode_block->length - offset;
+    num_blocks = (inode_block->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    block_num = offset / BLOCK_SIZE;
+    block_offset = offset % BLOCK_SIZE;
+    while(num_bytes_read < length && block_num < num_blocks) {
+        /* Extend the run while the next block follows this one on the device */
+        for(run = 1; run < BCACHE_MAX_RUN && block_num + run < num_blocks &&
+                run * BLOCK_SIZE - block_offset < length - num_bytes_read &&
+                inode_block->data_blocks[block_num + run] == inode_block->data_blocks[block_num] + run; ++run) continue;
+        chunk = run * BLOCK_SIZE - block_offset;
+        if(chunk > length - num_bytes_read) chunk = length - num_bytes_read;
+
+        if((src = bmap_run(DATA_BLOCK(inode_block->data_blocks[block_num]), run))) {
+            iov_scatter(&iov, &iov_off, src + block_offset, chunk);
+        } else {
+            if((got = bread_run(DATA_BLOCK(inode_block->data_blocks[block_num]), run, bufs)) < 0) break;
+            if(got < run) {
+                /* Short of buffers, take what we got */
+                run = got;
+                if(chunk > run * BLOCK_SIZE - block_offset) chunk = run * BLOCK_SIZE - block_offset;
+            }
+            for(i = 0, left = chunk; i < run; ++i, left -= n) {
+                n = BLOCK_SIZE - (i ? 0 : block_offset);
+                if(n > left) n = left;
+                iov_scatter(&iov, &iov_off, bufs[i]->data + (i ? 0 : block_offset), n);
+                brelse(bufs[i]);
+            }
         }
 
-		/* If we cannot fill the buffer with just the current block, 
-			read the rest of this block into the buffer and move on to the next block*/
-        memcpy(buf, current_block+offset, BLOCK_SIZE-offset);
-        length -= BLOCK_SIZE-offset;	        /* reduce bytes remaining to be read */
-        buf += BLOCK_SIZE-offset;				/* move the location in the buffer to copy to */
-        num_bytes_read += BLOCK_SIZE-offset;    /* track the number of bytes read */
-        offset = 0;						        /* start at the beginning of the next block */
-        block_num += 1;					        /* move to the next block */
+        num_bytes_read += chunk;
+        block_num += run;
+        block_offset = 0;
     }
 
+    brelse(inode_buf);
     return num_bytes_read;
 }
@@ -3,11 +3,14 @@
  */
 
 #include "filesystem_structs.h"
+#include "block_dev.h"
+#include "fdtable.h"
 
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 
-#define MAX_OPEN_FILES 8
+/* Files open at once across every process, see fdtable.h */
+#define NUM_OPEN_FILES 512
 
 /* File descriptors for STDIN, STDOUT */
 #define STDIN 0
@@ -17,24 +20,51 @@
 #define FILE_TYPE_RTC 0
 #define FILE_TYPE_DIR 1
 #define FILE_TYPE_REGULAR 2
+#define FILE_TYPE_TMPFS 3		/* never stored on the device, see tmpfs.h */
+#define FILE_TYPE_DEV 4		/* never stored on the device, see devfs.h */
 /* Note: these are used in check_valid_file_type */
 
-inode_t* inode_base;		/* Physical addresss of first inode */
-data_block_t* data_base; 	/* Physical address of first data block */ // hahahahahahaha (name)
-fd_t* fd_table;				/* File descriptor table for tracking open files, is of size MAX_OPEN_FILES */
-fd_t kernel_fd_table[MAX_OPEN_FILES]; /* Block of memory allocated for file descriptors in the kernel 
+/* lseek whence values */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+/* fcntl commands */
+#define F_GETFL 3
+#define F_SETFL 4
+
+/* Device block holding a given inode / data block (the boot block is block 0) */
+#define INODE_BLOCK(inode) (root.inode_start + (inode))
+#define DATA_BLOCK(block) (root.data_start + (block))
+
+fd_t* fd_table;				/* Open files of every process, of size NUM_OPEN_FILES. File operations are
+								passed an index into it, syscalls find it from a descriptor with fd_file */
+fd_t kernel_fd_table[NUM_OPEN_FILES]; /* Block of memory allocated for open files in the kernel
 											NOTE: on filesystem init, MUST set fd_table to this */
 
 /* Boot block, which also acts as our root directory */
 boot_block_t root;
 
 /* Bitmaps for filesystem contents */
-unsigned long long inode_bitmap;
-uint8_t data_block_bitmap[NUM_DATA_BLOCK_ADDR];
+fs_bitmap_t inode_bitmap;
+fs_bitmap_t data_bitmap;
+
+/* Initializes the filesystem stored on the block device dev */
+int32_t filesystem_init(block_dev_t* dev);
+
+/* Discards all changes to the filesystem, going back to the image it booted with */
+int32_t filesystem_reset(void);
+
+/* Marks the inodes and data blocks used by files in the bitmaps */
+void create_bitmaps(void);
 
-/* Initializes the filesystem using base_addr as the base 
- * 	physical address of the filesystem image in memory */
-void filesystem_init(unsigned int base_addr);
+/* Bitmap operations, see bitmap.c */
+int32_t bitmap_test(fs_bitmap_t* map, uint32_t index);
+void bitmap_set(fs_bitmap_t* map, uint32_t index, uint8_t used);
+int32_t bitmap_alloc(fs_bitmap_t* map);
+
+/* Writes the in-memory copy of the boot block back through the buffer cache */
+int32_t write_boot_block(void);
 
 
 /* Obtains file directory entry for a file in current directory 
@@ -48,6 +78,12 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
 /* Reads a number of bytes from a file given an inode and an offset */
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 
+/* Reads from a file given an inode and an offset into several buffers */
+int32_t read_datav(uint32_t inode, uint32_t offset, const iovec_t* iov, int32_t iovcnt);
+
+/* Writes a number of bytes into a file given an inode and an offset */
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+
 /*** File Operations Tables ***/
 
 /* File operations for regular files */
@@ -55,6 +91,12 @@ int32_t file_open(const uint8_t* filename);							/* Opens a file */
 int32_t file_close(int32_t fd);										/* Closes a file */
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes);	/* Write a string to a file (TODO does nothing) */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes);			/* Reads a string from a file */
+int32_t file_lseek(int32_t fd, int32_t offset, int32_t whence);	/* Moves the file position */
+int32_t file_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);			/* Reads at an offset */
+int32_t file_pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);	/* Writes at an offset */
+int32_t file_fstat(int32_t fd, stat_t* buf);						/* Gets the file's size */
+int32_t file_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);	/* Reads into several buffers */
+int32_t file_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);	/* Replaces the contents with several buffers */
 
 /* File operations table for regular files */
 extern file_ops_t file_ops_regular;
@@ -64,10 +106,22 @@ int32_t directory_open(const uint8_t* filename);						/* Opens a directory */
 int32_t directory_close(int32_t fd);									/* Closes a directory */
 int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes);	/* Writes to a directory (TODO does nothing) */
 int32_t directory_read(int32_t fd, void* buf, int32_t nbytes);			/* Reads a file name from a directory */
+int32_t directory_lseek(int32_t fd, int32_t offset, int32_t whence);	/* Moves to a directory entry */
+int32_t directory_getdents(int32_t fd, dirent_t* buf, int32_t nbytes);	/* Reads as many entries as fit */
+int32_t directory_fstat(int32_t fd, stat_t* buf);						/* Gets directory information */
+
+/* Fills in stat information for a directory entry */
+int32_t stat_dentry(const dentry_t* dentry, stat_t* buf);
 
 int32_t new_dentry(const uint8_t* fname); // write to directory
 int32_t remove_dentry(const uint8_t* fname); // write to directory
 
+/* Loads the root directory and indexes its names */
+int32_t directory_init(void);
+
+/* Number of entries the root directory can hold */
+uint32_t max_dir_entries(void);
+
 /* File operations table for directories */
 extern file_ops_t file_ops_dir;
 
@@ -1,30 +1,210 @@
-/* filesystem_driver.c - Initializes the file system 
+/* filesystem_driver.c - Initializes the file system
  * vim:ts=4 noexpandtab
  */
 
 #include "filesystem.h"
 #include "filesystem_structs.h"
+#include "overlay.h"
+#include "devfs.h"
+#include "../klog.h"
+
+/* Longest command written to "dev/overlay" */
+#define OVERLAY_CMD_LEN 16
+
+/* Longest line read from "dev/overlay" */
+#define OVERLAY_LINE_LEN 128
+
+/* Bitmaps of images in the original format, which has none on disk */
+static uint8_t legacy_inode_bits[BLOCK_SIZE];
+static uint8_t legacy_data_bits[BLOCK_SIZE];
+
+static int32_t filesystem_mount(block_dev_t* dev);
+static int32_t overlay_ctl_open(const uint8_t* filename);
+static int32_t overlay_ctl_close(int32_t fd);
+static int32_t overlay_ctl_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t overlay_ctl_write(int32_t fd, const void* buf, int32_t nbytes);
+
+static file_ops_t file_ops_overlay_ctl = {overlay_ctl_read, overlay_ctl_write, overlay_ctl_open, overlay_ctl_close};
+
+/* int32_t filesystem_init(block_dev_t* dev);
+ * Inputs: dev - block device holding the filesystem image
+ * Return Value: 0 for success, -1 for failure
+ * Function: Attaches the buffer cache to dev and mounts the filesystem on it */
+int32_t filesystem_init(block_dev_t* dev) {
+    /* Set the current file descriptor table to one statically allocated in the kernel
+    	for file accesses while in the kernel */
+    fd_table = (fd_t*) kernel_fd_table;
+
+    /* All file and directory operations go through the cache */
+    bcache_init(dev);
+
+    /* Let programs throw away their changes when there is an overlay */
+    if(overlay_base(dev) != dev) devfs_register((const uint8_t*)"overlay", &file_ops_overlay_ctl);
+
+    return filesystem_mount(dev);
+}
+
+/* int32_t filesystem_reset(void);
+ * Inputs: none
+ * Return Value: 0 for success, -1 if the filesystem isn't on the overlay
+ * Function: Throws away every change made since boot by discarding the
+ *				overlay's upper layer and the cached blocks, then mounts the
+ *				base image again. Files that are open keep their descriptors
+ *				but see the base image's contents from now on
+ */
+int32_t filesystem_reset(void) {
+    uint32_t flags;
+    int32_t ret;
+
+    cli_and_save(flags);
+    if(overlay_discard(fs_dev)) {
+        restore_flags(flags);
+        return -1;
+    }
+    bcache_init(fs_dev);
+    ret = filesystem_mount(fs_dev);
+    restore_flags(flags);
+    return ret;
+}
+
+/* static int32_t overlay_ctl_open(const uint8_t* filename);
+ * Inputs: filename - the fd, as for the rtc
+ * Return Value: 0
+ * Function: Starts reading at the beginning of the usage line
+ */
+static int32_t overlay_ctl_open(const uint8_t* filename) {
+    fd_table[(int32_t) filename].file_pos = 0;
+    return 0;
+}
+
+/* static int32_t overlay_ctl_close(int32_t fd);
+ * Inputs: fd - file descriptor
+ * Return Value: 0
+ * Function: Does nothing
+ */
+static int32_t overlay_ctl_close(int32_t fd) {
+    return 0;
+}
+
+/* static int32_t overlay_ctl_read(int32_t fd, void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor
+ *			buf - filled with the overlay usage
+ *			nbytes - size of buf
+ * Return Value: bytes read, 0 at the end of the line, -1 for a bad buffer
+ * Function: Reads a line of overlay statistics from the file position on
+ */
+static int32_t overlay_ctl_read(int32_t fd, void* buf, int32_t nbytes) {
+    int8_t line[OVERLAY_LINE_LEN];
+    overlay_stats_t s;
+    uint32_t len;
+
+    if(!buf || nbytes < 0) return -1;
+    overlay_get_stats(&s);
+    len = snprintf(line, sizeof(line), "%u/%u blocks modified, %u copy-ups, %u discards\n",
+        s.upper_blocks, OVERLAY_MAX_BLOCKS, s.copy_ups, s.discards);
+    if(len >= sizeof(line)) len = sizeof(line) - 1;
+
+    if(fd_table[fd].file_pos >= len) return 0;
+    len -= fd_table[fd].file_pos;
+    if(len > (uint32_t) nbytes) len = nbytes;
+    memcpy(buf, line + fd_table[fd].file_pos, len);
+    fd_table[fd].file_pos += len;
+    return len;
+}
+
+/* static int32_t overlay_ctl_write(int32_t fd, const void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor
+ *			buf - command
+ *			nbytes - its length
+ * Return Value: nbytes, -1 for an unknown command or a failed reset
+ * Function: "reset" discards every change made since boot, as filesystem_reset
+ */
+static int32_t overlay_ctl_write(int32_t fd, const void* buf, int32_t nbytes) {
+    int8_t cmd[OVERLAY_CMD_LEN];
+
+    if(!buf || nbytes <= 0 || nbytes >= OVERLAY_CMD_LEN) return -1;
+    memcpy(cmd, buf, nbytes);
+    cmd[nbytes] = '\0';
+
+    if(strncmp(cmd, "reset", 5)) return -1;
+    return filesystem_reset() ? -1 : nbytes;
+}
+
+/* static int32_t filesystem_mount(block_dev_t* dev);
+ * Inputs: dev - block device attached to the buffer cache
+ * Return Value: 0 for success, -1 for failure
+ * Function: Loads the boot block, checks the layout and sets up the bitmaps
+ *				and the directory */
+static int32_t filesystem_mount(block_dev_t* dev) {
+    buffer_t* b;
 
-/* void filesystem_init(unsigned int base_addr);
- * Inputs: base_addr - base address of physical memory address of filesystem image
- * Return Value: none
- * Function: Initializes base addresses used in file and directory operations */
-void filesystem_init(unsigned int base_addr) {
     /* Load the boot block */
-    root = *((boot_block_t*)base_addr);
+    if(!(b = bread(0))) {
+        klog(KLOG_ERR, "filesystem: can't read boot block from %s\n", dev->name);
+        return -1;
+    }
+    memcpy(&root, b->data, BLOCK_SIZE);
+    brelse(b);
 
-    /* Initialize where the inodes are found */
-    inode_base = (inode_t*)(base_addr + BLOCK_SIZE);
+    if(root.magic == FS_MAGIC) {
+        /* Bitmaps live on the device, the directory in its own inode */
+        if(root.inode_bitmap_start < 1 || root.data_bitmap_start <= root.inode_bitmap_start ||
+                root.inode_start <= root.data_bitmap_start ||
+                root.data_start != root.inode_start + root.num_inodes ||
+                root.dir_inode >= root.num_inodes ||
+                root.num_inodes > (root.data_bitmap_start - root.inode_bitmap_start) * BITS_PER_BLOCK) {
+            klog(KLOG_ERR, "filesystem: bad layout in boot block\n");
+            return -1;
+        }
+        inode_bitmap.mem = NULL;
+        inode_bitmap.start_block = root.inode_bitmap_start;
+        data_bitmap.mem = NULL;
+        data_bitmap.start_block = root.data_bitmap_start;
+        data_bitmap.count = (root.inode_start - root.data_bitmap_start) * BITS_PER_BLOCK;
+    } else {
+        /* Original format: inodes follow the boot block, bitmaps are built below */
+        root.dir_inode = 0;
+        root.inode_start = 1;
+        root.data_start = 1 + root.num_inodes;
+        inode_bitmap.mem = legacy_inode_bits;
+        data_bitmap.mem = legacy_data_bits;
+        data_bitmap.count = BITS_PER_BLOCK;
+        if(root.num_inodes > BITS_PER_BLOCK) {
+            klog(KLOG_ERR, "filesystem: too many inodes\n");
+            return -1;
+        }
+    }
+
+    if(root.data_start + root.num_data_blocks > dev->num_blocks) {
+        klog(KLOG_ERR, "filesystem: image is larger than %s\n", dev->name);
+        return -1;
+    }
+
+    /* Files may grow into the rest of the device */
+    inode_bitmap.count = root.num_inodes;
+    inode_bitmap.hint = 0;
+    if(data_bitmap.count > dev->num_blocks - root.data_start)
+        data_bitmap.count = dev->num_blocks - root.data_start;
+    data_bitmap.hint = 0;
 
 	/* Create bitmaps to allow file creation */
 	create_bitmaps();
 
-	/* Initialize the base address for where to find data blocks */
-    data_base = (data_block_t*)(inode_base + root.num_inodes);
-    
-    /* Set the current file descriptor table to one statically allocated in the kernel 
-    	for file accesses while in the kernel */
-    fd_table = (fd_t*) kernel_fd_table;
+    return directory_init();
+}
+
+/* int32_t write_boot_block(void);
+ * Inputs: none
+ * Return Value: 0 for success, -1 for failure
+ * Function: Copies root into the cached boot block so it is written back to the device
+ */
+int32_t write_boot_block(void) {
+    buffer_t* b = bread(0);
+    if(!b) return -1;
+    memcpy(b->data, &root, BLOCK_SIZE);
+    bwrite(b);
+    brelse(b);
+    return 0;
 }
 
 /*
@@ -32,20 +212,34 @@ void filesystem_init(unsigned int base_addr) {
  * Inputs: None
  * Outputs: None
  * Return value: None
- * Side Effects: Initializes filesystem bitmaps
+ * Side Effects: Initializes in-memory bitmaps from the files in the directory,
+ *				images with on-disk bitmaps need nothing done
  */
 void create_bitmaps() {
-  inode_t curr_inode;
+  inode_t* curr_inode;
+  buffer_t* b;
   uint32_t i, j;
-  for(i = 0; i < root.num_dir_entries; ++i) {
+
+  if(!inode_bitmap.mem) return;
+
+  memset(legacy_inode_bits, 0, sizeof(legacy_inode_bits));
+  memset(legacy_data_bits, 0, sizeof(legacy_data_bits));
+
+  // Inode 0 belongs to "." and the RTC
+  bitmap_set(&inode_bitmap, 0, 1);
+  for(i = 0; i < root.num_dir_entries && i < MAX_FILES; ++i) {
+	if(root.dentries[i].file_type != FILE_TYPE_REGULAR) continue;
 	// Mark inodes as 'in use'
-	inode_bitmap |= (0x1 << root.dentries[i].inode_num);
-	printf("inode_bitmap %ll\n", inode_bitmap);
+	bitmap_set(&inode_bitmap, root.dentries[i].inode_num, 1);
 	// Get inode
-	curr_inode = inode_base[root.dentries[i].inode_num];
-	for(j = 0; j < (curr_inode.length/FOUR_KB); ++j) {
+	if(!(b = bread(INODE_BLOCK(root.dentries[i].inode_num)))) continue;
+	curr_inode = (inode_t*) b->data;
+	for(j = 0; j < (curr_inode->length + BLOCK_SIZE - 1) / BLOCK_SIZE; ++j) {
 	  // Mark data blocks as 'in use'
-	  data_block_bitmap[curr_inode.data_blocks[j]] = 0xFF;
+	  bitmap_set(&data_bitmap, curr_inode->data_blocks[j], 1);
 	}
+	brelse(b);
   }
+  inode_bitmap.hint = 0;
+  data_bitmap.hint = 0;
 }
@@ -8,6 +8,7 @@
 #define FILESYSTEM_STRUCTS_H
 
 #define NUM_DATA_BLOCK_ADDR 1023
+#define MAX_FILE_SIZE (NUM_DATA_BLOCK_ADDR * BLOCK_SIZE)
 #define DENTRY_SIZE 64
 #define MAX_FILENAME_LENGTH 32
 
@@ -17,6 +18,15 @@
 /* Maximum files limited by boot block size */
 #define MAX_FILES (BLOCK_SIZE / DENTRY_SIZE - 1)
 
+/* Maximum files in a directory stored in an inode (FS_MAGIC images) */
+#define MAX_DIR_ENTRIES (MAX_FILE_SIZE / DENTRY_SIZE)
+
+/* Value of boot_block_t.magic on images with on-disk bitmaps and a directory inode */
+#define FS_MAGIC 0x32534633 /* "3FS2" */
+
+/* Number of bits held by one bitmap block */
+#define BITS_PER_BLOCK (BLOCK_SIZE * 8)
+
 /*** Block formats  ***/
 
 /* directory structure */
@@ -46,10 +56,75 @@ typedef struct __attribute__((packed, aligned(FOUR_KB))) boot_block {
   uint32_t num_dir_entries;			/* number of directory entries in root */
   uint32_t num_inodes;				/* number of inodes used by the system */
   uint32_t num_data_blocks;			/* number of data blocks used by the filesystem */
-  uint8_t reserved[52]; 			/* not used, size is 64 - 3 * sizeof(uint32_t) */
+
+  /* Images written by fstools/createfs set magic to FS_MAGIC and fill in the
+   * fields below; the original format leaves them 0, keeps the directory in
+   * dentries[] and builds its bitmaps in memory at mount */
+  uint32_t magic;
+  uint32_t dir_inode;				/* inode holding the root directory's dentries */
+  uint32_t inode_bitmap_start;		/* first block of the inode bitmap */
+  uint32_t data_bitmap_start;		/* first block of the data block bitmap */
+  uint32_t inode_start;				/* block holding inode 0 */
+  uint32_t data_start;				/* block holding data block 0 */
+  uint8_t reserved[28]; 			/* not used, size is 64 - 9 * sizeof(uint32_t) */
   dentry_t dentries[MAX_FILES]; 	/* maximum number of dentries that will fit into the block */
 } boot_block_t;
 
+/* bitmap of free inodes or data blocks, bit i set means item i is in use */
+typedef struct fs_bitmap {
+  uint32_t count;			/* number of items tracked */
+  uint32_t start_block;		/* first device block of an on-disk bitmap */
+  uint8_t* mem;				/* bitmap held in memory instead, NULL if on disk */
+  uint32_t hint;			/* search for free items starts here */
+} fs_bitmap_t;
+
+/* directory record filled in by getdents */
+typedef struct dirent {
+  uint32_t inode_num;
+  uint32_t length;						/* file size in bytes, 0 unless a regular file */
+  uint32_t file_type;
+  uint8_t name[MAX_FILENAME_LENGTH + 1];	/* always NUL terminated */
+  uint8_t reserved[3];					/* pads the record to 48 B */
+} dirent_t;
+
+/* file information filled in by stat and fstat */
+typedef struct stat {
+  uint32_t inode_num;
+  uint32_t file_type;
+  uint32_t length;		/* file size in bytes, 0 unless a regular file */
+  uint32_t blocks;		/* number of data blocks the file uses */
+} stat_t;
+
+/* one buffer of a readv or writev */
+typedef struct iovec {
+  void* base;
+  uint32_t len;
+} iovec_t;
+
+/* Most iovecs readv and writev accept */
+#define IOV_MAX 16
+
+/* one file, or network endpoint, a poll call waits on */
+typedef struct pollfd {
+  int32_t fd;			/* file descriptor, or a port/connection with POLL_UDP/POLL_TCP */
+  int16_t events;		/* POLLIN and/or POLLOUT, plus at most one of POLL_UDP, POLL_TCP */
+  int16_t revents;		/* filled in: the requested events that are ready, POLLERR, POLLHUP, POLLNVAL */
+} pollfd_t;
+
+/* poll events */
+#define POLLIN    0x0001	/* read wouldn't block */
+#define POLLOUT   0x0004	/* write wouldn't block */
+#define POLLERR   0x0008	/* always reported: the endpoint failed */
+#define POLLHUP   0x0010	/* always reported: the other end closed */
+#define POLLNVAL  0x0020	/* always reported: fd isn't open */
+#define POLL_UDP  0x1000	/* fd is a UDP port, POLLIN when a datagram is queued for it */
+#define POLL_TCP  0x2000	/* fd is a connection from tcp_connect, POLLIN when data arrived,
+								POLLOUT when the send window is open */
+
+/* Most pollfds poll accepts, and its timeout that never expires */
+#define POLL_MAX_FDS 32
+#define POLL_FOREVER -1
+
 /* Checks that a given file type is a valid file type */
 uint8_t check_valid_file_type(uint32_t file_type);
 
@@ -61,6 +136,14 @@ typedef int32_t(*read_t)(int32_t, void*, int32_t);			/* int32_t read (int32_t fd
 typedef int32_t(*write_t)(int32_t, const void*, int32_t);	/* int32_t write (int32_t fd, const void* buf, int32_t nbytes) */
 typedef int32_t(*open_t)(const uint8_t*);					/* int32_t open (const uint8_t* filename) */
 typedef int32_t(*close_t)(int32_t);							/* int32_t close (int32_t fd) */
+typedef int32_t(*lseek_t)(int32_t, int32_t, int32_t);		/* int32_t lseek (int32_t fd, int32_t offset, int32_t whence) */
+typedef int32_t(*pread_t)(int32_t, void*, int32_t, uint32_t);		/* int32_t pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset) */
+typedef int32_t(*pwrite_t)(int32_t, const void*, int32_t, uint32_t);	/* int32_t pwrite (int32_t fd, const void* buf, int32_t nbytes, uint32_t offset) */
+typedef int32_t(*getdents_t)(int32_t, dirent_t*, int32_t);	/* int32_t getdents (int32_t fd, dirent_t* buf, int32_t nbytes) */
+typedef int32_t(*fstat_t)(int32_t, stat_t*);				/* int32_t fstat (int32_t fd, stat_t* buf) */
+typedef int32_t(*readv_t)(int32_t, const iovec_t*, int32_t);	/* int32_t readv (int32_t fd, const iovec_t* iov, int32_t iovcnt) */
+typedef int32_t(*writev_t)(int32_t, const iovec_t*, int32_t);	/* int32_t writev (int32_t fd, const iovec_t* iov, int32_t iovcnt) */
+typedef int32_t(*poll_t)(int32_t, int32_t);				/* int32_t poll (int32_t fd, int32_t events), returns the ready events */
 
 /* filesystem operations table */
 typedef struct file_ops_t {
@@ -68,6 +151,14 @@ typedef struct file_ops_t {
   write_t write;
   open_t open;
   close_t close;
+  lseek_t lseek;	/* NULL if the file can't seek */
+  pread_t pread;	/* NULL if the file has no positional I/O */
+  pwrite_t pwrite;
+  getdents_t getdents;	/* NULL unless a directory */
+  fstat_t fstat;		/* NULL if the file has no inode */
+  readv_t readv;		/* NULL to read each iovec with read */
+  writev_t writev;		/* NULL to write each iovec with write */
+  poll_t poll;			/* NULL if reads and writes never wait */
 } file_ops_t;
 
 /* file descriptor structure */
@@ -75,7 +166,13 @@ typedef struct __attribute__((packed, aligned(16))) fd { // fd are 4B * 4 = 16B
   file_ops_t* fops_table;	/* file operations table for this file descriptor */
   uint32_t inode_num;		/* inode number for regular file */
   uint32_t file_pos; 		/* virutal addr within file (0 to length in bytes for regular files) */
-  uint32_t flags;			/* not used for regular files */
+  uint32_t flags;			/* O_NONBLOCK, plus driver state in the low bits (rtc rate, pipe end) */
 } fd_t;
 
+/* fd_t.flags bit: reads that would wait return -EAGAIN instead, see fcntl */
+#define O_NONBLOCK 0x00010000
+
+/* Negated, returned by a non-blocking read with nothing ready */
+#define EAGAIN 11
+
 #endif /* FILESYSTEM_STRUCTS_H */
@@ -0,0 +1,195 @@
+/* lz4.c - Block device backed by a compressed filesystem image in memory,
+ *			decompressing each block as it is read
+ * vim:ts=4 noexpandtab
+ */
+
+#include "lz4.h"
+#include "../klog.h"
+
+/* Shortest match LZ4 encodes */
+#define LZ4_MIN_MATCH 4
+
+static int32_t lz4disk_submit(block_dev_t* dev, block_request_t* req);
+
+static block_dev_t lz4disk = {
+	.name = "lz4disk",
+	.submit = lz4disk_submit,
+	.poll = NULL,
+	.map = NULL, /* blocks only exist decompressed in the buffer cache */
+};
+
+static lz4disk_stats_t stats;
+
+/* int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len);
+ * Inputs: src - one LZ4 block (the block format, without a frame header)
+ *			src_len - size of src in bytes
+ *			dst - buffer for the decompressed data
+ *			dst_len - size of dst in bytes
+ * Return Value: number of bytes decompressed, -1 if src is corrupt or doesn't fit in dst
+ * Function: Replays the literal runs and back-references of each sequence,
+ *				never reading or writing outside src and dst
+ */
+int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len) {
+	uint32_t ip = 0, op = 0, len, offset;
+	uint8_t token, b;
+
+	while(ip < src_len) {
+		token = src[ip++];
+
+		/* Literals, with 255-valued bytes extending long runs */
+		len = token >> 4;
+		if(len == 0xF) {
+			do {
+				if(ip >= src_len) return -1;
+				b = src[ip++];
+				len += b;
+			} while(b == 0xFF);
+		}
+		if(len > src_len - ip || len > dst_len - op) return -1;
+		memcpy(dst + op, src + ip, len);
+		ip += len;
+		op += len;
+
+		/* The last sequence has no match */
+		if(ip == src_len) break;
+
+		if(src_len - ip < 2) return -1;
+		offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		if(!offset || offset > op) return -1;
+
+		len = token & 0xF;
+		if(len == 0xF) {
+			do {
+				if(ip >= src_len) return -1;
+				b = src[ip++];
+				len += b;
+			} while(b == 0xFF);
+		}
+		len += LZ4_MIN_MATCH;
+		if(len > dst_len - op) return -1;
+
+		/* Byte by byte since the match may overlap what it produces */
+		for(; len; --len, ++op) dst[op] = dst[op - offset];
+	}
+	return op;
+}
+
+/* block_dev_t* lz4disk_init(uint32_t base_addr, uint32_t end_addr);
+ * Inputs: base_addr - address of the first byte of the image
+ *			end_addr - address one past the last byte of the image
+ * Return Value: the lz4disk block device, NULL if the memory isn't a compressed image
+ * Function: Checks the header and block index and wraps the image in a block device
+ */
+block_dev_t* lz4disk_init(uint32_t base_addr, uint32_t end_addr) {
+	lz4_image_header_t* hdr = (lz4_image_header_t*) base_addr;
+	uint32_t size = end_addr - base_addr, i;
+
+	if(size < sizeof(*hdr) || hdr->magic != LZ4_IMAGE_MAGIC) return NULL;
+	if(hdr->num_blocks > (size - sizeof(*hdr)) / sizeof(uint32_t) - 1 ||
+			hdr->data_offset < sizeof(*hdr) + (hdr->num_blocks + 1) * sizeof(uint32_t) ||
+			hdr->data_offset > size) {
+		klog(KLOG_ERR, "lz4disk: bad header\n");
+		return NULL;
+	}
+
+	/* Frames must be in order and inside the image */
+	for(i = 0; i < hdr->num_blocks; ++i) {
+		if(hdr->index[i] > hdr->index[i + 1] || hdr->index[i + 1] - hdr->index[i] > BLOCK_SIZE) break;
+	}
+	if(i < hdr->num_blocks || hdr->index[hdr->num_blocks] > size - hdr->data_offset) {
+		klog(KLOG_ERR, "lz4disk: bad block index\n");
+		return NULL;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	stats.image_bytes = size;
+
+	lz4disk.priv = hdr;
+	lz4disk.num_blocks = hdr->num_blocks;
+	return &lz4disk;
+}
+
+/* static int32_t lz4disk_read_block(lz4_image_header_t* hdr, uint32_t block, uint8_t* buf);
+ * Inputs: hdr - the compressed image
+ *			block - block number
+ *			buf - BLOCK_SIZE buffer for the block
+ * Return Value: BLOCK_OK, or BLOCK_ERROR if the frame is corrupt
+ * Function: Expands one frame into buf
+ */
+static int32_t lz4disk_read_block(lz4_image_header_t* hdr, uint32_t block, uint8_t* buf) {
+	const uint8_t* frame = (const uint8_t*) hdr + hdr->data_offset + hdr->index[block];
+	uint32_t frame_len = hdr->index[block + 1] - hdr->index[block];
+	uint64_t start;
+	int32_t len;
+
+	stats.blocks_read++;
+	if(frame_len == 0) {
+		memset(buf, 0, BLOCK_SIZE);
+		return BLOCK_OK;
+	}
+	if(frame_len == BLOCK_SIZE) {
+		memcpy(buf, frame, BLOCK_SIZE);
+		return BLOCK_OK;
+	}
+
+	start = rdtsc();
+	len = lz4_decompress(frame, frame_len, buf, BLOCK_SIZE);
+	stats.decompress_cycles += (uint32_t)(rdtsc() - start);
+	stats.blocks_decompressed++;
+	return len == BLOCK_SIZE ? BLOCK_OK : BLOCK_ERROR;
+}
+
+/* static int32_t lz4disk_submit(block_dev_t* dev, block_request_t* req);
+ * Inputs: dev - the lz4disk
+ *			req - list of requests to perform
+ * Return Value: BLOCK_OK, or BLOCK_ERROR if a request is out of range
+ * Function: Decompresses the blocks asked for, completing the requests
+ *				immediately. The image is read-only, so writes complete with
+ *				BLOCK_ERROR
+ */
+static int32_t lz4disk_submit(block_dev_t* dev, block_request_t* req) {
+	block_request_t *r, *next;
+	uint32_t i;
+
+	for(r = req; r; r = r->next) {
+		if(r->block + r->count > dev->num_blocks) return BLOCK_ERROR;
+	}
+
+	for(r = req; r; r = next) {
+		next = r->next; /* the callback may reuse r */
+		r->status = r->write ? BLOCK_ERROR : BLOCK_OK;
+		for(i = 0; i < r->count && !r->write; ++i) {
+			if(lz4disk_read_block(dev->priv, r->block + i, (uint8_t*) r->buf + i * BLOCK_SIZE) != BLOCK_OK)
+				r->status = BLOCK_ERROR;
+		}
+
+		r->done = 1;
+		if(r->callback) r->callback(r);
+	}
+	return BLOCK_OK;
+}
+
+/* void lz4disk_get_stats(lz4disk_stats_t* out);
+ * Inputs: out - filled with the decompression statistics
+ * Return Value: none
+ * Function: Copies out the decompression statistics
+ */
+void lz4disk_get_stats(lz4disk_stats_t* out) {
+	memcpy(out, &stats, sizeof(stats));
+}
+
+/* void lz4disk_print_stats(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Prints the compression ratio and the average cost of a decompressed block
+ */
+void lz4disk_print_stats(void) {
+	uint32_t full = lz4disk.num_blocks * (BLOCK_SIZE / 1024);
+
+	if(!lz4disk.priv) return;
+	printf("lz4disk: %u kB image holds %u kB (%u%%), %u blocks read, %u decompressed, %u cycles each\n",
+		stats.image_bytes / 1024, full, full ? (stats.image_bytes / 1024) * 100 / full : 0,
+		stats.blocks_read, stats.blocks_decompressed,
+		stats.blocks_decompressed ? stats.decompress_cycles / stats.blocks_decompressed : 0);
+}
@@ -0,0 +1,47 @@
+/* lz4.h - Defines the compressed filesystem image format and the block
+ *			device that decompresses it
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include "block_dev.h"
+
+/* First word of a compressed image ("LZ4I") */
+#define LZ4_IMAGE_MAGIC 0x49345A4C
+
+/* A compressed image is this header, then num_blocks + 1 offsets (relative to
+ *	data_offset) where frame i spans [index[i], index[i + 1]), then the frames.
+ *	A frame of 0 bytes is a block of zeros, a frame of BLOCK_SIZE bytes is the
+ *	block stored as is, and anything else is the block as one LZ4 block */
+typedef struct lz4_image_header {
+	uint32_t magic;
+	uint32_t num_blocks;		/* blocks in the uncompressed image */
+	uint32_t data_offset;		/* byte offset of the first frame from the header */
+	uint32_t reserved;
+	uint32_t index[0];
+} lz4_image_header_t;
+
+/* Decompression statistics */
+typedef struct lz4disk_stats {
+	uint32_t image_bytes;		/* size of the compressed image in memory */
+	uint32_t blocks_read;		/* blocks read from the device */
+	uint32_t blocks_decompressed;	/* of those, blocks that needed LZ4 */
+	uint32_t decompress_cycles;	/* cycles spent decompressing */
+} lz4disk_stats_t;
+
+/* Decompresses one LZ4 block */
+int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len);
+
+/* Creates a block device over a compressed image in memory, NULL if the
+ *	memory doesn't hold one */
+block_dev_t* lz4disk_init(uint32_t base_addr, uint32_t end_addr);
+
+/* Fills in the current decompression statistics */
+void lz4disk_get_stats(lz4disk_stats_t* stats);
+
+/* Prints compression ratio and decompression cost */
+void lz4disk_print_stats(void);
+
+#endif /* LZ4_H */
@@ -0,0 +1,228 @@
+/* overlay.c - Block device that stacks a RAM upper layer over a read-only
+ *				base device, copying blocks up when they are first written
+ * vim:ts=4 noexpandtab
+ */
+
+#include "overlay.h"
+
+/* Marks the end of a hash chain */
+#define NO_SLOT 0xFFFF
+
+static int32_t overlay_submit(block_dev_t* dev, block_request_t* req);
+static void* overlay_map(block_dev_t* dev, uint32_t block);
+
+static block_dev_t overlay = {
+	.name = "overlay",
+	.submit = overlay_submit,
+	.poll = NULL,
+	.map = overlay_map,
+};
+
+/* Upper layer: slot i holds block slot_block[i], slots are handed out in
+ *	order so discarding them is just resetting the count */
+static uint8_t upper_data[OVERLAY_MAX_BLOCKS][BLOCK_SIZE] __attribute__((aligned(BLOCK_SIZE)));
+static uint32_t slot_block[OVERLAY_MAX_BLOCKS];
+static uint16_t slot_next[OVERLAY_MAX_BLOCKS];
+static uint16_t buckets[OVERLAY_HASH_BUCKETS];
+
+static overlay_stats_t stats;
+
+/* static void overlay_clear(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Empties the upper layer
+ */
+static void overlay_clear(void) {
+	uint32_t i;
+
+	for(i = 0; i < OVERLAY_HASH_BUCKETS; ++i) buckets[i] = NO_SLOT;
+	stats.upper_blocks = 0;
+}
+
+/* block_dev_t* overlay_init(block_dev_t* base);
+ * Inputs: base - device holding the image, which is never written
+ * Return Value: the overlay block device
+ * Function: Stacks an empty upper layer on base. The overlay is larger than
+ *				base by the size of the upper layer so files can still grow,
+ *				blocks past the end of base read as zeros until written
+ */
+block_dev_t* overlay_init(block_dev_t* base) {
+	memset(&stats, 0, sizeof(stats));
+	overlay_clear();
+
+	overlay.priv = base;
+	overlay.num_blocks = base->num_blocks + OVERLAY_MAX_BLOCKS;
+	return &overlay;
+}
+
+/* block_dev_t* overlay_base(block_dev_t* dev);
+ * Inputs: dev - a block device
+ * Return Value: the device under dev if dev is the overlay, otherwise dev
+ * Function: Looks through the overlay
+ */
+block_dev_t* overlay_base(block_dev_t* dev) {
+	return dev == &overlay ? overlay.priv : dev;
+}
+
+/* static uint8_t* overlay_lookup(uint32_t block);
+ * Inputs: block - block number
+ * Return Value: the upper copy of block, NULL if it hasn't been written
+ * Function: Walks the block's hash chain
+ */
+static uint8_t* overlay_lookup(uint32_t block) {
+	uint16_t slot;
+
+	for(slot = buckets[block % OVERLAY_HASH_BUCKETS]; slot != NO_SLOT; slot = slot_next[slot]) {
+		if(slot_block[slot] == block) return upper_data[slot];
+	}
+	return NULL;
+}
+
+/* static uint8_t* overlay_copy_up(uint32_t block);
+ * Inputs: block - block number
+ * Return Value: the upper copy of block, NULL if the upper layer is full
+ * Function: Finds or claims the block's slot. Writes are always whole blocks,
+ *				so the old contents never have to be copied from the base
+ */
+static uint8_t* overlay_copy_up(uint32_t block) {
+	uint8_t* data;
+	uint16_t slot;
+
+	if((data = overlay_lookup(block))) return data;
+	if(stats.upper_blocks >= OVERLAY_MAX_BLOCKS) return NULL;
+
+	slot = stats.upper_blocks++;
+	slot_block[slot] = block;
+	slot_next[slot] = buckets[block % OVERLAY_HASH_BUCKETS];
+	buckets[block % OVERLAY_HASH_BUCKETS] = slot;
+	stats.copy_ups++;
+	return upper_data[slot];
+}
+
+/* static int32_t overlay_read(block_dev_t* base, uint32_t block, uint32_t count, uint8_t* buf);
+ * Inputs: base - device under the overlay
+ *			block - first block to read
+ *			count - number of blocks
+ *			buf - count * BLOCK_SIZE buffer
+ * Return Value: BLOCK_OK, or BLOCK_ERROR if the base device failed
+ * Function: Takes blocks from the upper layer where they have been written,
+ *				reading each run of unmodified blocks from base in one request
+ */
+static int32_t overlay_read(block_dev_t* base, uint32_t block, uint32_t count, uint8_t* buf) {
+	uint32_t i = 0, run;
+	uint8_t* data;
+
+	while(i < count) {
+		if((data = overlay_lookup(block + i))) {
+			memcpy(buf + i * BLOCK_SIZE, data, BLOCK_SIZE);
+			stats.upper_reads++;
+			++i;
+			continue;
+		}
+		if(block + i >= base->num_blocks) {
+			memset(buf + i * BLOCK_SIZE, 0, BLOCK_SIZE);
+			++i;
+			continue;
+		}
+
+		for(run = 1; i + run < count && block + i + run < base->num_blocks &&
+				!overlay_lookup(block + i + run); ++run) continue;
+		if(block_rw(base, block + i, run, buf + i * BLOCK_SIZE, 0) != BLOCK_OK) return BLOCK_ERROR;
+		stats.base_reads += run;
+		i += run;
+	}
+	return BLOCK_OK;
+}
+
+/* static int32_t overlay_submit(block_dev_t* dev, block_request_t* req);
+ * Inputs: dev - the overlay
+ *			req - list of requests to perform
+ * Return Value: BLOCK_OK, or BLOCK_ERROR if a request is out of range
+ * Function: Completes the requests immediately. Writes land in the upper
+ *				layer and fail with BLOCK_ERROR once it is full
+ */
+static int32_t overlay_submit(block_dev_t* dev, block_request_t* req) {
+	block_request_t *r, *next;
+	uint8_t* data;
+	uint32_t i;
+
+	for(r = req; r; r = r->next) {
+		if(r->block + r->count > dev->num_blocks) return BLOCK_ERROR;
+	}
+
+	for(r = req; r; r = next) {
+		next = r->next; /* the callback may reuse r */
+		if(r->write) {
+			r->status = BLOCK_OK;
+			for(i = 0; i < r->count; ++i) {
+				if(!(data = overlay_copy_up(r->block + i))) {
+					r->status = BLOCK_ERROR;
+					break;
+				}
+				memcpy(data, (uint8_t*) r->buf + i * BLOCK_SIZE, BLOCK_SIZE);
+			}
+		} else {
+			r->status = overlay_read(dev->priv, r->block, r->count, r->buf);
+		}
+
+		r->done = 1;
+		if(r->callback) r->callback(r);
+	}
+	return BLOCK_OK;
+}
+
+/* static void* overlay_map(block_dev_t* dev, uint32_t block);
+ * Inputs: dev - the overlay
+ *			block - block number
+ * Return Value: address of the block's current contents, NULL if they
+ *			aren't in memory
+ * Function: Points at the upper copy, or into the base device if it can be
+ *				mapped. A block's address changes when it is first written
+ */
+static void* overlay_map(block_dev_t* dev, uint32_t block) {
+	block_dev_t* base = dev->priv;
+	uint8_t* data;
+
+	if((data = overlay_lookup(block))) return data;
+	if(block >= base->num_blocks || !base->map) return NULL;
+	return base->map(base, block);
+}
+
+/* int32_t overlay_discard(block_dev_t* dev);
+ * Inputs: dev - the overlay
+ * Return Value: 0 on success, -1 if dev isn't the overlay
+ * Function: Forgets every modified block, so the device reads as the base
+ *				image again. Whoever caches blocks of dev must drop them too
+ */
+int32_t overlay_discard(block_dev_t* dev) {
+	uint32_t flags;
+
+	if(dev != &overlay) return -1;
+
+	cli_and_save(flags);
+	overlay_clear();
+	stats.discards++;
+	restore_flags(flags);
+	return 0;
+}
+
+/* void overlay_get_stats(overlay_stats_t* out);
+ * Inputs: out - filled with the overlay statistics
+ * Return Value: none
+ * Function: Copies out the overlay statistics
+ */
+void overlay_get_stats(overlay_stats_t* out) {
+	memcpy(out, &stats, sizeof(stats));
+}
+
+/* void overlay_print_stats(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Prints the upper layer usage and where reads were served from
+ */
+void overlay_print_stats(void) {
+	if(!overlay.priv) return;
+	printf("overlay on %s: %u/%u blocks modified, %u copy-ups, %u upper reads, %u base reads, %u discards\n",
+		((block_dev_t*) overlay.priv)->name, stats.upper_blocks, OVERLAY_MAX_BLOCKS,
+		stats.copy_ups, stats.upper_reads, stats.base_reads, stats.discards);
+}
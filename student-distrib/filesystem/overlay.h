@@ -0,0 +1,41 @@
+/* overlay.h - Defines the copy-on-write overlay that keeps a read-only
+ *				filesystem image pristine while programs modify it
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include "block_dev.h"
+
+/* Number of modified blocks the upper layer can hold (1 MB) */
+#define OVERLAY_MAX_BLOCKS 256
+
+/* Buckets of the block number -> upper block hash */
+#define OVERLAY_HASH_BUCKETS 64
+
+/* Overlay statistics */
+typedef struct overlay_stats {
+	uint32_t upper_blocks;		/* blocks currently held in the upper layer */
+	uint32_t copy_ups;			/* blocks copied into the upper layer since boot */
+	uint32_t upper_reads;		/* blocks read from the upper layer */
+	uint32_t base_reads;		/* blocks read from the base device */
+	uint32_t discards;			/* times the upper layer was thrown away */
+} overlay_stats_t;
+
+/* Stacks the overlay on top of a base device, returns the overlay device */
+block_dev_t* overlay_init(block_dev_t* base);
+
+/* Returns the device under the overlay, or dev itself if it isn't the overlay */
+block_dev_t* overlay_base(block_dev_t* dev);
+
+/* Drops every modified block, -1 if dev isn't the overlay */
+int32_t overlay_discard(block_dev_t* dev);
+
+/* Fills in the current overlay statistics */
+void overlay_get_stats(overlay_stats_t* stats);
+
+/* Prints how much of the upper layer is in use */
+void overlay_print_stats(void);
+
+#endif /* OVERLAY_H */
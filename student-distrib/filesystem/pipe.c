@@ -0,0 +1,267 @@
+/* pipe.c - Pipes between file descriptors. Data goes through a one-page
+ *			ring, except that a large write to a reader already waiting
+ *			is copied straight into the reader's buffer
+ * vim:ts=4 noexpandtab
+ */
+
+#include "filesystem.h"
+#include "pipe.h"
+#include "../paging.h"
+#include "../syscalls/syscalls.h"	/* For current_pcb, is_in_user_mem */
+#include "../tasks/tasks.h"			/* For yield_to */
+
+/* Both ends share one table, fd_t.flags says which end an fd is */
+file_ops_t file_ops_pipe = {pipe_read, pipe_write, pipe_open, pipe_close,
+						NULL, NULL, NULL, NULL, NULL, NULL, NULL, pipe_poll};
+
+static pipe_stats_t stats;
+
+#define PIPE_OF(fd) ((pipe_t*) fd_table[fd].inode_num)
+#define END_OF(fd) (fd_table[fd].flags & PIPE_END)
+
+/* pipe_t* pipe_alloc(void);
+ * Inputs: None
+ * Return Value: new pipe with neither end open, NULL if out of memory
+ * Function: Takes a frame for the pipe and one for its ring
+ */
+pipe_t* pipe_alloc(void) {
+  pipe_t* p = frame_alloc();
+
+  if(!p) return NULL;
+  memset(p, 0, sizeof(pipe_t));
+  if(!(p->buf = frame_alloc())) {
+	frame_free(p);
+	return NULL;
+  }
+  stats.pipes++;
+  return p;
+}
+
+/* void pipe_discard(pipe_t* p);
+ * Inputs: p - pipe from pipe_alloc
+ * Return Value: None
+ * Function: Frees the pipe if no file descriptor points at it
+ */
+void pipe_discard(pipe_t* p) {
+  if(!p || p->ends[PIPE_READ] || p->ends[PIPE_WRITE]) return;
+  frame_free(p->buf);
+  frame_free(p);
+}
+
+/* void pipe_attach(fd_t* fd, pipe_t* p, uint32_t end, struct pcb* owner);
+ * Inputs: fd - entry of some process' file descriptor table
+ *			p - pipe
+ *			end - PIPE_READ or PIPE_WRITE
+ *			owner - process whose table fd is in, blocked processes at
+ *				the other end hand it the CPU
+ * Return Value: None
+ * Function: Opens one end of the pipe in fd
+ */
+void pipe_attach(fd_t* fd, pipe_t* p, uint32_t end, struct pcb* owner) {
+  fd->fops_table = &file_ops_pipe;
+  fd->inode_num = (uint32_t) p;
+  fd->file_pos = 0;
+  fd->flags = end;
+  p->ends[end]++;
+  p->owner[end] = owner;
+}
+
+/* void pipe_get_stats(pipe_stats_t* out);
+ * Inputs: out - filled in
+ * Return Value: None
+ * Function: Copies out the totals
+ */
+void pipe_get_stats(pipe_stats_t* out) {
+  memcpy(out, &stats, sizeof(stats));
+}
+
+/* static void pipe_wait(struct pcb* other);
+ * Inputs: other - process holding the other end, NULL if none
+ * Return Value: None
+ * Function: Blocks until the pipe may have changed. Called with interrupts
+ *				off. Gives the CPU to the other end's process if it is a
+ *				different one, which only comes back when that process
+ *				blocks or exits. Otherwise halts until the next interrupt
+ */
+static void pipe_wait(struct pcb* other) {
+  stats.waits++;
+  irqoff_cancel(); /* the interrupts-off window ends here */
+  if(other && other != current_pcb && (uint32_t) current_pcb < KERNEL_MEM_END) {
+	stats.handoffs++;
+	yield_to(other);
+	return;
+  }
+  asm volatile ("sti; hlt" : : : "memory");
+  cli();
+}
+
+/* static void pipe_copy_direct(pipe_t* p, const uint8_t* src, uint32_t n);
+ * Inputs: p - pipe with a waiting reader
+ *			src - data in the writer's memory
+ *			n - bytes, at most p->wait_len
+ * Return Value: None
+ * Function: Maps the reader's user page into the kernel and copies into
+ *				its buffer, so the data is only copied once. Called with
+ *				interrupts off, the mapping is shared by every process
+ */
+static void pipe_copy_direct(pipe_t* p, const uint8_t* src, uint32_t n) {
+  uint8_t* dst = (uint8_t*) map_peer_user_page(p->wait_pcb->user_physical_mem_block_num);
+
+  dst += (uint32_t) p->wait_buf - USER_MEM_PAGE_INDEX * FOUR_MB;
+  memcpy(dst, src, n);
+  unmap_peer_user_page();
+}
+
+/* int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+ * Inputs: fd - read end of a pipe
+ *			buf - buffer to fill
+ *			nbytes - size of buf
+ * Return Value: bytes read, 0 once the pipe is empty and the write end is
+ *		closed, -1 for the write end, a bad buffer, or an empty pipe with
+ *		interrupts off, -EAGAIN for an empty pipe and an O_NONBLOCK fd
+ * Function: Waits for data, then returns what is in the ring up to nbytes.
+ *				A user buffer of at least PIPE_DIRECT_MIN is left for the
+ *				writer to fill directly while waiting
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes) {
+  pipe_t* p = PIPE_OF(fd);
+  uint32_t flags, avail, off, first, got;
+
+  if(END_OF(fd) != PIPE_READ || !buf || nbytes < 0) return -1;
+  if(!nbytes) return 0;
+
+  cli_and_save(flags);
+  while(p->head == p->tail && p->ends[PIPE_WRITE]) {
+	if(fd_table[fd].flags & O_NONBLOCK) {
+	  restore_flags(flags);
+	  return -EAGAIN;
+	}
+	if(!(flags & EFLAGS_IF)) {
+	  restore_flags(flags);
+	  return -1;
+	}
+	if((uint32_t) nbytes >= PIPE_DIRECT_MIN && (uint32_t) current_pcb < KERNEL_MEM_END &&
+		  is_in_user_mem((uint32_t) buf) && is_in_user_mem((uint32_t) buf + nbytes - 1)) {
+	  p->wait_buf = buf;
+	  p->wait_len = nbytes;
+	  p->wait_pcb = current_pcb;
+	}
+	pipe_wait(p->owner[PIPE_WRITE]);
+
+	got = p->wait_got;
+	p->wait_buf = NULL;
+	p->wait_got = 0;
+	p->wait_pcb = NULL;
+	if(got) {
+	  restore_flags(flags);
+	  return got;
+	}
+  }
+
+  avail = p->tail - p->head;
+  if(avail > (uint32_t) nbytes) avail = nbytes;
+  off = p->head % PIPE_SIZE;
+  first = (avail < PIPE_SIZE - off) ? avail : PIPE_SIZE - off;
+  memcpy(buf, p->buf + off, first);
+  memcpy((uint8_t*) buf + first, p->buf, avail - first);
+  p->head += avail;
+  restore_flags(flags);
+  return avail;
+}
+
+/* int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+ * Inputs: fd - write end of a pipe
+ *			buf - data
+ *			nbytes - its length
+ * Return Value: nbytes, fewer if the read end was closed part way or the
+ *		pipe filled with interrupts off or an O_NONBLOCK fd, -1 if nothing
+ *		could be written, -EAGAIN if the pipe was full for an O_NONBLOCK fd
+ * Function: Copies into the ring, waiting whenever it is full. With the
+ *				ring empty and a reader waiting, writes of at least
+ *				PIPE_DIRECT_MIN go straight into the reader's buffer
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes) {
+  pipe_t* p = PIPE_OF(fd);
+  const uint8_t* src = buf;
+  uint32_t flags, n, off, first, done = 0;
+
+  if(END_OF(fd) != PIPE_WRITE || !buf || nbytes < 0) return -1;
+
+  cli_and_save(flags);
+  while(done < (uint32_t) nbytes) {
+	if(!p->ends[PIPE_READ]) break;
+
+	if(p->wait_buf && !p->wait_got && p->head == p->tail && nbytes - done >= PIPE_DIRECT_MIN) {
+	  n = (nbytes - done < p->wait_len) ? nbytes - done : p->wait_len;
+	  pipe_copy_direct(p, src + done, n);
+	  p->wait_got = n;
+	  stats.direct_bytes += n;
+	} else if(p->tail - p->head < PIPE_SIZE) {
+	  n = PIPE_SIZE - (p->tail - p->head);
+	  if(n > nbytes - done) n = nbytes - done;
+	  off = p->tail % PIPE_SIZE;
+	  first = (n < PIPE_SIZE - off) ? n : PIPE_SIZE - off;
+	  memcpy(p->buf + off, src + done, first);
+	  memcpy(p->buf, src + done + first, n - first);
+	  p->tail += n;
+	} else {
+	  if(fd_table[fd].flags & O_NONBLOCK) {
+		restore_flags(flags);
+		return done ? (int32_t) done : -EAGAIN;
+	  }
+	  if(!(flags & EFLAGS_IF)) break;
+	  pipe_wait(p->owner[PIPE_READ]);
+	  continue;
+	}
+	done += n;
+	stats.bytes += n;
+  }
+  restore_flags(flags);
+  return (done || !nbytes) ? (int32_t) done : -1;
+}
+
+/* int32_t pipe_open(const uint8_t* filename);
+ * Inputs: filename - ignored
+ * Return Value: -1
+ * Function: Pipes have no name, they are made by the pipe syscall
+ */
+int32_t pipe_open(const uint8_t* filename) {
+  return -1;
+}
+
+/* int32_t pipe_close(int32_t fd);
+ * Inputs: fd - either end of a pipe
+ * Return Value: 0
+ * Function: Closes the end. Readers see end of file once every write end
+ *				is closed, writers get -1 once every read end is. The pipe
+ *				is freed with its last end
+ */
+int32_t pipe_close(int32_t fd) {
+  pipe_t* p = PIPE_OF(fd);
+  uint32_t end = END_OF(fd), flags;
+
+  cli_and_save(flags);
+  if(!--p->ends[end]) p->owner[end] = NULL;
+  pipe_discard(p);
+  restore_flags(flags);
+  return 0;
+}
+
+/* int32_t pipe_poll(int32_t fd, int32_t events);
+ * Inputs: fd - either end of a pipe
+ *			events - POLLIN and/or POLLOUT
+ * Return Value: for the read end POLLIN if there is data, or POLLIN and
+ *		POLLHUP at end of file; for the write end POLLOUT if there is room,
+ *		POLLERR if the read end is closed
+ * Function: poll operation for pipes
+ */
+int32_t pipe_poll(int32_t fd, int32_t events) {
+  pipe_t* p = PIPE_OF(fd);
+
+  if(END_OF(fd) == PIPE_READ) {
+	if(!p->ends[PIPE_WRITE]) return (events & POLLIN) | POLLHUP;
+	return (p->head != p->tail) ? events & POLLIN : 0;
+  }
+  if(!p->ends[PIPE_READ]) return POLLERR;
+  return (p->tail - p->head < PIPE_SIZE) ? events & POLLOUT : 0;
+}
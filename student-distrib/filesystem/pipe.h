@@ -0,0 +1,68 @@
+/* pipe.h - Defines pipes: a page-sized ring buffer with a read end and a
+ *			write end, each opened as a file descriptor
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "filesystem_structs.h"
+
+/* Bytes a pipe holds, one page frame */
+#define PIPE_SIZE FOUR_KB
+
+/* Reads and writes at least this large to a waiting reader skip the ring */
+#define PIPE_DIRECT_MIN FOUR_KB
+
+/* Which end a file descriptor holds, kept in the PIPE_END bit of fd_t.flags */
+#define PIPE_READ 0
+#define PIPE_WRITE 1
+#define PIPE_END 1
+
+struct pcb;
+
+typedef struct pipe {
+	uint8_t* buf;				/* ring, a page frame */
+	uint32_t head;				/* bytes read since the pipe was made */
+	uint32_t tail;				/* bytes written */
+	uint32_t ends[2];			/* open file descriptors on each end */
+	struct pcb* owner[2];		/* process holding each end, to hand the CPU to when blocked */
+
+	/* A reader blocked on an empty pipe leaves its buffer here,
+	 *	so a large write can copy straight into it */
+	uint8_t* wait_buf;
+	uint32_t wait_len;
+	uint32_t wait_got;			/* set by the writer */
+	struct pcb* wait_pcb;
+} pipe_t;
+
+/* Pipe totals, see pipe_get_stats */
+typedef struct pipe_stats {
+	uint32_t pipes;				/* pipes made */
+	uint32_t bytes;				/* bytes written */
+	uint32_t direct_bytes;		/* of those, copied straight into a waiting reader */
+	uint32_t waits;				/* times a reader or writer blocked */
+	uint32_t handoffs;			/* of those, handed the CPU to the process at the other end */
+} pipe_stats_t;
+
+/* Makes a pipe with neither end open, NULL if out of memory */
+pipe_t* pipe_alloc(void);
+
+/* Frees a pipe neither of whose ends were ever opened */
+void pipe_discard(pipe_t* p);
+
+/* Points fd at one end of p, owned by process owner */
+void pipe_attach(fd_t* fd, pipe_t* p, uint32_t end, struct pcb* owner);
+
+void pipe_get_stats(pipe_stats_t* out);
+
+/* File operations for each end */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t pipe_open(const uint8_t* filename);
+int32_t pipe_close(int32_t fd);
+int32_t pipe_poll(int32_t fd, int32_t events);
+
+extern file_ops_t file_ops_pipe;
+
+#endif /* PIPE_H */
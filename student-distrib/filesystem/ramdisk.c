@@ -0,0 +1,65 @@
+/* ramdisk.c - Block device backed by the filesystem image the bootloader
+ *				loaded into memory as a multiboot module
+ * vim:ts=4 noexpandtab
+ */
+
+#include "block_dev.h"
+
+static int32_t ramdisk_submit(block_dev_t* dev, block_request_t* req);
+static void* ramdisk_map(block_dev_t* dev, uint32_t block);
+
+static block_dev_t ramdisk = {
+	.name = "ramdisk",
+	.submit = ramdisk_submit,
+	.poll = NULL,
+	.map = ramdisk_map,
+};
+
+/* block_dev_t* ramdisk_init(uint32_t base_addr, uint32_t end_addr);
+ * Inputs: base_addr - address of the first byte of the image
+ *			end_addr - address one past the last byte of the image
+ * Return Value: the ramdisk block device
+ * Function: Wraps the image in memory in a block device
+ */
+block_dev_t* ramdisk_init(uint32_t base_addr, uint32_t end_addr) {
+	ramdisk.priv = (void*) base_addr;
+	ramdisk.num_blocks = (end_addr - base_addr) / BLOCK_SIZE;
+	return &ramdisk;
+}
+
+/* static int32_t ramdisk_submit(block_dev_t* dev, block_request_t* req);
+ * Inputs: dev - the ramdisk
+ *			req - list of requests to perform
+ * Return Value: BLOCK_OK, or BLOCK_ERROR if a request is out of range
+ * Function: Copies blocks to or from the image, completing the requests immediately
+ */
+static int32_t ramdisk_submit(block_dev_t* dev, block_request_t* req) {
+	block_request_t *r, *next;
+	uint8_t* addr;
+
+	for(r = req; r; r = r->next) {
+		if(r->block + r->count > dev->num_blocks) return BLOCK_ERROR;
+	}
+
+	for(r = req; r; r = next) {
+		next = r->next; /* the callback may reuse r */
+		addr = ramdisk_map(dev, r->block);
+		if(r->write) memcpy(addr, r->buf, r->count * BLOCK_SIZE);
+		else memcpy(r->buf, addr, r->count * BLOCK_SIZE);
+
+		r->status = BLOCK_OK;
+		r->done = 1;
+		if(r->callback) r->callback(r);
+	}
+	return BLOCK_OK;
+}
+
+/* static void* ramdisk_map(block_dev_t* dev, uint32_t block);
+ * Inputs: dev - the ramdisk
+ *			block - block number
+ * Return Value: address of the block in memory
+ * Function: Blocks of the image are contiguous, so this is just an offset
+ */
+static void* ramdisk_map(block_dev_t* dev, uint32_t block) {
+	return (uint8_t*) dev->priv + block * BLOCK_SIZE;
+}
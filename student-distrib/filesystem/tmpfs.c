@@ -0,0 +1,456 @@
+/* tmpfs.c - In-memory filesystem mounted at "tmp". File data lives in page
+ *			frames found through a per-file radix tree, so writes never go
+ *			through the block allocator or the buffer cache
+ * vim:ts=4 noexpandtab
+ */
+
+#include "filesystem.h"
+#include "tmpfs.h"
+#include "../paging.h"
+
+static tmpfs_inode_t tmpfs_inodes[TMPFS_MAX_FILES];
+
+/* Definition of file operations tables for tmpfs files and the mount point */
+file_ops_t file_ops_tmpfs = {tmpfs_read, tmpfs_write, tmpfs_open, tmpfs_close,
+						tmpfs_lseek, tmpfs_pread, tmpfs_pwrite, NULL, tmpfs_fstat};
+file_ops_t file_ops_tmpfs_dir = {tmpfs_dir_read, tmpfs_dir_write, tmpfs_open, tmpfs_close,
+						tmpfs_dir_lseek, NULL, NULL, tmpfs_dir_getdents, tmpfs_dir_fstat};
+
+/* const uint8_t* tmpfs_path(const uint8_t* fname);
+ * Inputs: fname - file name as passed to open
+ * Return Value: the name below the mount point ("" for the mount point
+ *			itself), NULL if fname isn't in tmpfs
+ * Function: Matches "tmp" and "tmp/<name>"
+ */
+const uint8_t* tmpfs_path(const uint8_t* fname) {
+	if(strncmp((const int8_t*)fname, (const int8_t*)TMPFS_MOUNT, TMPFS_MOUNT_LEN)) return NULL;
+	if(fname[TMPFS_MOUNT_LEN] == '\0') return fname + TMPFS_MOUNT_LEN;
+	if(fname[TMPFS_MOUNT_LEN] == '/') return fname + TMPFS_MOUNT_LEN + 1;
+	return NULL;
+}
+
+/* static int32_t tmpfs_find(const uint8_t* name);
+ * Inputs: name - file name below the mount point
+ * Return Value: inode number of the file, -1 if there is none
+ * Function: Scans the inode table
+ */
+static int32_t tmpfs_find(const uint8_t* name) {
+	int32_t i;
+
+	if(!name[0] || strlen((const int8_t*)name) > MAX_FILENAME_LENGTH) return -1;
+	for(i = 0; i < TMPFS_MAX_FILES; ++i) {
+		if(tmpfs_inodes[i].used &&
+			!strncmp((const int8_t*)tmpfs_inodes[i].name, (const int8_t*)name, MAX_FILENAME_LENGTH))
+			return i;
+	}
+	return -1;
+}
+
+/* static void** tmpfs_slot(tmpfs_inode_t* f, uint32_t page, uint8_t create);
+ * Inputs: f - file
+ *			page - index of a page in the file
+ *			create - 1 to grow the tree down to the page if needed
+ * Return Value: pointer to the tree slot holding the page, NULL if the path
+ *			to it doesn't exist (or couldn't be allocated)
+ * Function: Walks at most TMPFS_MAX_HEIGHT nodes, so finding the page to
+ *				append to costs the same however large the file is
+ */
+static void** tmpfs_slot(tmpfs_inode_t* f, uint32_t page, uint8_t create) {
+	void **slot, **node;
+	uint32_t level;
+
+	/* Add levels on top until the tree reaches the page */
+	while(f->height < TMPFS_MAX_HEIGHT && page >> (f->height * TMPFS_NODE_BITS)) {
+		if(!create) return NULL;
+		if(f->root) {
+			if(!(node = frame_alloc())) return NULL;
+			memset(node, 0, FOUR_KB);
+			node[0] = f->root;
+			f->root = node;
+		}
+		f->height++;
+	}
+
+	slot = &f->root;
+	for(level = f->height; level > 0; --level) {
+		if(!*slot) {
+			if(!create || !(node = frame_alloc())) return NULL;
+			memset(node, 0, FOUR_KB);
+			*slot = node;
+		}
+		node = *slot;
+		slot = &node[(page >> ((level - 1) * TMPFS_NODE_BITS)) & (TMPFS_NODE_SLOTS - 1)];
+	}
+	return slot;
+}
+
+/* static void tmpfs_free_tree(void* node, uint32_t level);
+ * Inputs: node - a node or data page
+ *			level - levels of nodes at and below node, 0 for a data page
+ * Return Value: none
+ * Function: Returns the subtree's frames to the page frame allocator
+ */
+static void tmpfs_free_tree(void* node, uint32_t level) {
+	uint32_t i;
+
+	if(!node) return;
+	for(i = 0; level && i < TMPFS_NODE_SLOTS; ++i) tmpfs_free_tree(((void**) node)[i], level - 1);
+	frame_free(node);
+}
+
+/* int32_t tmpfs_lookup(const uint8_t* name, dentry_t* dentry);
+ * Inputs: name - file name below the mount point, "" for the mount point
+ *			dentry - filled with the file's entry
+ * Return Value: 0 for success, -1 if there is no such file
+ * Function: Makes a tmpfs file look like a directory entry, with
+ *				file_type FILE_TYPE_TMPFS so open picks tmpfs operations
+ */
+int32_t tmpfs_lookup(const uint8_t* name, dentry_t* dentry) {
+	int32_t inode;
+
+	memset(dentry, 0, sizeof(*dentry));
+	dentry->file_type = FILE_TYPE_TMPFS;
+	if(!name[0]) {
+		strncpy((int8_t*)dentry->filename, (const int8_t*)TMPFS_MOUNT, MAX_FILENAME_LENGTH);
+		dentry->inode_num = TMPFS_ROOT_INODE;
+		return 0;
+	}
+
+	if((inode = tmpfs_find(name)) == -1) return -1;
+	memcpy(dentry->filename, tmpfs_inodes[inode].name, MAX_FILENAME_LENGTH);
+	dentry->inode_num = inode;
+	return 0;
+}
+
+/* int32_t tmpfs_create(const uint8_t* name);
+ * Inputs: name - name of the file to create below the mount point
+ * Return Value: 0 for success, -1 if the name is bad or taken or tmpfs is full
+ * Function: Claims a free inode for an empty file
+ */
+int32_t tmpfs_create(const uint8_t* name) {
+	int32_t i;
+
+	if(!name[0] || strlen((const int8_t*)name) > MAX_FILENAME_LENGTH || tmpfs_find(name) != -1) return -1;
+	for(i = 0; i < TMPFS_MAX_FILES; ++i) {
+		if(tmpfs_inodes[i].used) continue;
+		memset(&tmpfs_inodes[i], 0, sizeof(tmpfs_inodes[i]));
+		strncpy((int8_t*)tmpfs_inodes[i].name, (const int8_t*)name, MAX_FILENAME_LENGTH);
+		tmpfs_inodes[i].used = 1;
+		return 0;
+	}
+	return -1;
+}
+
+/* int32_t tmpfs_remove(const uint8_t* name);
+ * Inputs: name - name of the file below the mount point
+ * Return Value: 0 for success, -1 if there is no such file
+ * Function: Frees every frame of the file and its inode
+ */
+int32_t tmpfs_remove(const uint8_t* name) {
+	int32_t i;
+
+	if((i = tmpfs_find(name)) == -1) return -1;
+	tmpfs_free_tree(tmpfs_inodes[i].root, tmpfs_inodes[i].height);
+	memset(&tmpfs_inodes[i], 0, sizeof(tmpfs_inodes[i]));
+	return 0;
+}
+
+/* int32_t tmpfs_stat(uint32_t inode, stat_t* buf);
+ * Inputs: inode - tmpfs inode number, or TMPFS_ROOT_INODE
+ *			buf - filled with the file's information
+ * Return Value: 0 for success, -1 if the inode isn't in use
+ * Function: Reports files as regular files and the mount point as a
+ *				directory whose length is its number of files
+ */
+int32_t tmpfs_stat(uint32_t inode, stat_t* buf) {
+	uint32_t i;
+
+	buf->inode_num = inode;
+	buf->blocks = 0;
+	if(inode == TMPFS_ROOT_INODE) {
+		buf->file_type = FILE_TYPE_DIR;
+		buf->length = 0;
+		for(i = 0; i < TMPFS_MAX_FILES; ++i) buf->length += tmpfs_inodes[i].used;
+		return 0;
+	}
+	if(inode >= TMPFS_MAX_FILES || !tmpfs_inodes[inode].used) return -1;
+	buf->file_type = FILE_TYPE_REGULAR;
+	buf->length = tmpfs_inodes[inode].length;
+	buf->blocks = tmpfs_inodes[inode].pages;
+	return 0;
+}
+
+/* int32_t tmpfs_read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+ * Inputs: inode - tmpfs inode number
+ *			offset - byte offset in the file to read from
+ *			buf - buffer for the data
+ *			length - number of bytes to read
+ * Return Value: number of bytes read, -1 if the inode isn't in use
+ * Function: Copies out of the file's pages, pages never written read as zeros
+ */
+int32_t tmpfs_read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
+	tmpfs_inode_t* f;
+	uint32_t done = 0, chunk, page_offset;
+	void** slot;
+
+	if(inode >= TMPFS_MAX_FILES || !tmpfs_inodes[inode].used) return -1;
+	f = &tmpfs_inodes[inode];
+	if(offset >= f->length) return 0;
+	if(length > f->length - offset) length = f->length - offset;
+
+	while(done < length) {
+		page_offset = (offset + done) % FOUR_KB;
+		chunk = FOUR_KB - page_offset;
+		if(chunk > length - done) chunk = length - done;
+
+		slot = tmpfs_slot(f, (offset + done) / FOUR_KB, 0);
+		if(slot && *slot) memcpy(buf + done, (uint8_t*) *slot + page_offset, chunk);
+		else memset(buf + done, 0, chunk);
+		done += chunk;
+	}
+	return done;
+}
+
+/* int32_t tmpfs_write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+ * Inputs: inode - tmpfs inode number
+ *			offset - byte offset in the file to write at
+ *			buf - data to write
+ *			length - number of bytes to write
+ * Return Value: number of bytes written (less than length if memory runs
+ *			out), -1 for failure
+ * Function: Copies into the file's pages, allocating the ones it lacks.
+ *				New pages are zeroed unless they are about to be filled
+ */
+int32_t tmpfs_write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length) {
+	tmpfs_inode_t* f;
+	uint32_t done = 0, chunk, page_offset;
+	void** slot;
+
+	if(inode >= TMPFS_MAX_FILES || !tmpfs_inodes[inode].used) return -1;
+	if(length > 0xFFFFFFFF - offset) return -1;
+	f = &tmpfs_inodes[inode];
+
+	while(done < length) {
+		page_offset = (offset + done) % FOUR_KB;
+		chunk = FOUR_KB - page_offset;
+		if(chunk > length - done) chunk = length - done;
+
+		if(!(slot = tmpfs_slot(f, (offset + done) / FOUR_KB, 1))) break;
+		if(!*slot) {
+			if(!(*slot = frame_alloc())) break;
+			if(chunk != FOUR_KB) memset(*slot, 0, FOUR_KB);
+			f->pages++;
+		}
+		memcpy((uint8_t*) *slot + page_offset, buf + done, chunk);
+		done += chunk;
+	}
+
+	if(offset + done > f->length) f->length = offset + done;
+	return (done || !length) ? (int32_t) done : -1;
+}
+
+/* int32_t tmpfs_open(const uint8_t* filename);
+ * Inputs: filename - name of file to be opened
+ * Return Value: 0
+ * Function: Does nothing
+ */
+int32_t tmpfs_open(const uint8_t* filename) {
+	return 0;
+}
+
+/* int32_t tmpfs_close(int32_t fd);
+ * Inputs: fd - file descriptor of file to close
+ * Return Value: 0
+ * Function: Does nothing
+ */
+int32_t tmpfs_close(int32_t fd) {
+	return 0;
+}
+
+/* int32_t tmpfs_read(int32_t fd, void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor of file to read from
+ *			buf - buffer for data read from the file
+ *			nbytes - number of bytes to read
+ * Return Value: number of bytes read, -1 for failure
+ * Function: Reads at file_pos and moves it forward by the bytes read
+ */
+int32_t tmpfs_read(int32_t fd, void* buf, int32_t nbytes) {
+	int32_t n;
+
+	if(nbytes < 0) return -1;
+	if((n = tmpfs_read_data(fd_table[fd].inode_num, fd_table[fd].file_pos, buf, nbytes)) < 0) return -1;
+	fd_table[fd].file_pos += n;
+	return n;
+}
+
+/* int32_t tmpfs_write(int32_t fd, const void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor of file to write to
+ *			buf - data to write
+ *			nbytes - number of bytes to write
+ * Return Value: number of bytes written, -1 for failure
+ * Function: Writes at file_pos and moves it forward, so successive writes
+ *				append without touching what was written before
+ */
+int32_t tmpfs_write(int32_t fd, const void* buf, int32_t nbytes) {
+	int32_t n;
+
+	if(nbytes < 0) return -1;
+	if((n = tmpfs_write_data(fd_table[fd].inode_num, fd_table[fd].file_pos, buf, nbytes)) < 0) return -1;
+	fd_table[fd].file_pos += n;
+	return n;
+}
+
+/* int32_t tmpfs_lseek(int32_t fd, int32_t offset, int32_t whence);
+ * Inputs: fd - file descriptor of file to seek in
+ *			offset - byte offset relative to whence
+ *			whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * Return Value: new file position, -1 for failure
+ * Function: Moves file_pos, which may go past the end of the file
+ */
+int32_t tmpfs_lseek(int32_t fd, int32_t offset, int32_t whence) {
+	int32_t base;
+
+	switch(whence) {
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = fd_table[fd].file_pos;
+			break;
+		case SEEK_END:
+			base = tmpfs_inodes[fd_table[fd].inode_num].length;
+			break;
+		default:
+			return -1;
+	}
+
+	/* A position past TMPFS_MAX_SEEK reads as negative. Bound offset before
+		adding so the sum can't overflow */
+	if(base < 0 || offset < -base || offset > TMPFS_MAX_SEEK - base) return -1;
+	fd_table[fd].file_pos = base + offset;
+	return fd_table[fd].file_pos;
+}
+
+/* int32_t tmpfs_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+ * Inputs: fd - file descriptor of file to read from
+ *			buf - buffer for data read from the file
+ *			nbytes - number of bytes to read
+ *			offset - byte offset in the file to read from
+ * Return Value: number of bytes read, -1 for failure
+ * Function: Reads at offset without moving file_pos
+ */
+int32_t tmpfs_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset) {
+	if(nbytes < 0) return -1;
+	return tmpfs_read_data(fd_table[fd].inode_num, offset, buf, nbytes);
+}
+
+/* int32_t tmpfs_pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+ * Inputs: fd - file descriptor of file to write to
+ *			buf - data to write
+ *			nbytes - number of bytes to write
+ *			offset - byte offset in the file to write at
+ * Return Value: number of bytes written, -1 for failure
+ * Function: Writes at offset without moving file_pos
+ */
+int32_t tmpfs_pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset) {
+	if(nbytes < 0) return -1;
+	return tmpfs_write_data(fd_table[fd].inode_num, offset, buf, nbytes);
+}
+
+/* int32_t tmpfs_fstat(int32_t fd, stat_t* buf);
+ * Inputs: fd - file descriptor of an open tmpfs file
+ *			buf - filled with the file's information
+ * Return Value: 0 for success, -1 for failure
+ * Function: Reports the file's length and pages
+ */
+int32_t tmpfs_fstat(int32_t fd, stat_t* buf) {
+	return tmpfs_stat(fd_table[fd].inode_num, buf);
+}
+
+/* int32_t tmpfs_dir_read(int32_t fd, void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor of the mount point
+ *			buf - buffer for the file name
+ *			nbytes - number of bytes to read
+ * Return Value: number of bytes read, 0 after the last file
+ * Function: Reads the next file name, file_pos is the next inode to look at
+ */
+int32_t tmpfs_dir_read(int32_t fd, void* buf, int32_t nbytes) {
+	uint32_t i;
+	int32_t n;
+
+	if(nbytes < 0) return -1;
+	for(i = fd_table[fd].file_pos; i < TMPFS_MAX_FILES && !tmpfs_inodes[i].used; ++i) continue;
+	if(i >= TMPFS_MAX_FILES) return 0;
+	fd_table[fd].file_pos = i + 1;
+
+	if(nbytes > MAX_FILENAME_LENGTH) nbytes = MAX_FILENAME_LENGTH;
+	memcpy(buf, tmpfs_inodes[i].name, nbytes);
+	for(n = 0; n < nbytes && tmpfs_inodes[i].name[n]; ++n) continue;
+	return n;
+}
+
+/* int32_t tmpfs_dir_write(int32_t fd, const void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor of the mount point
+ *			buf, nbytes - ignored
+ * Return Value: -1
+ * Function: Does nothing, always fails since it is not supported
+ */
+int32_t tmpfs_dir_write(int32_t fd, const void* buf, int32_t nbytes) {
+	return -1;
+}
+
+/* int32_t tmpfs_dir_lseek(int32_t fd, int32_t offset, int32_t whence);
+ * Inputs: fd - file descriptor of the mount point
+ *			offset - inode index relative to whence
+ *			whence - SEEK_SET or SEEK_CUR
+ * Return Value: new position, -1 for failure
+ * Function: lseek(fd, 0, SEEK_SET) rewinds the listing
+ */
+int32_t tmpfs_dir_lseek(int32_t fd, int32_t offset, int32_t whence) {
+	int32_t base;
+	if(whence == SEEK_SET) base = 0;
+	else if(whence == SEEK_CUR) base = fd_table[fd].file_pos;
+	else return -1;
+
+	if(offset < -base || offset > TMPFS_MAX_FILES - base) return -1;
+	fd_table[fd].file_pos = base + offset;
+	return fd_table[fd].file_pos;
+}
+
+/* int32_t tmpfs_dir_getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor of the mount point
+ *			buf - array of records to fill
+ *			nbytes - size of buf in bytes
+ * Return Value: number of bytes filled, 0 after the last file, -1 if buf
+ *			can't hold a single record
+ * Function: Reads as many files as fit in buf
+ */
+int32_t tmpfs_dir_getdents(int32_t fd, dirent_t* buf, int32_t nbytes) {
+	int32_t count = 0, max = nbytes / (int32_t)sizeof(dirent_t);
+	uint32_t pos;
+
+	if(max <= 0) return -1;
+
+	for(pos = fd_table[fd].file_pos; pos < TMPFS_MAX_FILES && count < max; ++pos) {
+		if(!tmpfs_inodes[pos].used) continue;
+		buf[count].inode_num = pos;
+		buf[count].length = tmpfs_inodes[pos].length;
+		buf[count].file_type = FILE_TYPE_REGULAR;
+		memcpy(buf[count].name, tmpfs_inodes[pos].name, MAX_FILENAME_LENGTH);
+		buf[count].name[MAX_FILENAME_LENGTH] = '\0';
+		++count;
+	}
+
+	fd_table[fd].file_pos = pos;
+	return count * sizeof(dirent_t);
+}
+
+/* int32_t tmpfs_dir_fstat(int32_t fd, stat_t* buf);
+ * Inputs: fd - file descriptor of the mount point
+ *			buf - filled with the mount point's information
+ * Return Value: 0
+ * Function: Reports the mount point as a directory
+ */
+int32_t tmpfs_dir_fstat(int32_t fd, stat_t* buf) {
+	return tmpfs_stat(TMPFS_ROOT_INODE, buf);
+}
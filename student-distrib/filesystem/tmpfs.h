@@ -0,0 +1,74 @@
+/* tmpfs.h - Defines the in-memory filesystem mounted at "tmp", whose
+ *			files are trees of page frames instead of device blocks
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include "filesystem_structs.h"
+
+/* Name of the mount point, files in it are opened as "tmp/<name>" */
+#define TMPFS_MOUNT "tmp"
+#define TMPFS_MOUNT_LEN 3
+
+/* Number of files tmpfs can hold */
+#define TMPFS_MAX_FILES 64
+
+/* Inode number of the mount point itself */
+#define TMPFS_ROOT_INODE TMPFS_MAX_FILES
+
+/* Each radix tree node is a page frame of pointers, so a tree of height h
+ *	indexes 1024^h pages and height 2 covers any 32 bit offset */
+#define TMPFS_NODE_BITS 10
+#define TMPFS_NODE_SLOTS (1 << TMPFS_NODE_BITS)
+#define TMPFS_MAX_HEIGHT 2
+
+/* Furthest lseek moves a file's position, the largest it can return */
+#define TMPFS_MAX_SEEK 0x7FFFFFFF
+
+/* A tmpfs file */
+typedef struct tmpfs_inode {
+	uint8_t name[MAX_FILENAME_LENGTH];
+	uint8_t used;				/* slot holds a file */
+	uint8_t height;				/* levels of nodes above the data pages */
+	uint32_t length;			/* file size in bytes */
+	uint32_t pages;				/* data pages allocated */
+	void* root;					/* the only data page at height 0, otherwise a node */
+} tmpfs_inode_t;
+
+/* Returns the part of fname below the mount point, NULL if fname isn't in tmpfs */
+const uint8_t* tmpfs_path(const uint8_t* fname);
+
+/* Directory operations on names below the mount point ("" is the mount point) */
+int32_t tmpfs_lookup(const uint8_t* name, dentry_t* dentry);
+int32_t tmpfs_create(const uint8_t* name);
+int32_t tmpfs_remove(const uint8_t* name);
+int32_t tmpfs_stat(uint32_t inode, stat_t* buf);
+
+/* Reads and writes a file's pages directly */
+int32_t tmpfs_read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+int32_t tmpfs_write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+
+/* File operations for tmpfs files */
+int32_t tmpfs_open(const uint8_t* filename);
+int32_t tmpfs_close(int32_t fd);
+int32_t tmpfs_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t tmpfs_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t tmpfs_lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t tmpfs_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t tmpfs_pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+int32_t tmpfs_fstat(int32_t fd, stat_t* buf);
+
+/* File operations for the mount point */
+int32_t tmpfs_dir_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t tmpfs_dir_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t tmpfs_dir_lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t tmpfs_dir_getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+int32_t tmpfs_dir_fstat(int32_t fd, stat_t* buf);
+
+/* File operations tables for tmpfs files and the mount point */
+extern file_ops_t file_ops_tmpfs;
+extern file_ops_t file_ops_tmpfs_dir;
+
+#endif /* TMPFS_H */
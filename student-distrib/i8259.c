@@ -3,6 +3,9 @@
  */
 
 #include "i8259.h"
+#include "apic.h"
+#include "irqstat.h"
+#include "trace.h"
 #include "lib.h"
 #include "idt.h"
 #include "paging.h"
@@ -26,17 +29,21 @@ extern void do_irq_12();
 extern void do_irq_13();
 extern void do_irq_14();
 extern void do_irq_15();
+extern void do_irq_16();
 
-/* Interrupt masks to determine which interrupts are enabled and disabled */
-uint8_t master_mask; /* IRQs 0-7  */
-uint8_t slave_mask;  /* IRQs 8-15 */
+/* Interrupt masks to determine which interrupts are enabled and disabled,
+ * kept here so changing one doesn't need an inb */
+uint8_t master_mask = 0xFF; /* IRQs 0-7  */
+uint8_t slave_mask = 0xFF;  /* IRQs 8-15 */
 
 
-// Data structure containing handlers
-uint32_t i8259_handlers[PIC_SIZE*2][MAX_CHAIN] = {{0x0}};
+// Data structure containing handlers, the first i8259_handler_count[irq] are in use
+uint32_t i8259_handlers[NUM_IRQS][MAX_CHAIN] = {{0x0}};
+uint8_t i8259_handler_count[NUM_IRQS];
 // Table containing IRQ linker functions
-void* do_irq_table[16] = {&do_irq_0, &do_irq_1, &do_irq_2, &do_irq_3, &do_irq_4, &do_irq_5, &do_irq_6, &do_irq_7, 
-							&do_irq_8, &do_irq_9, &do_irq_10, &do_irq_11, &do_irq_12, &do_irq_13, &do_irq_14, &do_irq_15};
+void* do_irq_table[NUM_IRQS] = {&do_irq_0, &do_irq_1, &do_irq_2, &do_irq_3, &do_irq_4, &do_irq_5, &do_irq_6, &do_irq_7, 
+							&do_irq_8, &do_irq_9, &do_irq_10, &do_irq_11, &do_irq_12, &do_irq_13, &do_irq_14, &do_irq_15,
+							&do_irq_16};
 
 /*
  * i8259_init
@@ -71,8 +78,10 @@ void i8259_init(void) {
   outb(ICW4, SLAVE_8259_PORT+1);
 
   // Re-enable the interrupts we masked
-  outb(mask_m, MASTER_8259_PORT+1);
-  outb(mask_m, SLAVE_8259_PORT+1);
+  master_mask = mask_m;
+  slave_mask = mask_s;
+  outb(master_mask, MASTER_8259_PORT+1);
+  outb(slave_mask, SLAVE_8259_PORT+1);
 
  restore_flags(flags);
 }
@@ -92,8 +101,13 @@ void register_interrupt_handler(uint32_t irq_num, void* handler) {
 
   send_eoi(irq_num); // TODO in case??
   // (1) Add handler to IRQ list
-  for(i = 0; i8259_handlers[irq_num][i] != 0; ++i);
+  i = i8259_handler_count[irq_num];
+  if(i >= MAX_CHAIN) {
+	restore_flags(flags);
+	return;
+  }
   i8259_handlers[irq_num][i] = (uint32_t)handler;
+  i8259_handler_count[irq_num] = i + 1;
 
   // (2) write function to IDT
   install_irq(do_irq_table[irq_num], irq_num);
@@ -104,15 +118,30 @@ void register_interrupt_handler(uint32_t irq_num, void* handler) {
   restore_flags(flags);
 }
 
+/*
+ * remove_interrupt_handler
+ *	  DESCRIPTION: Removes a handler from an IRQ, masking the IRQ once it
+ *				   has none left
+ *	  INPUTS: irq_num -- IRQ the handler was registered for
+ *			  handler -- handler function
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Moves the last handler into the freed slot
+ */
 void remove_interrupt_handler(uint32_t irq_num, void* handler) {
-  uint32_t i;
+  uint32_t flags, i, n;
 
-  for(i = 0; i < MAX_CHAIN; ++i) {
-	if(i8259_handlers[irq_num][i]) i8259_handlers[irq_num][i] = 0;
-	return;
+  cli_and_save(flags);
+  n = i8259_handler_count[irq_num];
+  for(i = 0; i < n; ++i) {
+	if(i8259_handlers[irq_num][i] != (uint32_t)handler) continue;
+	i8259_handlers[irq_num][i] = i8259_handlers[irq_num][n - 1];
+	i8259_handlers[irq_num][n - 1] = 0;
+	i8259_handler_count[irq_num] = --n;
+	break;
   }
 
-  disable_irq(irq_num);
+  if(!n) disable_irq(irq_num);
+  restore_flags(flags);
 }
 
 
@@ -124,17 +153,19 @@ void remove_interrupt_handler(uint32_t irq_num, void* handler) {
  *	  SIDE EFFECTS: Unmasks IRQ at irq_num
  */
 void enable_irq(uint32_t irq_num) {
-  uint16_t port;
-  uint8_t value;
+  if(apic_enabled) {
+	apic_enable_irq(irq_num);
+	return;
+  }
 
   // Need to determine if IRQ is on master or slave
-  if(irq_num < PIC_SIZE) port = MASTER_8259_PORT+1;
-  else {
-	port = SLAVE_8259_PORT+1;
-	irq_num -= PIC_SIZE;
+  if(irq_num < PIC_SIZE) {
+	master_mask &= ~(1 << irq_num);
+	outb(master_mask, MASTER_8259_PORT+1);
+  } else if(irq_num < 2*PIC_SIZE) {
+	slave_mask &= ~(1 << (irq_num - PIC_SIZE));
+	outb(slave_mask, SLAVE_8259_PORT+1);
   }
-  value = inb(port) & ~(1 << irq_num); // Read current mask to avoid issues
-  outb(value, port);
 }
 
 /*
@@ -145,17 +176,19 @@ void enable_irq(uint32_t irq_num) {
  *	  SIDE EFFECTS: Masks IRQ at irq_num
  */
 void disable_irq(uint32_t irq_num) {
-  uint16_t port;
-  uint8_t value;
+  if(apic_enabled) {
+	apic_disable_irq(irq_num);
+	return;
+  }
 
   // Need to determine if IRQ is on master or slave
-  if(irq_num < PIC_SIZE) port = MASTER_8259_PORT+1;
-  else {
-	port = SLAVE_8259_PORT+1;
-	irq_num -= PIC_SIZE;
+  if(irq_num < PIC_SIZE) {
+	master_mask |= 1 << irq_num;
+	outb(master_mask, MASTER_8259_PORT+1);
+  } else if(irq_num < 2*PIC_SIZE) {
+	slave_mask |= 1 << (irq_num - PIC_SIZE);
+	outb(slave_mask, SLAVE_8259_PORT+1);
   }
-  value = inb(port) | (1 << irq_num); // Read current mask to avoid issues
-  outb(value, port);
 }
 
 /* i8259_mask_all
@@ -165,8 +198,10 @@ void disable_irq(uint32_t irq_num) {
  *	  SIDE EFFECTS: Masks all PIC interrupts
  */
 void i8259_mask_all() {
-  outb(0xFB, MASTER_8259_PORT+1); /* mask all IRQs, except slave connection */
-  outb(0xFF, SLAVE_8259_PORT+1);
+  master_mask = 0xFB; /* mask all IRQs, except slave connection */
+  slave_mask = 0xFF;
+  outb(master_mask, MASTER_8259_PORT+1);
+  outb(slave_mask, SLAVE_8259_PORT+1);
 }
 
 /*
@@ -177,6 +212,21 @@ void i8259_mask_all() {
  *	  SIDE EFFECTS: Device at irq_num recieves EOI
  */
 void send_eoi(uint32_t irq_num) {
+  if(apic_enabled) {
+	apic_eoi();
+	return;
+  }
+  i8259_eoi(irq_num);
+}
+
+/*
+ * i8259_eoi
+ *	  DESCRIPTION: Sends end-of-interrupt to the 8259s whatever controller is in use
+ *	  INPUTS: irq_num -- IRQ to recieve EOI
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Port writes to one or both PICs
+ */
+void i8259_eoi(uint32_t irq_num) {
   if(irq_num >= PIC_SIZE) outb(EOI, SLAVE_8259_PORT);
   outb(EOI, MASTER_8259_PORT);
 }
@@ -185,17 +235,29 @@ void send_eoi(uint32_t irq_num) {
  * do_irq
  *	  DESCRIPTION: Perform handler actions associated with given IRQ
  *	  INPUTS: irq_num -- IRQ who raised interrupt
+ *			  entry -- low half of the TSC do_irq_common stamped on entry
  *	  OUTPUTS: None
- *	  SIDE EFFECTS: Executes handlers
+ *	  SIDE EFFECTS: Executes handlers, times them and the EOI from entry
  */
-void do_irq(uint32_t irq_num) {
-  uint8_t i;
-
-  for(i = 0; i < MAX_CHAIN; ++i) {
-	if(!i8259_handlers[irq_num][i]) continue; // Don't execute null entries
-	((void(*)(void))(i8259_handlers[irq_num][i]))(); // Execute function at specified addr
+void do_irq(uint32_t irq_num, uint32_t entry) {
+  uint32_t* handlers = i8259_handlers[irq_num];
+  uint8_t i, n = i8259_handler_count[irq_num];
+  uint32_t dispatch, start, end;
+
+  // Interrupts were on to get here, so any cli_and_save window is over
+  irqoff_cancel();
+
+  // Most IRQs have one handler, so this is usually a single call
+  start = dispatch = (uint32_t) rdtsc();
+  for(i = 0; i < n; ++i) {
+	((void(*)(void))(handlers[i]))(); // Execute function at specified addr
+	end = (uint32_t) rdtsc();
+	irqstat_handler(irq_num, i, handlers[i], end - start);
+	start = end;
   }
 
   send_eoi(irq_num); // Send EOI
 
+  irqstat_irq(irq_num, dispatch - entry, (uint32_t) rdtsc() - entry);
+  tracepoint(TRACE_IRQ, irq_num, n, start - entry, 0);
 }
@@ -33,6 +33,9 @@
 /* Number of IRQs per PIC */
 #define PIC_SIZE			0x08
 
+/* IRQs with handlers: the 16 8259 lines and the local APIC timer (apic.h) */
+#define NUM_IRQS			(PIC_SIZE*2 + 1)
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
@@ -45,12 +48,17 @@ void remove_interrupt_handler(uint32_t irq_num, void* handler);
 void enable_irq(uint32_t irq_num);
 /* Disable (mask) the specified IRQ */
 void disable_irq(uint32_t irq_num);
-/* Send end-of-interrupt signal for the specified IRQ */
+/* Send end-of-interrupt signal for the specified IRQ, to whichever controller is in use */
 void send_eoi(uint32_t irq_num);
+/* Send end-of-interrupt to the 8259s themselves */
+void i8259_eoi(uint32_t irq_num);
 /* Mask all IRQs */
 void i8259_mask_all(void);
 
-/* call specified irq handler*/
-extern void do_irq(uint32_t irq_num) ; 
+/* Handlers registered per IRQ, see do_irq */
+extern uint8_t i8259_handler_count[NUM_IRQS];
+
+/* call specified irq handler, entry is the TSC stamp do_irq_common took */
+extern void do_irq(uint32_t irq_num, uint32_t entry) ; 
 
 #endif /* _I8259_H */
@@ -4,6 +4,7 @@
  */
 
 #include "lib.h"
+#include "klog.h"
 #include "x86_desc.h"
 #include "idt.h"
 #include "syscalls/syscalls.h"
@@ -11,6 +12,14 @@
 
 uint32_t exception_handlers[22];
 
+/* Stack sysenter lands on, only used until the handler loads tss.esp0 */
+#define SYSENTER_STACK_WORDS 64
+static uint32_t sysenter_stack[SYSENTER_STACK_WORDS];
+
+uint8_t sysenter_enabled = 0;
+
+static void sysenter_init(void);
+
 static void divide_by_zero_handler(hw_context_t* context);
 static void single_step_handler(hw_context_t* context);
 static void nmi_handler(hw_context_t* context);
@@ -146,7 +155,40 @@ void idt_init() {
 
   // 0x80 Syscalls
   SET_IDT_ENTRY(idt[0x80], &syscall_handler);
-  
+
+  // 0x81 Process switches from inside the kernel, not callable by users
+  SET_IDT_ENTRY(idt[YIELD_VECTOR], &yield_handler);
+  idt[YIELD_VECTOR].present = 0x01;
+
+  // Fast syscalls through sysenter
+  sysenter_init();
+}
+
+/*
+ * sysenter_init
+ *    DESCRIPTION: Points the sysenter MSRs at sysenter_handler, so user
+ *                 programs can make syscalls without going through the IDT.
+ *                 sysexit derives the user segments from the kernel ones
+ *                 (KERNEL_CS + 16 and + 24), which is how the GDT is laid out
+ *    INPUTS: None
+ *    OUTPUTS: None
+ *    SIDE EFFECTS: Writes MSRs. Without sysenter sysenter_enabled stays 0,
+ *                  which the user stubs see on the time page and use
+ *                  int $0x80 instead
+ */
+static void sysenter_init(void) {
+  uint32_t regs[4];
+
+  cpuid(CPUID_FEATURES, regs);
+  if(!(regs[3] & CPUID_EDX_SEP)) {
+    klog(KLOG_WARN, "sysenter not supported, syscalls use int $0x80\n");
+    return;
+  }
+
+  wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+  wrmsr(MSR_SYSENTER_ESP, (uint32_t) &sysenter_stack[SYSENTER_STACK_WORDS]);
+  wrmsr(MSR_SYSENTER_EIP, (uint32_t) &sysenter_handler);
+  sysenter_enabled = 1;
 }
 
 /* install_irq
@@ -17,4 +17,26 @@ void install_irq(void* handler, int irq_num);
 
 extern uint32_t exception_handlers[22];
 
+/* Model specific registers sysenter loads CS, ESP and EIP from */
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+/* CPUID leaf 1 EDX bit for sysenter/sysexit */
+#define CPUID_FEATURES 1
+#define CPUID_EDX_SEP (1 << 11)
+
+/* Kernel-only vector yield_to uses to switch processes, see tasks.c */
+#define YIELD_VECTOR 0x81
+
+/* Its entry, defined in irq.S */
+extern void yield_handler();
+
+/* Fast syscall entry, defined in syscalls/syscalls.S */
+extern void sysenter_handler();
+
+/* 1 once sysenter_init has set up the MSRs, published to user programs
+ * through the time page */
+extern uint8_t sysenter_enabled;
+
 #endif /* IDT_H */
@@ -0,0 +1,230 @@
+/* irqstat.c - Times interrupt dispatch, each handler and the EOI, and the
+ *				windows code spends with interrupts off
+ * vim:ts=4 noexpandtab
+ */
+
+#include "irqstat.h"
+#include "lib.h"
+#include "filesystem/devfs.h"
+#include "filesystem/filesystem.h"	/* For fd_table */
+
+/* Longest command written to "dev/irqstat" */
+#define IRQSTAT_CMD_LEN 8
+
+#ifdef IRQOFF_TIMING
+/* Open interrupts-off window, see cli_and_save in lib.h */
+volatile uint32_t irqoff_site;
+static uint32_t irqoff_start;
+#endif
+
+static irqstat_stats_t stats;
+
+static int32_t irqstat_open(const uint8_t* filename);
+static int32_t irqstat_close(int32_t fd);
+static int32_t irqstat_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t irqstat_write(int32_t fd, const void* buf, int32_t nbytes);
+
+static file_ops_t file_ops_irqstat = {irqstat_read, irqstat_write, irqstat_open, irqstat_close};
+
+/*
+ * irqstat_init
+ *	  DESCRIPTION: Adds "dev/irqstat"
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void irqstat_init(void) {
+	devfs_register((const uint8_t*)"irqstat", &file_ops_irqstat);
+}
+
+/*
+ * irqstat_bucket
+ *	  DESCRIPTION: Finds the histogram bucket of a latency
+ *	  INPUTS: cycles -- latency
+ *	  OUTPUTS: index of the highest set bit, 0 for 0
+ *	  SIDE EFFECTS: None
+ */
+static uint32_t irqstat_bucket(uint32_t cycles) {
+	uint32_t b;
+
+	if(!cycles) return 0;
+	asm ("bsrl %1, %0" : "=r"(b) : "rm"(cycles));
+	return b;
+}
+
+/*
+ * irqstat_handler
+ *	  DESCRIPTION: Adds one call of a chained handler
+ *	  INPUTS: irq_num -- IRQ
+ *			  slot -- handler's place in the chain
+ *			  handler -- its address
+ *			  cycles -- how long it ran
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None, called with interrupts off
+ */
+void irqstat_handler(uint32_t irq_num, uint32_t slot, uint32_t handler, uint32_t cycles) {
+	irqstat_line_t* l = &stats.irq[irq_num];
+
+	l->handler[slot] = handler;
+	l->handler_cycles[slot] += cycles;
+	if(cycles > l->handler_max[slot]) l->handler_max[slot] = cycles;
+}
+
+/*
+ * irqstat_irq
+ *	  DESCRIPTION: Adds one interrupt on a line
+ *	  INPUTS: irq_num -- IRQ
+ *			  dispatch -- cycles from the stub to the first handler
+ *			  eoi -- cycles from the stub to the EOI
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None, called with interrupts off
+ */
+void irqstat_irq(uint32_t irq_num, uint32_t dispatch, uint32_t eoi) {
+	irqstat_line_t* l = &stats.irq[irq_num];
+	uint32_t lo = l->cycles_lo;
+
+	l->count++;
+	if(dispatch > l->dispatch_max) l->dispatch_max = dispatch;
+	if(eoi > l->eoi_max) l->eoi_max = eoi;
+	l->cycles_lo += eoi;
+	if(l->cycles_lo < lo) l->cycles_hi++;
+	l->buckets[irqstat_bucket(eoi)]++;
+}
+
+#ifdef IRQOFF_TIMING
+/*
+ * irqoff_begin
+ *	  DESCRIPTION: Called by cli_and_save when it turned interrupts off.
+ *				   Can't use cli_and_save itself
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Opens a window at the caller's address
+ */
+void irqoff_begin(void) {
+	irqoff_start = (uint32_t) rdtsc();
+	irqoff_site = (uint32_t) __builtin_return_address(0);
+}
+
+/*
+ * irqoff_end
+ *	  DESCRIPTION: Called by restore_flags when it is about to turn
+ *				   interrupts back on. Keeps the window if it is among the
+ *				   longest, replacing a shorter one from the same site
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Closes the window
+ */
+void irqoff_end(void) {
+	uint32_t site = irqoff_site, cycles, slot, i;
+
+	if(!site) return; /* opened by a bare cli(), or cancelled by sti() */
+	irqoff_site = 0;
+	cycles = (uint32_t) rdtsc() - irqoff_start;
+	stats.windows++;
+
+	if(cycles <= stats.longest[IRQSTAT_WINDOWS - 1].cycles) return;
+
+	/* Drop the site's previous entry, or the shortest, then insert in order */
+	for(slot = 0; slot < IRQSTAT_WINDOWS - 1 && stats.longest[slot].cli_site != site; ++slot) continue;
+	if(stats.longest[slot].cli_site == site && stats.longest[slot].cycles >= cycles) return;
+	for(i = slot; i > 0 && stats.longest[i - 1].cycles < cycles; --i) stats.longest[i] = stats.longest[i - 1];
+
+	stats.longest[i].cycles = cycles;
+	stats.longest[i].cli_site = site;
+	stats.longest[i].restore_site = (uint32_t) __builtin_return_address(0);
+}
+#endif /* IRQOFF_TIMING */
+
+/*
+ * irqstat_clear
+ *	  DESCRIPTION: Zeroes the counters, histograms and windows
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void irqstat_clear(void) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	memset(&stats, 0, sizeof(stats));
+	restore_flags(flags);
+}
+
+/*
+ * irqstat_get_stats
+ *	  DESCRIPTION: Copies out the statistics
+ *	  INPUTS: out -- filled in
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void irqstat_get_stats(irqstat_stats_t* out) {
+	memcpy(out, &stats, sizeof(stats));
+}
+
+/*
+ * irqstat_open
+ *	  DESCRIPTION: open for "dev/irqstat"
+ *	  INPUTS: filename -- the fd, as for the rtc
+ *	  OUTPUTS: 0
+ *	  SIDE EFFECTS: Starts reading at the beginning
+ */
+static int32_t irqstat_open(const uint8_t* filename) {
+	fd_table[(int32_t) filename].file_pos = 0;
+	return 0;
+}
+
+/*
+ * irqstat_close
+ *	  DESCRIPTION: close for "dev/irqstat"
+ *	  INPUTS: fd -- file descriptor
+ *	  OUTPUTS: 0
+ *	  SIDE EFFECTS: None
+ */
+static int32_t irqstat_close(int32_t fd) {
+	return 0;
+}
+
+/*
+ * irqstat_read
+ *	  DESCRIPTION: Reads part of an irqstat_stats_t from the file position on.
+ *				   Copied with interrupts on so the reader doesn't show up
+ *				   among the longest windows, so a line may be mid-update
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- filled in
+ *			  nbytes -- size of buf
+ *	  OUTPUTS: bytes read, 0 at the end, -1 for a bad buffer
+ *	  SIDE EFFECTS: Moves the file position
+ */
+static int32_t irqstat_read(int32_t fd, void* buf, int32_t nbytes) {
+	uint32_t pos = fd_table[fd].file_pos;
+
+	if(!buf || nbytes < 0) return -1;
+	if(pos >= sizeof(stats)) return 0;
+	if((uint32_t) nbytes > sizeof(stats) - pos) nbytes = sizeof(stats) - pos;
+
+	memcpy(buf, (uint8_t*) &stats + pos, nbytes);
+	fd_table[fd].file_pos += nbytes;
+	return nbytes;
+}
+
+/*
+ * irqstat_write
+ *	  DESCRIPTION: Writing "clear" zeroes the statistics, so a benchmark can
+ *				   measure just itself
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- command
+ *			  nbytes -- its length
+ *	  OUTPUTS: nbytes, -1 for an unknown command
+ *	  SIDE EFFECTS: None
+ */
+static int32_t irqstat_write(int32_t fd, const void* buf, int32_t nbytes) {
+	int8_t cmd[IRQSTAT_CMD_LEN];
+
+	if(!buf || nbytes <= 0 || nbytes >= IRQSTAT_CMD_LEN) return -1;
+	memcpy(cmd, buf, nbytes);
+	cmd[nbytes] = '\0';
+
+	if(strncmp(cmd, "clear", 5)) return -1;
+	irqstat_clear();
+	return nbytes;
+}
@@ -0,0 +1,61 @@
+/* irqstat.h - Defines interrupt instrumentation: per-IRQ counts and
+ * latency histograms, per-handler durations and the longest windows with
+ * interrupts off, read through "dev/irqstat"
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IRQSTAT_H
+#define _IRQSTAT_H
+
+#include "types.h"
+#include "i8259.h"
+
+/* Bucket b counts interrupts that took 2^b to 2^(b+1) - 1 cycles */
+#define IRQSTAT_HIST_BUCKETS 32
+
+/* Longest interrupts-off windows kept, at most one per cli_and_save site */
+#define IRQSTAT_WINDOWS 8
+
+/* One IRQ line. Times are TSC cycles from the stub in irq.S */
+typedef struct irqstat_line {
+	uint32_t count;
+	uint32_t dispatch_max;			/* entry to the first handler */
+	uint32_t eoi_max;				/* entry to the EOI being sent */
+	uint32_t cycles_lo;				/* entry to EOI, total */
+	uint32_t cycles_hi;
+	uint32_t buckets[IRQSTAT_HIST_BUCKETS];	/* entry to EOI */
+	uint32_t handler[MAX_CHAIN];	/* address of each chained handler */
+	uint32_t handler_cycles[MAX_CHAIN];	/* total per handler, wraps */
+	uint32_t handler_max[MAX_CHAIN];
+} irqstat_line_t;
+
+/* cli_and_save to the restore_flags that turned interrupts back on. Only
+ * measured in kernels built with -DIRQOFF_TIMING */
+typedef struct irqstat_window {
+	uint32_t cycles;
+	uint32_t cli_site;				/* return address of the cli_and_save call */
+	uint32_t restore_site;			/* and of the restore_flags */
+	uint32_t reserved;
+} irqstat_window_t;
+
+/* Contents of "dev/irqstat" */
+typedef struct irqstat_stats {
+	uint32_t windows;				/* interrupts-off windows measured */
+	uint32_t reserved[3];
+	irqstat_window_t longest[IRQSTAT_WINDOWS];	/* longest first */
+	irqstat_line_t irq[NUM_IRQS];
+} irqstat_stats_t;
+
+/* Registers the device file */
+void irqstat_init(void);
+
+/* Called by do_irq with cycles since its entry stamp from do_irq_common */
+void irqstat_handler(uint32_t irq_num, uint32_t slot, uint32_t handler, uint32_t cycles);
+void irqstat_irq(uint32_t irq_num, uint32_t dispatch, uint32_t eoi);
+
+/* Zeroes everything */
+void irqstat_clear(void);
+
+void irqstat_get_stats(irqstat_stats_t* out);
+
+#endif /* _IRQSTAT_H */
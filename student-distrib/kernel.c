@@ -6,6 +6,11 @@
 #include "x86_desc.h"
 #include "lib.h"
 #include "i8259.h"
+#include "apic.h"
+#include "irqstat.h"
+#include "profile.h"
+#include "trace.h"
+#include "klog.h"
 #include "debug.h"
 #include "tests.h"
 #include "tty.h"
@@ -13,12 +18,19 @@
 #include "idt.h"
 #include "devices/devices.h"
 #include "filesystem/filesystem.h"
+#include "filesystem/lz4.h"
+#include "filesystem/overlay.h"
 #include "syscalls/syscalls.h"
 #include "loader.h"
 #include "tasks/scheduling.h"
 #include "devices/pci.h"
 #include "networking/networking.h"
 #include "devices/e1000.h"
+#include "devices/ata.h"
+#include "devices/virtio_blk.h"
+#include "devices/time_page.h"
+#include "devices/uart.h"
+#include "syscalls/strace.h"
 #include "networking/http.h"
 
 #define RUN_TESTS
@@ -36,16 +48,22 @@ static void test_rtc(uint32_t n) {
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
+    block_dev_t* fs_device;
+    uint32_t fs_mod_start = 0, fs_mod_end = 0;
 
     /* Init the terminal */
     tty_init();
 
+    /* Boot messages go to the log, written out once interrupts are on */
+    klog_init();
+
     /* Clear the screen. */
     clear();
 
     /* Am I booted by a Multiboot-compliant boot loader? */
     if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
-        printf("Invalid magic number: 0x%#x\n", (unsigned)magic);
+        klog(KLOG_ERR, "Invalid magic number: 0x%#x\n", (unsigned)magic);
+        klog_flush();
         return;
     }
 
@@ -53,47 +71,53 @@ void entry(unsigned long magic, unsigned long addr) {
     mbi = (multiboot_info_t *) addr;
 
     /* Print out the flags. */
-    printf("flags = 0x%#x\n", (unsigned)mbi->flags);
+    klog(KLOG_INFO, "flags = 0x%#x\n", (unsigned)mbi->flags);
 
     /* Are mem_* valid? */
     if (CHECK_FLAG(mbi->flags, 0))
-        printf("mem_lower = %uKB, mem_upper = %uKB\n", (unsigned)mbi->mem_lower, (unsigned)mbi->mem_upper);
+        klog(KLOG_INFO, "mem_lower = %uKB, mem_upper = %uKB\n", (unsigned)mbi->mem_lower, (unsigned)mbi->mem_upper);
 
     /* Is boot_device valid? */
     if (CHECK_FLAG(mbi->flags, 1))
-        printf("boot_device = 0x%#x\n", (unsigned)mbi->boot_device);
+        klog(KLOG_INFO, "boot_device = 0x%#x\n", (unsigned)mbi->boot_device);
 
     /* Is the command line passed? */
     if (CHECK_FLAG(mbi->flags, 2))
-        printf("cmdline = %s\n", (char *)mbi->cmdline);
+        klog(KLOG_INFO, "cmdline = %s\n", (char *)mbi->cmdline);
 
     if (CHECK_FLAG(mbi->flags, 3)) {
         int mod_count = 0;
-        int i;
+        int i, len;
+        int8_t bytes[5 * 16 + 1];
         module_t* mod = (module_t*)mbi->mods_addr;
         while (mod_count < mbi->mods_count) {
-            printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
-			filesystem_init((unsigned int)mod->mod_start);
-            printf("Module %d ends at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_end);
-            printf("First few bytes of module:\n");
-            for (i = 0; i < 16; i++) {
-                printf("0x%x ", *((char*)(mod->mod_start+i)));
+            klog(KLOG_INFO, "Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
+			/* Fall back to the filesystem image module if there is no disk */
+			if (!fs_mod_start) {
+				fs_mod_start = mod->mod_start;
+				fs_mod_end = mod->mod_end;
+			}
+            klog(KLOG_INFO, "Module %d ends at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_end);
+            /* One message rather than one per byte */
+            for (i = 0, len = 0; i < 16; i++) {
+                len += snprintf(bytes + len, sizeof(bytes) - len, "0x%x ", *((uint8_t*)(mod->mod_start+i)));
             }
-            printf("\n");
+            klog(KLOG_DEBUG, "First few bytes of module: %s\n", bytes);
             mod_count++;
             mod++;
         }
     }
     /* Bits 4 and 5 are mutually exclusive! */
     if (CHECK_FLAG(mbi->flags, 4) && CHECK_FLAG(mbi->flags, 5)) {
-        printf("Both bits 4 and 5 are set.\n");
+        klog(KLOG_ERR, "Both bits 4 and 5 are set.\n");
+        klog_flush();
         return;
     }
 
     /* Is the section header table of ELF valid? */
     if (CHECK_FLAG(mbi->flags, 5)) {
         elf_section_header_table_t *elf_sec = &(mbi->elf_sec);
-        printf("elf_sec: num = %u, size = 0x%#x, addr = 0x%#x, shndx = 0x%#x\n",
+        klog(KLOG_DEBUG, "elf_sec: num = %u, size = 0x%#x, addr = 0x%#x, shndx = 0x%#x\n",
                 (unsigned)elf_sec->num, (unsigned)elf_sec->size,
                 (unsigned)elf_sec->addr, (unsigned)elf_sec->shndx);
     }
@@ -101,18 +125,20 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Are mmap_* valid? */
     if (CHECK_FLAG(mbi->flags, 6)) {
         memory_map_t *mmap;
-        printf("mmap_addr = 0x%#x, mmap_length = 0x%x\n",
+        klog(KLOG_DEBUG, "mmap_addr = 0x%#x, mmap_length = 0x%x\n",
                 (unsigned)mbi->mmap_addr, (unsigned)mbi->mmap_length);
         for (mmap = (memory_map_t *)mbi->mmap_addr;
                 (unsigned long)mmap < mbi->mmap_addr + mbi->mmap_length;
-                mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size)))
-            printf("    size = 0x%x, base_addr = 0x%#x%#x\n    type = 0x%x,  length    = 0x%#x%#x\n",
+                mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size))) {
+            klog(KLOG_DEBUG, "    size = 0x%x, base_addr = 0x%#x%#x\n",
                     (unsigned)mmap->size,
                     (unsigned)mmap->base_addr_high,
-                    (unsigned)mmap->base_addr_low,
+                    (unsigned)mmap->base_addr_low);
+            klog(KLOG_DEBUG, "    type = 0x%x,  length    = 0x%#x%#x\n",
                     (unsigned)mmap->type,
                     (unsigned)mmap->length_high,
                     (unsigned)mmap->length_low);
+        }
     }
 
     /* Construct an LDT entry in the GDT */
@@ -166,12 +192,34 @@ void entry(unsigned long magic, unsigned long addr) {
     i8259_init();
 	i8259_mask_all();
 
+	/* Move interrupts to the APICs if there are any, the 8259 stays otherwise */
+	if (apic_init() == 0) klog(KLOG_INFO, "Interrupts through the I/O APIC\n");
+	else klog(KLOG_INFO, "Interrupts through the 8259\n");
+
 	/* Init devices */
 	keyboard_init();
+	uart_init();
 	rtc_init();
+	time_page_init();
+	strace_init();
+	irqstat_init();
+	profile_init();
+	trace_init();
+
+	/* Mount the filesystem from a disk partition if there is one */
+	fs_device = virtio_blk_init();
+	if (!fs_device) fs_device = ata_init();
+	if (!fs_device && fs_mod_start) {
+		/* Otherwise use the module, kept pristine under an overlay so the
+			filesystem can be reset without a reboot */
+		fs_device = lz4disk_init(fs_mod_start, fs_mod_end);
+		if (!fs_device) fs_device = ramdisk_init(fs_mod_start, fs_mod_end);
+		fs_device = overlay_init(fs_device);
+	}
+	if (!fs_device || filesystem_init(fs_device)) klog(KLOG_ERR, "No filesystem!\n");
 
 	/* Set up STDIN/STDOUT for kernel */
-    setup_fdtable(fd_table);
+    setup_fdtable(&kernel_fds);
 
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
@@ -182,7 +230,7 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Do not enable the following until after you have set up your
      * IDT correctly otherwise QEMU will triple fault and simple close
      * without showing you any output */
-    printf("Enabling Interrupts\n");
+    klog(KLOG_INFO, "Enabling Interrupts\n");
 	sti();
 
 	dhcp_init(); // must be run with interrupts enabled
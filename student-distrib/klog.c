@@ -0,0 +1,375 @@
+/* klog.c - Kernel log ring. Writers claim a slot with one locked add and
+ *				mark it complete last, as trace.c does, so logging never
+ *				waits on the console; a tasklet copies new records out
+ * vim:ts=4 noexpandtab
+ */
+
+#include "klog.h"
+#include "lib.h"
+#include "tty.h"
+#include "softirq.h"
+#include "devices/uart.h"
+#include "filesystem/devfs.h"
+#include "filesystem/filesystem.h"	/* For fd_table */
+
+/* Longest command written to "dev/dmesg" */
+#define KLOG_CMD_LEN 16
+
+/* Longest formatted line: "<L>[sssss.mmm] " and the text */
+#define KLOG_LINE_LEN (KLOG_TEXT_LEN + 20)
+
+/* Records the tasklet writes out before letting other work run */
+#define KLOG_DRAIN_BATCH 8
+
+volatile uint32_t klog_console_level = KLOG_INFO;
+
+/* Not static, so a debugger can dump it after a crash */
+klog_record_t klog_ring[KLOG_RING_ENTRIES];
+static volatile uint32_t klog_tail = 0;		/* records ever claimed */
+static volatile uint32_t klog_start = 0;	/* position of the oldest record not cleared */
+static uint32_t klog_drained = 0;			/* position of the next record to write out */
+static volatile uint32_t klog_suppressed = 0;
+static uint32_t klog_lost = 0;
+
+static tasklet_t klog_tasklet;
+
+static void klog_drain_tasklet(uint32_t arg);
+static int32_t klog_open(const uint8_t* filename);
+static int32_t klog_close(int32_t fd);
+static int32_t klog_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t klog_write(int32_t fd, const void* buf, int32_t nbytes);
+
+static file_ops_t file_ops_dmesg = {klog_read, klog_write, klog_open, klog_close};
+
+/*
+ * klog_init
+ *	  DESCRIPTION: Adds "dev/dmesg"
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void klog_init(void) {
+	tasklet_init(&klog_tasklet, klog_drain_tasklet, 0);
+	devfs_register((const uint8_t*)"dmesg", &file_ops_dmesg);
+}
+
+/*
+ * klog
+ *	  DESCRIPTION: Claims the next slot, formats the message into it and
+ *				   has the tasklet write it out. An interrupt during this
+ *				   claims the slot after, so messages from nested contexts
+ *				   may be written out of order but never mixed
+ *	  INPUTS: level -- KLOG_*
+ *			  format -- printf format string, followed by its arguments
+ *	  OUTPUTS: characters kept, -1 for a bad level
+ *	  SIDE EFFECTS: Overwrites the oldest record once the ring is full
+ */
+int32_t klog(uint32_t level, int8_t* format, ...) {
+	klog_record_t* r;
+	uint32_t pos, len;
+
+	if(level >= KLOG_NUM_LEVELS) return -1;
+
+	pos = __sync_fetch_and_add(&klog_tail, 1);
+	r = &klog_ring[pos % KLOG_RING_ENTRIES];
+	r->seq = 0;
+	asm volatile ("" : : : "memory");
+
+	len = vsnprintf(r->text, KLOG_TEXT_LEN, format, (int32_t*) &format + 1);
+	if(len && r->text[len - 1] == '\n') r->text[--len] = '\0';
+	r->len = len;
+	r->level = level;
+	r->ticks = time_page_get()->ticks;
+
+	asm volatile ("" : : : "memory");
+	r->seq = pos + 1;
+
+	tasklet_schedule(&klog_tasklet);
+	return len;
+}
+
+/*
+ * klog_ratelimit
+ *	  DESCRIPTION: Lets KLOG_RATELIMIT_BURST messages through per
+ *				   KLOG_RATELIMIT_TICKS and counts the rest
+ *	  INPUTS: rs -- the call site's state, zeroed to start
+ *	  OUTPUTS: 1 to log the message, 0 to drop it
+ *	  SIDE EFFECTS: Logs how many were dropped when an interval ends
+ */
+uint32_t klog_ratelimit(klog_ratelimit_t* rs) {
+	uint32_t now = time_page_get()->ticks, missed = 0, ok, flags;
+
+	cli_and_save(flags);
+	if(!rs->printed && !rs->missed) rs->start = now;
+	if(now - rs->start >= KLOG_RATELIMIT_TICKS) {
+		missed = rs->missed;
+		rs->start = now;
+		rs->printed = rs->missed = 0;
+	}
+	ok = (rs->printed < KLOG_RATELIMIT_BURST);
+	if(ok) {
+		rs->printed++;
+	} else {
+		rs->missed++;
+		klog_suppressed++;
+	}
+	restore_flags(flags);
+
+	if(missed) klog(KLOG_WARN, "%u messages suppressed\n", missed);
+	return ok;
+}
+
+/*
+ * klog_format
+ *	  DESCRIPTION: Makes a record into a "dev/dmesg" line,
+ *				   "<level>[seconds.milliseconds] text\n"
+ *	  INPUTS: r -- record
+ *			  line -- filled in, KLOG_LINE_LEN bytes
+ *	  OUTPUTS: length of the line
+ *	  SIDE EFFECTS: None
+ */
+static uint32_t klog_format(const klog_record_t* r, int8_t* line) {
+	uint32_t ms = ((r->ticks % TIME_PAGE_HZ) * 1000) / TIME_PAGE_HZ;
+
+	return snprintf(line, KLOG_LINE_LEN, "<%u>[%u.%s%u] %s\n", r->level, r->ticks / TIME_PAGE_HZ,
+			ms < 10 ? "00" : ms < 100 ? "0" : "", ms, r->text);
+}
+
+/*
+ * klog_lost_note
+ *	  DESCRIPTION: Says on the console that records were overwritten
+ *				   before they could be written out
+ *	  INPUTS: n -- records lost
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+static void klog_lost_note(uint32_t n) {
+	int8_t line[KLOG_LINE_LEN];
+
+	klog_lost += n;
+	snprintf(line, KLOG_LINE_LEN, "klog: %u messages lost\n", n);
+	tty_puts(line);
+}
+
+/*
+ * klog_drain
+ *	  DESCRIPTION: Writes records not yet written out to the console if at
+ *				   klog_console_level or more urgent, which the serial
+ *				   console echoes, and as "dev/dmesg" lines to the serial
+ *				   port otherwise. Stops at a record still being written,
+ *				   whose writer schedules the tasklet again once it is done
+ *	  INPUTS: max -- records to write at most
+ *	  OUTPUTS: 1 if more are ready
+ *	  SIDE EFFECTS: None
+ */
+static uint32_t klog_drain(uint32_t max) {
+	klog_record_t r;
+	volatile klog_record_t* slot;
+	int8_t line[KLOG_LINE_LEN];
+	uint32_t tail, i;
+
+	for(i = 0; i < max; ++i) {
+		tail = klog_tail;
+		if(klog_drained == tail) return 0;
+		if(tail - klog_drained > KLOG_RING_ENTRIES) {
+			klog_lost_note(tail - KLOG_RING_ENTRIES - klog_drained);
+			klog_drained = tail - KLOG_RING_ENTRIES;
+		}
+
+		slot = &klog_ring[klog_drained % KLOG_RING_ENTRIES];
+		if((int32_t) (slot->seq - (klog_drained + 1)) < 0) return 0;
+		r = *(klog_record_t*) slot;
+		asm volatile ("" : : : "memory");
+		if(slot->seq != klog_drained + 1 || r.seq != klog_drained + 1) {
+			/* Overwritten, by now or during the copy */
+			klog_lost_note(1);
+			klog_drained++;
+			continue;
+		}
+		klog_drained++;
+
+		if(r.level <= klog_console_level) {
+			tty_puts(r.text);
+			tty_puts("\n");
+		} else {
+			klog_format(&r, line);
+			uart_puts(line);
+		}
+	}
+	return klog_drained != klog_tail;
+}
+
+/*
+ * klog_drain_tasklet
+ *	  DESCRIPTION: Writes out a batch of records, coming back for the rest
+ *				   so a burst of messages doesn't hold up other softirqs
+ *	  INPUTS: arg -- unused
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Reschedules itself
+ */
+static void klog_drain_tasklet(uint32_t arg) {
+	if(klog_drain(KLOG_DRAIN_BATCH)) tasklet_schedule(&klog_tasklet);
+}
+
+/*
+ * klog_flush
+ *	  DESCRIPTION: Writes out everything now, for a dying kernel or a
+ *				   caller that needs its messages seen before going on
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void klog_flush(void) {
+	while(klog_drain(KLOG_RING_ENTRIES));
+}
+
+/*
+ * klog_copy
+ *	  DESCRIPTION: Copies records from *pos on. Each is checked to still
+ *				   hold the same position after the copy, so one being
+ *				   written or overwritten meanwhile is skipped
+ *	  INPUTS: out -- filled in
+ *			  n -- entries in out
+ *			  pos -- position to start at, moved past what was copied
+ *	  OUTPUTS: records copied
+ *	  SIDE EFFECTS: None
+ */
+uint32_t klog_copy(klog_record_t* out, uint32_t n, uint32_t* pos) {
+	uint32_t tail = klog_tail, i = 0;
+	volatile klog_record_t* r;
+
+	if((int32_t) (klog_start - *pos) > 0) *pos = klog_start;
+	if(tail - *pos > KLOG_RING_ENTRIES) *pos = tail - KLOG_RING_ENTRIES;
+
+	for(; *pos != tail && i < n; ++*pos) {
+		r = &klog_ring[*pos % KLOG_RING_ENTRIES];
+		if(r->seq != *pos + 1) continue;
+		out[i] = *(klog_record_t*) r;
+		asm volatile ("" : : : "memory");
+		if(r->seq == *pos + 1 && out[i].seq == *pos + 1) i++;
+	}
+	return i;
+}
+
+/*
+ * klog_position
+ *	  DESCRIPTION: Reports how far the log has got
+ *	  INPUTS: None
+ *	  OUTPUTS: records claimed since boot
+ *	  SIDE EFFECTS: None
+ */
+uint32_t klog_position(void) {
+	return klog_tail;
+}
+
+/*
+ * klog_clear
+ *	  DESCRIPTION: Makes readers start after every record written so far
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None, records not yet written out still are
+ */
+void klog_clear(void) {
+	klog_start = klog_tail;
+}
+
+/*
+ * klog_get_stats
+ *	  DESCRIPTION: Copies out the counts
+ *	  INPUTS: out -- filled in
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void klog_get_stats(klog_stats_t* out) {
+	out->logged = klog_tail;
+	out->drained = klog_drained;
+	out->lost = klog_lost;
+	out->suppressed = klog_suppressed;
+	out->console_level = klog_console_level;
+}
+
+/*
+ * klog_open
+ *	  DESCRIPTION: open for "dev/dmesg"
+ *	  INPUTS: filename -- the fd, as for the rtc
+ *	  OUTPUTS: 0
+ *	  SIDE EFFECTS: Starts reading at the oldest record kept
+ */
+static int32_t klog_open(const uint8_t* filename) {
+	fd_table[(int32_t) filename].file_pos = klog_start;
+	return 0;
+}
+
+/*
+ * klog_close
+ *	  DESCRIPTION: close for "dev/dmesg"
+ *	  INPUTS: fd -- file descriptor
+ *	  OUTPUTS: 0
+ *	  SIDE EFFECTS: None
+ */
+static int32_t klog_close(int32_t fd) {
+	return 0;
+}
+
+/*
+ * klog_read
+ *	  DESCRIPTION: Reads whole lines from the file position on, as many as
+ *				   fit. Records stay in the ring, so any number of readers
+ *				   each see all of them
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- filled in
+ *			  nbytes -- size of buf
+ *	  OUTPUTS: bytes read, 0 once the reader has caught up, -1 for a bad
+ *			   buffer or one too small for the next line
+ *	  SIDE EFFECTS: Moves the file position, a record position
+ */
+static int32_t klog_read(int32_t fd, void* buf, int32_t nbytes) {
+	klog_record_t r;
+	int8_t line[KLOG_LINE_LEN];
+	uint32_t pos, len;
+	int32_t done = 0;
+
+	if(!buf || nbytes < 0) return -1;
+	while(1) {
+		pos = fd_table[fd].file_pos;
+		if(!klog_copy(&r, 1, &pos)) break;
+		len = klog_format(&r, line);
+		if(len > (uint32_t) (nbytes - done)) {
+			if(!done) return -1;
+			break;
+		}
+		memcpy((int8_t*) buf + done, line, len);
+		done += len;
+		fd_table[fd].file_pos = pos;
+	}
+	return done;
+}
+
+/*
+ * klog_write
+ *	  DESCRIPTION: "console N" sends levels up to N to the console and
+ *				   "clear" drops what has been logged
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- command
+ *			  nbytes -- its length
+ *	  OUTPUTS: nbytes, -1 for an unknown command or level
+ *	  SIDE EFFECTS: None
+ */
+static int32_t klog_write(int32_t fd, const void* buf, int32_t nbytes) {
+	int8_t cmd[KLOG_CMD_LEN];
+	int level = 0;
+
+	if(!buf || nbytes <= 0 || nbytes >= KLOG_CMD_LEN) return -1;
+	memcpy(cmd, buf, nbytes);
+	cmd[nbytes] = '\0';
+
+	if(!strncmp(cmd, "console ", 8) && atoi(cmd + 8, &level)) {
+		if(level >= KLOG_NUM_LEVELS) return -1;
+		klog_console_level = level;
+	} else if(!strncmp(cmd, "clear", 5)) {
+		klog_clear();
+	} else {
+		return -1;
+	}
+	return nbytes;
+}
@@ -0,0 +1,91 @@
+/* klog.h - Defines the kernel log: messages with a level and a timestamp
+ * written to a ring without waiting on the console, then copied to the
+ * console and serial port by a tasklet, and read back through "dev/dmesg"
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _KLOG_H
+#define _KLOG_H
+
+#include "types.h"
+#include "devices/time_page.h"
+
+/* Levels, most urgent first */
+#define KLOG_ERR 0
+#define KLOG_WARN 1
+#define KLOG_INFO 2
+#define KLOG_DEBUG 3
+#define KLOG_NUM_LEVELS 4
+
+/* Records the ring holds, a power of two; the oldest are overwritten */
+#define KLOG_RING_ENTRIES 256
+
+/* Longest message kept, including the NUL; the rest is cut off */
+#define KLOG_TEXT_LEN 116
+
+/* Messages a klog_ratelimited site may log per KLOG_RATELIMIT_TICKS */
+#define KLOG_RATELIMIT_BURST 10
+#define KLOG_RATELIMIT_TICKS (5 * TIME_PAGE_HZ)
+
+/* One message. 128 bytes */
+typedef struct klog_record {
+	uint32_t seq;				/* position in the log + 1, 0 while being written */
+	uint32_t ticks;				/* time page ticks when it was logged */
+	uint16_t level;				/* KLOG_* */
+	uint16_t len;				/* characters in text */
+	int8_t text[KLOG_TEXT_LEN];	/* NUL terminated, without the newline */
+} klog_record_t;
+
+/* State of one rate limited call site */
+typedef struct klog_ratelimit {
+	uint32_t start;				/* tick the interval began */
+	uint32_t printed;			/* messages let through in it */
+	uint32_t missed;			/* messages held back in it */
+} klog_ratelimit_t;
+
+typedef struct klog_stats {
+	uint32_t logged;			/* records written since boot */
+	uint32_t drained;			/* records the tasklet has handled */
+	uint32_t lost;				/* overwritten before they were drained */
+	uint32_t suppressed;		/* held back by rate limits */
+	uint32_t console_level;		/* klog_console_level */
+} klog_stats_t;
+
+/* Logs at most KLOG_RATELIMIT_BURST messages per interval from each site
+ * it is written at, and how many it held back once the interval is over */
+#define klog_ratelimited(level, ...) \
+	do { \
+		static klog_ratelimit_t _rs; \
+		if(klog_ratelimit(&_rs)) klog((level), __VA_ARGS__); \
+	} while(0)
+
+/* Messages at this level or more urgent also go to the console */
+extern volatile uint32_t klog_console_level;
+
+/* Registers the device file */
+void klog_init(void);
+
+/* Formats a message as printf does and adds it to the ring. Safe from any
+ * context, including an interrupt that arrives while another is written */
+int32_t klog(uint32_t level, int8_t* format, ...);
+
+/* 1 if the caller may log, 0 if it has hit its limit. Logs how many were
+ * held back when a new interval starts */
+uint32_t klog_ratelimit(klog_ratelimit_t* rs);
+
+/* Writes out everything not yet drained, without waiting for the tasklet */
+void klog_flush(void);
+
+/* Copies out up to n records from position *pos on, skipping ones already
+ * overwritten, and moves *pos past them */
+uint32_t klog_copy(klog_record_t* out, uint32_t n, uint32_t* pos);
+
+/* Records written since boot, including overwritten ones */
+uint32_t klog_position(void);
+
+/* Drops every record from what "dev/dmesg" reads */
+void klog_clear(void);
+
+void klog_get_stats(klog_stats_t* out);
+
+#endif /* _KLOG_H */
@@ -4,6 +4,8 @@
 #include "lib.h"
 #include "tty.h"
 #include "tasks/screen.h"
+#include "klog.h"
+#include "devices/uart.h"
 
 static char* video_mem = (char *)VIDEO;
 
@@ -161,6 +163,88 @@ format_char_switch:
     return (buf - format);
 }
 
+/* int32_t vsnprintf(int8_t* out, uint32_t size, int8_t* format, int32_t* args);
+ *   Inputs: out = buffer, always NUL terminated if size isn't 0
+ *           size = bytes in out
+ *           format = the same format strings as printf
+ *           args = the first argument after format on the caller's stack
+ *   Return Value: characters written, not counting the NUL
+ *    Function: printf into a buffer, cutting off what doesn't fit */
+int32_t vsnprintf(int8_t* out, uint32_t size, int8_t* format, int32_t* args) {
+    int8_t conv_buf[40];
+    int8_t* buf;
+    int8_t* s;
+    uint32_t n = 0, i;
+    int32_t value;
+
+    if (size == 0) return 0;
+    for (buf = format; *buf != '\0' && n < size - 1; buf++) {
+        if (*buf != '%') {
+            out[n++] = *buf;
+            continue;
+        }
+        buf++;
+        s = conv_buf;
+        switch (*buf) {
+            case '%':
+                s = "%";
+                break;
+            case '#':
+                /* 8 hexadecimal digits, as for printf */
+                if (*++buf != 'x') return n;
+                itoa(*((uint32_t *)args++), &conv_buf[8], 16);
+                i = strlen(&conv_buf[8]);
+                s = &conv_buf[i];
+                while (i < 8) conv_buf[i++] = '0';
+                break;
+            case 'x':
+                itoa(*((uint32_t *)args++), conv_buf, 16);
+                break;
+            case 'u':
+                itoa(*((uint32_t *)args++), conv_buf, 10);
+                break;
+            case 'd':
+                value = *args++;
+                if (value < 0) {
+                    conv_buf[0] = '-';
+                    itoa(-value, &conv_buf[1], 10);
+                } else {
+                    itoa(value, conv_buf, 10);
+                }
+                break;
+            case 'c':
+                conv_buf[0] = (uint8_t) *args++;
+                conv_buf[1] = '\0';
+                break;
+            case 's':
+                s = *((int8_t **)args++);
+                break;
+            case 'b':
+                value = *args++;
+                for (i = 0; i < 8; i++) conv_buf[i] = ((value >> (7 - i)) & 1) ? '1' : '0';
+                conv_buf[8] = '\0';
+                break;
+            default:
+                s = "";
+                if (*buf == '\0') buf--;
+                break;
+        }
+        while (*s != '\0' && n < size - 1) out[n++] = *s++;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+/* int32_t snprintf(int8_t* out, uint32_t size, int8_t* format, ...);
+ *   Inputs: out = buffer
+ *           size = bytes in out
+ *           format = printf format string, followed by its arguments
+ *   Return Value: characters written, not counting the NUL
+ *    Function: See vsnprintf */
+int32_t snprintf(int8_t* out, uint32_t size, int8_t* format, ...) {
+    return vsnprintf(out, size, format, (int32_t*) &format + 1);
+}
+
 /* int32_t puts(int8_t* s);
  *   Inputs: int_8* s = pointer to a string of characters
  *   Return Value: Number of bytes written
@@ -509,8 +593,12 @@ void test_interrupts(void) {
 void die(int8_t* s) {
     cli();
     change_process_screen(view_screen);
+    /* Messages still in the ring may say what went wrong */
+    klog_flush();
     putc('\n');
     puts(s);
+    /* Interrupts stay off, so the serial console won't drain by itself */
+    uart_flush();
     while(1);
 }
 
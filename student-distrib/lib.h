@@ -20,6 +20,8 @@
 #define EIGHT_MB (FOUR_MB << 1)
 
 int32_t printf(int8_t *format, ...);
+int32_t snprintf(int8_t* out, uint32_t size, int8_t* format, ...);
+int32_t vsnprintf(int8_t* out, uint32_t size, int8_t* format, int32_t* args);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -92,6 +94,45 @@ static inline uint32_t inl(int port) {
     return val;
 }
 
+/* Reads the 64-bit time-stamp counter (cycles since reset) */
+static inline uint64_t rdtsc(void) {
+    uint64_t val;
+    asm volatile ("rdtsc"
+            : "=A"(val)
+            :
+            : "memory"
+    );
+    return val;
+}
+
+/* Reads a 64-bit model specific register */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint64_t val;
+    asm volatile ("rdmsr"
+            : "=A"(val)
+            : "c"(msr)
+            : "memory"
+    );
+    return val;
+}
+
+/* Writes a 64-bit model specific register */
+static inline void wrmsr(uint32_t msr, uint64_t val) {
+    asm volatile ("wrmsr"
+            :
+            : "c"(msr), "A"(val)
+            : "memory"
+    );
+}
+
+/* Runs cpuid for leaf, filling in eax, ebx, ecx and edx */
+static inline void cpuid(uint32_t leaf, uint32_t regs[4]) {
+    asm volatile ("cpuid"
+            : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+            : "a"(leaf), "c"(0)
+    );
+}
+
 /* Writes a byte to a port */
 #define outb(data, port)                \
 do {                                    \
@@ -122,6 +163,25 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Interrupt enable bit of EFLAGS */
+#define EFLAGS_IF 0x200
+
+/* Time the windows between cli_and_save and restore_flags, see irqstat.c.
+ * Built with -DIRQOFF_TIMING, otherwise the hooks compile to nothing */
+#ifdef IRQOFF_TIMING
+extern volatile uint32_t irqoff_site;
+void irqoff_begin(void);
+void irqoff_end(void);
+#define irqoff_begin_if(flags) do { if ((flags) & EFLAGS_IF) irqoff_begin(); } while (0)
+#define irqoff_end_if(flags) do { if ((flags) & EFLAGS_IF) irqoff_end(); } while (0)
+/* Ends the current window without timing it */
+#define irqoff_cancel() do { irqoff_site = 0; } while (0)
+#else
+#define irqoff_begin_if(flags) do { } while (0)
+#define irqoff_end_if(flags) do { } while (0)
+#define irqoff_cancel() do { } while (0)
+#endif
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
@@ -134,7 +194,9 @@ do {                                    \
 
 /* Save flags and then clear interrupt flag
  * Saves the EFLAGS register into the variable "flags", and then
- * disables interrupts on this processor */
+ * disables interrupts on this processor. If they were on and
+ * IRQOFF_TIMING is defined, the interrupts-off window is timed until
+ * restore_flags (irqstat.c) */
 #define cli_and_save(flags)             \
 do {                                    \
     asm volatile ("                   \n\
@@ -146,11 +208,14 @@ do {                                    \
             :                           \
             : "memory", "cc"            \
     );                                  \
+    irqoff_begin_if(flags);             \
 } while (0)
 
-/* Set interrupt flag - enable interrupts on this processor */
+/* Set interrupt flag - enable interrupts on this processor.
+ * Ends any interrupts-off window without timing it */
 #define sti()                           \
 do {                                    \
+    irqoff_cancel();                    \
     asm volatile ("sti"                 \
             :                           \
             :                           \
@@ -163,6 +228,7 @@ do {                                    \
  * after a cli_and_save_flags(flags) */
 #define restore_flags(flags)            \
 do {                                    \
+    irqoff_end_if(flags);               \
     asm volatile ("                   \n\
             pushl %0                  \n\
             popfl                     \n\
@@ -0,0 +1,16 @@
+#!/bin/bash
+# Builds disk.img, a second disk for qemu (-hdb disk.img, or as a virtio
+# drive) holding filesys_img in an MBR partition of type 7f. The kernel
+# mounts that partition through the buffer cache and falls back to the
+# filesys_img module in memory if the disk is missing.
+
+DISK=${1:-disk.img}
+IMAGE=${2:-filesys_img}
+SIZE_MB=${3:-8}
+
+set -e
+
+dd if=/dev/zero of=$DISK bs=1M count=$SIZE_MB 2>/dev/null
+echo 'start=2048, type=7f' | sfdisk -q $DISK
+dd if=$IMAGE of=$DISK bs=512 seek=2048 conv=notrunc 2>/dev/null
+echo "$DISK: $IMAGE at sector 2048"
@@ -154,6 +154,7 @@ int dhcp_init(void) {
   uint32_t xid = 0x26a08845; // XKCD random
   int i;
   i = udp_recv_start(DHCP_SOURCE_PORT, packet, DHCP_MAX_LEN);
+  if (i < 0) return -1; // port already has a listener
   dhcp_discover(packet, xid);
   udp_recv_join(i);
   if (dhcp_parse_offer(packet, xid)) {
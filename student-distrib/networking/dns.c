@@ -111,6 +111,7 @@ int dns_query(uint8_t* name, ip_t* ip) {
   uint16_t xid = xid_base;
   xid_base += 1;
   int i = udp_recv_start(PORT_OFFSET + xid, packet, DNS_LENGTH);
+  if (i < 0) return -1; // port already has a listener
   dns_request(packet, name, xid);
   udp_recv_join(i);
   return dns_parse(packet, ip, xid);
@@ -2,6 +2,7 @@
 #define NETWORKING_H
 
 #include "networking_structs.h"
+#include "../filesystem/filesystem_structs.h" /* For POLLIN, POLLOUT, EAGAIN */
 
 extern mac_t our_mac;
 extern ip_t our_ip;
@@ -66,6 +67,11 @@ void udp_parse_packet(uint8_t* packet);
 uint16_t udp_recv(uint16_t port, uint8_t *data, uint16_t n);
 int udp_recv_start(uint16_t port, uint8_t *data, uint16_t n);
 uint16_t udp_recv_join(int i);
+int udp_recv_poll(int i);
+int udp_recv_ready(int i);
+void udp_recv_cancel(int i);
+int32_t udp_recv_nonblock(uint16_t port, uint8_t *data, uint16_t n);
+int32_t udp_poll(uint16_t port, int32_t events);
 
 #define UDP_HEADER_LENGTH 8
 #define UDP_HEADER_OFFSET (IP_HEADER_OFFSET + UDP_HEADER_LENGTH)
@@ -81,8 +87,10 @@ void tcp_parse_packet(uint8_t* packet, uint32_t len);
 int tcp_connect(int8_t* domain, uint16_t port);
 uint32_t tcp_send(uint32_t idx, uint8_t* data, uint32_t len);
 uint32_t tcp_recv(uint32_t idx, uint8_t* buffer, uint32_t len);
+int32_t tcp_recv_nonblock(uint32_t idx, uint8_t* buffer, uint32_t len);
 int tcp_sendall(uint32_t idx, uint8_t* data, uint32_t len);
 int tcp_recvall(uint32_t idx, uint8_t* buffer, uint32_t len);
+int32_t tcp_poll(uint32_t idx, int32_t events);
 
 #define TCP_HEADER_LENGTH 20
 #define TCP_HEADER_OFFSET (IP_HEADER_OFFSET + UDP_HEADER_LENGTH)
@@ -1,5 +1,6 @@
 #include "networking.h"
 #include "../devices/devices.h"
+#include "../trace.h"
 
 #define BUFFER_SIZE 2048
 #define MSS (1500-IP_HEADER_LENGTH-TCP_HEADER_LENGTH-TCP_MAX_OPTION_LENGTH)
@@ -137,6 +138,7 @@ void tcp_parse_packet(uint8_t* packet, uint32_t len) {
   uint16_t urg_pointer __attribute__((unused)) = read_u16(&packet);
   connection_t *connection = NULL;
   int i, j;
+  tracepoint(TRACE_TCP, source_port, dest_port, flags.v, seq);
   for (i = 0; i < NUM_CONNECTIONS; i++) {
     if (connections[i].is_valid
      && connections[i].source_port == dest_port
@@ -313,6 +315,39 @@ uint32_t tcp_recv(uint32_t idx, uint8_t* buffer, uint32_t len) {
   return read_to;
 }
 
+/* int32_t tcp_recv_nonblock(uint32_t idx, uint8_t* buffer, uint32_t len)
+ * Inputs: idx -- connection from tcp_connect
+ *         buffer, len -- where to copy received data
+ * Return Value: bytes read, 0 once the connection is closed, -EAGAIN if
+ *               no data has arrived
+ * tcp_recv that returns instead of waiting for data
+ */
+int32_t tcp_recv_nonblock(uint32_t idx, uint8_t* buffer, uint32_t len) {
+  connection_t *conn = &connections[idx];
+  if (conn->is_valid && (conn->rx_readable == conn->rx_read)) return -EAGAIN;
+  return tcp_recv(idx, buffer, len);
+}
+
+/* int32_t tcp_poll(uint32_t idx, int32_t events)
+ * Inputs: idx -- connection from tcp_connect
+ *         events -- POLLIN and/or POLLOUT
+ * Return Value: POLLIN if tcp_recv wouldn't wait, POLLOUT if tcp_send
+ *               wouldn't, POLLHUP once the other end closed, POLLNVAL for
+ *               a bad idx
+ * Readiness of a connection for poll
+ */
+int32_t tcp_poll(uint32_t idx, int32_t events) {
+  connection_t *conn;
+  int32_t revents = 0;
+  if (idx >= NUM_CONNECTIONS) return POLLNVAL;
+  conn = &connections[idx];
+  if (!conn->is_valid) return POLLHUP;
+  if (conn->rx_readable != conn->rx_read) revents |= events & POLLIN;
+  if (conn->is_closed) revents |= POLLHUP; // they sent FIN, nothing more will arrive
+  else if (conn->tx_ackd + BUFFER_SIZE != conn->tx_sendable) revents |= events & POLLOUT;
+  return revents;
+}
+
 // TODO
 int tcp_sendall(uint32_t idx, uint8_t* data, uint32_t len) {
   if (connections[idx].is_closed) return -1;
@@ -6,11 +6,27 @@ typedef struct udp_datagram {
   uint16_t dest_port; // so this would be the port you were listening on
   uint16_t n;
   int is_valid; // 0 for not valid
+  int is_done; // datagram landed in data, slot is freed when it's collected
 } datagram_t;
 
 #define NUM_PORTS 128
 static datagram_t open_ports[NUM_PORTS]; // 0 is empty
 
+// Datagrams that arrived with nobody listening, oldest dropped when full
+#define UDP_BACKLOG 8
+#define UDP_BACKLOG_SIZE 1472 // largest payload in one ethernet frame
+
+typedef struct udp_queued {
+  uint16_t source_port;
+  uint16_t dest_port;
+  uint16_t n;
+  uint8_t data[UDP_BACKLOG_SIZE];
+} queued_t;
+
+static queued_t backlog[UDP_BACKLOG];
+static uint32_t backlog_head = 0; // oldest
+static uint32_t backlog_tail = 0; // next to fill
+
 // TODO
 uint32_t udp_send_packet(ip_t *dest, uint16_t dest_port, uint16_t source_port, const uint8_t *data, uint16_t len) {
   uint8_t packet[1518];// TODO magic (also seems a little big for the stack)
@@ -49,6 +65,7 @@ static int add_listener(uint16_t port, uint8_t* data, uint16_t n) {
       d->data = data;
       d->dest_port = port;
       d->n = n;
+      d->is_done = 0;
       d->is_valid = 1;
       return i;
     }
@@ -56,41 +73,183 @@ static int add_listener(uint16_t port, uint8_t* data, uint16_t n) {
   return -1;
 }
 
+/* static int backlog_find(uint16_t port)
+ * Inputs: port -- destination port
+ * Return Value: index into backlog of the oldest datagram for port, -1 if none
+ * Must be called with interrupts off
+ */
+static int backlog_find(uint16_t port) {
+  uint32_t i;
+  for (i = backlog_head; i != backlog_tail; ++i) {
+    if (backlog[i % UDP_BACKLOG].dest_port == port) return i % UDP_BACKLOG;
+  }
+  return -1;
+}
+
+/* static void backlog_deliver(int q, datagram_t* d)
+ * Inputs: q -- backlog index from backlog_find
+ *         d -- listener for the datagram's port
+ * Return Value: none
+ * Completes d with the queued datagram and removes it from the backlog,
+ * keeping the rest in order. Must be called with interrupts off
+ */
+static void backlog_deliver(int q, datagram_t* d) {
+  uint32_t i, len = backlog[q].n;
+  if (d->n < len) len = d->n;
+  memcpy(d->data, backlog[q].data, len);
+  d->n = len;
+  d->source_port = backlog[q].source_port;
+  d->is_done = 1;
+
+  for (i = q; (i + 1) % UDP_BACKLOG != backlog_tail % UDP_BACKLOG; i = (i + 1) % UDP_BACKLOG) {
+    backlog[i] = backlog[(i + 1) % UDP_BACKLOG];
+  }
+  backlog_tail--;
+}
+
+/* static void backlog_add(uint16_t source_port, uint16_t dest_port, uint8_t* data, uint16_t len)
+ * Inputs: source_port, dest_port -- from the header
+ *         data, len -- payload
+ * Return Value: none
+ * Keeps a datagram nobody was waiting for, for the next listener on the port
+ */
+static void backlog_add(uint16_t source_port, uint16_t dest_port, uint8_t* data, uint16_t len) {
+  queued_t* q;
+  if (backlog_tail - backlog_head == UDP_BACKLOG) backlog_head++;
+  q = &backlog[backlog_tail++ % UDP_BACKLOG];
+  if (len > UDP_BACKLOG_SIZE) len = UDP_BACKLOG_SIZE;
+  q->source_port = source_port;
+  q->dest_port = dest_port;
+  q->n = len;
+  memcpy(q->data, data, len);
+}
+
 // TODO
 int udp_recv_start(uint16_t port, uint8_t *data, uint16_t n) {
-  // race condition?
-  if (!is_open(port)) return 0; // maybe wait?
-  return add_listener(port, data, n);
+  uint32_t flags;
+  int i, q;
+  // packets are parsed in a softirq, so keep it out while the slot is set up
+  cli_and_save(flags);
+  if (!is_open(port)) { // maybe wait?
+    restore_flags(flags);
+    return -1;
+  }
+  i = add_listener(port, data, n);
+  if (i >= 0 && (q = backlog_find(port)) >= 0) backlog_deliver(q, &open_ports[i]);
+  restore_flags(flags);
+  return i;
 }
 
 // TODO
 uint16_t udp_recv_join(int i) {
   datagram_t* d = &open_ports[i];
-  while ((volatile int)d->is_valid);
+  while (!(volatile int)d->is_done);
+  d->is_valid = 0;
   return d->source_port;
 }
 
 // TODO
 uint16_t udp_recv(uint16_t port, uint8_t *data, uint16_t n) {
-  return udp_recv_join(udp_recv_start(port, data, n));
+  int i = udp_recv_start(port, data, n);
+  if (i < 0) return 0;
+  return udp_recv_join(i);
+}
+
+/* int udp_recv_poll(int i)
+ * Inputs: i -- listener returned by udp_recv_start
+ * Return Value: bytes received, -1 if no datagram has arrived yet
+ * Checks a listener without waiting for it, freeing it once it has
+ */
+int udp_recv_poll(int i) {
+  datagram_t* d = &open_ports[i];
+  if (!(volatile int)d->is_done) return -1;
+  d->is_valid = 0;
+  return d->n;
+}
+
+/* int udp_recv_ready(int i)
+ * Inputs: i -- listener returned by udp_recv_start
+ * Return Value: 1 if a datagram has arrived, 0 if not
+ * udp_recv_poll without taking the datagram or freeing the listener
+ */
+int udp_recv_ready(int i) {
+  return (volatile int)open_ports[i].is_done ? 1 : 0;
+}
+
+/* void udp_recv_cancel(int i)
+ * Inputs: i -- listener returned by udp_recv_start
+ * Return Value: none
+ * Stops listening, after which the listener's buffer is no longer written
+ */
+void udp_recv_cancel(int i) {
+  open_ports[i].is_valid = 0;
+}
+
+/* int32_t udp_recv_nonblock(uint16_t port, uint8_t *data, uint16_t n)
+ * Inputs: port -- local UDP port
+ *         data, n -- buffer for the payload
+ * Return Value: bytes received, -EAGAIN if no datagram is queued for port,
+ *               -1 if port already has a listener or none are free
+ * udp_recv that takes a queued datagram instead of waiting for one
+ */
+int32_t udp_recv_nonblock(uint16_t port, uint8_t *data, uint16_t n) {
+  uint32_t flags;
+  int i, got;
+  cli_and_save(flags);
+  if ((i = udp_recv_start(port, data, n)) < 0) {
+    restore_flags(flags);
+    return -1;
+  }
+  if ((got = udp_recv_poll(i)) < 0) {
+    udp_recv_cancel(i);
+    got = -EAGAIN;
+  }
+  restore_flags(flags);
+  return got;
+}
+
+/* int32_t udp_poll(uint16_t port, int32_t events)
+ * Inputs: port -- local UDP port
+ *         events -- POLLIN and/or POLLOUT
+ * Return Value: POLLOUT if asked for, since sending never waits, and POLLIN
+ *               if asked for and a datagram for port is waiting to be received
+ * Readiness of a port for poll
+ */
+int32_t udp_poll(uint16_t port, int32_t events) {
+  int32_t revents = events & POLLOUT;
+  uint32_t flags;
+  int i;
+  cli_and_save(flags);
+  if (backlog_find(port) >= 0) revents |= events & POLLIN;
+  for (i = 0; i < NUM_PORTS; i++) {
+    if (open_ports[i].is_valid && open_ports[i].is_done && open_ports[i].dest_port == port) revents |= events & POLLIN;
+  }
+  restore_flags(flags);
+  return revents;
 }
 
 // TODO
 void udp_parse_packet(uint8_t* packet) {
   uint16_t source_port = read_u16(&packet);
   uint16_t dest_port = read_u16(&packet);
-  if (is_open(dest_port)) return; // ignore
   uint16_t len = read_u16(&packet) - UDP_HEADER_LENGTH;
   uint16_t chksum __attribute__((unused)) = read_u16(&packet);
+  uint32_t flags;
   int i;
+  cli_and_save(flags);
   for (i = 0; i < NUM_PORTS; i++) {
     datagram_t *d = &open_ports[i];
-    if (d->is_valid && (d->dest_port == dest_port)) {
+    if (d->is_valid && !d->is_done && (d->dest_port == dest_port)) {
       d->source_port = source_port;
       if (d->n < len) len = d->n;
       memcpy(d->data, packet, len); // drop rest of packet (maybe when we have malloc...)
-      d->is_valid = 0;
+      d->n = len;
+      d->is_done = 1;
+      restore_flags(flags);
       return;
     }
   }
+  // nobody is waiting yet, keep it for udp_recv_start or poll
+  backlog_add(source_port, dest_port, packet, len);
+  restore_flags(flags);
 }
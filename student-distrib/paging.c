@@ -167,8 +167,23 @@ void brute_add_page(uint32_t addr) {
 	flush_tlb();
 }
 
-/* Note: need to skip the first two 4MB blocks since those are already used */
-uint32_t user_pages = 0x3; // Bitmap to keep track of free pages
+/* Note: need to skip the first two 4MB blocks since those are already used,
+ *	and the one at 32MB holding the terminals' video backups */
+uint32_t user_pages = 0x3 | (0x01 << VIDEO_BACKUP_PAGE_INDEX); // Bitmap to keep track of free pages
+
+/* static int32_t claim_big_page(void)
+ *	INPUTS: None
+ *	OUTPUTS: number of a free 4MB physical page, -1 if there are none
+ *	SIDE EFFECTS: Marks the page in use in the user_pages bitmap
+ */
+static int32_t claim_big_page(void) {
+  uint32_t i;
+
+  for(i = 0; i < 32 && (user_pages & (0x01 << i)); ++i) continue; // Find the first free page
+  if(i == 32) return -1;
+  user_pages |= (0x01 << i); // Mark page as in use
+  return i;
+}
 
 /* uint32_t add_user_page(void)
  *	INPUTS: None
@@ -176,11 +191,7 @@ uint32_t user_pages = 0x3; // Bitmap to keep track of free pages
  *	SIDE EFFECTS: Changes user_pages bitmap and current page_base_addr in the PD, flushes TLB
  */
 uint32_t add_user_page(void) {
-  uint32_t i, user_bitmap;
-
-  user_bitmap = user_pages;
-  for(i = 0; (user_bitmap & 0x01); ++i) user_bitmap = user_bitmap >> 1; // Find the first free page
-  user_pages |= (0x01 << i); // Mark page as in use
+  uint32_t i = claim_big_page();
 
 	set_user_page(i); // Offset to not infringe on kmem
 	return i;
@@ -205,6 +216,33 @@ void set_user_page(uint32_t page_num) {
   flush_tlb();
 }
 
+/* uint32_t map_peer_user_page(uint32_t page_num)
+ *	INPUTS: page_num - another process' user page, as from add_user_page
+ *	OUTPUTS: kernel address the page is mapped at
+ *	SIDE EFFECTS: Maps the page kernel-only at PEER_USER_MEM_ADDR, flushes TLB.
+ *				There is one such mapping, so callers keep interrupts off
+ *				until unmap_peer_user_page
+ */
+uint32_t map_peer_user_page(uint32_t page_num) {
+	page_directory[PEER_USER_PAGE_INDEX].val = 0;
+	page_directory[PEER_USER_PAGE_INDEX].page_base_addr = page_num;	/* Same frame as the process sees at 128 MB */
+	page_directory[PEER_USER_PAGE_INDEX].page_size = 1;				/* Is a 4 MB page */
+	page_directory[PEER_USER_PAGE_INDEX].read_write_perm = 1;		/* Allow read/write for kernel */
+	page_directory[PEER_USER_PAGE_INDEX].present = 1;
+	flush_tlb();
+	return PEER_USER_MEM_ADDR;
+}
+
+/* void unmap_peer_user_page(void)
+ *	INPUTS: None
+ *	OUTPUTS: None
+ *	SIDE EFFECTS: Removes the mapping from map_peer_user_page, flushes TLB
+ */
+void unmap_peer_user_page(void) {
+	page_directory[PEER_USER_PAGE_INDEX].val = 0;
+	flush_tlb();
+}
+
 // TODO  make vidmap enable/disable per process
 
 /* uint32_t enable_vidmap(void)
@@ -280,3 +318,119 @@ void map_vidmap_to_backup(int n) {
 	page_table_vidmap[VIDMAP_PAGE_TABLE_INDEX].page_base_addr = 0x2000+n;
 	flush_tlb();
 }
+
+/* 4 kB page frames for kernel data, free frames are linked through their first word */
+static void* free_frames = NULL;
+static uint32_t frame_chunks = 0;
+static uint32_t frames_free = 0;
+
+/* static int32_t frame_grow(void)
+ *	INPUTS: None
+ *	OUTPUTS: 0 on success, -1 if no 4MB page could be claimed
+ *	SIDE EFFECTS: Claims a 4MB physical page, maps it kernel-only at the next
+ *				slot of the frame pool window and splits it into free frames
+ */
+static int32_t frame_grow(void) {
+	uint32_t idx = FRAME_POOL_PAGE_INDEX + frame_chunks, i;
+	uint8_t* base;
+	int32_t page;
+
+	if(frame_chunks >= FRAME_POOL_MAX_CHUNKS || (page = claim_big_page()) == -1) return -1;
+
+	page_directory[idx].val = 0;
+	page_directory[idx].page_base_addr = page;		/* Physical 4MB page */
+	page_directory[idx].global = 1;					/* Kernel memory should be global */
+	page_directory[idx].page_size = 1;				/* Is a 4 MB page */
+	page_directory[idx].user_super = 0;				/* Kernel-only memory */
+	page_directory[idx].read_write_perm = 1;		/* Allow read/write for kernel */
+	page_directory[idx].present = 1;				/* Page is being used */
+	flush_tlb();
+
+	base = (uint8_t*) (idx * FOUR_MB);
+	for(i = FOUR_MB; i; i -= FOUR_KB) {
+		*(void**) (base + i - FOUR_KB) = free_frames;
+		free_frames = base + i - FOUR_KB;
+	}
+	frames_free += FOUR_MB / FOUR_KB;
+	frame_chunks++;
+	return 0;
+}
+
+/* void* frame_alloc(void)
+ *	INPUTS: None
+ *	OUTPUTS: kernel address of a 4 kB page frame, NULL if memory is exhausted
+ *	SIDE EFFECTS: Grows the frame pool by 4MB when it runs dry. The frame's
+ *				contents are undefined
+ */
+void* frame_alloc(void) {
+	uint32_t flags;
+	void* frame;
+
+	cli_and_save(flags);
+	if(!free_frames && frame_grow()) {
+		restore_flags(flags);
+		return NULL;
+	}
+	frame = free_frames;
+	free_frames = *(void**) frame;
+	frames_free--;
+	restore_flags(flags);
+	return frame;
+}
+
+/* void frame_free(void* frame)
+ *	INPUTS: frame - frame returned by frame_alloc
+ *	OUTPUTS: None
+ *	SIDE EFFECTS: Puts the frame back on the free list
+ */
+void frame_free(void* frame) {
+	uint32_t flags;
+
+	if(!frame) return;
+	cli_and_save(flags);
+	*(void**) frame = free_frames;
+	free_frames = frame;
+	frames_free++;
+	restore_flags(flags);
+}
+
+/* uint32_t map_shared_frame(uint32_t index, void* frame, uint32_t writable)
+ *	INPUTS: index - entry of the vidmap page table to use, at least
+ *				SHARED_FRAME_FIRST_INDEX
+ *			frame - frame returned by frame_alloc, or a page-aligned kernel page
+ *			writable - 0 to map the frame read-only for the user
+ *	OUTPUTS: user virtual address of the frame
+ *	SIDE EFFECTS: Maps the frame user-accessible, flushes TLB.
+ *				The kernel keeps using the frame's own address
+ */
+uint32_t map_shared_frame(uint32_t index, void* frame, uint32_t writable) {
+	uint32_t addr = (uint32_t) frame;
+	uint32_t phys = page_directory[addr / FOUR_MB].page_base_addr * FOUR_MB + addr % FOUR_MB;
+
+	page_table_vidmap[index].val = 0;
+	page_table_vidmap[index].page_base_addr = phys / FOUR_KB;	/* Physical frame */
+	page_table_vidmap[index].user_super = 1;					/* User accessible memory */
+	page_table_vidmap[index].read_write_perm = writable ? 1 : 0;
+	page_table_vidmap[index].present = 1;
+	flush_tlb();
+	return VIDMAP_MEM_ADDR + index * FOUR_KB;
+}
+
+/* void unmap_shared_frame(uint32_t index)
+ *	INPUTS: index - entry passed to map_shared_frame
+ *	OUTPUTS: None
+ *	SIDE EFFECTS: Removes the user mapping, flushes TLB
+ */
+void unmap_shared_frame(uint32_t index) {
+	page_table_vidmap[index].val = 0;
+	flush_tlb();
+}
+
+/* uint32_t frame_count_free(void)
+ *	INPUTS: None
+ *	OUTPUTS: number of frames on the free list
+ *	SIDE EFFECTS: None
+ */
+uint32_t frame_count_free(void) {
+	return frames_free;
+}
@@ -20,6 +20,30 @@
 #define VIDMAP_MEM_PAGE_INDEX (VIDMAP_MEM_ADDR / FOUR_MB) 
 #define VIDMAP_PAGE_TABLE_INDEX 0
 
+/* Frames shared with user programs go in the vidmap page table after video memory */
+#define SHARED_FRAME_FIRST_INDEX 1
+
+/* The running process' I/O ring, remapped whenever current_pcb changes so
+ * no other process can see it (see ring_map_current) */
+#define RING_PAGE_INDEX SHARED_FRAME_FIRST_INDEX
+#define RING_PAGE_ADDR (VIDMAP_MEM_ADDR + RING_PAGE_INDEX * FOUR_KB)
+
+/* The read-only time page is the last entry, at the same address in every process */
+#define TIME_PAGE_INDEX 1023
+#define TIME_PAGE_ADDR (VIDMAP_MEM_ADDR + TIME_PAGE_INDEX * FOUR_KB)
+
+/* Another process' user page is mapped here to copy into it (see map_peer_user_page) */
+#define PEER_USER_MEM_ADDR 0x0C000000
+#define PEER_USER_PAGE_INDEX (PEER_USER_MEM_ADDR / FOUR_MB)
+
+/* Terminal video backups live in the 4MB page at 32 MB (see map_video_to_backup) */
+#define VIDEO_BACKUP_PAGE_INDEX 8
+
+/* Page frames handed out by frame_alloc are mapped from 256 MB up, one 4MB page at a time */
+#define FRAME_POOL_ADDR 0x10000000
+#define FRAME_POOL_PAGE_INDEX (FRAME_POOL_ADDR / FOUR_MB)
+#define FRAME_POOL_MAX_CHUNKS 4
+
 #define FOUR_KB_PAGE_SIZE FOUR_KB
 
 #define NUM_BYTES_PER_PAGE_DIR_ENTRY 4
@@ -128,6 +152,17 @@ extern void flush_tlb(void);
 extern uint32_t add_user_page(void);
 extern void free_user_page(uint32_t page_num);
 extern void set_user_page(uint32_t page_num);
+extern uint32_t map_peer_user_page(uint32_t page_num);
+extern void unmap_peer_user_page(void);
+
+/* 4 kB page frame allocator for kernel data */
+extern void* frame_alloc(void);
+extern void frame_free(void* frame);
+extern uint32_t frame_count_free(void);
+
+/* Maps frames from frame_alloc into user space */
+extern uint32_t map_shared_frame(uint32_t index, void* frame, uint32_t writable);
+extern void unmap_shared_frame(uint32_t index);
  
 /* Vidmap enable/disable */
 extern uint32_t enable_vidmap(void);
@@ -0,0 +1,298 @@
+/* profile.c - Samples the interrupted EIP, process and frame pointer chain
+ *				from a timer interrupt, the local APIC timer if there is
+ *				one and PIT channel 0 otherwise
+ * vim:ts=4 noexpandtab
+ */
+
+#include "profile.h"
+#include "lib.h"
+#include "apic.h"
+#include "i8259.h"
+#include "paging.h"					/* For KERNEL_MEM_END */
+#include "x86_desc.h"				/* For USER_CS */
+#include "syscalls/syscalls.h"		/* For current_pcb, global_context */
+#include "filesystem/devfs.h"
+#include "filesystem/filesystem.h"	/* For fd_table */
+
+/* Longest command written to "dev/profile" */
+#define PROFILE_CMD_LEN 16
+
+/* PIT channel 0 as a rate generator. The RTC drives the scheduler, so
+ * nothing else uses it */
+#define PIT_CH0_DATA		0x40
+#define PIT_COMMAND			0x43
+#define PIT_CH0_RATE		0x34	/* channel 0, lobyte/hibyte, mode 2 */
+#define PIT_HZ				1193182
+#define PIT_IRQ				0
+
+static profile_sample_t ring[PROFILE_RING_ENTRIES];
+static uint32_t ring_head = 0;			/* next sample to read */
+static uint32_t ring_tail = 0;			/* next sample to write */
+static profile_stats_t stats;
+
+static int32_t profile_open(const uint8_t* filename);
+static int32_t profile_close(int32_t fd);
+static int32_t profile_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t profile_write(int32_t fd, const void* buf, int32_t nbytes);
+static int32_t profile_stats_read(int32_t fd, void* buf, int32_t nbytes);
+
+static file_ops_t file_ops_profile = {profile_read, profile_write, profile_open, profile_close};
+static file_ops_t file_ops_profile_stats = {profile_stats_read, profile_write, profile_open, profile_close};
+
+/*
+ * profile_init
+ *	  DESCRIPTION: Adds "dev/profile" and "dev/profile_stats"
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void profile_init(void) {
+	devfs_register((const uint8_t*)"profile", &file_ops_profile);
+	devfs_register((const uint8_t*)"profile_stats", &file_ops_profile_stats);
+}
+
+/*
+ * profile_backtrace
+ *	  DESCRIPTION: Follows saved frame pointers up the stack the interrupted
+ *				   code was on. Stops at a frame outside that stack, so a
+ *				   program built without frame pointers ends the walk
+ *				   rather than faulting
+ *	  INPUTS: ebp -- interrupted EBP
+ *			  user -- 1 for the user stack, 0 for a kernel stack
+ *			  frames -- filled with return addresses
+ *	  OUTPUTS: entries of frames filled, at most PROFILE_DEPTH
+ *	  SIDE EFFECTS: None
+ */
+static uint32_t profile_backtrace(uint32_t ebp, uint32_t user, uint32_t* frames) {
+	uint32_t depth, next;
+
+	for(depth = 0; depth < PROFILE_DEPTH; ++depth) {
+		if(ebp & 3) break;
+		if(user) {
+			if(!is_in_user_mem(ebp) || !is_in_user_mem(ebp + 7)) break;
+		} else if(ebp < FOUR_MB || ebp + 8 > KERNEL_MEM_END) {
+			break;
+		}
+		frames[depth] = ((uint32_t*) ebp)[1];
+		next = ((uint32_t*) ebp)[0];
+		if(next <= ebp) break;		/* frames only go up the stack */
+		ebp = next;
+	}
+	return depth;
+}
+
+/*
+ * profile_tick
+ *	  DESCRIPTION: Timer handler. do_irq_main has saved the interrupted
+ *				   context in the current pcb, or in global_context with
+ *				   no process running
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Adds a sample, or counts it dropped if the ring is full
+ */
+static void profile_tick(void) {
+	hw_context_t* context;
+	profile_sample_t* s;
+	uint32_t running = (uint32_t) current_pcb < KERNEL_MEM_END;
+
+	context = running ? current_pcb->context : global_context;
+	if(!context) return;
+	if(ring_tail - ring_head >= PROFILE_RING_ENTRIES) {
+		stats.dropped++;
+		return;
+	}
+
+	s = &ring[ring_tail % PROFILE_RING_ENTRIES];
+	s->eip = context->ret;
+	s->user = (context->cs == USER_CS);
+	s->pid = running ? current_pcb->pid : PROFILE_NO_PID;
+	s->depth = profile_backtrace(context->ebp, s->user, s->frames);
+	memset(s->comm, 0, PROFILE_COMM_LEN);
+	strncpy((int8_t*) s->comm, running ? (int8_t*) current_pcb->name : "kernel", PROFILE_COMM_LEN - 1);
+
+	ring_tail++;
+	stats.samples++;
+	if(s->user) stats.user++;
+}
+
+/*
+ * profile_start
+ *	  DESCRIPTION: Starts sampling, restarting at the new rate if already on
+ *	  INPUTS: hz -- samples per second, PROFILE_MIN_HZ to PROFILE_MAX_HZ
+ *	  OUTPUTS: 0, -1 for a rate out of range
+ *	  SIDE EFFECTS: Takes over the local APIC timer, or PIT channel 0
+ */
+int32_t profile_start(uint32_t hz) {
+	uint32_t divisor;
+
+	if(hz < PROFILE_MIN_HZ || hz > PROFILE_MAX_HZ) return -1;
+	profile_stop();
+
+	stats.hz = hz;
+	if(apic_timer_rate()) {
+		stats.timer = PROFILE_TIMER_APIC;
+		register_interrupt_handler(APIC_TIMER_IRQ, profile_tick);
+		apic_timer_start(hz);
+		return 0;
+	}
+
+	divisor = PIT_HZ / hz;
+	stats.timer = PROFILE_TIMER_PIT;
+	outb(PIT_CH0_RATE, PIT_COMMAND);
+	outb(divisor & 0xFF, PIT_CH0_DATA);
+	outb(divisor >> 8, PIT_CH0_DATA);
+	register_interrupt_handler(PIT_IRQ, profile_tick);
+	return 0;
+}
+
+/*
+ * profile_stop
+ *	  DESCRIPTION: Stops sampling
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Masks the timer's IRQ again
+ */
+void profile_stop(void) {
+	if(stats.timer == PROFILE_TIMER_APIC) {
+		apic_timer_start(0);
+		remove_interrupt_handler(APIC_TIMER_IRQ, profile_tick);
+	} else if(stats.timer == PROFILE_TIMER_PIT) {
+		remove_interrupt_handler(PIT_IRQ, profile_tick);
+	}
+	stats.timer = PROFILE_TIMER_NONE;
+}
+
+/*
+ * profile_clear
+ *	  DESCRIPTION: Empties the ring and zeroes the counts
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Keeps sampling if it was on
+ */
+void profile_clear(void) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	ring_head = ring_tail = 0;
+	stats.samples = stats.dropped = stats.user = 0;
+	restore_flags(flags);
+}
+
+/*
+ * profile_drain
+ *	  DESCRIPTION: Takes the oldest samples out of the ring
+ *	  INPUTS: out -- filled in
+ *			  n -- entries in out
+ *	  OUTPUTS: samples taken
+ *	  SIDE EFFECTS: None
+ */
+uint32_t profile_drain(profile_sample_t* out, uint32_t n) {
+	uint32_t i = 0, flags;
+
+	cli_and_save(flags);
+	while(ring_head != ring_tail && i < n) {
+		out[i++] = ring[ring_head++ % PROFILE_RING_ENTRIES];
+	}
+	restore_flags(flags);
+	return i;
+}
+
+/*
+ * profile_get_stats
+ *	  DESCRIPTION: Copies out the counts
+ *	  INPUTS: out -- filled in
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void profile_get_stats(profile_stats_t* out) {
+	memcpy(out, &stats, sizeof(stats));
+}
+
+/*
+ * profile_open
+ *	  DESCRIPTION: open for "dev/profile" and "dev/profile_stats"
+ *	  INPUTS: filename -- the fd, as for the rtc
+ *	  OUTPUTS: 0
+ *	  SIDE EFFECTS: Starts reading at the beginning
+ */
+static int32_t profile_open(const uint8_t* filename) {
+	fd_table[(int32_t) filename].file_pos = 0;
+	return 0;
+}
+
+/*
+ * profile_close
+ *	  DESCRIPTION: close for both files
+ *	  INPUTS: fd -- file descriptor
+ *	  OUTPUTS: 0
+ *	  SIDE EFFECTS: None, sampling goes on until "stop" is written
+ */
+static int32_t profile_close(int32_t fd) {
+	return 0;
+}
+
+/*
+ * profile_read
+ *	  DESCRIPTION: Reads whole profile_sample_t's out of the ring
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- filled in
+ *			  nbytes -- size of buf
+ *	  OUTPUTS: bytes read, a multiple of sizeof(profile_sample_t), 0 if the
+ *			   ring is empty, -1 for a bad buffer
+ *	  SIDE EFFECTS: None
+ */
+static int32_t profile_read(int32_t fd, void* buf, int32_t nbytes) {
+	if(!buf || nbytes < 0) return -1;
+	return profile_drain(buf, nbytes / sizeof(profile_sample_t)) * sizeof(profile_sample_t);
+}
+
+/*
+ * profile_stats_read
+ *	  DESCRIPTION: Reads part of a profile_stats_t from the file position on
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- filled in
+ *			  nbytes -- size of buf
+ *	  OUTPUTS: bytes read, 0 at the end, -1 for a bad buffer
+ *	  SIDE EFFECTS: Moves the file position
+ */
+static int32_t profile_stats_read(int32_t fd, void* buf, int32_t nbytes) {
+	uint32_t pos = fd_table[fd].file_pos;
+
+	if(!buf || nbytes < 0) return -1;
+	if(pos >= sizeof(stats)) return 0;
+	if((uint32_t) nbytes > sizeof(stats) - pos) nbytes = sizeof(stats) - pos;
+
+	memcpy(buf, (uint8_t*) &stats + pos, nbytes);
+	fd_table[fd].file_pos += nbytes;
+	return nbytes;
+}
+
+/*
+ * profile_write
+ *	  DESCRIPTION: Controls sampling with "start HZ", "stop" or "clear",
+ *				   written to either file
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- command
+ *			  nbytes -- its length
+ *	  OUTPUTS: nbytes, -1 for an unknown command or a rate out of range
+ *	  SIDE EFFECTS: None
+ */
+static int32_t profile_write(int32_t fd, const void* buf, int32_t nbytes) {
+	int8_t cmd[PROFILE_CMD_LEN];
+	int hz = 0;
+
+	if(!buf || nbytes <= 0 || nbytes >= PROFILE_CMD_LEN) return -1;
+	memcpy(cmd, buf, nbytes);
+	cmd[nbytes] = '\0';
+
+	if(!strncmp(cmd, "start ", 6) && atoi(cmd + 6, &hz)) {
+		if(profile_start(hz)) return -1;
+	} else if(!strncmp(cmd, "stop", 4)) {
+		profile_stop();
+	} else if(!strncmp(cmd, "clear", 5)) {
+		profile_clear();
+	} else {
+		return -1;
+	}
+	return nbytes;
+}
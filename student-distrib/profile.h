@@ -0,0 +1,68 @@
+/* profile.h - Defines the sampling profiler: a timer interrupt records where
+ * the CPU was and a short frame pointer backtrace, read through
+ * "dev/profile" and "dev/profile_stats"
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "types.h"
+
+/* Samples the ring holds before new ones are dropped */
+#define PROFILE_RING_ENTRIES 4096
+
+/* Return addresses kept above the interrupted EIP */
+#define PROFILE_DEPTH 6
+
+/* Bytes of the program name kept, NUL padded */
+#define PROFILE_COMM_LEN 16
+
+/* pid of a sample taken with no process running */
+#define PROFILE_NO_PID 0xFFFF
+
+/* Sampling rates profile_start takes. The PIT can't go below about 19 Hz */
+#define PROFILE_MIN_HZ 19
+#define PROFILE_MAX_HZ 10000
+
+/* Timer the samples come from */
+#define PROFILE_TIMER_NONE 0
+#define PROFILE_TIMER_APIC 1		/* local APIC timer, APIC_TIMER_IRQ */
+#define PROFILE_TIMER_PIT 2			/* PIT channel 0, IRQ 0, without a local APIC */
+
+/* One timer interrupt, read from "dev/profile" */
+typedef struct profile_sample {
+	uint32_t eip;					/* interrupted instruction */
+	uint16_t pid;					/* PROFILE_NO_PID for the kernel with no process */
+	uint8_t user;					/* 1 if the interrupted CS was USER_CS */
+	uint8_t depth;					/* entries of frames in use */
+	uint32_t frames[PROFILE_DEPTH];	/* return addresses, innermost first */
+	uint8_t comm[PROFILE_COMM_LEN];	/* the process' executable, "kernel" if none */
+} profile_sample_t;
+
+/* Contents of "dev/profile_stats" */
+typedef struct profile_stats {
+	uint32_t timer;					/* PROFILE_TIMER_* while sampling, else NONE */
+	uint32_t hz;					/* rate asked for */
+	uint32_t samples;				/* samples added to the ring */
+	uint32_t dropped;				/* samples lost because the ring was full */
+	uint32_t user;					/* of those added, taken in user mode */
+	uint32_t reserved[3];
+} profile_stats_t;
+
+/* Registers the device files */
+void profile_init(void);
+
+/* Starts sampling hz times a second, or stops. Samples in the ring are kept */
+int32_t profile_start(uint32_t hz);
+void profile_stop(void);
+
+/* Empties the ring and zeroes the counts */
+void profile_clear(void);
+
+/* Takes up to n of the oldest samples out of the ring, returns how many */
+uint32_t profile_drain(profile_sample_t* out, uint32_t n);
+
+void profile_get_stats(profile_stats_t* out);
+
+#endif /* _PROFILE_H */
@@ -0,0 +1,180 @@
+/* softirq.c - Runs the work hard IRQ handlers queue after the interrupt is
+ *				acknowledged, with interrupts enabled
+ * vim:ts=4 noexpandtab
+ */
+
+#include "softirq.h"
+#include "lib.h"
+
+static void (*actions[NUM_SOFTIRQS])(void);
+static volatile uint32_t pending;
+static volatile uint32_t running;
+
+/* Scheduled tasklets, in the order they were scheduled */
+static tasklet_t* tasklet_head;
+static tasklet_t* tasklet_tail;
+
+static softirq_stats_t stats;
+
+static void tasklet_action(void);
+
+/*
+ * open_softirq
+ *	  DESCRIPTION: Sets the function a softirq runs
+ *	  INPUTS: nr -- SOFTIRQ_*
+ *			  action -- called with interrupts on each time nr was raised
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void open_softirq(uint32_t nr, void (*action)(void)) {
+	if(nr < NUM_SOFTIRQS) actions[nr] = action;
+}
+
+/*
+ * raise_softirq
+ *	  DESCRIPTION: Marks a softirq pending. Called from hard IRQ handlers,
+ *				   anywhere else interrupts must be off or the softirq may
+ *				   wait for the next interrupt
+ *	  INPUTS: nr -- SOFTIRQ_*
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void raise_softirq(uint32_t nr) {
+	if(nr >= NUM_SOFTIRQS) return;
+	pending |= 1 << nr;
+	stats.raised[nr]++;
+}
+
+/*
+ * do_softirq
+ *	  DESCRIPTION: Runs every pending softirq with interrupts on, repeating
+ *				   while hard IRQs raise more, up to SOFTIRQ_MAX_RESTART
+ *				   passes. Interrupts arriving meanwhile only queue work, so
+ *				   this never nests
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Enables interrupts while actions run, restores them after
+ */
+void do_softirq(void) {
+	uint32_t flags, todo, nr, restart = SOFTIRQ_MAX_RESTART, cycles;
+	uint64_t start;
+
+	cli_and_save(flags);
+	if(running || !pending) {
+		restore_flags(flags);
+		return;
+	}
+	running = 1;
+	start = rdtsc();
+
+	while(pending && restart--) {
+		todo = pending;
+		pending = 0;
+		stats.passes++;
+		sti();
+		for(nr = 0; nr < NUM_SOFTIRQS; ++nr) {
+			if(!(todo & (1 << nr)) || !actions[nr]) continue;
+			actions[nr]();
+			stats.runs[nr]++;
+		}
+		cli();
+	}
+	/* Under a flood of interrupts the rest waits for the next one, so the
+		interrupted code still makes progress */
+	if(pending) stats.deferred++;
+
+	cycles = (uint32_t) (rdtsc() - start);
+	stats.cycles += cycles;
+	if(cycles > stats.max_cycles) stats.max_cycles = cycles;
+	running = 0;
+	restore_flags(flags);
+}
+
+/*
+ * in_softirq
+ *	  DESCRIPTION: Tells interrupt handlers whether they interrupted a softirq,
+ *				   which must finish before the scheduler switches processes
+ *	  INPUTS: None
+ *	  OUTPUTS: 1 while do_softirq is running actions, 0 otherwise
+ *	  SIDE EFFECTS: None
+ */
+uint32_t in_softirq(void) {
+	return running;
+}
+
+/*
+ * tasklet_init
+ *	  DESCRIPTION: Prepares a tasklet
+ *	  INPUTS: t -- tasklet, usually static in the driver
+ *			  function -- called with arg each time t runs
+ *			  arg -- passed to function
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void tasklet_init(tasklet_t* t, void (*function)(uint32_t), uint32_t arg) {
+	t->next = NULL;
+	t->function = function;
+	t->arg = arg;
+	t->scheduled = 0;
+	open_softirq(SOFTIRQ_TASKLET, tasklet_action);
+}
+
+/*
+ * tasklet_schedule
+ *	  DESCRIPTION: Queues a tasklet to run on the next softirq pass, unless
+ *				   it is already queued
+ *	  INPUTS: t -- tasklet from tasklet_init
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Raises SOFTIRQ_TASKLET
+ */
+void tasklet_schedule(tasklet_t* t) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(!t->scheduled) {
+		t->scheduled = 1;
+		t->next = NULL;
+		if(tasklet_tail) tasklet_tail->next = t;
+		else tasklet_head = t;
+		tasklet_tail = t;
+		raise_softirq(SOFTIRQ_TASKLET);
+	}
+	restore_flags(flags);
+}
+
+/*
+ * tasklet_action
+ *	  DESCRIPTION: SOFTIRQ_TASKLET action, runs the tasklets queued so far.
+ *				   Each is unqueued before its function runs, so it can
+ *				   schedule itself again
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+static void tasklet_action(void) {
+	tasklet_t *t, *next;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	t = tasklet_head;
+	tasklet_head = tasklet_tail = NULL;
+	restore_flags(flags);
+
+	for(; t; t = next) {
+		next = t->next;
+		t->scheduled = 0;
+		t->function(t->arg);
+		stats.tasklets++;
+	}
+}
+
+/*
+ * softirq_get_stats
+ *	  DESCRIPTION: Copies out the softirq statistics
+ *	  INPUTS: out -- filled in
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void softirq_get_stats(softirq_stats_t* out) {
+	memcpy(out, &stats, sizeof(stats));
+}
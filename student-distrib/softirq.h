@@ -0,0 +1,52 @@
+/* softirq.h - Defines for the work interrupt handlers defer until the
+ * interrupt is acknowledged and interrupts are back on
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SOFTIRQ_H
+#define _SOFTIRQ_H
+
+#include "types.h"
+
+/* Softirqs, run in this order on each pass */
+#define SOFTIRQ_TIMER       0	/* expired rtc_register_handler callbacks */
+#define SOFTIRQ_TASKLET     1	/* scheduled tasklets */
+#define NUM_SOFTIRQS        2
+
+/* Passes do_softirq makes before leaving the rest for the next interrupt */
+#define SOFTIRQ_MAX_RESTART 10
+
+/* A function a hard IRQ handler wants called once, soon, with interrupts on.
+ *	Scheduling it again before it runs does nothing */
+typedef struct tasklet {
+	struct tasklet* next;
+	void (*function)(uint32_t);
+	uint32_t arg;
+	uint32_t scheduled;
+} tasklet_t;
+
+typedef struct softirq_stats {
+	uint32_t raised[NUM_SOFTIRQS];	/* raise_softirq calls */
+	uint32_t runs[NUM_SOFTIRQS];	/* times the action ran */
+	uint32_t tasklets;				/* tasklet functions called */
+	uint32_t passes;				/* passes over the pending mask */
+	uint32_t deferred;				/* do_softirq calls that hit SOFTIRQ_MAX_RESTART */
+	uint32_t cycles;				/* spent in actions, wraps */
+	uint32_t max_cycles;			/* longest do_softirq call */
+} softirq_stats_t;
+
+/* Sets the function run for softirq nr */
+void open_softirq(uint32_t nr, void (*action)(void));
+/* Marks softirq nr pending, from a hard IRQ handler or with interrupts off */
+void raise_softirq(uint32_t nr);
+/* Runs pending softirqs with interrupts on, on the way out of an interrupt */
+void do_softirq(void);
+/* 1 while softirq actions are running */
+uint32_t in_softirq(void);
+
+void tasklet_init(tasklet_t* t, void (*function)(uint32_t), uint32_t arg);
+void tasklet_schedule(tasklet_t* t);
+
+void softirq_get_stats(softirq_stats_t* out);
+
+#endif /* _SOFTIRQ_H */
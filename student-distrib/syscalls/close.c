@@ -8,23 +8,17 @@
 /* int32_t close(int32_t fd);
  * Inputs: fd - file descriptor of file to be closed
  * Return Value: 0 for success, -1 (SYSCALL_ERROR) for failure
- * Function: Clears the file descriptor for a given file
+ * Function: Clears the file descriptor for a given file, closing the file
+ *				once no other descriptor (from dup or dup2) shares it
  */
 int32_t close(int32_t fd) {
-  if ((fd < 0) || (fd > 7)) return SYSCALL_ERROR;
+	int32_t file;
+
 	/* If not closable or not in the file descriptor table */
     if((fd == STDIN) || (fd == STDOUT)) return SYSCALL_ERROR; // Can't close stdin or stdout
-    else if(!fd_table[fd].fops_table) return SYSCALL_ERROR;
-
-    /* open will reset all values in file descriptor, so we only need to clear 
-     * file_ops ptr because we use it to identify if the fd is populates
-     */
+    else if((file = fd_remove(current_fds, fd)) < 0) return SYSCALL_ERROR;
 
-	/* Call close() */
-    (fd_table[fd].fops_table->close)(fd);
-    
-    /* Clear the entry in the file descriptor table */
-    fd_table[fd].fops_table = 0; 
+	/* Call close() with the last reference */
+    file_put(file);
     return 0;
 }
-
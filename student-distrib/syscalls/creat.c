@@ -19,7 +19,7 @@ int32_t creat(const uint8_t* filename) {
   if(!read_dentry_by_name(filename, &file_dentry)) return open(filename);
 
 // create then open
-  new_dentry(filename);
+  if(new_dentry(filename)) return -1;
   return open(filename);
 }
 
@@ -0,0 +1,46 @@
+/* dup.c - Implements the dup() and dup2() syscalls
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t dup(int32_t fd);
+ * Inputs: fd - open file descriptor
+ * Return Value: the new descriptor, -1 (SYSCALL_ERROR) if fd isn't open or
+ *		no descriptor is free
+ * Function: Opens the lowest free descriptor on fd's open file, so the two
+ *				share its position and flags
+ */
+int32_t dup(int32_t fd) {
+	int32_t file = fd_file(fd), new_fd;
+
+	if(file < 0 || (new_fd = fd_lowest_free(current_fds, 0)) < 0) return SYSCALL_ERROR;
+	file_get(file);
+	if(fd_install(current_fds, new_fd, file) < 0) {
+		file_put(file);
+		return SYSCALL_ERROR;
+	}
+	return new_fd;
+}
+
+/* int32_t dup2(int32_t fd, int32_t new_fd);
+ * Inputs: fd - open file descriptor
+ *			new_fd - descriptor to point at fd's open file, closed first if
+ *				it is open. STDIN and STDOUT may be replaced this way
+ * Return Value: new_fd, -1 (SYSCALL_ERROR) if fd isn't open or new_fd is
+ *		out of range
+ * Function: Makes new_fd share fd's open file, used to redirect STDIN/STDOUT
+ */
+int32_t dup2(int32_t fd, int32_t new_fd) {
+	int32_t file = fd_file(fd);
+
+	if(file < 0 || new_fd < 0 || new_fd >= MAX_FDS) return SYSCALL_ERROR;
+	if(fd == new_fd) return new_fd;
+	file_get(file);
+	if(fd_install(current_fds, new_fd, file) < 0) {
+		file_put(file);
+		return SYSCALL_ERROR;
+	}
+	return new_fd;
+}
@@ -8,10 +8,18 @@
 #include "../filesystem/filesystem.h"
 #include "../x86_desc.h"			/* For tss, USER_DS, USER_CS */
 #include "../tasks/tasks.h"
+#include "../filesystem/pipe.h"
 
 #define USER_MEM_END (FOUR_MB * (USER_MEM_PAGE_INDEX + 1))
 #define FN_BUF_SIZE 33
 
+/* Most programs one command can chain with '|' */
+#define PIPELINE_MAX_STAGES MAX_PROCESSES
+
+/* Open files n stages use: a terminal STDIN and STDOUT each, and both ends
+ * of the n - 1 pipes between them */
+#define PIPELINE_FILES(n) (2 * (n) + 2 * ((n) - 1))
+
 /* Pushes IRET context and IRET-s to program */
 #define execute_program(user_ds, esp, cs, eip)	\
 do {                                    \
@@ -29,22 +37,37 @@ do {                                    \
     );  								\
 } while (0)
 
-/* int32_t execute(const uint8_t* command);
- * Inputs: command - string containing command to be executed 
- *			(executable file and arguments)
- * Return Value: 0 for success, -1 (SYSCALL_ERROR) for failure
- * Function: Creates a new user process which executes the given executable
+/* static uint32_t program_name(const uint8_t* command, uint8_t* filename);
+ * Inputs: command - executable file and arguments
+ *			filename - filled in with the executable file name
+ * Return Value: offset of the file name in command
+ * Function: Skips leading spaces and copies the first word
  */
-int32_t execute(const uint8_t* command) {
-	uint32_t user_memory_block, pcb_addr, i, b, flags;
-	uint8_t save_command[129], filename[FN_BUF_SIZE];
+static uint32_t program_name(const uint8_t* command, uint8_t* filename) {
+	uint32_t i, b;
 
-	/* Extract executable file name */
 	for(b = 0; command[b] == ' '; b++);
 	for(i = b; command[i] && command[i] != ' ' && i < FN_BUF_SIZE; i++) {
 		filename[i-b] = command[i];
 	}
 	filename[i-b] = '\0';
+	return b;
+}
+
+/* static int32_t start_program(const uint8_t* command);
+ * Inputs: command - string containing command to be executed 
+ *			(executable file and arguments)
+ * Return Value: 0 for success, -1 (SYSCALL_ERROR) for failure
+ * Function: Creates a new user process which executes the given executable,
+ *				as the child of the current one. It becomes current_pcb and
+ *				starts when the syscall returns
+ */
+static int32_t start_program(const uint8_t* command) {
+	uint32_t user_memory_block, pcb_addr, b, flags;
+	uint8_t save_command[129], filename[FN_BUF_SIZE];
+
+	/* Extract executable file name */
+	b = program_name(command, filename);
 
 	strcpy((char*) save_command, (char*) command+b);
     
@@ -69,9 +92,13 @@ int32_t execute(const uint8_t* command) {
     }
     
 	strcpy((char*) current_pcb->command, (char*) save_command);
+	strcpy((char*) current_pcb->name, (char*) filename);
 
     /* Set the new kernel stack pointer to point to current 8 kB block*/
     update_tss();
+
+    /* Hide the parent's ring from the child */
+    ring_map_current();
     
     /* Track the User memory block used by the current process */
 	current_pcb->user_physical_mem_block_num = user_memory_block; 
@@ -103,3 +130,95 @@ int32_t execute(const uint8_t* command) {
 
     return 0;
 }
+
+/* static void attach_pipe(pcb_t* pcb, int32_t fd, pipe_t* p, uint32_t end);
+ * Inputs: pcb - stage just started
+ *			fd - STDIN or STDOUT
+ *			p - pipe
+ *			end - PIPE_READ or PIPE_WRITE
+ * Return Value: none
+ * Function: Replaces the stage's terminal file with one end of the pipe.
+ *				execute_pipeline has checked there are open files to spare
+ */
+static void attach_pipe(pcb_t* pcb, int32_t fd, pipe_t* p, uint32_t end) {
+	int32_t file = file_alloc();
+
+	pipe_attach(&fd_table[file], p, end, pcb);
+	fd_install(&pcb->files, fd, file);
+}
+
+/* static int32_t execute_pipeline(const uint8_t* command);
+ * Inputs: command - programs and their arguments separated by '|'
+ * Return Value: 0 for success, -1 (SYSCALL_ERROR) for an empty stage, a
+ *		stage that isn't executable, or too few free processes or open files
+ * Function: Starts every stage, each one's STDOUT a pipe to the next one's
+ *				STDIN. Each stage is the child of the stage it feeds, so
+ *				the last is the caller's child and its exit status is the
+ *				pipeline's. The first stage runs first; the stages share the
+ *				terminal, handing it to each other when a pipe they use
+ *				fills up or runs dry (see pipe_wait), and a stage that exits
+ *				early waits in halt for the stages above it
+ */
+static int32_t execute_pipeline(const uint8_t* command) {
+	uint8_t stage[PIPELINE_MAX_STAGES][MAX_TERMINAL_BUF_SIZE + 1], filename[FN_BUF_SIZE];
+	pipe_t* pipes[PIPELINE_MAX_STAGES - 1];
+	uint32_t i, n = 0, len = 0;
+	int32_t s;
+	pcb_t* pcb;
+
+	/* Split at '|', dropping the spaces around each stage */
+	for(i = 0; ; ++i) {
+		if(command[i] == '|' || !command[i]) {
+			while(len && stage[n][len - 1] == ' ') len--;
+			stage[n][len] = '\0';
+			if(!len) return SYSCALL_ERROR;
+			n++;
+			len = 0;
+			if(!command[i]) break;
+			if(n == PIPELINE_MAX_STAGES) return SYSCALL_ERROR;
+		} else if((len || command[i] != ' ') && len < MAX_TERMINAL_BUF_SIZE) {
+			stage[n][len++] = command[i];
+		}
+	}
+
+	/* Check everything that can fail before starting anything */
+	if(n > pcb_count_free() || PIPELINE_FILES(n) > file_count_free()) return SYSCALL_ERROR;
+	for(i = 0; i < n; ++i) {
+		program_name(stage[i], filename);
+		if(!is_executable_file(filename)) return SYSCALL_ERROR;
+	}
+	for(i = 0; i < n - 1; ++i) {
+		if(!(pipes[i] = pipe_alloc())) {
+			while(i--) pipe_discard(pipes[i]);
+			return SYSCALL_ERROR;
+		}
+	}
+
+	/* Last stage first, so each is pushed as the child of the one it feeds.
+	 * If loading one still fails, the stages after it read end of file */
+	for(s = n - 1; s >= 0; --s) {
+		if(start_program(stage[s])) break;
+		pcb = current_pcb;
+		if(s > 0) attach_pipe(pcb, STDIN, pipes[s - 1], PIPE_READ);
+		if(s < n - 1) attach_pipe(pcb, STDOUT, pipes[s], PIPE_WRITE);
+	}
+	for(i = 0; i < n - 1; ++i) pipe_discard(pipes[i]); /* only frees the unused */
+
+	return (s == (int32_t) n - 1) ? SYSCALL_ERROR : 0;
+}
+
+/* int32_t execute(const uint8_t* command);
+ * Inputs: command - string containing command to be executed 
+ *			(executable file and arguments), or a pipeline of them
+ *			separated by '|'
+ * Return Value: 0 for success, -1 (SYSCALL_ERROR) for failure
+ * Function: Creates a new user process which executes the given executable,
+ *				or one per stage of a pipeline
+ */
+int32_t execute(const uint8_t* command) {
+	uint32_t i;
+
+	for(i = 0; command[i] && command[i] != '|'; ++i);
+	if(command[i] == '|') return execute_pipeline(command);
+	return start_program(command);
+}
@@ -0,0 +1,32 @@
+/* fcntl.c - Implements the fcntl() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t fcntl(int32_t fd, int32_t cmd, int32_t arg);
+ * Inputs: fd - open file descriptor
+ *			cmd - F_GETFL or F_SETFL
+ *			arg - for F_SETFL, the new status flags
+ * Return Value: the status flags for F_GETFL, 0 for F_SETFL,
+ *		-1 (SYSCALL_ERROR) for a bad fd or cmd
+ * Function: Gets or sets the status flags of fd's open file, which
+ *				descriptors from dup share. O_NONBLOCK is the only one, the
+ *				rest of fd_t.flags belongs to the driver
+ */
+int32_t fcntl(int32_t fd, int32_t cmd, int32_t arg) {
+	int32_t file = fd_file(fd);
+
+	if(file < 0 || !fd_table[file].fops_table) return SYSCALL_ERROR;
+
+	switch(cmd) {
+		case F_GETFL:
+			return fd_table[file].flags & O_NONBLOCK;
+		case F_SETFL:
+			fd_table[file].flags = (fd_table[file].flags & ~O_NONBLOCK) | (arg & O_NONBLOCK);
+			return 0;
+		default:
+			return SYSCALL_ERROR;
+	}
+}
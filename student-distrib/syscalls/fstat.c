@@ -0,0 +1,20 @@
+/* fstat.c - Implements the fstat() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t fstat(int32_t fd, stat_t* buf);
+ * Inputs: fd - file descriptor of an open file
+ *			buf - filled with the file's information
+ * Return Value: 0 for success, -1 (SYSCALL_ERROR) for failure
+ * Function: Gets information about an open file by calling the appropriate fstat function
+ */
+int32_t fstat(int32_t fd, stat_t* buf) {
+  int32_t file = fd_file(fd);
+
+  if ((file < 0) || !buf) return SYSCALL_ERROR;
+	if(!fd_table[file].fops_table || !fd_table[file].fops_table->fstat) return SYSCALL_ERROR;
+	return (fd_table[file].fops_table->fstat)(file, buf);
+}
@@ -0,0 +1,22 @@
+/* getdents.c - Implements the getdents() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor of an open directory
+ *			buf - array of records to fill
+ *			nbytes - size of buf in bytes
+ * Return Value: number of bytes filled, 0 at the end of the directory,
+ *		-1 (SYSCALL_ERROR) for failure
+ * Function: Reads a batch of directory entries by calling the appropriate getdents function
+ */
+int32_t getdents(int32_t fd, dirent_t* buf, int32_t nbytes) {
+  int32_t file = fd_file(fd);
+
+  if ((file < 0) || !buf) return SYSCALL_ERROR;
+	if(!fd_table[file].fops_table || !fd_table[file].fops_table->getdents) return SYSCALL_ERROR;
+	return (fd_table[file].fops_table->getdents)(file, buf, nbytes);
+}
@@ -0,0 +1,15 @@
+/* getpid.c - Implements the getpid() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+
+/* int32_t getpid(void);
+ * Inputs: none
+ * Return Value: pid of the current process
+ * Function: Returns the caller's process id. It does nothing else, so it
+ *				also serves to time a syscall round trip
+ */
+int32_t getpid(void) {
+	return current_pcb->pid;
+}
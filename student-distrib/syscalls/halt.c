@@ -15,11 +15,16 @@
  * Function: Terminates the current user process
  */
 int32_t halt(uint8_t status) {
-  uint32_t i;
+  // (1) close fds (NOTE: a pipeline stage's STDIN/STDOUT may be pipes,
+  // whose readers wait for this)
+  fdtable_release(&current_pcb->files);
 
-  // (1) close fds (NOTE: do not close STDIN, STDOUT)
-  for(i = 2; i < MAX_OPEN_FILES; ++i) 
-	if(fd_table[i].fops_table) (fd_table[i].fops_table->close)(i);
+  // (1a) a pipeline stage outlives the stages feeding it, let them finish
+  // (their writes now fail) and exit back to us
+  while(current_pcb->child != (pcb_t*)KERNEL_MEM_END) yield_to(current_pcb->child);
+
+  // (1b) drop the I/O ring, waiting operations are never completed
+  ring_release();
 
   // (2) restore parent paging
   if(current_pcb->parent != (pcb_t*)KERNEL_MEM_END) set_user_page(current_pcb->parent->user_physical_mem_block_num);
@@ -35,14 +40,14 @@ int32_t halt(uint8_t status) {
   // (5) restore parent data
   pop_pcb();
 
-  // (6) set tss and set return value
+  // (6) set tss and set return value (pop_pcb has set the fd table)
   if(current_pcb != (pcb_t*)KERNEL_MEM_END) {
     update_tss();
     current_pcb->context->eax = status;
   }
 
-  // (7) set fd table
-  fd_table = (fd_t*) current_pcb->process_fd_table;
-  
+  // (7) map the parent's ring back in, if it has one
+  ring_map_current();
+
   return 0;
 }
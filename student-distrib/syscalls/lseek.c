@@ -0,0 +1,21 @@
+/* lseek.c - Implements the lseek() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t lseek(int32_t fd, int32_t offset, int32_t whence);
+ * Inputs: fd - file descriptor of file to seek in
+ *			offset - byte offset relative to whence
+ *			whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * Return Value: new file position, -1 (SYSCALL_ERROR) for failure
+ * Function: Moves the file position by calling the appropriate lseek function
+ */
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence) {
+  int32_t file = fd_file(fd);
+
+  if (file < 0) return SYSCALL_ERROR;
+	if(!fd_table[file].fops_table || !fd_table[file].fops_table->lseek) return SYSCALL_ERROR;
+	return (fd_table[file].fops_table->lseek)(file, offset, whence);
+}
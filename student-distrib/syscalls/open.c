@@ -4,8 +4,64 @@
 
 #include "syscalls.h"
 #include "../filesystem/filesystem.h"
+#include "../filesystem/tmpfs.h"
+#include "../filesystem/devfs.h"
 #include "../devices/devices.h"
 
+/* static int32_t open_file(int32_t file, dentry_t* file_dentry);
+ * Inputs: file - open file from file_alloc
+ *			file_dentry - its directory entry
+ * Return Value: 0 for success, -1 (SYSCALL_ERROR) for failure, after which
+ *		the file has no operations so putting it doesn't close it
+ * Function: Fills in the open file and calls its open function
+ */
+static int32_t open_file(int32_t file, dentry_t* file_dentry) {
+	/* Set default values for an opened file */
+    fd_table[file].inode_num = file_dentry->inode_num;
+    fd_table[file].file_pos = 0;
+    fd_table[file].flags = 0; // Blocking until fcntl sets O_NONBLOCK
+
+	/* Set file operations based on file type */
+	switch(file_dentry->file_type) {
+		case FILE_TYPE_REGULAR:
+			fd_table[file].fops_table = &file_ops_regular; // ptr to file operations
+			break;
+		case FILE_TYPE_DIR:
+			fd_table[file].fops_table = &file_ops_dir;
+			break;
+		case FILE_TYPE_TMPFS:
+			fd_table[file].fops_table = (file_dentry->inode_num == TMPFS_ROOT_INODE) ?
+				&file_ops_tmpfs_dir : &file_ops_tmpfs;
+			break;
+		case FILE_TYPE_DEV:
+			fd_table[file].fops_table = devfs_fops(file_dentry->inode_num);
+			if((fd_table[file].fops_table->open)((const uint8_t*)file) == SYSCALL_ERROR) {
+				fd_table[file].fops_table = NULL;
+				return SYSCALL_ERROR;
+			}
+			return 0;
+			break;
+		case FILE_TYPE_RTC:
+			fd_table[file].fops_table = &file_ops_rtc;
+			if((fd_table[file].fops_table->open)((const uint8_t*)file) == SYSCALL_ERROR) {
+				fd_table[file].fops_table = NULL;
+				return SYSCALL_ERROR;
+			}
+			return 0;
+			break;
+		default:
+			return -1; // Unsupported file type
+			break;
+	}
+
+	/* Open file */
+    if((fd_table[file].fops_table->open)(file_dentry->filename) == SYSCALL_ERROR) {
+		fd_table[file].fops_table = NULL;
+		return SYSCALL_ERROR;
+	}
+    return 0;
+}
+
 /* int32_t open(const uint8_t* filename);
  * Inputs: filename - name of file to be opened
  * Return Value: file descriptor for opened file on success, 
@@ -13,7 +69,7 @@
  * Function: Opens the file by calling its open function
  */
 int32_t open(const uint8_t* filename) {
-    uint32_t fd, found_empty_file_descriptor;
+    int32_t fd, file;
     dentry_t file_dentry;
 
 	/* If not successful (file dir-entry doesn't exist in root), return error */
@@ -21,42 +77,14 @@ int32_t open(const uint8_t* filename) {
     	return SYSCALL_ERROR;
     }
 
-    /* Find next available file descriptor, return error if not available */
-    found_empty_file_descriptor = 0;
-    for(fd = 2; fd < MAX_OPEN_FILES; ++fd) {
-    	if(!fd_table[fd].fops_table) {
-    		found_empty_file_descriptor = 1;
-    		break;
-    	}
+    /* Find the lowest available file descriptor and an open file for it,
+     * return error if not available */
+    if((fd = fd_lowest_free(current_fds, FD_FIRST_FREE)) < 0 || (file = file_alloc()) < 0) {
+    	return SYSCALL_ERROR;
     }
-    if(!found_empty_file_descriptor) {
+    if(open_file(file, &file_dentry) == SYSCALL_ERROR || fd_install(current_fds, fd, file) < 0) {
+    	file_put(file);
     	return SYSCALL_ERROR;
     }
-
-	/* Set default values for an opened file descriptor */
-    fd_table[fd].inode_num = file_dentry.inode_num;
-    fd_table[fd].file_pos = 0;
-    fd_table[fd].flags = 0; // We're not using these
-
-	/* Set file operations based on file type */
-	switch(file_dentry.file_type) {
-		case FILE_TYPE_REGULAR:
-			fd_table[fd].fops_table = &file_ops_regular; // ptr to file operations
-			break;
-		case FILE_TYPE_DIR:
-			fd_table[fd].fops_table = &file_ops_dir;
-			break;
-		case FILE_TYPE_RTC:
-			fd_table[fd].fops_table = &file_ops_rtc;
-			if((fd_table[fd].fops_table->open)((const uint8_t*)fd) == SYSCALL_ERROR) return SYSCALL_ERROR;
-			return fd;
-			break;
-		default:
-			return -1; // Unsupported file type
-			break;
-	}
-
-	/* Open file */
-    if((fd_table[fd].fops_table->open)(file_dentry.filename) == SYSCALL_ERROR) return SYSCALL_ERROR;
     return fd;
 }
@@ -0,0 +1,42 @@
+/* pipe.c - Implements the pipe() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+#include "../filesystem/pipe.h"
+
+/* int32_t pipe(int32_t* fds);
+ * Inputs: fds - filled in with the read end in fds[0], the write end in fds[1]
+ * Return Value: 0 for success, -1 (SYSCALL_ERROR) for a bad pointer, too few
+ *		free file descriptors or open files, or no memory
+ * Function: Makes a pipe and opens both ends in the lowest free descriptors
+ */
+int32_t pipe(int32_t* fds) {
+	int32_t end, found[2], file[2];
+	pipe_t* p;
+
+	if(!fds) return SYSCALL_ERROR;
+	if((found[PIPE_READ] = fd_lowest_free(current_fds, FD_FIRST_FREE)) < 0) return SYSCALL_ERROR;
+	if((found[PIPE_WRITE] = fd_lowest_free(current_fds, found[PIPE_READ] + 1)) < 0) return SYSCALL_ERROR;
+	if((file[PIPE_READ] = file_alloc()) < 0) return SYSCALL_ERROR;
+	if((file[PIPE_WRITE] = file_alloc()) < 0 || !(p = pipe_alloc())) {
+		if(file[PIPE_WRITE] >= 0) file_put(file[PIPE_WRITE]);
+		file_put(file[PIPE_READ]);
+		return SYSCALL_ERROR;
+	}
+
+	for(end = PIPE_READ; end <= PIPE_WRITE; ++end) {
+		pipe_attach(&fd_table[file[end]], p, end, current_pcb);
+		if(fd_install(current_fds, found[end], file[end]) < 0) {
+			/* Putting the last end frees the pipe */
+			file_put(file[end]);
+			if(end == PIPE_READ) file_put(file[PIPE_WRITE]);
+			else file_put(fd_remove(current_fds, found[PIPE_READ]));
+			return SYSCALL_ERROR;
+		}
+	}
+	fds[PIPE_READ] = found[PIPE_READ];
+	fds[PIPE_WRITE] = found[PIPE_WRITE];
+	return 0;
+}
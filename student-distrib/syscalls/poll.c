@@ -0,0 +1,79 @@
+/* poll.c - Implements the poll() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../devices/devices.h"			/* For rtc_wait, rtc_check */
+#include "../devices/time_page.h"		/* For time_page_idle */
+#include "../networking/networking.h"	/* For udp_poll, tcp_poll */
+
+/* int32_t file_poll(int32_t fd, int32_t events);
+ * Inputs: fd - file descriptor
+ *			events - POLLIN and/or POLLOUT
+ * Return Value: the events that are ready, POLLNVAL if fd isn't open
+ * Function: Asks the file's poll operation. Files without one never wait
+ */
+int32_t file_poll(int32_t fd, int32_t events) {
+	file_ops_t* fops;
+	int32_t file = fd_file(fd);
+
+	if(file < 0 || !(fops = fd_table[file].fops_table)) return POLLNVAL;
+	if(!fops->poll) return events & (POLLIN | POLLOUT);
+	return (fops->poll)(file, events);
+}
+
+/* static uint32_t poll_scan(pollfd_t* fds, uint32_t nfds);
+ * Inputs: fds - entries to check
+ *			nfds - number of entries
+ * Return Value: number of entries with revents set
+ * Function: Fills in every entry's revents. Entries with a negative fd are
+ *				skipped, so one can be switched off without removing it
+ */
+static uint32_t poll_scan(pollfd_t* fds, uint32_t nfds) {
+	uint32_t i, ready = 0;
+	int32_t want;
+
+	for(i = 0; i < nfds; ++i) {
+		want = fds[i].events & (POLLIN | POLLOUT);
+		if(fds[i].events & POLL_UDP) fds[i].revents = udp_poll(fds[i].fd, want);
+		else if(fds[i].events & POLL_TCP) fds[i].revents = tcp_poll(fds[i].fd, want);
+		else if(fds[i].fd < 0) fds[i].revents = 0;
+		else fds[i].revents = file_poll(fds[i].fd, want);
+		if(fds[i].revents) ready++;
+	}
+	return ready;
+}
+
+/* int32_t poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+ * Inputs: fds - files and network endpoints to wait on
+ *			nfds - number of entries, at most POLL_MAX_FDS
+ *			timeout_ms - longest wait, 0 to only check, POLL_FOREVER for no limit
+ * Return Value: number of entries that are ready, 0 if the timeout ran out,
+ *		-1 (SYSCALL_ERROR) for bad arguments
+ * Function: Checks every entry and halts the CPU until the next interrupt
+ *				until one is ready. Readiness only changes in interrupts and
+ *				the softirqs after them, so nothing is missed: the check runs
+ *				with interrupts off and sti's shadow keeps the interrupt from
+ *				arriving before the hlt. Time halted is published on the
+ *				time page
+ */
+int32_t poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms) {
+	uint32_t flags, stop = 0, start, ready;
+
+	if(nfds > POLL_MAX_FDS || (nfds && !fds)) return SYSCALL_ERROR;
+	if(timeout_ms > 0) stop = rtc_wait(timeout_ms);
+
+	cli_and_save(flags);
+	while(!(ready = poll_scan(fds, nfds)) && timeout_ms && (timeout_ms < 0 || rtc_check(stop))) {
+		/* With interrupts off nothing could become ready */
+		if(!(flags & EFLAGS_IF)) break;
+
+		irqoff_cancel(); /* the window ends in the hlt */
+		start = (uint32_t) rdtsc();
+		asm volatile ("sti; hlt" : : : "memory");
+		cli();
+		time_page_idle((uint32_t) rdtsc() - start);
+	}
+	restore_flags(flags);
+	return ready;
+}
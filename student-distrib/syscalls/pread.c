@@ -0,0 +1,22 @@
+/* pread.c - Implements the pread() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+ * Inputs: fd - file descriptor of file to be read
+ *			buf - buffer to contain data read from file
+ *			nbytes - number of bytes to be read
+ *			offset - byte offset in the file to read from
+ * Return Value: number of bytes read, -1 (SYSCALL_ERROR) for failure
+ * Function: Reads from the file at offset without moving the file position
+ */
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset) {
+  int32_t file = fd_file(fd);
+
+  if (file < 0) return SYSCALL_ERROR;
+	if(!fd_table[file].fops_table || !fd_table[file].fops_table->pread) return SYSCALL_ERROR;
+	return (fd_table[file].fops_table->pread)(file, buf, nbytes, offset);
+}
@@ -9,7 +9,11 @@
 #include "../tty.h"					/* For STDIN/STDOUT */
 #include "../x86_desc.h"			/* For tss */
 #include "../i8259.h"               /* For do_irq */
-#include "../idt.h" 				/* For exception_handlers */
+#include "../idt.h" 				/* For exception_handlers, YIELD_VECTOR */
+#include "../tasks/tasks.h"			/* For do_yield */
+#include "../softirq.h"
+#include "strace.h"
+#include "../trace.h"
 
 /* Mask to round address down to an 8 kB when AND */
 #define PCB_ADDR_MASK 0xFFFFE000
@@ -26,20 +30,26 @@ uint32_t pcb_bitmap = 0xFFFFFFFF;
 hw_context_t *global_context;
 
 
-/* void setup_fdtable(fd_t* fd_table) 
- * Inputs: fd_table - pointer to file descriptor table to be initalized
- * Return Value: None
- * Function: Initializes the fd table with STDIN and STDOUT
+/* int32_t setup_fdtable(fdtable_t* t) 
+ * Inputs: t - pointer to file descriptor table to be initalized
+ * Return Value: 0 for success, -1 if there aren't two free open files
+ * Function: Initializes the fd table with STDIN and STDOUT, each a terminal
+ *				file of its own. The tty tells them apart by inode_num
  */
-void setup_fdtable(fd_t* fd_table) {
-    fd_table[STDIN].fops_table = &file_ops_tty;
-    fd_table[STDIN].file_pos = 0;
-    fd_table[STDIN].inode_num = 0;
-    fd_table[STDIN].flags = 0; // TODO determine flag format for file descriptors
-    fd_table[STDOUT].fops_table = &file_ops_tty;
-    fd_table[STDOUT].file_pos = 0;
-    fd_table[STDOUT].inode_num = 0;
-    fd_table[STDOUT].flags = 0; // TODO
+int32_t setup_fdtable(fdtable_t* t) {
+    int32_t fd, file;
+
+    fdtable_init(t);
+    for(fd = STDIN; fd <= STDOUT; ++fd) {
+        if((file = file_alloc()) < 0) {
+            fdtable_release(t);
+            return -1;
+        }
+        fd_table[file].fops_table = &file_ops_tty;
+        fd_table[file].inode_num = fd;
+        fd_install(t, fd, file);
+    }
+    return 0;
 }
 
 
@@ -84,21 +94,23 @@ uint32_t push_pcb(void) {
 		pcb_bitmap_temp >>= 1;
 	}
 	
-	/* Mark block as in use */
-	pcb_bitmap &= ~(pcb_bitmap & -pcb_bitmap);
-	
 	/* Set the new pcb to be (8 MB - 8 kB * (pcb_num + 1)) to (8 MB - 8 kB * pcb_num) */
 	new_pcb = (pcb_t*) ((void*) KERNEL_MEM_END - (PROCESS_STACK_SIZE * (pcb_num + 2)));
 	
 	/* Clear pcb (potentially leftover data from before */
 	memset(new_pcb, 0, sizeof(pcb_t)); 
 	
+	if(setup_fdtable(&new_pcb->files)) {
+		return -1; /* Out of open files */
+	}
+
+	/* Mark block as in use */
+	pcb_bitmap &= ~(pcb_bitmap & -pcb_bitmap);
+	
 	new_pcb->pcb_num = pcb_num;
 	new_pcb->pid = next_pid++;
 	new_pcb->parent = new_pcb->child = (pcb_t*) KERNEL_MEM_END; /* End of kernel memory indicates no process */
 	
-	setup_fdtable((fd_t*)(new_pcb->process_fd_table));
-	
 	/* Clear current process' command for get_args to use later */
 	memset(new_pcb->command, 0, sizeof(new_pcb->command));
 
@@ -109,13 +121,30 @@ uint32_t push_pcb(void) {
 	}
 	
 	current_pcb = new_pcb;
-	/* Set current fd_table to be this process' fd_table */
-	fd_table = (fd_t*) current_pcb->process_fd_table;
+	/* Set current fd table to be this process' fd table */
+	current_fds = &current_pcb->files;
+
+	tracepoint(TRACE_PUSH_PCB, new_pcb->pid, pcb_num,
+		new_pcb->parent != (pcb_t*) KERNEL_MEM_END ? new_pcb->parent->pid : TRACE_NO_PID, 0);
 	
 	return (uint32_t) current_pcb;
 }
 
 
+/* uint32_t pcb_count_free(void)
+ * Inputs: None
+ * Return Value: number of processes push_pcb can still make
+ * Function: Counts the free 8 kB blocks below MAX_PROCESSES
+ */
+uint32_t pcb_count_free(void) {
+	uint32_t i, count = 0;
+
+	for(i = 0; i < MAX_PROCESSES; ++i)
+		if(pcb_bitmap & (1 << i)) count++;
+	return count;
+}
+
+
 /* uint32_t pop_pcb(void)
  * Inputs: None
  * Return Value: address of pointer to popped pcb in memory, 
@@ -128,8 +157,14 @@ uint32_t pop_pcb(void) {
 		return -1; /* No current process, no pcb to pop */
 	}
 	
+	tracepoint(TRACE_POP_PCB, current_pcb->pid, current_pcb->pcb_num,
+		(uint32_t) current_pcb->parent < KERNEL_MEM_END ? current_pcb->parent->pid : TRACE_NO_PID, 0);
+
 	/* Mark current pcb as not in use */
 	pcb_bitmap |= (1 << current_pcb->pcb_num);
+
+	/* Close whatever the process left open */
+	fdtable_release(&current_pcb->files);
 	
 	/* Unpage vidmap */
 	//disable_vidmap();
@@ -137,6 +172,12 @@ uint32_t pop_pcb(void) {
 	
 	pcb_t *popped = current_pcb;
 	current_pcb = current_pcb->parent;
+	if((uint32_t) current_pcb < KERNEL_MEM_END) {
+		current_pcb->child = (pcb_t*) KERNEL_MEM_END;
+		current_fds = &current_pcb->files;
+	} else {
+		current_fds = &kernel_fds;
+	}
 	return (uint32_t) popped; 
 }
 
@@ -149,12 +190,14 @@ void update_tss(void) {
 	tss.esp0 = KERNEL_MEM_END - (PROCESS_STACK_SIZE * (current_pcb->pcb_num+1));
 }
 
-/* void do_irq_main(hw_context_t *context);
+/* void do_irq_main(hw_context_t *context, uint32_t entry_tsc);
  * Inputs: context - new context to swap to
+ *			entry_tsc - low half of the TSC when do_irq_common was entered,
+ *			kept on this entry's stack so nested entries don't overwrite it
  * Return Value: esp to go to
  * Function: Finishes setting up context and calls irqs
  */
-hw_context_t* do_irq_main(hw_context_t *context) {
+hw_context_t* do_irq_main(hw_context_t *context, uint32_t entry_tsc) {
 	// make context point to previous context
 	if ((uint32_t) current_pcb >= KERNEL_MEM_END) { // no current process
 		context->parent = global_context;
@@ -169,14 +212,20 @@ hw_context_t* do_irq_main(hw_context_t *context) {
 		((void(*)(hw_context_t*))exception_handlers[context->irq_num])(context);
 	} else if (context->irq_num == 0x80) {
 		// syscall
-		if ((context->eax < 1) || (context->eax > 14)) { // TODO signals
+		if ((context->eax < 1) || (context->eax > NUM_SYSCALLS)) { // TODO signals
 			context->eax = -1; // return -1
+		} else if (strace_enabled) {
+			context->eax = strace_syscall(context);
 		} else {
-			context->eax = syscall_shim(context->ebx, context->ecx, context->edx, context->eax);
+			context->eax = syscall_shim(context->ebx, context->ecx, context->edx, context->esi, context->eax);
 		}
-	} else if ((32 <= context->irq_num) && (context->irq_num < 48)) {
-		// irq
-		do_irq(context->irq_num - 32);
+	} else if (context->irq_num == YIELD_VECTOR) {
+		// another process takes over, see yield_to
+		do_yield();
+	} else if ((32 <= context->irq_num) && (context->irq_num < 32 + NUM_IRQS)) {
+		// irq, then the work its handlers deferred
+		do_irq(context->irq_num - 32, entry_tsc);
+		do_softirq();
 	}
 
 	if ((uint32_t) current_pcb >= KERNEL_MEM_END) { // no current process
@@ -0,0 +1,22 @@
+/* pwrite.c - Implements the pwrite() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+ * Inputs: fd - file descriptor of file to be written
+ *			buf - buffer containing data to write to the file
+ *			nbytes - number of bytes to be written
+ *			offset - byte offset in the file to write at
+ * Return Value: number of bytes written, -1 (SYSCALL_ERROR) for failure
+ * Function: Writes to the file at offset without moving the file position
+ */
+int32_t pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset) {
+  int32_t file = fd_file(fd);
+
+  if (file < 0) return SYSCALL_ERROR;
+	if(!fd_table[file].fops_table || !fd_table[file].fops_table->pwrite) return SYSCALL_ERROR;
+	return (fd_table[file].fops_table->pwrite)(file, buf, nbytes, offset);
+}
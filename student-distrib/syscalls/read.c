@@ -13,7 +13,9 @@
  * Function: Reads from the file by calling the appropriate read function
  */
 int32_t read(int32_t fd, void* buf, int32_t nbytes) {
-  if ((fd < 0) || (fd > 7)) return SYSCALL_ERROR;
-	if(!fd_table[fd].fops_table) return SYSCALL_ERROR;
-	return (fd_table[fd].fops_table->read)(fd, buf, nbytes);
+  int32_t file = fd_file(fd);
+
+  if (file < 0) return SYSCALL_ERROR;
+	if(!fd_table[file].fops_table) return SYSCALL_ERROR;
+	return (fd_table[file].fops_table->read)(file, buf, nbytes);
 }
@@ -0,0 +1,34 @@
+/* readv.c - Implements the readv() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+ * Inputs: fd - file descriptor of file to be read
+ *			iov - buffers to fill, in order
+ *			iovcnt - number of buffers, at most IOV_MAX
+ * Return Value: number of bytes read, -1 (SYSCALL_ERROR) for failure
+ * Function: Reads into several buffers with one call. Files without a
+ *				readv operation get one read per buffer, stopping at the
+ *				first short read
+ */
+int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+	int32_t i, n, total = 0, file = fd_file(fd);
+
+	if (file < 0) return SYSCALL_ERROR;
+	if(!fd_table[file].fops_table || !iov || iovcnt < 0 || iovcnt > IOV_MAX) return SYSCALL_ERROR;
+	for(i = 0; i < iovcnt; ++i) {
+		if((int32_t) iov[i].len < 0 || (total += iov[i].len) < 0) return SYSCALL_ERROR;
+	}
+
+	if(fd_table[file].fops_table->readv) return (fd_table[file].fops_table->readv)(file, iov, iovcnt);
+
+	for(i = 0, total = 0; i < iovcnt; ++i) {
+		if((n = (fd_table[file].fops_table->read)(file, iov[i].base, iov[i].len)) < 0) return total ? total : SYSCALL_ERROR;
+		total += n;
+		if(n < iov[i].len) break;
+	}
+	return total;
+}
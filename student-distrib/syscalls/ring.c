@@ -0,0 +1,320 @@
+/* ring.c - Runs the operations programs queue in their submission ring and
+ *			posts the results to their completion ring
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "ring.h"
+#include "../paging.h"
+#include "../networking/networking.h"
+#include "../devices/time_page.h"	/* For time_page_idle */
+
+/* Ring page mapped at RING_PAGE_ADDR, NULL if none */
+static ring_t* ring_mapped = NULL;
+
+/* ring_ctx_t* ring_create(void);
+ * Inputs: none
+ * Return Value: a ring with empty queues, NULL if out of memory
+ * Function: Allocates the shared page and the kernel's state for a ring
+ */
+ring_ctx_t* ring_create(void) {
+	ring_ctx_t* ctx = frame_alloc();
+
+	if(!ctx) return NULL;
+	if(!(ctx->ring = frame_alloc())) {
+		frame_free(ctx);
+		return NULL;
+	}
+	memset(ctx->ops, 0, sizeof(ctx->ops));
+	ctx->user_addr = ctx->inflight = 0;
+	ctx->submitted = ctx->completed = ctx->enters = 0;
+
+	memset(ctx->ring, 0, FOUR_KB);
+	ctx->ring->sq_entries = RING_SQ_ENTRIES;
+	ctx->ring->cq_entries = RING_CQ_ENTRIES;
+	return ctx;
+}
+
+/* void ring_destroy(ring_ctx_t* ctx);
+ * Inputs: ctx - ring from ring_create, no longer mapped
+ * Return Value: none
+ * Function: Drops waiting operations without completing them and frees the ring
+ */
+void ring_destroy(ring_ctx_t* ctx) {
+	uint32_t i, flags;
+
+	for(i = 0; i < RING_MAX_INFLIGHT; ++i) {
+		if(!ctx->ops[i].used || !ctx->ops[i].bounce) continue;
+		/* Stop the network writing into the page before freeing it */
+		cli_and_save(flags);
+		udp_recv_cancel(ctx->ops[i].udp_slot);
+		restore_flags(flags);
+		frame_free(ctx->ops[i].bounce);
+	}
+	frame_free(ctx->ring);
+	frame_free(ctx);
+}
+
+/* static uint32_t ring_cq_used(ring_t* ring);
+ * Inputs: ring - shared page
+ * Return Value: completions the program hasn't consumed yet
+ * Function: Treats a cq_head the program moved past cq_tail as a full queue
+ */
+static uint32_t ring_cq_used(ring_t* ring) {
+	uint32_t used = ring->cq_tail - ring->cq_head;
+	return used > RING_CQ_ENTRIES ? RING_CQ_ENTRIES : used;
+}
+
+/* static void ring_post(ring_ctx_t* ctx, uint32_t user_data, int32_t res);
+ * Inputs: ctx - ring
+ *			user_data - from the submission
+ *			res - result of the operation
+ * Return Value: none
+ * Function: Appends a completion. ring_submit never lets more operations
+ *				run than the cq has room for
+ */
+static void ring_post(ring_ctx_t* ctx, uint32_t user_data, int32_t res) {
+	ring_t* ring = ctx->ring;
+	ring_cqe_t* cqe = &ring->cq[ring->cq_tail % RING_CQ_ENTRIES];
+
+	cqe->user_data = user_data;
+	cqe->res = res;
+	asm volatile ("" : : : "memory");	/* entry before tail */
+	ring->cq_tail++;
+	ctx->completed++;
+}
+
+/* static int32_t ring_do_io(ring_sqe_t* sqe);
+ * Inputs: sqe - read or write submission
+ * Return Value: what read/pread or write/pwrite returned
+ * Function: Performs a read or write now, through the syscalls so fds are
+ *				checked the same way
+ */
+static int32_t ring_do_io(ring_sqe_t* sqe) {
+	if(sqe->opcode == RING_OP_READ) {
+		if(sqe->offset == RING_OFFSET_CUR) return read(sqe->fd, sqe->buf, sqe->len);
+		return pread(sqe->fd, sqe->buf, sqe->len, sqe->offset);
+	}
+	if(sqe->offset == RING_OFFSET_CUR) return write(sqe->fd, sqe->buf, sqe->len);
+	return pwrite(sqe->fd, sqe->buf, sqe->len, sqe->offset);
+}
+
+/* static int32_t ring_read_waits(ring_sqe_t* sqe);
+ * Inputs: sqe - read submission
+ * Return Value: 1 if reading now would block, 0 otherwise
+ * Function: Asks the file's poll operation, bad fds don't wait so the read
+ *				fails right away, and O_NONBLOCK fds don't so it completes
+ *				with -EAGAIN
+ */
+static int32_t ring_read_waits(ring_sqe_t* sqe) {
+	if(file_poll(sqe->fd, POLLIN) & (POLLIN | POLLNVAL)) return 0;
+	return !(fd_table[fd_file(sqe->fd)].flags & O_NONBLOCK);
+}
+
+/* static void ring_start(ring_ctx_t* ctx, ring_sqe_t* sqe);
+ * Inputs: ctx - ring
+ *			sqe - kernel copy of the submission
+ * Return Value: none
+ * Function: Completes the operation now if it can, otherwise parks it in
+ *				a free slot of ctx->ops for ring_progress
+ */
+static void ring_start(ring_ctx_t* ctx, ring_sqe_t* sqe) {
+	ring_op_t* op = NULL;
+	uint32_t i;
+
+	switch(sqe->opcode) {
+		case RING_OP_NOP:
+			ring_post(ctx, sqe->user_data, 0);
+			return;
+		case RING_OP_WRITE:
+			ring_post(ctx, sqe->user_data, ring_do_io(sqe));
+			return;
+		case RING_OP_READ:
+			if(!ring_read_waits(sqe)) {
+				ring_post(ctx, sqe->user_data, ring_do_io(sqe));
+				return;
+			}
+			break;
+		case RING_OP_UDP_RECV:
+			if(!sqe->buf || !sqe->len) {
+				ring_post(ctx, sqe->user_data, SYSCALL_ERROR);
+				return;
+			}
+			break;
+		default:
+			ring_post(ctx, sqe->user_data, SYSCALL_ERROR);
+			return;
+	}
+
+	/* ring_submit made sure a slot is free */
+	for(i = 0; i < RING_MAX_INFLIGHT; ++i) {
+		if(!ctx->ops[i].used) {
+			op = &ctx->ops[i];
+			break;
+		}
+	}
+	op->sqe = *sqe;
+	op->bounce = NULL;
+
+	if(sqe->opcode == RING_OP_UDP_RECV) {
+		/* Datagrams arrive in interrupts, whatever process is running, so
+			they land in a kernel page and are copied out later */
+		if(!(op->bounce = frame_alloc())) {
+			ring_post(ctx, sqe->user_data, SYSCALL_ERROR);
+			return;
+		}
+		if(sqe->len > FOUR_KB) op->sqe.len = FOUR_KB;
+		if((op->udp_slot = udp_recv_start(sqe->fd, op->bounce, op->sqe.len)) < 0) {
+			frame_free(op->bounce);
+			ring_post(ctx, sqe->user_data, SYSCALL_ERROR);
+			return;
+		}
+	}
+
+	op->used = 1;
+	ctx->inflight++;
+}
+
+/* uint32_t ring_submit(ring_ctx_t* ctx, uint32_t n);
+ * Inputs: ctx - ring
+ *			n - most entries to take from the sq
+ * Return Value: number of entries taken
+ * Function: Copies each entry out of the shared page before looking at it,
+ *				then starts it. Stops early when the sq is empty or the cq
+ *				couldn't take the completion of another operation
+ */
+uint32_t ring_submit(ring_ctx_t* ctx, uint32_t n) {
+	ring_t* ring = ctx->ring;
+	ring_sqe_t sqe;
+	uint32_t taken = 0;
+
+	while(taken < n && ring->sq_head != ring->sq_tail) {
+		if(ring->sq_tail - ring->sq_head > RING_SQ_ENTRIES) break;
+		if(ring_cq_used(ring) + ctx->inflight >= RING_CQ_ENTRIES) break;
+		if(ctx->inflight >= RING_MAX_INFLIGHT) break;
+
+		sqe = ring->sq[ring->sq_head % RING_SQ_ENTRIES];
+		ring->sq_head++;
+		ring_start(ctx, &sqe);
+		taken++;
+	}
+	ctx->submitted += taken;
+	return taken;
+}
+
+/* uint32_t ring_progress(ring_ctx_t* ctx);
+ * Inputs: ctx - ring
+ * Return Value: number of operations completed
+ * Function: Finishes each waiting operation whose file or port is ready.
+ *				Must run in the process that owns the ring, since reads copy
+ *				into its memory and use its fd table
+ */
+uint32_t ring_progress(ring_ctx_t* ctx) {
+	ring_op_t* op;
+	int32_t n;
+	uint32_t i, done = 0;
+
+	for(i = 0; i < RING_MAX_INFLIGHT && ctx->inflight; ++i) {
+		op = &ctx->ops[i];
+		if(!op->used) continue;
+
+		if(op->sqe.opcode == RING_OP_UDP_RECV) {
+			if((n = udp_recv_poll(op->udp_slot)) < 0) continue;
+			memcpy(op->sqe.buf, op->bounce, n);
+			frame_free(op->bounce);
+		} else {
+			if(ring_read_waits(&op->sqe)) continue;
+			n = ring_do_io(&op->sqe);
+		}
+
+		op->used = 0;
+		ctx->inflight--;
+		ring_post(ctx, op->sqe.user_data, n);
+		done++;
+	}
+	return done;
+}
+
+/* static uint32_t ring_ready(ring_ctx_t* ctx);
+ * Inputs: ctx - ring
+ * Return Value: 1 if ring_progress would complete a waiting operation
+ * Function: Checks readiness without completing anything, so it can run
+ *				with interrupts off
+ */
+static uint32_t ring_ready(ring_ctx_t* ctx) {
+	ring_op_t* op;
+	uint32_t i;
+
+	for(i = 0; i < RING_MAX_INFLIGHT; ++i) {
+		op = &ctx->ops[i];
+		if(!op->used) continue;
+		if(op->sqe.opcode == RING_OP_UDP_RECV ? udp_recv_ready(op->udp_slot) : !ring_read_waits(&op->sqe))
+			return 1;
+	}
+	return 0;
+}
+
+/* void ring_wait(ring_ctx_t* ctx, uint32_t min_complete);
+ * Inputs: ctx - ring
+ *			min_complete - completions wanted in the cq
+ * Return Value: none
+ * Function: Completes waiting operations until enough completions are
+ *				queued, returning early if nothing is left that could
+ *				complete. When a pass finishes nothing it halts until the
+ *				next interrupt as poll() does: readiness is checked again
+ *				with interrupts off, and sti's shadow keeps the interrupt
+ *				from arriving before the hlt
+ */
+void ring_wait(ring_ctx_t* ctx, uint32_t min_complete) {
+	uint32_t flags, start;
+
+	if(min_complete > RING_CQ_ENTRIES) min_complete = RING_CQ_ENTRIES;
+
+	while(ring_cq_used(ctx->ring) < min_complete && ctx->inflight) {
+		if(ring_progress(ctx)) continue;
+
+		cli_and_save(flags);
+		/* With interrupts off nothing would wake the hlt, keep polling */
+		if((flags & EFLAGS_IF) && !ring_ready(ctx)) {
+			irqoff_cancel(); /* the window ends in the hlt */
+			start = (uint32_t) rdtsc();
+			asm volatile ("sti; hlt" : : : "memory");
+			cli();
+			time_page_idle((uint32_t) rdtsc() - start);
+		}
+		restore_flags(flags);
+	}
+}
+
+/* void ring_release(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Unmaps the current process' ring and frees it
+ */
+void ring_release(void) {
+	ring_ctx_t* ctx = current_pcb->ring;
+
+	if(!ctx) return;
+	current_pcb->ring = NULL;
+	ring_map_current();
+	ring_destroy(ctx);
+}
+
+/* void ring_map_current(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Points RING_PAGE_ADDR at the current process' ring, or unmaps
+ *				it if the process has none, so a program only ever sees its
+ *				own queues. Leaves the page table alone if nothing changes
+ */
+void ring_map_current(void) {
+	pcb_t* pcb = current_pcb;
+	ring_t* want = NULL;
+
+	if(pcb && pcb != (pcb_t*) KERNEL_MEM_END && pcb->ring && pcb->ring->user_addr) want = pcb->ring->ring;
+	if(want == ring_mapped) return;
+
+	if(want) map_shared_frame(RING_PAGE_INDEX, want, 1);
+	else unmap_shared_frame(RING_PAGE_INDEX);
+	ring_mapped = want;
+}
@@ -0,0 +1,97 @@
+/* ring.h - Defines the submission and completion rings a process shares
+ *			with the kernel to queue I/O without a syscall per operation
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include "../types.h"
+
+/* Ring sizes, powers of two so indices can run freely and be masked */
+#define RING_SQ_ENTRIES 64
+#define RING_CQ_ENTRIES 128
+
+/* Operations that can wait at once, for tty, rtc and network reads */
+#define RING_MAX_INFLIGHT 64
+
+/* Operations */
+#define RING_OP_NOP 0			/* completes with 0 */
+#define RING_OP_READ 1			/* read or pread on fd */
+#define RING_OP_WRITE 2			/* write or pwrite on fd */
+#define RING_OP_UDP_RECV 3		/* one datagram from UDP port fd, at most a page */
+
+/* Offset of a read or write that uses and moves the file position */
+#define RING_OFFSET_CUR 0xFFFFFFFF
+
+/* Submission queue entry, filled in by the program */
+typedef struct ring_sqe {
+	uint32_t opcode;
+	int32_t fd;					/* file descriptor, or port for RING_OP_UDP_RECV */
+	void* buf;
+	uint32_t len;
+	uint32_t offset;			/* RING_OFFSET_CUR or a byte offset for pread/pwrite */
+	uint32_t user_data;			/* handed back in the completion */
+} ring_sqe_t;
+
+/* Completion queue entry, filled in by the kernel */
+typedef struct ring_cqe {
+	uint32_t user_data;
+	int32_t res;				/* what the equivalent syscall would have returned */
+} ring_cqe_t;
+
+/* The page shared with the program. The program writes sq entries and moves
+ *	sq_tail and cq_head, the kernel moves sq_head and cq_tail. Indices only
+ *	ever increase, entry i lives at i % entries */
+typedef struct ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	uint32_t sq_entries;
+	uint32_t cq_entries;
+	uint32_t reserved[2];
+	ring_sqe_t sq[RING_SQ_ENTRIES];
+	ring_cqe_t cq[RING_CQ_ENTRIES];
+} ring_t;
+
+/* An operation waiting for its file or port to become ready */
+typedef struct ring_op {
+	uint32_t used;
+	ring_sqe_t sqe;				/* kernel copy of the submission */
+	int32_t udp_slot;			/* listener for RING_OP_UDP_RECV */
+	uint8_t* bounce;			/* kernel page the datagram lands in */
+} ring_op_t;
+
+/* Kernel side of a ring, never visible to the program */
+typedef struct ring_ctx {
+	ring_t* ring;				/* kernel address of the shared page */
+	uint32_t user_addr;			/* where the program sees it while it runs, 0 before ring_setup */
+	uint32_t inflight;			/* used entries of ops */
+	uint32_t submitted;			/* operations taken from the sq since setup */
+	uint32_t completed;			/* completions posted since setup */
+	uint32_t enters;			/* calls to ring_enter */
+	ring_op_t ops[RING_MAX_INFLIGHT];
+} ring_ctx_t;
+
+/* Creates and frees a ring that isn't mapped anywhere */
+ring_ctx_t* ring_create(void);
+void ring_destroy(ring_ctx_t* ctx);
+
+/* Takes up to n entries from the sq, returns the number taken */
+uint32_t ring_submit(ring_ctx_t* ctx, uint32_t n);
+
+/* Completes whatever waiting operations are ready, returns how many */
+uint32_t ring_progress(ring_ctx_t* ctx);
+
+/* Waits until the cq holds min_complete entries or nothing is left waiting */
+void ring_wait(ring_ctx_t* ctx, uint32_t min_complete);
+
+/* Unmaps and frees the current process' ring, for halt */
+void ring_release(void);
+
+/* Maps the current process' ring at RING_PAGE_ADDR, or nothing if it has
+ * none. Called wherever current_pcb changes */
+void ring_map_current(void);
+
+#endif /* RING_H */
@@ -0,0 +1,27 @@
+/* ring_enter.c - Implements the ring_enter() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "ring.h"
+
+/* int32_t ring_enter(uint32_t to_submit, uint32_t min_complete);
+ * Inputs: to_submit - most sq entries to start
+ *			min_complete - completions to wait for before returning
+ * Return Value: number of sq entries started,
+ *		-1 (SYSCALL_ERROR) if the process has no ring
+ * Function: Starts queued operations, finishes waiting ones that are ready
+ *				and waits until the cq holds min_complete entries, so one
+ *				trap can do a whole batch of I/O
+ */
+int32_t ring_enter(uint32_t to_submit, uint32_t min_complete) {
+	ring_ctx_t* ctx = current_pcb->ring;
+	uint32_t submitted;
+
+	if(!ctx) return SYSCALL_ERROR;
+
+	ctx->enters++;
+	submitted = ring_submit(ctx, to_submit);
+	ring_wait(ctx, min_complete);
+	return submitted;
+}
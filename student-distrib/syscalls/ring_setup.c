@@ -0,0 +1,34 @@
+/* ring_setup.c - Implements the ring_setup() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "ring.h"
+#include "../paging.h"
+
+/* int32_t ring_setup(ring_t** ring);
+ * Inputs: ring - pointer in user memory that receives the address of the
+ *			shared ring page
+ * Return Value: 0 on success,
+ *		-1 (SYSCALL_ERROR) for failure
+ * Function: Gives the process a submission/completion ring, or hands back
+ *				the one it already has. The page sits next to vidmap memory
+ *				and is only mapped while the process runs
+ */
+int32_t ring_setup(ring_t** ring) {
+	ring_ctx_t* ctx;
+
+	/* Verify address to overwrite is in User Memory */
+	if(!is_in_user_mem((uint32_t) ring))
+		return SYSCALL_ERROR;
+
+	if(!(ctx = current_pcb->ring)) {
+		if(!(ctx = ring_create())) return SYSCALL_ERROR;
+		ctx->user_addr = RING_PAGE_ADDR;
+		current_pcb->ring = ctx;
+		ring_map_current();
+	}
+
+	*ring = (ring_t*) ctx->user_addr;
+	return 0;
+}
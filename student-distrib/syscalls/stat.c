@@ -0,0 +1,21 @@
+/* stat.c - Implements the stat() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t stat(const uint8_t* filename, stat_t* buf);
+ * Inputs: filename - name of the file
+ *			buf - filled with the file's information
+ * Return Value: 0 for success, -1 (SYSCALL_ERROR) for failure
+ * Function: Gets information about a file without opening it
+ */
+int32_t stat(const uint8_t* filename, stat_t* buf) {
+	dentry_t file_dentry;
+
+	if(!filename || !buf) return SYSCALL_ERROR;
+	if(read_dentry_by_name(filename, &file_dentry)) return SYSCALL_ERROR;
+	if(file_dentry.file_type == FILE_TYPE_DIR) return directory_fstat(0, buf);
+	return stat_dentry(&file_dentry, buf);
+}
@@ -0,0 +1,266 @@
+/* strace.c - Records syscalls made through do_irq_main while tracing is on.
+ *			sysenter_handler sends every syscall there while it is
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "strace.h"
+#include "../paging.h"					/* For KERNEL_MEM_END */
+#include "../filesystem/devfs.h"
+
+/* Longest command written to "dev/strace" */
+#define STRACE_CMD_LEN 16
+
+volatile uint32_t strace_enabled = 0;
+
+static strace_record_t ring[STRACE_RING_ENTRIES];
+static uint32_t ring_head = 0;			/* next record to read */
+static uint32_t ring_tail = 0;			/* next record to write */
+static strace_stats_t stats;
+
+static int32_t strace_open(const uint8_t* filename);
+static int32_t strace_close(int32_t fd);
+static int32_t strace_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t strace_write(int32_t fd, const void* buf, int32_t nbytes);
+static int32_t strace_hist_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t strace_hist_write(int32_t fd, const void* buf, int32_t nbytes);
+
+static file_ops_t file_ops_strace = {strace_read, strace_write, strace_open, strace_close};
+static file_ops_t file_ops_strace_hist = {strace_hist_read, strace_hist_write, strace_open, strace_close};
+
+/* void strace_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Adds "dev/strace" and "dev/strace_hist"
+ */
+void strace_init(void) {
+	devfs_register((const uint8_t*)"strace", &file_ops_strace);
+	devfs_register((const uint8_t*)"strace_hist", &file_ops_strace_hist);
+}
+
+/* void strace_start(uint32_t filter, uint32_t pid);
+ * Inputs: filter - STRACE_FILTER_*
+ *			pid - process the filter is relative to
+ * Return Value: none
+ * Function: Turns tracing on. Records already in the ring are kept
+ */
+void strace_start(uint32_t filter, uint32_t pid) {
+	stats.filter = filter;
+	stats.filter_pid = pid;
+	stats.enabled = strace_enabled = 1;
+}
+
+/* void strace_stop(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Turns tracing off, syscalls take the untraced paths again
+ */
+void strace_stop(void) {
+	stats.enabled = strace_enabled = 0;
+}
+
+/* void strace_clear(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Drops unread records and zeroes the counters and histograms
+ */
+void strace_clear(void) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	ring_head = ring_tail = 0;
+	stats.recorded = stats.dropped = 0;
+	memset(stats.hist, 0, sizeof(stats.hist));
+	restore_flags(flags);
+}
+
+/* static uint32_t strace_match(void);
+ * Inputs: none
+ * Return Value: 1 if the current process is traced, 0 otherwise
+ * Function: Applies the filter, walking up the parents for descendants
+ */
+static uint32_t strace_match(void) {
+	pcb_t* p;
+
+	if((uint32_t) current_pcb >= KERNEL_MEM_END) return 0;
+	if(stats.filter == STRACE_FILTER_ALL) return 1;
+	if(stats.filter == STRACE_FILTER_TREE && current_pcb->pid == stats.filter_pid) return 1;
+
+	for(p = current_pcb->parent; (uint32_t) p < KERNEL_MEM_END; p = p->parent) {
+		if(p->pid == stats.filter_pid) return 1;
+	}
+	return 0;
+}
+
+/* static uint32_t strace_bucket(uint32_t cycles);
+ * Inputs: cycles - nonzero latency
+ * Return Value: histogram bucket, the index of the highest set bit
+ * Function: One bsr
+ */
+static uint32_t strace_bucket(uint32_t cycles) {
+	uint32_t b;
+
+	asm ("bsrl %1, %0" : "=r"(b) : "rm"(cycles));
+	return b;
+}
+
+/* static void strace_add(const strace_record_t* r);
+ * Inputs: r - finished syscall
+ * Return Value: none
+ * Function: Adds the call to its histogram, and to the ring unless it is full
+ */
+static void strace_add(const strace_record_t* r) {
+	strace_hist_t* h;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(r->nr < STRACE_MAX_SYSCALLS) {
+		h = &stats.hist[r->nr];
+		h->calls++;
+		if(r->result < 0) h->errors++;
+		if((h->cycles_lo += r->cycles) < r->cycles) h->cycles_hi++;
+		h->buckets[strace_bucket(r->cycles | 1)]++;
+	}
+
+	if(ring_tail - ring_head >= STRACE_RING_ENTRIES) {
+		stats.dropped++;
+	} else {
+		ring[ring_tail++ % STRACE_RING_ENTRIES] = *r;
+		stats.recorded++;
+	}
+	restore_flags(flags);
+}
+
+/* int32_t strace_syscall(hw_context_t* context);
+ * Inputs: context - int $0x80 frame with a valid syscall number in eax
+ * Return Value: the syscall's return value
+ * Function: Times the syscall with the TSC. The number and pid are taken
+ *				first, halt and execute switch current_pcb
+ */
+int32_t strace_syscall(hw_context_t* context) {
+	strace_record_t r;
+	uint64_t start;
+
+	if(!strace_match())
+		return syscall_shim(context->ebx, context->ecx, context->edx, context->esi, context->eax);
+
+	r.pid = current_pcb->pid;
+	r.nr = context->eax;
+	r.args[0] = context->ebx;
+	r.args[1] = context->ecx;
+	r.args[2] = context->edx;
+	r.args[3] = context->esi;
+
+	start = rdtsc();
+	r.result = syscall_shim(context->ebx, context->ecx, context->edx, context->esi, r.nr);
+	r.cycles = (uint32_t) (rdtsc() - start);
+	r.tsc_lo = (uint32_t) start;
+	r.tsc_hi = (uint32_t) (start >> 32);
+
+	strace_add(&r);
+	return r.result;
+}
+
+/* static int32_t strace_open(const uint8_t* filename);
+ * Inputs: filename - fd of the new file, as devfs passes it
+ * Return Value: 0
+ * Function: Nothing to set up, the ring is shared by every reader
+ */
+static int32_t strace_open(const uint8_t* filename) {
+	fd_table[(int32_t) filename].file_pos = 0;
+	return 0;
+}
+
+/* static int32_t strace_close(int32_t fd);
+ * Inputs: fd - file descriptor
+ * Return Value: 0
+ * Function: Nothing to release
+ */
+static int32_t strace_close(int32_t fd) {
+	return 0;
+}
+
+/* static int32_t strace_read(int32_t fd, void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor
+ *			buf - filled with strace_record_t
+ *			nbytes - size of buf
+ * Return Value: bytes read, a multiple of sizeof(strace_record_t), 0 if the
+ *			ring is empty
+ * Function: Takes the oldest records out of the ring
+ */
+static int32_t strace_read(int32_t fd, void* buf, int32_t nbytes) {
+	strace_record_t* out = buf;
+	uint32_t n = 0, flags;
+
+	if(!buf || nbytes < 0) return -1;
+
+	cli_and_save(flags);
+	while(ring_head != ring_tail && (n + 1) * sizeof(strace_record_t) <= (uint32_t) nbytes) {
+		out[n++] = ring[ring_head++ % STRACE_RING_ENTRIES];
+	}
+	restore_flags(flags);
+	return n * sizeof(strace_record_t);
+}
+
+/* static int32_t strace_write(int32_t fd, const void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor
+ *			buf - one command: "all", "pid N", "kids N", "off" or "clear"
+ *			nbytes - length of the command
+ * Return Value: nbytes on success, -1 for an unknown command
+ * Function: Controls tracing. "pid N" traces process N and everything it
+ *				starts, "kids N" only what it starts, so a tracer can follow
+ *				a program without tracing itself
+ */
+static int32_t strace_write(int32_t fd, const void* buf, int32_t nbytes) {
+	int8_t cmd[STRACE_CMD_LEN];
+	int pid = 0;
+
+	if(!buf || nbytes <= 0 || nbytes >= STRACE_CMD_LEN) return -1;
+	memcpy(cmd, buf, nbytes);
+	cmd[nbytes] = '\0';
+
+	if(!strncmp(cmd, "all", 3)) {
+		strace_start(STRACE_FILTER_ALL, 0);
+	} else if(!strncmp(cmd, "pid ", 4) && atoi(cmd + 4, &pid)) {
+		strace_start(STRACE_FILTER_TREE, pid);
+	} else if(!strncmp(cmd, "kids ", 5) && atoi(cmd + 5, &pid)) {
+		strace_start(STRACE_FILTER_CHILDREN, pid);
+	} else if(!strncmp(cmd, "off", 3)) {
+		strace_stop();
+	} else if(!strncmp(cmd, "clear", 5)) {
+		strace_clear();
+	} else {
+		return -1;
+	}
+	return nbytes;
+}
+
+/* static int32_t strace_hist_read(int32_t fd, void* buf, int32_t nbytes);
+ * Inputs: fd - file descriptor
+ *			buf - filled with part of a strace_stats_t
+ *			nbytes - size of buf
+ * Return Value: bytes read, 0 at the end
+ * Function: Reads the counters and histograms from the file position on
+ */
+static int32_t strace_hist_read(int32_t fd, void* buf, int32_t nbytes) {
+	uint32_t pos = fd_table[fd].file_pos, flags;
+
+	if(!buf || nbytes < 0) return -1;
+	if(pos >= sizeof(stats)) return 0;
+	if((uint32_t) nbytes > sizeof(stats) - pos) nbytes = sizeof(stats) - pos;
+
+	cli_and_save(flags);
+	memcpy(buf, (uint8_t*) &stats + pos, nbytes);
+	restore_flags(flags);
+	fd_table[fd].file_pos += nbytes;
+	return nbytes;
+}
+
+/* static int32_t strace_hist_write(int32_t fd, const void* buf, int32_t nbytes);
+ * Inputs: ignored
+ * Return Value: -1
+ * Function: The histograms are read-only
+ */
+static int32_t strace_hist_write(int32_t fd, const void* buf, int32_t nbytes) {
+	return -1;
+}
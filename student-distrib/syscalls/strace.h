@@ -0,0 +1,74 @@
+/* strace.h - Defines syscall tracing: a ring of per-call records and
+ *			log2 latency histograms, read through "dev/strace" and
+ *			"dev/strace_hist"
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef STRACE_H
+#define STRACE_H
+
+#include "../types.h"
+#include "syscalls_structs.h"
+
+/* Records the ring holds before new ones are dropped */
+#define STRACE_RING_ENTRIES 1024
+
+/* Syscall numbers that get a histogram, and its buckets: bucket b counts
+ *	calls that took 2^b to 2^(b+1) - 1 cycles */
+#define STRACE_MAX_SYSCALLS 32
+#define STRACE_HIST_BUCKETS 32
+
+/* Which processes are traced */
+#define STRACE_FILTER_ALL 0			/* every process */
+#define STRACE_FILTER_TREE 1		/* filter_pid and its descendants */
+#define STRACE_FILTER_CHILDREN 2	/* only filter_pid's descendants */
+
+/* One syscall, read from "dev/strace" */
+typedef struct strace_record {
+	uint32_t tsc_lo;			/* time-stamp counter at entry */
+	uint32_t tsc_hi;
+	uint16_t pid;
+	uint16_t nr;				/* syscall number */
+	uint32_t args[4];			/* ebx, ecx, edx, esi */
+	int32_t result;
+	uint32_t cycles;			/* entry to return, including any preemption */
+} strace_record_t;
+
+/* Latency of one syscall number */
+typedef struct strace_hist {
+	uint32_t calls;
+	uint32_t errors;			/* calls that returned a negative value */
+	uint32_t cycles_lo;			/* total cycles */
+	uint32_t cycles_hi;
+	uint32_t buckets[STRACE_HIST_BUCKETS];
+} strace_hist_t;
+
+/* Contents of "dev/strace_hist" */
+typedef struct strace_stats {
+	uint32_t enabled;
+	uint32_t filter;			/* STRACE_FILTER_* */
+	uint32_t filter_pid;
+	uint32_t recorded;			/* records added to the ring */
+	uint32_t dropped;			/* records lost because the ring was full */
+	uint32_t reserved[3];
+	strace_hist_t hist[STRACE_MAX_SYSCALLS];
+} strace_stats_t;
+
+/* Nonzero while tracing, checked by do_irq_main and sysenter_handler */
+extern volatile uint32_t strace_enabled;
+
+/* Registers the device files */
+void strace_init(void);
+
+/* Starts tracing processes matching the filter, or stops */
+void strace_start(uint32_t filter, uint32_t pid);
+void strace_stop(void);
+
+/* Empties the ring and zeroes the histograms */
+void strace_clear(void);
+
+/* Runs the syscall in context through syscall_shim, recording it if the
+ *	current process matches the filter */
+int32_t strace_syscall(hw_context_t* context);
+
+#endif /* STRACE_H */
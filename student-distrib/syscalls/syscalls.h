@@ -8,10 +8,14 @@
 #include "../types.h"
 #include "../filesystem/filesystem.h"
 #include "syscalls_structs.h" /* Included for pcb_t */
+#include "ring.h" /* Included for ring_t */
 
 #define MAX_PROCESSES 6
 #define SYSCALL_ERROR -1
 
+/* Highest syscall number in syscall_table */
+#define NUM_SYSCALLS 28
+
 int32_t halt(uint8_t status);
 int32_t execute(const uint8_t* command);
 int32_t read(int32_t fd, void* buf, int32_t nbytes);
@@ -24,13 +28,34 @@ int32_t set_handler(int32_t signum, void* handler_address);
 int32_t sigreturn(void);
 int32_t creat(const uint8_t* filename);
 int32_t unlink(const uint8_t* filename);
-void setup_fdtable(fd_t* fd_table);
-int32_t syscall_shim(int32_t b, int32_t c, int32_t d, int32_t a);
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+int32_t getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+int32_t stat(const uint8_t* filename, stat_t* buf);
+int32_t fstat(int32_t fd, stat_t* buf);
+int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t getpid(void);
+int32_t ring_setup(ring_t** ring);
+int32_t ring_enter(uint32_t to_submit, uint32_t min_complete);
+int32_t poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+int32_t pipe(int32_t* fds);
+int32_t fcntl(int32_t fd, int32_t cmd, int32_t arg);
+int32_t dup(int32_t fd);
+int32_t dup2(int32_t fd, int32_t new_fd);
+int32_t setup_fdtable(fdtable_t* t);
+int32_t syscall_shim(int32_t b, int32_t c, int32_t d, int32_t si, int32_t a);
+
+/* Ready events of an open file, see poll.c */
+int32_t file_poll(int32_t fd, int32_t events);
 
 /* See process.c for more information */
 extern pcb_t *current_pcb; 
+extern hw_context_t *global_context; /* Context of the kernel while no process runs */
 uint32_t push_pcb(void);
 uint32_t pop_pcb(void);
+uint32_t pcb_count_free(void);
 uint32_t is_in_user_mem(uint32_t addr);
 void update_tss(void);
 
@@ -34,7 +34,7 @@ typedef struct hw_context {
 
 /* Struct for the Process Control Block, which stores state needed for transitioning between processes */
 typedef struct pcb {
-	fd_t process_fd_table[MAX_OPEN_FILES];	/* File descriptor table */
+	fdtable_t files;	/* File descriptor table */
 	uint32_t pid; 	/* Process id for current process */
 	uint32_t pcb_num; /* 8kB slot number that this PCB occupies in memory */
 	struct pcb *parent, *child; 	/* pointers to parent and child processes, NULL if doesn't exist */
@@ -45,7 +45,11 @@ typedef struct pcb {
 
 	uint8_t command[MAX_TERMINAL_BUF_SIZE + 1]; /* Used for storing user command for use by get_args */
 
+	uint8_t name[MAX_FILENAME_LENGTH + 1]; /* Executable file, for the profiler */
+
 	hw_context_t *context; /* Context to return from interrupt/syscall */
+
+	struct ring_ctx *ring; /* I/O ring from ring_setup, NULL if none */
 } pcb_t;
 
 #endif /* SYSCALLS_STRUCTS_H */
@@ -0,0 +1,34 @@
+/* writev.c - Implements the writev() syscall
+ * vim:ts=4 noexpandtab
+ */
+
+#include "syscalls.h"
+#include "../filesystem/filesystem.h"
+
+/* int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+ * Inputs: fd - file descriptor of file to be written
+ *			iov - buffers to write, in order
+ *			iovcnt - number of buffers, at most IOV_MAX
+ * Return Value: number of bytes written, -1 (SYSCALL_ERROR) for failure
+ * Function: Writes several buffers with one call. Files without a writev
+ *				operation get one write per buffer, stopping at the first
+ *				short write
+ */
+int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+	int32_t i, n, total = 0, file = fd_file(fd);
+
+	if (file < 0) return SYSCALL_ERROR;
+	if(!fd_table[file].fops_table || !iov || iovcnt < 0 || iovcnt > IOV_MAX) return SYSCALL_ERROR;
+	for(i = 0; i < iovcnt; ++i) {
+		if((int32_t) iov[i].len < 0 || (total += iov[i].len) < 0) return SYSCALL_ERROR;
+	}
+
+	if(fd_table[file].fops_table->writev) return (fd_table[file].fops_table->writev)(file, iov, iovcnt);
+
+	for(i = 0, total = 0; i < iovcnt; ++i) {
+		if((n = (fd_table[file].fops_table->write)(file, iov[i].base, iov[i].len)) < 0) return total ? total : SYSCALL_ERROR;
+		total += n;
+		if(n < iov[i].len) break;
+	}
+	return total;
+}
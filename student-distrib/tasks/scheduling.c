@@ -4,6 +4,7 @@
 
 #include "scheduling.h"
 #include "tasks.h"
+#include "../softirq.h"
 
 static uint32_t rr_counter = 0 ;
 static uint8_t curr_process_index = 0 ;
@@ -28,6 +29,9 @@ void round_robin() {
 
     else { /* do context switch */ 
 
+        /* a softirq we interrupted must finish first, try again next tick */
+        if (in_softirq()) return ;
+
         curr_process_index = (curr_process_index+1) % MAX_QUEUE_SIZE;
 
         switch_process(curr_process_index);
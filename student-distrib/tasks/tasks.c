@@ -9,6 +9,11 @@
 #include "../paging.h"
 #include "../x86_desc.h"			/* For tss */
 #include "../i8259.h"
+#include "../idt.h"				/* For YIELD_VECTOR */
+#include "../trace.h"
+
+/* Process the next YIELD_VECTOR interrupt switches to */
+static pcb_t* yield_target;
 
 /* int32_t switch_view_screen(int task);
  * Inputs: task - task number whose screen to display
@@ -26,6 +31,8 @@ int32_t switch_view_screen(int task_id) {
  * Function: 
  */
 int32_t switch_process(int task_id) {
+	int old_task = current_task;
+
 	if(current_task == task_id)
 		return 0;
 
@@ -58,6 +65,7 @@ int32_t switch_process(int task_id) {
 		}
 
 		strcpy((char*) current_pcb->command, (char*) filename);
+		strcpy((char*) current_pcb->name, (char*) filename);
 		
 		/* Track the User memory block used by the current process */
 		current_pcb->user_physical_mem_block_num = user_memory_block; 
@@ -94,9 +102,44 @@ int32_t switch_process(int task_id) {
 		/* Set the new kernel stack pointer to point to current 8 kB block*/
 		update_tss();
 
-		/* Update fd_table */
-		fd_table = (fd_t*) current_pcb->process_fd_table;
+		/* Update the fd table */
+		current_fds = &current_pcb->files;
 	}
+
+	/* Only the process now running may see its ring */
+	ring_map_current();
+
+	tracepoint(TRACE_SWITCH, old_task, task_id, current_pcb->pid, 0);
 	
 	return 0;
 }
+
+/* void yield_to(pcb_t* pcb);
+ * Inputs: pcb - process on the current terminal to run instead, started
+ *			or blocked inside the kernel
+ * Return Value: none
+ * Function: Switches to pcb until something switches back, with yield_to
+ *				or by pcb exiting while it is this process' child. The
+ *				caller's registers are saved by int YIELD_VECTOR like any
+ *				interrupt; eax may come back as a child's exit status
+ */
+void yield_to(pcb_t* pcb) {
+	yield_target = pcb;
+	asm volatile ("int %0" : : "i"(YIELD_VECTOR) : "eax", "memory", "cc");
+}
+
+/* void do_yield(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: YIELD_VECTOR handler. Makes yield_target the current process,
+ *				do_irq_main then returns to its context
+ */
+void do_yield(void) {
+	current_pcb = yield_target;
+	current_tasks[current_task] = current_pcb;
+
+	set_user_page(current_pcb->user_physical_mem_block_num);
+	update_tss();
+	current_fds = &current_pcb->files;
+	ring_map_current();
+}
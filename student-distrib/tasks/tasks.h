@@ -14,6 +14,10 @@ int32_t switch_view_screen(int task_id);
 /* Switches currently executing process to the target process */
 int32_t switch_process(int task_id);
 
+/* Hands the CPU to another process on the same terminal, see tasks.c */
+void yield_to(pcb_t* pcb);
+void do_yield(void);
+
 extern pcb_t *current_tasks[MAX_ACTIVE_TASKS]; 
 int current_task;
 #define USER_MEM_END (FOUR_MB * (USER_MEM_PAGE_INDEX + 1)) // TODO remove
@@ -10,11 +10,26 @@
 #include "tasks/scheduling.h"
 #include "devices/devices.h"
 #include "i8259.h"
+#include "apic.h"
 #include "tasks/screen.h"
 #include "networking/networking.h"
+#include "devices/ata.h"
+#include "devices/virtio_blk.h"
+#include "filesystem/lz4.h"
+#include "filesystem/overlay.h"
+#include "devices/time_page.h"
+#include "syscalls/strace.h"
+#include "softirq.h"
+#include "irqstat.h"
+#include "filesystem/pipe.h"
+#include "profile.h"
+#include "trace.h"
+#include "klog.h"
+#include "devices/uart.h"
 
 #define PASS 1
 #define FAIL 0
+#define SKIPPED 2 /* the device was too full to run the whole test */
 
 /* format these macros as you see fit */
 #define TEST_HEADER 	\
@@ -24,7 +39,7 @@
 int test_result; /* Temporary variable used in the TEST_OUTPUT macro */
 #define TEST_OUTPUT(name, result, failure_count)	\
 	test_result = result; \
-	if (!test_result)printf("[TEST %s] Result = %s\n", name, (test_result) ? "PASS" : "FAIL"); \
+	if (!test_result || test_result == SKIPPED)printf("[TEST %s] Result = %s\n", name, (test_result) ? "SKIPPED" : "FAIL"); \
 	*(failure_count) += !test_result;
 
 static inline void assertion_failure(){
@@ -341,7 +356,7 @@ int arbitrary_file_read_test(void) {
             printf("File not found!\n");
             continue;
         }
-        if (fd_table[fd].inode_num == 0) {
+        if (fd_table[fd_file(fd)].inode_num == 0) {
         	printf("Not a regular file!\n");
             continue;
         }
@@ -839,6 +854,1647 @@ int dns_test(void){
     return result; 
 }
 
+/*********** Block device tests ***********/
+
+#define BCACHE_TEST_SIZE 6000 /* spans two blocks */
+static uint8_t bcache_test_buf[BCACHE_TEST_SIZE];
+static uint8_t bcache_test_check[BCACHE_TEST_SIZE];
+
+/* Buffer Cache Test
+ *
+ * Asserts repeated reads are served from the cache and that written data
+ *		survives a flush to the device, then prints the hit ratio and flush latency
+ * Inputs: None
+ * Outputs: PASS/FAIL, SKIPPED if the device is too full to write the file
+ * Side Effects: Creates and removes the file bcache_test
+ * Coverage: bread, bwrite, bcache_sync, file_write, read_data
+ * Files: buffer_cache.c, block_dev.c, ata.c, file_operations.c
+ */
+int bcache_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	bcache_stats_t before, after;
+	dentry_t d;
+	int32_t fd, i;
+
+	if(read_dentry_by_name((uint8_t*)"frame0.txt", &d)) return FAIL;
+
+	/* The second read of a file must not go to the device */
+	read_data(d.inode_num, 0, bcache_test_buf, BCACHE_TEST_SIZE);
+	bcache_get_stats(&before);
+	read_data(d.inode_num, 0, bcache_test_buf, BCACHE_TEST_SIZE);
+	bcache_get_stats(&after);
+	if(after.misses != before.misses || after.hits <= before.hits) {
+		printf("re-read missed the cache\n");
+		result = FAIL;
+	}
+
+	/* Written data must survive a flush and read back the same */
+	for(i = 0; i < BCACHE_TEST_SIZE; ++i) bcache_test_buf[i] = i;
+	fd = creat((uint8_t*)"bcache_test");
+	if(fd == -1) return FAIL;
+	if(write(fd, bcache_test_buf, BCACHE_TEST_SIZE) == BCACHE_TEST_SIZE) {
+		bcache_sync();
+		bcache_get_stats(&after);
+		if(after.flushes == before.flushes || after.writebacks < before.writebacks + 3) {
+			printf("sync didn't write back the file\n");
+			result = FAIL;
+		}
+		read_dentry_by_name((uint8_t*)"bcache_test", &d);
+		read_data(d.inode_num, 0, bcache_test_check, BCACHE_TEST_SIZE);
+		for(i = 0; i < BCACHE_TEST_SIZE; ++i) {
+			if(bcache_test_buf[i] != bcache_test_check[i]) {
+				printf("read back different data at byte %d\n", i);
+				result = FAIL;
+				break;
+			}
+		}
+	} else {
+		printf("%s is full, skipping write-back\n", fs_dev->name);
+		if(result == PASS) result = SKIPPED;
+	}
+	close(fd);
+	unlink((uint8_t*)"bcache_test");
+	bcache_sync();
+
+	bcache_print_stats();
+	ata_print_stats();
+
+	return result;
+}
+
+#define IOPS_TEST_OPS 1024
+#define IOPS_TEST_DEPTH 32 /* requests submitted per batch */
+static uint8_t iops_test_bufs[IOPS_TEST_DEPTH][BLOCK_SIZE] __attribute__((aligned(FOUR_KB)));
+static block_request_t iops_test_reqs[IOPS_TEST_DEPTH];
+
+/* Issues IOPS_TEST_OPS 4 kB reads to dev in batches of IOPS_TEST_DEPTH,
+ *	returns the RTC ticks taken or -1 if a read failed */
+static int32_t iops_run(block_dev_t* dev, uint8_t random) {
+	block_request_t* list;
+	uint32_t seed = 391, next_block = 0, issued, i, start;
+
+	start = rtc_get_ticks();
+	for(issued = 0; issued < IOPS_TEST_OPS; issued += IOPS_TEST_DEPTH) {
+		list = NULL;
+		for(i = 0; i < IOPS_TEST_DEPTH; ++i) {
+			if(random) {
+				seed = seed * 1103515245 + 12345;
+				iops_test_reqs[i].block = (seed >> 8) % dev->num_blocks;
+			} else {
+				iops_test_reqs[i].block = next_block++ % dev->num_blocks;
+			}
+			iops_test_reqs[i].count = 1;
+			iops_test_reqs[i].buf = iops_test_bufs[i];
+			iops_test_reqs[i].write = 0;
+			iops_test_reqs[i].done = 0;
+			iops_test_reqs[i].callback = NULL;
+			iops_test_reqs[i].next = list;
+			list = &iops_test_reqs[i];
+		}
+		if(dev->submit(dev, list) == BLOCK_ERROR) return -1;
+		for(i = 0; i < IOPS_TEST_DEPTH; ++i) {
+			if(block_wait(dev, &iops_test_reqs[i]) != BLOCK_OK) return -1;
+		}
+	}
+	return rtc_get_ticks() - start;
+}
+
+/* Block IOPS Test
+ *
+ * Measures sequential and random 4 kB read IOPS of the filesystem's device
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints IOPS (reads only, the filesystem is left alone)
+ * Coverage: block device submit/poll, request batching
+ * Files: block_dev.c, virtio_blk.c, ata.c, ramdisk.c
+ */
+int block_iops_test(void) {
+	TEST_HEADER;
+
+	int32_t seq_ticks, rand_ticks;
+
+	if(!fs_dev) return FAIL;
+	if((seq_ticks = iops_run(fs_dev, 0)) < 0) return FAIL;
+	if((rand_ticks = iops_run(fs_dev, 1)) < 0) return FAIL;
+
+	/* Ticks are 1/OS_RTC_MAX s, treat 0 as 1 */
+	printf("%s: sequential %u IOPS, random %u IOPS (4 kB, depth %d)\n", fs_dev->name,
+		(IOPS_TEST_OPS * OS_RTC_MAX) / (seq_ticks ? seq_ticks : 1),
+		(IOPS_TEST_OPS * OS_RTC_MAX) / (rand_ticks ? rand_ticks : 1), IOPS_TEST_DEPTH);
+	virtio_blk_print_stats();
+
+	return PASS;
+}
+
+/* Positional I/O Test
+ *
+ * Asserts pwrite/pread touch only the bytes asked for, that gaps past the end
+ *		of file read back as zeros, and that lseek moves where read starts
+ * Inputs: None
+ * Outputs: PASS/FAIL, SKIPPED if the device is too full to write the file
+ * Side Effects: Creates and removes the file pio_test
+ * Coverage: lseek, pread, pwrite, write_data
+ * Files: lseek.c, pread.c, pwrite.c, file_operations.c
+ */
+int positional_io_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	uint8_t buf[16];
+	int32_t fd, i;
+
+	fd = creat((uint8_t*)"pio_test");
+	if(fd == -1) return FAIL;
+
+	/* Second write lands past a block boundary, leaving a hole */
+	if(pwrite(fd, "hello", 5, 0) != 5 || pwrite(fd, "world", 5, BLOCK_SIZE + 10) != 5) {
+		printf("%s is full, skipping positional I/O\n", fs_dev->name);
+		close(fd);
+		unlink((uint8_t*)"pio_test");
+		return SKIPPED;
+	}
+	if(lseek(fd, 0, SEEK_END) != BLOCK_SIZE + 15) result = FAIL;
+
+	if(pread(fd, buf, 5, BLOCK_SIZE + 10) != 5 || strncmp((int8_t*)buf, "world", 5)) result = FAIL;
+	if(pread(fd, buf, 16, 5) != 16) result = FAIL;
+	for(i = 0; i < 16; ++i) {
+		if(buf[i]) result = FAIL; /* hole must read back as zeros */
+	}
+
+	/* Overwrite in the middle without touching the rest */
+	if(pwrite(fd, "J", 1, 0) != 1) result = FAIL;
+	if(lseek(fd, 0, SEEK_SET) != 0 || read(fd, buf, 5) != 5 || strncmp((int8_t*)buf, "Jello", 5)) result = FAIL;
+	if(lseek(fd, -5, SEEK_END) != BLOCK_SIZE + 10 || read(fd, buf, 16) != 5) result = FAIL;
+	if(lseek(fd, -1, SEEK_SET) != -1) result = FAIL;
+
+	close(fd);
+	unlink((uint8_t*)"pio_test");
+	return result;
+}
+
+
+/* Number of directory listings each ls benchmark runs */
+#define LS_BENCH_RUNS 100
+
+static dirent_t ls_bench_ents[MAX_FILES];
+
+/* Getdents Test
+ *
+ * Asserts getdents returns the same names as reading "." one name at a time with
+ *		the sizes stat reports, then times a listing each way
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints syscalls and cycles per listing
+ * Coverage: getdents, stat, fstat, directory lseek
+ * Files: getdents.c, stat.c, fstat.c, dir_operations.c
+ */
+int getdents_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	uint8_t name[MAX_FILENAME_LENGTH + 1];
+	int32_t fd, fd2, cnt, n, i, pos, run, calls_old, calls_new;
+	uint32_t cycles_old, cycles_new;
+	uint64_t start;
+	dentry_t d;
+	stat_t st;
+
+	if((fd = open((uint8_t*)".")) == -1) return FAIL;
+
+	/* Count the entries a batch at a time */
+	n = 0;
+	while((cnt = getdents(fd, ls_bench_ents, sizeof(ls_bench_ents))) > 0) {
+		if(cnt % sizeof(dirent_t)) result = FAIL;
+		n += cnt / sizeof(dirent_t);
+	}
+	if(cnt != 0 || n == 0) result = FAIL;
+	if(getdents(fd, ls_bench_ents, sizeof(dirent_t) - 1) != -1) result = FAIL;
+
+	/* Rewind and compare against the one name per read interface */
+	if(lseek(fd, 0, SEEK_SET) != 0) result = FAIL;
+	pos = 0;
+	while((cnt = getdents(fd, ls_bench_ents, sizeof(ls_bench_ents))) > 0) {
+		lseek(fd, pos, SEEK_SET);
+		for(i = 0; i < cnt / (int32_t)sizeof(dirent_t); ++i) {
+			memset(name, 0, sizeof(name));
+			if(read(fd, name, MAX_FILENAME_LENGTH) <= 0) result = FAIL;
+			if(strncmp((int8_t*)name, (int8_t*)ls_bench_ents[i].name, MAX_FILENAME_LENGTH)) result = FAIL;
+			if(stat(ls_bench_ents[i].name, &st) || st.length != ls_bench_ents[i].length
+				|| st.file_type != ls_bench_ents[i].file_type) result = FAIL;
+		}
+		pos = lseek(fd, 0, SEEK_CUR);
+	}
+	if(fstat(fd, &st) || st.file_type != FILE_TYPE_DIR) result = FAIL;
+
+	/* fstat on an open file agrees with stat by name */
+	lseek(fd, 0, SEEK_SET);
+	cnt = getdents(fd, ls_bench_ents, sizeof(ls_bench_ents));
+	for(i = 0; i < cnt / (int32_t)sizeof(dirent_t); ++i) {
+		if(ls_bench_ents[i].file_type != FILE_TYPE_REGULAR) continue;
+		if((fd2 = open(ls_bench_ents[i].name)) == -1) continue;
+		if(fstat(fd2, &st) || st.length != ls_bench_ents[i].length) result = FAIL;
+		close(fd2);
+		break;
+	}
+
+	/* Old ls: one read per name, plus a read to the end of every file to learn its size */
+	calls_old = 0;
+	start = rdtsc();
+	for(run = 0; run < LS_BENCH_RUNS; ++run) {
+		lseek(fd, 0, SEEK_SET);
+		while(read(fd, name, MAX_FILENAME_LENGTH) > 0) {
+			++calls_old;
+			name[MAX_FILENAME_LENGTH] = '\0';
+			/* Only regular files have a size (and reading the RTC would block) */
+			if(read_dentry_by_name(name, &d) || d.file_type != FILE_TYPE_REGULAR) continue;
+			if((fd2 = open(name)) == -1) continue;
+			while(read(fd2, bcache_test_buf, sizeof(bcache_test_buf)) > 0) ++calls_old;
+			close(fd2);
+			calls_old += 2;
+		}
+		++calls_old;
+	}
+	cycles_old = (uint32_t)(rdtsc() - start);
+
+	/* New ls: one getdents for the names and sizes, one more to see the end */
+	calls_new = 0;
+	start = rdtsc();
+	for(run = 0; run < LS_BENCH_RUNS; ++run) {
+		lseek(fd, 0, SEEK_SET);
+		do {
+			++calls_new;
+		} while(getdents(fd, ls_bench_ents, sizeof(ls_bench_ents)) > 0);
+	}
+	cycles_new = (uint32_t)(rdtsc() - start);
+
+	close(fd);
+
+	printf("ls of %d entries: read+open %d syscalls %u cycles, getdents %d syscalls %u cycles\n",
+		n, calls_old / LS_BENCH_RUNS, cycles_old / LS_BENCH_RUNS,
+		calls_new / LS_BENCH_RUNS, cycles_new / LS_BENCH_RUNS);
+	return result;
+}
+
+/* Number of files file_scale_test creates, and how many make up each line of its report */
+#define SCALE_TEST_FILES 10000
+#define SCALE_TEST_WINDOW 1000
+
+/* static void scale_test_name(uint8_t* name, uint32_t i);
+ * Inputs: name - filled with the name of the i-th test file
+ *			i - file number
+ * Return Value: none
+ * Function: Names test files scale0, scale1, ...
+ */
+static void scale_test_name(uint8_t* name, uint32_t i) {
+	strcpy((int8_t*)name, "scale");
+	itoa(i, (int8_t*)name + 5, 10);
+}
+
+/* File Scale Test
+ *
+ * Creates and opens SCALE_TEST_FILES files and reports the average cycles of
+ *		creat, open and unlink over each SCALE_TEST_WINDOW files, which should
+ *		stay flat as the directory grows
+ * Inputs: None
+ * Outputs: PASS/FAIL, SKIPPED if the device fills before all SCALE_TEST_FILES
+ *		files are made (build the image with room for them, see INSTALL)
+ * Side Effects: Creates and removes the files scale0 ... scale9999
+ * Coverage: new_dentry, remove_dentry, name index, inode and data bitmaps
+ * Files: dir_operations.c, bitmap.c, creat.c, open.c, unlink.c
+ */
+int file_scale_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	uint8_t name[MAX_FILENAME_LENGTH];
+	uint32_t creat_cycles, open_cycles, unlink_cycles, max_open, cycles;
+	int32_t fd, i, j, created, entries;
+	uint64_t start;
+	dentry_t d;
+
+	entries = root.num_dir_entries;
+
+	/* Create in windows so the latency report shows any growth with directory size */
+	for(created = 0; created < SCALE_TEST_FILES; created += SCALE_TEST_WINDOW) {
+		creat_cycles = open_cycles = max_open = 0;
+		for(i = created; i < created + SCALE_TEST_WINDOW; ++i) {
+			scale_test_name(name, i);
+			start = rdtsc();
+			fd = creat(name);
+			creat_cycles += (uint32_t)(rdtsc() - start);
+			if(fd == -1) break;
+			close(fd);
+		}
+		if(i < created + SCALE_TEST_WINDOW) {
+			created = i;
+			printf("%s is full after %d of %d files\n", fs_dev->name, created, SCALE_TEST_FILES);
+			break;
+		}
+
+		/* Reopen every file made so far, spread over the whole directory */
+		for(j = 0; j < SCALE_TEST_WINDOW; ++j) {
+			scale_test_name(name, (j * 7919) % (created + SCALE_TEST_WINDOW));
+			start = rdtsc();
+			fd = open(name);
+			cycles = (uint32_t)(rdtsc() - start);
+			if(fd == -1) {
+				result = FAIL;
+				continue;
+			}
+			close(fd);
+			open_cycles += cycles;
+			if(cycles > max_open) max_open = cycles;
+		}
+		printf("%d files: creat %u cycles, open %u cycles (max %u)\n", created + SCALE_TEST_WINDOW,
+			creat_cycles / SCALE_TEST_WINDOW, open_cycles / SCALE_TEST_WINDOW, max_open);
+	}
+
+	if(root.num_dir_entries != entries + created) result = FAIL;
+
+	/* Remove newest first, then check the directory is back to how it was */
+	unlink_cycles = 0;
+	for(i = created - 1; i >= 0; --i) {
+		scale_test_name(name, i);
+		start = rdtsc();
+		if(unlink(name)) result = FAIL;
+		unlink_cycles += (uint32_t)(rdtsc() - start);
+	}
+	if(created) printf("unlink %u cycles\n", unlink_cycles / created);
+
+	if(root.num_dir_entries != entries) result = FAIL;
+	scale_test_name(name, 0);
+	if(!read_dentry_by_name(name, &d)) result = FAIL;
+	if(result == PASS && created < SCALE_TEST_FILES) result = SKIPPED;
+	return result;
+}
+
+/* Compressed Image Test
+ *
+ * Reads every block of a compressed filesystem image and compares the cost with
+ *		the memcpy an uncompressed ramdisk does for the same blocks
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints RAM held by the image and read throughput
+ * Coverage: lz4disk, lz4_decompress
+ * Files: lz4.c
+ */
+int compressed_image_test(void) {
+	TEST_HEADER;
+
+	uint32_t i, lz4_cycles, copy_cycles, lz4_ticks, copy_ticks;
+	block_dev_t* dev = overlay_base(fs_dev);
+	lz4disk_stats_t st;
+	uint64_t start;
+
+	if(!dev || strncmp((int8_t*)dev->name, "lz4disk", 8)) {
+		printf("filesystem image isn't compressed, skipping\n");
+		return PASS;
+	}
+
+	/* Straight from the device, so the buffer cache doesn't hide the cost */
+	lz4_ticks = rtc_get_ticks();
+	start = rdtsc();
+	for(i = 0; i < dev->num_blocks; ++i) {
+		if(block_rw(dev, i, 1, iops_test_bufs[0], 0) != BLOCK_OK) return FAIL;
+	}
+	lz4_cycles = (uint32_t)(rdtsc() - start);
+	lz4_ticks = rtc_get_ticks() - lz4_ticks;
+
+	/* What the ramdisk would have done instead */
+	copy_ticks = rtc_get_ticks();
+	start = rdtsc();
+	for(i = 0; i < dev->num_blocks; ++i) {
+		memcpy(iops_test_bufs[0], iops_test_bufs[1 + i % (IOPS_TEST_DEPTH - 1)], BLOCK_SIZE);
+	}
+	copy_cycles = (uint32_t)(rdtsc() - start);
+	copy_ticks = rtc_get_ticks() - copy_ticks;
+
+	lz4disk_get_stats(&st);
+	printf("lz4disk: %u kB in RAM instead of %u kB\n", st.image_bytes / 1024,
+		dev->num_blocks * (BLOCK_SIZE / 1024));
+	printf("read %u blocks: lz4disk %u cycles/block (%u kB/s), ramdisk %u cycles/block (%u kB/s)\n",
+		dev->num_blocks, lz4_cycles / dev->num_blocks,
+		dev->num_blocks * (BLOCK_SIZE / 1024) * OS_RTC_MAX / (lz4_ticks ? lz4_ticks : 1),
+		copy_cycles / dev->num_blocks,
+		dev->num_blocks * (BLOCK_SIZE / 1024) * OS_RTC_MAX / (copy_ticks ? copy_ticks : 1));
+	lz4disk_print_stats();
+
+	return PASS;
+}
+
+/* Overlay Test
+ *
+ * Creates a file and overwrites part of frame0.txt, then resets the filesystem
+ *		through "dev/overlay" and checks both changes are gone
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the reset time and overlay usage
+ * Coverage: overlay copy-up and discard, filesystem_reset, "dev/overlay"
+ * Files: overlay.c, filesystem_driver.c
+ */
+int overlay_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	uint8_t before[16], after[16];
+	int32_t fd, entries;
+	uint32_t cycles;
+	uint64_t start;
+	dentry_t d;
+
+	if(!fs_dev || strncmp((int8_t*)fs_dev->name, "overlay", 8)) {
+		printf("filesystem isn't on the overlay, skipping\n");
+		return PASS;
+	}
+
+	entries = root.num_dir_entries;
+	if((fd = open((uint8_t*)"frame0.txt")) == -1) return FAIL;
+	if(pread(fd, before, sizeof(before), 0) != sizeof(before)) result = FAIL;
+	if(pwrite(fd, "overlay", 7, 0) != 7) result = FAIL;
+	close(fd);
+
+	if((fd = creat((uint8_t*)"overlay_test")) == -1) return FAIL;
+	if(write(fd, "scratch", 7) != 7) result = FAIL;
+	close(fd);
+	if(read_dentry_by_name((uint8_t*)"overlay_test", &d)) result = FAIL;
+	overlay_print_stats();
+
+	if((fd = open((uint8_t*)"dev/overlay")) == -1) return FAIL;
+	start = rdtsc();
+	if(write(fd, "reset", 5) != 5) result = FAIL;
+	cycles = (uint32_t)(rdtsc() - start);
+	close(fd);
+	printf("reset in %u cycles\n", cycles);
+
+	/* Everything reads as the base image again */
+	if(!read_dentry_by_name((uint8_t*)"overlay_test", &d)) result = FAIL;
+	if(root.num_dir_entries != entries) result = FAIL;
+	if((fd = open((uint8_t*)"frame0.txt")) == -1) return FAIL;
+	if(pread(fd, after, sizeof(after), 0) != sizeof(after) || strncmp((int8_t*)before, (int8_t*)after, sizeof(before))) result = FAIL;
+	close(fd);
+	overlay_print_stats();
+
+	return result;
+}
+
+/* Bytes each tmpfs_test write benchmark writes, in BLOCK_SIZE writes */
+#define TMPFS_BENCH_BYTES (512 * 1024)
+
+/* static int32_t tmpfs_bench_append(const uint8_t* name, uint32_t* ticks);
+ * Inputs: name - file to create and append to
+ *			ticks - set to the RTC ticks the appends took
+ * Return Value: cycles the appends took, -1 if the file couldn't be written
+ * Function: Appends TMPFS_BENCH_BYTES to a new file one block at a time with
+ *				pwrite at the end of file, which both filesystems do in place
+ */
+static int32_t tmpfs_bench_append(const uint8_t* name, uint32_t* ticks) {
+	uint32_t off, cycles;
+	uint64_t start;
+	int32_t fd;
+
+	if((fd = creat(name)) == -1) return -1;
+	*ticks = rtc_get_ticks();
+	start = rdtsc();
+	for(off = 0; off < TMPFS_BENCH_BYTES; off += BLOCK_SIZE) {
+		if(pwrite(fd, iops_test_bufs[(off / BLOCK_SIZE) % IOPS_TEST_DEPTH], BLOCK_SIZE, off) != BLOCK_SIZE) break;
+	}
+	cycles = (uint32_t)(rdtsc() - start);
+	*ticks = rtc_get_ticks() - *ticks;
+	close(fd);
+	unlink(name);
+	return off < TMPFS_BENCH_BYTES ? -1 : (int32_t) cycles;
+}
+
+/* Tmpfs Test
+ *
+ * Asserts tmpfs files append, read back holes as zeros and free their pages
+ *		when removed, then compares append throughput with a regular file
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints cycles per kB and kB/s for each filesystem
+ * Coverage: tmpfs file and mount point operations, frame_alloc
+ * Files: tmpfs.c, paging.c, dir_operations.c, open.c
+ */
+int tmpfs_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	uint8_t buf[16];
+	int32_t fd, i, cnt, tmp_cycles, reg_cycles;
+	uint32_t frames, tmp_ticks, reg_ticks;
+	dirent_t ents[4];
+	stat_t st;
+
+	frames = frame_count_free();
+	if((fd = creat((uint8_t*)"tmp/t0")) == -1) return FAIL;
+	if(write(fd, "hello", 5) != 5 || write(fd, " world", 6) != 6) result = FAIL;
+	if(pread(fd, buf, sizeof(buf), 0) != 11 || strncmp((int8_t*)buf, "hello world", 11)) result = FAIL;
+
+	/* A write two pages out leaves a hole, and grows the tree past height 0 */
+	if(pwrite(fd, "end", 3, 2 * FOUR_KB + 1) != 3) result = FAIL;
+	if(pread(fd, buf, sizeof(buf), FOUR_KB) != sizeof(buf)) result = FAIL;
+	for(i = 0; i < sizeof(buf); ++i) {
+		if(buf[i]) result = FAIL;
+	}
+	if(fstat(fd, &st) || st.length != 2 * FOUR_KB + 4 || st.blocks != 2) result = FAIL;
+	close(fd);
+
+	/* The mount point lists the file */
+	if((fd = open((uint8_t*)"tmp")) == -1) return FAIL;
+	cnt = getdents(fd, ents, sizeof(ents));
+	if(cnt != sizeof(dirent_t) || strncmp((int8_t*)ents[0].name, "t0", 3) || ents[0].length != st.length) result = FAIL;
+	close(fd);
+
+	if(unlink((uint8_t*)"tmp/t0") || !stat((uint8_t*)"tmp/t0", &st)) result = FAIL;
+	if(frame_count_free() < frames) result = FAIL;
+
+	/* Append throughput, regular files go through the block allocator and buffer cache */
+	if((tmp_cycles = tmpfs_bench_append((uint8_t*)"tmp/bench", &tmp_ticks)) < 0) return FAIL;
+	printf("tmpfs: %u cycles/kB (%u kB/s)\n", tmp_cycles / (TMPFS_BENCH_BYTES / 1024),
+		(TMPFS_BENCH_BYTES / 1024) * OS_RTC_MAX / (tmp_ticks ? tmp_ticks : 1));
+	if((reg_cycles = tmpfs_bench_append((uint8_t*)"tmpfs_bench", &reg_ticks)) < 0) {
+		printf("%s is full, skipping regular file comparison\n", fs_dev->name);
+		return result;
+	}
+	printf("%s: %u cycles/kB (%u kB/s)\n", fs_dev->name, reg_cycles / (TMPFS_BENCH_BYTES / 1024),
+		(TMPFS_BENCH_BYTES / 1024) * OS_RTC_MAX / (reg_ticks ? reg_ticks : 1));
+
+	return result;
+}
+
+/* Size of the file file_throughput_test reads, and the largest single read it makes */
+#define TP_TEST_BYTES (256 * 1024)
+#define TP_TEST_MAX_READ (64 * 1024)
+
+static uint8_t tp_test_buf[TP_TEST_MAX_READ];
+
+/* File Throughput Test
+ *
+ * Writes a file, checks readv scatters it correctly, then times reading the
+ *		whole file with read at sizes from 64 B to 64 kB and with readv
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints cycles per kB and kB/s for each read size
+ * Coverage: read_datav, bread_run, bmap_run, readv, writev
+ * Files: file_operations.c, buffer_cache.c, readv.c, writev.c
+ */
+int file_throughput_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	static const uint32_t sizes[] = {64, 512, 4096, 16384, TP_TEST_MAX_READ};
+	uint32_t i, j, off, cycles, ticks;
+	int32_t fd, n;
+	iovec_t iov[4];
+	uint64_t start;
+
+	for(i = 0; i < TP_TEST_MAX_READ; ++i) tp_test_buf[i] = i % 251;
+
+	/* writev replaces the contents, like write */
+	if((fd = creat((uint8_t*)"tp_test")) == -1) return FAIL;
+	iov[0].base = "ab";
+	iov[0].len = 2;
+	iov[1].base = "";
+	iov[1].len = 0;
+	iov[2].base = "cde";
+	iov[2].len = 3;
+	if(writev(fd, iov, 3) != 5 || pread(fd, tp_test_buf + TP_TEST_MAX_READ - 8, 8, 0) != 5 ||
+			strncmp((int8_t*)tp_test_buf + TP_TEST_MAX_READ - 8, "abcde", 5)) result = FAIL;
+
+	for(off = 0; off < TP_TEST_BYTES; off += TP_TEST_MAX_READ) {
+		if(pwrite(fd, tp_test_buf, TP_TEST_MAX_READ, off) != TP_TEST_MAX_READ) break;
+	}
+	if(off < TP_TEST_BYTES) {
+		printf("%s is full, skipping throughput\n", fs_dev->name);
+		close(fd);
+		unlink((uint8_t*)"tp_test");
+		return result;
+	}
+
+	/* Uneven buffers that straddle block boundaries */
+	iov[0].base = tp_test_buf;
+	iov[0].len = 100;
+	iov[1].base = tp_test_buf + 100;
+	iov[1].len = 0;
+	iov[2].base = tp_test_buf + 100;
+	iov[2].len = BLOCK_SIZE + 3;
+	iov[3].base = tp_test_buf + BLOCK_SIZE + 103;
+	iov[3].len = 2 * BLOCK_SIZE;
+	lseek(fd, 7, SEEK_SET);
+	memset(tp_test_buf, 0, sizeof(tp_test_buf));
+	if(readv(fd, iov, 4) != 3 * BLOCK_SIZE + 103 || lseek(fd, 0, SEEK_CUR) != 3 * BLOCK_SIZE + 110) result = FAIL;
+	for(i = 0; i < 3 * BLOCK_SIZE + 103; ++i) {
+		if(tp_test_buf[i] != (i + 7) % 251) {
+			result = FAIL;
+			break;
+		}
+	}
+
+	for(j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j) {
+		lseek(fd, 0, SEEK_SET);
+		ticks = rtc_get_ticks();
+		start = rdtsc();
+		for(off = 0; (n = read(fd, tp_test_buf, sizes[j])) > 0; off += n) continue;
+		cycles = (uint32_t)(rdtsc() - start);
+		ticks = rtc_get_ticks() - ticks;
+		if(off != TP_TEST_BYTES) result = FAIL;
+		printf("read %u B: %u cycles/kB (%u kB/s)\n", sizes[j], cycles / (TP_TEST_BYTES / 1024),
+			(TP_TEST_BYTES / 1024) * OS_RTC_MAX / (ticks ? ticks : 1));
+	}
+
+	/* Same 64 kB per call, gathered into four buffers */
+	for(i = 0; i < 4; ++i) {
+		iov[i].base = tp_test_buf + i * (TP_TEST_MAX_READ / 4);
+		iov[i].len = TP_TEST_MAX_READ / 4;
+	}
+	lseek(fd, 0, SEEK_SET);
+	start = rdtsc();
+	for(off = 0; (n = readv(fd, iov, 4)) > 0; off += n) continue;
+	cycles = (uint32_t)(rdtsc() - start);
+	if(off != TP_TEST_BYTES) result = FAIL;
+	printf("readv 4 x %u B: %u cycles/kB\n", TP_TEST_MAX_READ / 4, cycles / (TP_TEST_BYTES / 1024));
+	bcache_print_stats();
+
+	close(fd);
+	unlink((uint8_t*)"tp_test");
+	return result;
+}
+
+/* Sysenter Test
+ *
+ * Asserts the sysenter MSRs point at sysenter_handler on the kernel code
+ *		segment and the time page tells user programs to use sysenter only
+ *		if the CPU has it. sysexit only returns to user mode, so the round
+ *		trip itself is timed by the sysbench user program
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: sysenter_init, time page features
+ * Files: idt.c, syscalls.S, time_page.c
+ */
+int sysenter_test(void) {
+	TEST_HEADER;
+
+	uint32_t regs[4];
+	uint32_t esp;
+
+	cpuid(CPUID_FEATURES, regs);
+	if(!(regs[3] & CPUID_EDX_SEP)) {
+		printf("no sysenter on this CPU, checking programs use int $0x80\n");
+		return (time_page_get()->features & TIME_PAGE_SYSENTER) ? FAIL : PASS;
+	}
+	if(!(time_page_get()->features & TIME_PAGE_SYSENTER)) return FAIL;
+
+	/* sysexit's user selectors come from this one */
+	if((uint32_t) rdmsr(MSR_SYSENTER_CS) != KERNEL_CS || KERNEL_CS + 16 != (USER_CS & ~3) ||
+			KERNEL_CS + 24 != (USER_DS & ~3)) return FAIL;
+	if((uint32_t) rdmsr(MSR_SYSENTER_EIP) != (uint32_t) &sysenter_handler) return FAIL;
+
+	/* The scratch stack must be in the kernel page */
+	esp = (uint32_t) rdmsr(MSR_SYSENTER_ESP);
+	if(esp < FOUR_MB || esp > EIGHT_MB) return FAIL;
+
+	return PASS;
+}
+
+/* Ring Test
+ *
+ * Asserts the I/O ring completes no-ops and file reads as it takes them, parks
+ *		an rtc read until the next tick, and hands back every user_data
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: ring_create, ring_submit, ring_wait, ring_destroy
+ * Files: ring.c
+ */
+int ring_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	uint8_t buf[64], expect[64];
+	uint32_t free_before = frame_count_free(), seen = 0, i;
+	ring_ctx_t* ctx;
+	ring_sqe_t* sqe;
+	ring_cqe_t* cqe;
+	int32_t fd, rtc_fd;
+
+	if((fd = open((uint8_t*)"frame0.txt")) == -1) return FAIL;
+	if(pread(fd, expect, sizeof(expect), 8) != sizeof(expect)) result = FAIL;
+	if((rtc_fd = open((uint8_t*)"rtc")) == -1) {
+		close(fd);
+		return FAIL;
+	}
+	if(!(ctx = ring_create())) {
+		close(fd);
+		close(rtc_fd);
+		return FAIL;
+	}
+
+	/* user_data i for entry i: four no-ops, a pread, an rtc read */
+	for(i = 0; i < 6; ++i) {
+		sqe = &ctx->ring->sq[ctx->ring->sq_tail++ % RING_SQ_ENTRIES];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->user_data = i;
+	}
+	ctx->ring->sq[4].opcode = RING_OP_READ;
+	ctx->ring->sq[4].fd = fd;
+	ctx->ring->sq[4].buf = buf;
+	ctx->ring->sq[4].len = sizeof(buf);
+	ctx->ring->sq[4].offset = 8;
+	ctx->ring->sq[5].opcode = RING_OP_READ;
+	ctx->ring->sq[5].fd = rtc_fd;
+	ctx->ring->sq[5].offset = RING_OFFSET_CUR;
+
+	if(ring_submit(ctx, 6) != 6 || ctx->ring->sq_head != 6) result = FAIL;
+	if(ctx->ring->cq_tail + ctx->inflight != 6) result = FAIL;
+	ring_wait(ctx, 6);
+	if(ctx->ring->cq_tail != 6 || ctx->inflight) result = FAIL;
+
+	for(i = 0; i < ctx->ring->cq_tail; ++i) {
+		cqe = &ctx->ring->cq[i];
+		seen |= 1 << cqe->user_data;
+		if(cqe->user_data == 4 && cqe->res != sizeof(buf)) result = FAIL;
+		if(cqe->user_data != 4 && cqe->res != 0) result = FAIL;
+	}
+	if(seen != 0x3F || strncmp((int8_t*)buf, (int8_t*)expect, sizeof(buf))) result = FAIL;
+
+	ring_destroy(ctx);
+	close(fd);
+	close(rtc_fd);
+	if(frame_count_free() != free_before) result = FAIL;
+	return result;
+}
+
+/* Ring Map Test
+ *
+ * Asserts a process' ring page is mapped while it is current_pcb and gone
+ *		from the page table once another process, or none, runs
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: ring_map_current
+ * Files: ring.c
+ */
+int ring_map_test(void) {
+	TEST_HEADER;
+
+	static pcb_t owner, other;
+	int result = PASS;
+	pcb_t* saved = current_pcb;
+	pte_t* pte = &page_table_vidmap[RING_PAGE_INDEX];
+	ring_ctx_t* ctx;
+
+	if(!(ctx = ring_create())) return FAIL;
+	ctx->user_addr = RING_PAGE_ADDR;
+	owner.ring = ctx;
+	other.ring = NULL;
+
+	current_pcb = &owner;
+	ring_map_current();
+	if(!pte->present || !pte->user_super || !pte->read_write_perm ||
+			pte->page_base_addr != get_physical_addr((uint32_t) ctx->ring) / FOUR_KB) result = FAIL;
+
+	current_pcb = &other;
+	ring_map_current();
+	if(pte->present) result = FAIL;
+
+	current_pcb = saved;
+	ring_map_current();
+	ring_destroy(ctx);
+	return result;
+}
+
+/* Time Page Test
+ *
+ * Asserts the time page is mapped read-only for users at TIME_PAGE_ADDR, and
+ *		that its tick count and wall clock follow the RTC
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the measured TSC rate
+ * Coverage: time_page_init, time_page_tick, map_shared_frame
+ * Files: time_page.c, paging.c, rtc.c
+ */
+int time_page_test(void) {
+	TEST_HEADER;
+
+	const time_page_t* page = time_page_get();
+	const time_page_t* user = (const time_page_t*) TIME_PAGE_ADDR;
+	pte_t* pte = &page_table_vidmap[TIME_PAGE_INDEX];
+	uint32_t ticks, stop;
+
+	if(!pte->present || !pte->user_super || pte->read_write_perm) return FAIL;
+	if(pte->page_base_addr * FOUR_KB != (uint32_t) page) return FAIL; /* kernel page is identity mapped */
+	if(user->tick_hz != TIME_PAGE_HZ) return FAIL;
+
+	/* Later than 2020-01-01 */
+	if(page->wall_sec < 1577836800) return FAIL;
+
+	ticks = page->ticks;
+	stop = rtc_wait(10);
+	while(rtc_check(stop));
+	if(page->ticks == ticks || page->ticks != rtc_get_ticks()) return FAIL;
+	if(page->seq & 1) return FAIL;
+
+	printf("time page: tick %u, TSC %u Hz\n", page->ticks, page->tsc_hz);
+	return PASS;
+}
+
+static strace_stats_t strace_test_stats;
+
+/* Strace Test
+ *
+ * Asserts traced syscalls land in the ring and their histograms with the
+ *		right numbers, results and pid, and that the filter skips other pids
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: strace_syscall, strace device files, devfs
+ * Files: strace.c, devfs.c, process.c
+ */
+int strace_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	strace_record_t recs[4];
+	strace_stats_t* st = &strace_test_stats;
+	hw_context_t ctx;
+	int32_t fd, hfd, n;
+	uint32_t pid;
+
+	if(push_pcb() == -1) return FAIL;
+	pid = current_pcb->pid;
+
+	if((fd = open((uint8_t*)"dev/strace")) == -1 || (hfd = open((uint8_t*)"dev/strace_hist")) == -1) {
+		result = FAIL;
+		goto done;
+	}
+	if(write(fd, "bogus", 5) != -1 || creat((uint8_t*)"dev/x") != -1) result = FAIL;
+
+	strace_clear();
+	strace_start(STRACE_FILTER_TREE, pid);
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.eax = 21; /* getpid */
+	if(strace_syscall(&ctx) != pid) result = FAIL;
+	ctx.eax = 6; /* close */
+	ctx.ebx = 99;
+	if(strace_syscall(&ctx) != -1) result = FAIL;
+
+	/* Only descendants, so this one isn't recorded */
+	strace_start(STRACE_FILTER_CHILDREN, pid);
+	ctx.eax = 21;
+	strace_syscall(&ctx);
+	strace_stop();
+
+	n = read(fd, recs, sizeof(recs));
+	if(n != 2 * sizeof(strace_record_t)) result = FAIL;
+	if(recs[0].nr != 21 || recs[0].pid != pid || recs[0].result != pid) result = FAIL;
+	if(recs[1].nr != 6 || recs[1].args[0] != 99 || recs[1].result != -1) result = FAIL;
+	if(read(fd, recs, sizeof(recs)) != 0) result = FAIL;
+
+	if(read(hfd, st, sizeof(*st)) != sizeof(*st)) result = FAIL;
+	if(st->enabled || st->recorded != 2 || st->dropped) result = FAIL;
+	if(st->hist[21].calls != 1 || st->hist[6].calls != 1 || st->hist[6].errors != 1) result = FAIL;
+	printf("getpid: %u cycles traced\n", recs[0].cycles);
+
+	close(fd);
+	close(hfd);
+done:
+	strace_clear();
+	pop_pcb();
+	return result;
+}
+
+/* Rounds each interrupt controller operation is timed over */
+#define IRQ_BENCH_ROUNDS 1000
+/* Free ISA line the dispatch benchmark borrows (COM2) */
+#define IRQ_BENCH_IRQ 3
+
+static volatile uint32_t irq_bench_count;
+
+static void irq_bench_handler(void) {
+	irq_bench_count++;
+}
+
+/* IRQ Overhead Test
+ *
+ * Times EOI, mask changes and a full trip through do_irq with the 8259 and,
+ *		when present, the APICs, and checks the local APIC timer ticks at
+ *		the rate it was set to
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints cycles per operation, briefly unmasks IRQ 3
+ * Coverage: send_eoi, enable_irq, disable_irq, do_irq, apic_timer_start
+ * Files: i8259.c, apic.c, irq.S
+ */
+int irq_overhead_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	uint32_t i, flags, stop;
+	uint8_t mask;
+	uint64_t start;
+
+	cli_and_save(flags);
+
+	/* What enable_irq used to do: read the mask back from the PIC */
+	start = rdtsc();
+	for(i = 0; i < IRQ_BENCH_ROUNDS; ++i) {
+		mask = inb(MASTER_8259_PORT+1);
+		outb(mask, MASTER_8259_PORT+1);
+	}
+	printf("8259 mask read-modify-write: %u cycles\n", (uint32_t) (rdtsc() - start) / IRQ_BENCH_ROUNDS);
+
+	start = rdtsc();
+	for(i = 0; i < IRQ_BENCH_ROUNDS; ++i) {
+		enable_irq(IRQ_BENCH_IRQ);
+		disable_irq(IRQ_BENCH_IRQ);
+	}
+	printf("%s unmask+mask: %u cycles\n", apic_enabled ? "I/O APIC" : "8259 cached",
+		(uint32_t) (rdtsc() - start) / IRQ_BENCH_ROUNDS);
+
+	start = rdtsc();
+	for(i = 0; i < IRQ_BENCH_ROUNDS; ++i) i8259_eoi(RTC_IRQ);
+	printf("8259 EOI: %u cycles\n", (uint32_t) (rdtsc() - start) / IRQ_BENCH_ROUNDS);
+
+	if(apic_enabled) {
+		start = rdtsc();
+		for(i = 0; i < IRQ_BENCH_ROUNDS; ++i) apic_eoi();
+		printf("local APIC EOI: %u cycles\n", (uint32_t) (rdtsc() - start) / IRQ_BENCH_ROUNDS);
+	}
+
+	/* Whole path: IDT, hw_context_t frame, do_irq, handler, EOI */
+	irq_bench_count = 0;
+	register_interrupt_handler(IRQ_BENCH_IRQ, irq_bench_handler);
+	start = rdtsc();
+	for(i = 0; i < IRQ_BENCH_ROUNDS; ++i) asm volatile ("int $0x23");
+	printf("interrupt round trip: %u cycles\n", (uint32_t) (rdtsc() - start) / IRQ_BENCH_ROUNDS);
+	remove_interrupt_handler(IRQ_BENCH_IRQ, irq_bench_handler);
+	if(irq_bench_count != IRQ_BENCH_ROUNDS) result = FAIL;
+	if(i8259_handler_count[IRQ_BENCH_IRQ] != 0) result = FAIL;
+
+	restore_flags(flags);
+
+	/* About 100 timer interrupts in 100 ms of RTC time */
+	if(apic_enabled) {
+		irq_bench_count = 0;
+		register_interrupt_handler(APIC_TIMER_IRQ, irq_bench_handler);
+		apic_timer_start(1000);
+		stop = rtc_wait(100);
+		while(rtc_check(stop));
+		apic_timer_start(0);
+		remove_interrupt_handler(APIC_TIMER_IRQ, irq_bench_handler);
+		printf("local APIC timer: %u Hz, %u ticks in 100 ms\n", apic_timer_rate(), irq_bench_count);
+		if(irq_bench_count < 50 || irq_bench_count > 200) result = FAIL;
+	}
+
+	return result;
+}
+
+/* Timer callbacks the softirq test registers */
+#define SOFTIRQ_BENCH_TIMERS 16
+/* Bytes the stand-in for packet parsing reads per interrupt, a full frame */
+#define SOFTIRQ_BENCH_BYTES 1514
+
+static uint8_t softirq_bench_frame[SOFTIRQ_BENCH_BYTES];
+static volatile uint32_t softirq_bench_runs, softirq_bench_irq_on, softirq_bench_sum;
+static uint32_t softirq_bench_hard_cycles;
+static tasklet_t softirq_bench_tasklet;
+
+/* Sums a frame and notes whether interrupts were on, like a protocol handler would run */
+static void softirq_bench_work(uint32_t arg) {
+	uint32_t i, flags, sum = 0;
+
+	asm volatile ("pushfl; popl %0" : "=r"(flags));
+	if(flags & EFLAGS_IF) softirq_bench_irq_on++;
+	for(i = 0; i < SOFTIRQ_BENCH_BYTES; ++i) sum += softirq_bench_frame[i];
+	softirq_bench_sum += sum;
+	softirq_bench_runs++;
+}
+
+/* Hard IRQ handler doing the work itself, as e1000_interrupt used to */
+static void softirq_bench_inline(void) {
+	uint64_t start = rdtsc();
+	softirq_bench_work(0);
+	softirq_bench_hard_cycles += (uint32_t) (rdtsc() - start);
+}
+
+/* Hard IRQ handler that only queues the work */
+static void softirq_bench_deferred(void) {
+	uint64_t start = rdtsc();
+	tasklet_schedule(&softirq_bench_tasklet);
+	softirq_bench_hard_cycles += (uint32_t) (rdtsc() - start);
+}
+
+/* Softirq Test
+ *
+ * Checks tasklets scheduled by a hard IRQ and expired RTC callbacks run
+ *		once each, after the handler, with interrupts on, and compares the
+ *		interrupts-off time of a handler doing its work inline with one that
+ *		defers it
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints cycles per interrupt, briefly unmasks IRQ 3
+ * Coverage: tasklet_schedule, do_softirq, rtc_register_handler, do_irq_main
+ * Files: softirq.c, rtc.c, process.c
+ */
+int softirq_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	softirq_stats_t before, after;
+	uint32_t i, flags, inline_cycles, stop;
+
+	memset(softirq_bench_frame, 0xA5, SOFTIRQ_BENCH_BYTES);
+	tasklet_init(&softirq_bench_tasklet, softirq_bench_work, 0);
+	softirq_get_stats(&before);
+
+	/* Scheduling twice before it runs still runs it once */
+	softirq_bench_runs = softirq_bench_irq_on = 0;
+	cli_and_save(flags);
+	tasklet_schedule(&softirq_bench_tasklet);
+	tasklet_schedule(&softirq_bench_tasklet);
+	do_softirq();
+	restore_flags(flags);
+	if(softirq_bench_runs != 1 || softirq_bench_irq_on != 1) result = FAIL;
+
+	/* The old way: all the work with interrupts off */
+	softirq_bench_runs = softirq_bench_irq_on = softirq_bench_hard_cycles = 0;
+	register_interrupt_handler(IRQ_BENCH_IRQ, softirq_bench_inline);
+	for(i = 0; i < IRQ_BENCH_ROUNDS; ++i) asm volatile ("int $0x23");
+	remove_interrupt_handler(IRQ_BENCH_IRQ, softirq_bench_inline);
+	inline_cycles = softirq_bench_hard_cycles;
+	if(softirq_bench_runs != IRQ_BENCH_ROUNDS || softirq_bench_irq_on != 0) result = FAIL;
+
+	/* Deferred: the handler queues it, do_softirq runs it on the way out */
+	softirq_bench_runs = softirq_bench_irq_on = softirq_bench_hard_cycles = 0;
+	register_interrupt_handler(IRQ_BENCH_IRQ, softirq_bench_deferred);
+	for(i = 0; i < IRQ_BENCH_ROUNDS; ++i) asm volatile ("int $0x23");
+	remove_interrupt_handler(IRQ_BENCH_IRQ, softirq_bench_deferred);
+	if(softirq_bench_runs != IRQ_BENCH_ROUNDS || softirq_bench_irq_on != IRQ_BENCH_ROUNDS) result = FAIL;
+
+	printf("handler with interrupts off: %u cycles inline, %u cycles deferred\n",
+		inline_cycles / IRQ_BENCH_ROUNDS, softirq_bench_hard_cycles / IRQ_BENCH_ROUNDS);
+
+	/* RTC callbacks go through the timer softirq */
+	softirq_bench_runs = softirq_bench_irq_on = 0;
+	for(i = 0; i < SOFTIRQ_BENCH_TIMERS; ++i) rtc_register_handler(softirq_bench_work, i, 0);
+	stop = rtc_wait(10);
+	while(rtc_check(stop) && softirq_bench_runs < SOFTIRQ_BENCH_TIMERS);
+	if(softirq_bench_runs != SOFTIRQ_BENCH_TIMERS || softirq_bench_irq_on != SOFTIRQ_BENCH_TIMERS) result = FAIL;
+
+	softirq_get_stats(&after);
+	if(after.runs[SOFTIRQ_TIMER] == before.runs[SOFTIRQ_TIMER]) result = FAIL;
+	if(after.tasklets - before.tasklets < IRQ_BENCH_ROUNDS + 1) result = FAIL;
+	printf("softirq: %u passes, %u deferred, longest %u cycles\n",
+		after.passes - before.passes, after.deferred - before.deferred, after.max_cycles);
+
+	return result;
+}
+
+/* Cycles the irqstat test keeps interrupts off for */
+#define IRQSTAT_TEST_WINDOW 200000
+
+static irqstat_stats_t irqstat_test_stats;
+
+/* IRQ Stat Test
+ *
+ * Checks software interrupts through do_irq are counted, histogrammed and
+ *		attributed to their handler, and with IRQOFF_TIMING that a long
+ *		cli_and_save window is reported as the longest with its call sites
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the statistics, briefly unmasks IRQ 3
+ * Coverage: do_irq_common, do_irq, cli_and_save, restore_flags
+ * Files: irqstat.c, i8259.c, irq.S, lib.h
+ */
+int irqstat_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	irqstat_stats_t* st = &irqstat_test_stats;
+	irqstat_line_t* l = &st->irq[IRQ_BENCH_IRQ];
+	uint32_t i, flags, sum = 0;
+	uint64_t start;
+
+	irqstat_clear();
+	irq_bench_count = 0;
+	register_interrupt_handler(IRQ_BENCH_IRQ, irq_bench_handler);
+	for(i = 0; i < IRQ_BENCH_ROUNDS; ++i) asm volatile ("int $0x23");
+	remove_interrupt_handler(IRQ_BENCH_IRQ, irq_bench_handler);
+
+	cli_and_save(flags);
+	start = rdtsc();
+	while(rdtsc() - start < IRQSTAT_TEST_WINDOW);
+	restore_flags(flags);
+
+	irqstat_get_stats(st);
+	if(l->count != IRQ_BENCH_ROUNDS || l->handler[0] != (uint32_t) irq_bench_handler) result = FAIL;
+	if(!l->eoi_max || l->eoi_max < l->dispatch_max || l->handler_max[0] > l->eoi_max) result = FAIL;
+	for(i = 0; i < IRQSTAT_HIST_BUCKETS; ++i) sum += l->buckets[i];
+	if(sum != IRQ_BENCH_ROUNDS) result = FAIL;
+	printf("irq %u: %u cycles entry to EOI, handler %u, dispatch at most %u\n", IRQ_BENCH_IRQ,
+		l->cycles_lo / IRQ_BENCH_ROUNDS, l->handler_cycles[0] / IRQ_BENCH_ROUNDS, l->dispatch_max);
+
+#ifdef IRQOFF_TIMING
+	/* The window only counts if interrupts were on before it */
+	if((flags & EFLAGS_IF) && (st->longest[0].cycles < IRQSTAT_TEST_WINDOW ||
+			st->longest[0].restore_site <= st->longest[0].cli_site)) result = FAIL;
+	printf("longest interrupts-off window: %u cycles, cli at 0x%x\n",
+		st->longest[0].cycles, st->longest[0].cli_site);
+#else
+	if(st->windows) result = FAIL;
+#endif
+
+	return result;
+}
+
+/* Port with no listener, so the poll test's UDP entry is never ready */
+#define POLL_TEST_PORT 39100
+#define POLL_TEST_MS 100
+
+/* Poll Test
+ *
+ * Checks files are always ready, bad fds report POLLNVAL, negative fds are
+ *		skipped, an RTC wakes poll up, and a timeout with nothing ready
+ *		returns 0 after halting the CPU rather than spinning
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the halted share of the timeout
+ * Coverage: poll, file_poll, rtc_poll, udp_poll, time_page_idle
+ * Files: poll.c, rtc.c, udp.c, time_page.c
+ */
+int poll_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	pollfd_t fds[3];
+	int32_t file, rtc, rate = 64;
+	uint32_t idle, start;
+
+	file = open((uint8_t*)"frame0.txt");
+	rtc = open((uint8_t*)"rtc");
+	if(file == -1 || rtc == -1 || write(rtc, &rate, 0)) result = FAIL;
+
+	fds[0].fd = file;
+	fds[0].events = POLLIN | POLLOUT;
+	fds[1].fd = MAX_FDS - 1; /* not open */
+	fds[1].events = POLLIN;
+	fds[2].fd = -1;
+	fds[2].events = POLLIN;
+	if(poll(fds, 3, 0) != 2) result = FAIL;
+	if(fds[0].revents != (POLLIN | POLLOUT) || fds[1].revents != POLLNVAL || fds[2].revents) result = FAIL;
+
+	/* The RTC becomes readable within one period */
+	fds[0].fd = rtc;
+	fds[0].events = POLLIN;
+	if(poll(fds, 1, POLL_TEST_MS) != 1 || fds[0].revents != POLLIN) result = FAIL;
+	read(rtc, 0, 0);
+
+	/* Nothing arrives on an unused port, so poll sleeps out the timeout */
+	fds[0].fd = POLL_TEST_PORT;
+	fds[0].events = POLLIN | POLL_UDP;
+	idle = time_page_get()->idle_lo;
+	start = (uint32_t) rdtsc();
+	if(poll(fds, 1, POLL_TEST_MS) != 0 || fds[0].revents) result = FAIL;
+	idle = time_page_get()->idle_lo - idle;
+	start = (uint32_t) rdtsc() - start;
+	if(!idle) result = FAIL;
+	printf("poll: %u of %u cycles halted\n", idle, start);
+
+	if(close(file) || close(rtc)) result = FAIL;
+	return result;
+}
+
+/* Bytes the pipe test writes past a full ring */
+#define PIPE_TEST_EXTRA 10
+
+/* Bytes the pipe throughput loop moves, a page at a time */
+#define PIPE_TEST_BYTES (1024 * 1024)
+
+static uint8_t pipe_test_buf[2][PIPE_SIZE + PIPE_TEST_EXTRA];
+
+/* Pipe Test
+ *
+ * Checks data comes out of a pipe in order across the end of the ring, a
+ *		full pipe stops a write and reports no POLLOUT, closing the write
+ *		end gives end of file and closing the read end fails writes, and
+ *		times page-sized writes and reads
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints MB/s through the pipe
+ * Coverage: pipe, pipe_read, pipe_write, pipe_poll, pipe_close
+ * Files: pipe.c, syscalls/pipe.c
+ */
+int pipe_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	int32_t fds[2];
+	uint32_t i, flags, cycles, mhz = time_page_get()->tsc_hz / 1000000;
+	uint64_t start;
+	uint8_t *in = pipe_test_buf[0], *out = pipe_test_buf[1];
+
+	for(i = 0; i < PIPE_SIZE + PIPE_TEST_EXTRA; ++i) in[i] = (uint8_t) (i * 7);
+	if(pipe(fds) || fds[0] == fds[1]) return FAIL;
+
+	/* Leave the ring part way along so filling it wraps around */
+	if(write(fds[1], in, 100) != 100 || read(fds[0], out, PIPE_SIZE) != 100) result = FAIL;
+	if(read(fds[1], out, 1) != -1 || write(fds[0], in, 1) != -1) result = FAIL;
+
+	/* With interrupts off a full pipe stops the write instead of waiting */
+	cli_and_save(flags);
+	if(write(fds[1], in, PIPE_SIZE + PIPE_TEST_EXTRA) != PIPE_SIZE) result = FAIL;
+	restore_flags(flags);
+	if(file_poll(fds[1], POLLOUT) != 0 || file_poll(fds[0], POLLIN) != POLLIN) result = FAIL;
+	if(read(fds[0], out, PIPE_SIZE) != PIPE_SIZE) result = FAIL;
+	for(i = 0; i < PIPE_SIZE; ++i) if(in[i] != out[i]) result = FAIL;
+
+	start = rdtsc();
+	for(i = 0; i < PIPE_TEST_BYTES; i += PIPE_SIZE) {
+		write(fds[1], in, PIPE_SIZE);
+		read(fds[0], out, PIPE_SIZE);
+	}
+	cycles = (uint32_t) (rdtsc() - start);
+	if(mhz && cycles / mhz) printf("pipe: %u MB/s in page-sized writes and reads\n", PIPE_TEST_BYTES / (cycles / mhz));
+
+	/* Closing the write end: what's left, then end of file */
+	write(fds[1], in, 10);
+	close(fds[1]);
+	if(file_poll(fds[0], POLLIN) != (POLLIN | POLLHUP)) result = FAIL;
+	if(read(fds[0], out, PIPE_SIZE) != 10 || read(fds[0], out, PIPE_SIZE) != 0) result = FAIL;
+	close(fds[0]);
+
+	/* Closing the read end fails writes */
+	if(pipe(fds)) return FAIL;
+	close(fds[0]);
+	if(write(fds[1], in, 1) != -1 || file_poll(fds[1], POLLOUT) != POLLERR) result = FAIL;
+	close(fds[1]);
+
+	return result;
+}
+
+/* Non-blocking Test
+ *
+ * Checks fcntl sets and reports O_NONBLOCK without touching the rtc rate
+ *		kept in the same flags, and that an rtc before its period, an empty
+ *		or full pipe and a UDP port with nothing queued return -EAGAIN
+ *		instead of waiting
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: fcntl, rtc_read, rtc_write, pipe_read, pipe_write, udp_recv_nonblock
+ * Files: fcntl.c, rtc.c, pipe.c, udp.c
+ */
+int nonblock_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	int32_t rtc, fds[2], rate = 2;
+	uint8_t *in = pipe_test_buf[0], *out = pipe_test_buf[1];
+
+	if((rtc = open((uint8_t*)"rtc")) == -1) return FAIL;
+	if(fcntl(rtc, F_GETFL, 0) != 0 || fcntl(rtc, F_SETFL, O_NONBLOCK)) result = FAIL;
+	if(fcntl(rtc, F_GETFL, 0) != O_NONBLOCK) result = FAIL;
+	if(fcntl(rtc, F_GETFL + F_SETFL, 0) != -1 || fcntl(-1, F_GETFL, 0) != -1) result = FAIL;
+
+	/* Straight after open the period hasn't passed, at any rate */
+	if(read(rtc, 0, 0) != -EAGAIN) result = FAIL;
+	if(write(rtc, &rate, sizeof(rate)) || fcntl(rtc, F_GETFL, 0) != O_NONBLOCK) result = FAIL;
+	if(read(rtc, 0, 0) != -EAGAIN) result = FAIL;
+
+	/* Cleared again, the read waits out the half second */
+	if(fcntl(rtc, F_SETFL, 0) || read(rtc, 0, 0) != 0) result = FAIL;
+	if(close(rtc) || fcntl(rtc, F_GETFL, 0) != -1) result = FAIL;
+
+	if(pipe(fds)) return FAIL;
+	if(fcntl(fds[0], F_SETFL, O_NONBLOCK) || fcntl(fds[1], F_SETFL, O_NONBLOCK)) result = FAIL;
+	if(read(fds[0], out, PIPE_SIZE) != -EAGAIN) result = FAIL;
+	if(write(fds[1], in, PIPE_SIZE + PIPE_TEST_EXTRA) != PIPE_SIZE) result = FAIL;
+	if(write(fds[1], in, 1) != -EAGAIN) result = FAIL;
+	if(read(fds[0], out, PIPE_SIZE) != PIPE_SIZE || read(fds[0], out, 1) != -EAGAIN) result = FAIL;
+	close(fds[0]);
+	close(fds[1]);
+
+	if(udp_recv_nonblock(POLL_TEST_PORT, out, PIPE_SIZE) != -EAGAIN) result = FAIL;
+
+	return result;
+}
+
+/* Descriptors the fd table test opens, past the inline slots */
+#define FDTABLE_TEST_FDS 40
+
+/* fd table Test
+ *
+ * Opens more descriptors than fit inline, checks the lowest free one is
+ *		reused, that dup and dup2 share the file position with the
+ *		original and outlive it, and that closing everything gives back
+ *		every open file
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: open, close, dup, dup2, fd_lowest_free, fd_install, file_put
+ * Files: fdtable.c, dup.c, open.c, close.c
+ */
+int fdtable_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	int32_t fds[FDTABLE_TEST_FDS], i, fd, dfd;
+	uint32_t free_files = file_count_free();
+	uint8_t a[10], b[10];
+
+	for(i = 0; i < FDTABLE_TEST_FDS; ++i) {
+		if((fds[i] = open((uint8_t*)"frame0.txt")) != FD_FIRST_FREE + i) result = FAIL;
+	}
+	if(file_count_free() != free_files - FDTABLE_TEST_FDS) result = FAIL;
+
+	/* A descriptor in the overflow page reads like any other */
+	fd = fds[FDTABLE_TEST_FDS - 1];
+	if(read(fd, a, sizeof(a)) != sizeof(a) || pread(fd, b, sizeof(b), 0) != sizeof(b)) result = FAIL;
+	for(i = 0; i < sizeof(a); ++i) if(a[i] != b[i]) result = FAIL;
+
+	/* The lowest free descriptor is handed out again */
+	close(fds[3]);
+	close(fds[FD_INLINE]);
+	if(open((uint8_t*)"frame0.txt") != fds[3]) result = FAIL;
+	if(open((uint8_t*)"frame0.txt") != fds[FD_INLINE]) result = FAIL;
+
+	/* dup shares the position, and keeps the file open after the original closes */
+	if((dfd = dup(fd)) < 0 || dfd != FD_FIRST_FREE + FDTABLE_TEST_FDS) result = FAIL;
+	if(read(dfd, a, sizeof(a)) != sizeof(a) || pread(fd, b, sizeof(b), sizeof(a)) != sizeof(b)) result = FAIL;
+	for(i = 0; i < sizeof(a); ++i) if(a[i] != b[i]) result = FAIL;
+	close(fd);
+	if(lseek(dfd, 0, SEEK_CUR) != 2 * sizeof(a)) result = FAIL;
+
+	/* dup2 onto an open descriptor closes what it had */
+	if(dup2(dfd, fds[0]) != fds[0] || lseek(fds[0], 0, SEEK_CUR) != 2 * sizeof(a)) result = FAIL;
+	if(dup2(dfd, MAX_FDS) != -1 || dup(MAX_FDS - 1) != -1) result = FAIL;
+	if(file_count_free() != free_files - (FDTABLE_TEST_FDS - 1)) result = FAIL;
+
+	close(dfd);
+	for(i = 0; i < FDTABLE_TEST_FDS - 1; ++i) {
+		if(close(fds[i])) result = FAIL;
+	}
+	if(file_count_free() != free_files) result = FAIL;
+
+	return result;
+}
+
+/* Rate and length of the profiler test, and samples it looks at */
+#define PROFILE_TEST_HZ 1000
+#define PROFILE_TEST_MS 100
+#define PROFILE_TEST_SAMPLES 256
+
+static profile_sample_t profile_test_samples[PROFILE_TEST_SAMPLES];
+static uint32_t profile_test_ret;
+
+/* Spins for PROFILE_TEST_MS, noting where it returns to */
+static void __attribute__((noinline)) profile_test_spin(void) {
+	uint32_t stop;
+
+	profile_test_ret = (uint32_t) __builtin_return_address(0);
+	stop = rtc_wait(PROFILE_TEST_MS);
+	while(rtc_check(stop));
+}
+
+/* Profile Test
+ *
+ * Samples a kernel loop and checks the samples are about as many as the
+ *		rate asks for, all in kernel mode, and that their backtraces lead
+ *		back to the test through the loop's frame
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the profile ring
+ * Coverage: profile_start, profile_stop, profile_drain, do_irq
+ * Files: profile.c, apic.c, i8259.c
+ */
+int profile_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	profile_sample_t* s = profile_test_samples;
+	profile_stats_t st;
+	uint32_t i, n, in_spin = 0;
+
+	if(profile_start(PROFILE_MIN_HZ - 1) != -1 || profile_start(PROFILE_MAX_HZ + 1) != -1) result = FAIL;
+
+	profile_clear();
+	if(profile_start(PROFILE_TEST_HZ)) return FAIL;
+	profile_test_spin();
+	profile_stop();
+
+	profile_get_stats(&st);
+	if(st.timer != PROFILE_TIMER_NONE || st.user) result = FAIL;
+	n = profile_drain(s, PROFILE_TEST_SAMPLES);
+	if(n != st.samples || n < PROFILE_TEST_MS / 2 || n > PROFILE_TEST_MS * 2) result = FAIL;
+
+	for(i = 0; i < n; ++i) {
+		if(s[i].user || s[i].eip < FOUR_MB || s[i].eip >= KERNEL_MEM_END) result = FAIL;
+		if((s[i].depth > 0 && s[i].frames[0] == profile_test_ret) ||
+				(s[i].depth > 1 && s[i].frames[1] == profile_test_ret)) in_spin++;
+	}
+	if(in_spin < n / 2) result = FAIL;
+	printf("profile: %u samples in %u ms (%s), %u in the loop\n", n, PROFILE_TEST_MS,
+		apic_timer_rate() ? "local APIC timer" : "PIT", in_spin);
+
+	return result;
+}
+
+/* Records the trace test looks at, and how far it overruns the ring */
+#define TRACE_TEST_RECORDS 256
+#define TRACE_TEST_OVERRUN 16
+
+static trace_record_t trace_test_records[TRACE_TEST_RECORDS];
+
+/* Trace Test
+ *
+ * With tracepoints built in, checks an interrupt through do_irq and a
+ *		file read each leave one record with their arguments, in order,
+ *		and that a zero trace_mask records nothing; built without them,
+ *		that the same work records nothing. Either way, checks a reader
+ *		that falls a ring behind starts at the oldest record kept
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Overwrites the trace ring, briefly unmasks IRQ 3
+ * Coverage: trace_event, trace_copy, do_irq, file_read
+ * Files: trace.c, i8259.c, file_operations.c
+ */
+int trace_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	trace_record_t* r = trace_test_records;
+	uint32_t pos = trace_position(), i, n, flags, irqs = 0, reads = 0;
+	uint8_t buf[10];
+	int32_t fd;
+
+	register_interrupt_handler(IRQ_BENCH_IRQ, irq_bench_handler);
+	asm volatile ("int $0x23");
+	remove_interrupt_handler(IRQ_BENCH_IRQ, irq_bench_handler);
+	fd = open((uint8_t*)"frame0.txt");
+	if(read(fd, buf, sizeof(buf)) != sizeof(buf)) result = FAIL;
+	close(fd);
+
+	n = trace_copy(r, TRACE_TEST_RECORDS, &pos);
+	for(i = 0; i < n; ++i) {
+		if(i && r[i].seq <= r[i - 1].seq) result = FAIL;
+		if(r[i].event == TRACE_IRQ && r[i].args[0] == IRQ_BENCH_IRQ && r[i].args[1] == 1) irqs++;
+		if(r[i].event == TRACE_FILE_READ && r[i].args[1] == 0 && r[i].args[2] == sizeof(buf) &&
+			r[i].args[3] == sizeof(buf)) reads++;
+	}
+#ifdef TRACEPOINTS
+	if(irqs != 1 || reads != 1) result = FAIL;
+
+	trace_mask = 0;
+	pos = trace_position();
+	fd = open((uint8_t*)"frame0.txt");
+	read(fd, buf, sizeof(buf));
+	close(fd);
+	if(trace_copy(r, TRACE_TEST_RECORDS, &pos)) result = FAIL;
+	trace_mask = TRACE_ALL;
+#else
+	if(n) result = FAIL;
+#endif
+	printf("trace: %u records for one interrupt and one read\n", n);
+
+	/* Records past the ring overwrite the oldest */
+	cli_and_save(flags);
+	pos = trace_position();
+	for(i = 0; i < TRACE_RING_ENTRIES + TRACE_TEST_OVERRUN; ++i) trace_event(TRACE_RX, i, 0, 0, 0);
+	restore_flags(flags);
+	if(trace_copy(r, 1, &pos) != 1 || r[0].args[0] != TRACE_TEST_OVERRUN ||
+		r[0].seq != pos) result = FAIL;
+
+	return result;
+}
+
+/* Klog Test
+ *
+ * Checks a message lands in the ring with its level and without its
+ *		newline, snprintf cuts off what doesn't fit, a rate limited site
+ *		lets a burst through and then reports what it held back, and
+ *		"dev/dmesg" reads whole lines from where it was cleared
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears what "dev/dmesg" reads
+ * Coverage: klog, klog_ratelimit, klog_copy, klog_flush, snprintf, dmesg device file
+ * Files: klog.c, lib.c, devfs.c
+ */
+int klog_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	klog_record_t r;
+	klog_ratelimit_t rs;
+	klog_stats_t st;
+	int8_t buf[64];
+	uint32_t pos, i, ok = 0, level = klog_console_level;
+	int32_t fd, n;
+
+	/* Keep the test's messages off the console */
+	klog_flush();
+	klog_console_level = KLOG_ERR;
+
+	if(snprintf(buf, 8, "%s-%u", "abcdef", 42) != 7 || strncmp(buf, "abcdef-", 8)) result = FAIL;
+	if(klog(KLOG_NUM_LEVELS, "bad level\n") != -1) result = FAIL;
+
+	pos = klog_position();
+	if(klog(KLOG_DEBUG, "klog test %d\n", -7) != 12) result = FAIL;
+	if(klog_copy(&r, 1, &pos) != 1 || r.level != KLOG_DEBUG || r.len != 12 ||
+		strncmp(r.text, "klog test -7", KLOG_TEXT_LEN)) result = FAIL;
+
+	memset(&rs, 0, sizeof(rs));
+	for(i = 0; i < KLOG_RATELIMIT_BURST + 5; ++i) ok += klog_ratelimit(&rs);
+	if(ok != KLOG_RATELIMIT_BURST || rs.missed != 5) result = FAIL;
+	/* The next interval starts with a note of what was held back */
+	rs.start -= KLOG_RATELIMIT_TICKS;
+	pos = klog_position();
+	if(!klog_ratelimit(&rs) || klog_copy(&r, 1, &pos) != 1 || r.level != KLOG_WARN ||
+		strncmp(r.text, "5 messages suppressed", KLOG_TEXT_LEN)) result = FAIL;
+
+	if((fd = open((uint8_t*)"dev/dmesg")) == -1) return FAIL;
+	if(write(fd, "bogus", 5) != -1 || write(fd, "console 9", 9) != -1) result = FAIL;
+	if(write(fd, "clear", 5) != 5) result = FAIL;
+	if(read(fd, buf, sizeof(buf)) != 0) result = FAIL;
+	klog(KLOG_DEBUG, "klog test line\n");
+	if(read(fd, buf, 8) != -1) result = FAIL;
+	n = read(fd, buf, sizeof(buf) - 1);
+	buf[n > 0 ? n : 0] = '\0';
+	if(n <= 0 || strncmp(buf, "<3>[", 4) || buf[n - 1] != '\n' ||
+		strncmp(&buf[n - 16], "] klog test line", 16)) result = FAIL;
+	if(read(fd, buf, sizeof(buf)) != 0) result = FAIL;
+	close(fd);
+
+	klog_flush();
+	klog_console_level = level;
+	klog_get_stats(&st);
+	if(st.drained != st.logged || st.suppressed < 5) result = FAIL;
+	printf("klog: %u logged, %u lost, %u suppressed\n", st.logged, st.lost, st.suppressed);
+
+	return result;
+}
+
+/* Bytes the uart test sends, enough to fill the transmit ring and wait */
+#define UART_TEST_BYTES (UART_TX_RING + 8 * UART_FIFO_SIZE)
+
+static uint8_t uart_test_buf[UART_TEST_BYTES];
+
+/* UART Test
+ *
+ * Sends more than the transmit ring holds through "dev/ttyS0" and checks
+ *		the write waits on interrupts, about a FIFO's worth of bytes each,
+ *		rather than polling, that every byte reaches the port, and that an empty receive ring reads as -EAGAIN
+ *		for an O_NONBLOCK fd. Skipped without a serial port
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Writes lines of text to the serial port
+ * Coverage: uart_putc, uart_interrupt, uart_flush, ttyS0 device file
+ * Files: uart.c, devfs.c, fcntl.c
+ */
+int uart_test(void) {
+	TEST_HEADER;
+
+	int result = PASS;
+	uart_stats_t before, after;
+	uint32_t i, sent, irqs, cycles;
+	uint64_t start;
+	int32_t fd;
+	uint8_t c;
+
+	if((fd = open((uint8_t*)"dev/ttyS0")) == -1) {
+		printf("no serial port, skipping\n");
+		return PASS;
+	}
+
+	for(i = 0; i < UART_TEST_BYTES; ++i) uart_test_buf[i] = (i % 64 == 63) ? '\n' : 'a' + i % 26;
+	uart_flush();
+	uart_get_stats(&before);
+	start = rdtsc();
+	if(write(fd, uart_test_buf, UART_TEST_BYTES) != UART_TEST_BYTES) result = FAIL;
+	cycles = (uint32_t) (rdtsc() - start);
+
+	/* The ring was full, so the write waited on interrupts rather than polling */
+	uart_get_stats(&after);
+	if(after.tx_waits == before.tx_waits || after.tx_polled != before.tx_polled) result = FAIL;
+	sent = after.tx_bytes - before.tx_bytes;
+	irqs = after.interrupts - before.interrupts;
+	if(irqs * (UART_FIFO_SIZE / 2) > sent) result = FAIL;
+
+	/* What is left goes out by polling */
+	uart_flush();
+	uart_get_stats(&after);
+	if(after.tx_bytes - before.tx_bytes < UART_TEST_BYTES) result = FAIL;
+
+	if(file_poll(fd, POLLIN | POLLOUT) != POLLOUT) result = FAIL;
+	if(fcntl(fd, F_SETFL, O_NONBLOCK) || read(fd, &c, 1) != -EAGAIN) result = FAIL;
+	close(fd);
+	printf("uart: %u bytes, %u interrupts, %u cycles to queue\n", sent, irqs, cycles);
+
+	return result;
+}
 
 /* Test suite entry point */
 void launch_tests(){
@@ -866,6 +2522,31 @@ void launch_tests(){
   	TEST_OUTPUT("screen_test", screen_test(), &failed_count);
     TEST_OUTPUT("arp_test", arp_test(), &failed_count);
     TEST_OUTPUT("dns_test", dns_test(), &failed_count);
+    TEST_OUTPUT("bcache_test", bcache_test(), &failed_count);
+    TEST_OUTPUT("block_iops_test", block_iops_test(), &failed_count);
+    TEST_OUTPUT("positional_io_test", positional_io_test(), &failed_count);
+    TEST_OUTPUT("getdents_test", getdents_test(), &failed_count);
+    TEST_OUTPUT("file_scale_test", file_scale_test(), &failed_count);
+    TEST_OUTPUT("compressed_image_test", compressed_image_test(), &failed_count);
+    TEST_OUTPUT("overlay_test", overlay_test(), &failed_count);
+    TEST_OUTPUT("tmpfs_test", tmpfs_test(), &failed_count);
+    TEST_OUTPUT("file_throughput_test", file_throughput_test(), &failed_count);
+    TEST_OUTPUT("sysenter_test", sysenter_test(), &failed_count);
+    TEST_OUTPUT("ring_test", ring_test(), &failed_count);
+    TEST_OUTPUT("ring_map_test", ring_map_test(), &failed_count);
+    TEST_OUTPUT("time_page_test", time_page_test(), &failed_count);
+    TEST_OUTPUT("strace_test", strace_test(), &failed_count);
+    TEST_OUTPUT("irq_overhead_test", irq_overhead_test(), &failed_count);
+    TEST_OUTPUT("softirq_test", softirq_test(), &failed_count);
+    TEST_OUTPUT("irqstat_test", irqstat_test(), &failed_count);
+    TEST_OUTPUT("poll_test", poll_test(), &failed_count);
+    TEST_OUTPUT("pipe_test", pipe_test(), &failed_count);
+    TEST_OUTPUT("nonblock_test", nonblock_test(), &failed_count);
+    TEST_OUTPUT("fdtable_test", fdtable_test(), &failed_count);
+    TEST_OUTPUT("profile_test", profile_test(), &failed_count);
+    TEST_OUTPUT("trace_test", trace_test(), &failed_count);
+    TEST_OUTPUT("klog_test", klog_test(), &failed_count);
+    TEST_OUTPUT("uart_test", uart_test(), &failed_count);
     printf("TESTING COMPLETE\n");
 	printf("Failed %d test(s)\n", failed_count);
 }
@@ -0,0 +1,200 @@
+/* trace.c - Ring of tracepoint records. Writers claim a slot with one
+ *				locked add and mark it complete last, so nothing waits and
+ *				a reader can tell a record it copied mid-write
+ * vim:ts=4 noexpandtab
+ */
+
+#include "trace.h"
+#include "lib.h"
+#include "paging.h"					/* For KERNEL_MEM_END */
+#include "syscalls/syscalls.h"		/* For current_pcb */
+#include "filesystem/devfs.h"
+#include "filesystem/filesystem.h"	/* For fd_table */
+
+/* Longest command written to "dev/trace" */
+#define TRACE_CMD_LEN 16
+
+volatile uint32_t trace_mask = TRACE_ALL;
+
+/* Not static, so a debugger can dump it after a crash */
+trace_record_t trace_ring[TRACE_RING_ENTRIES];
+static volatile uint32_t trace_tail = 0;	/* records ever claimed */
+static volatile uint32_t trace_start = 0;	/* position of the oldest record not cleared */
+
+static int32_t trace_open(const uint8_t* filename);
+static int32_t trace_close(int32_t fd);
+static int32_t trace_read(int32_t fd, void* buf, int32_t nbytes);
+static int32_t trace_write(int32_t fd, const void* buf, int32_t nbytes);
+
+static file_ops_t file_ops_trace = {trace_read, trace_write, trace_open, trace_close};
+
+/*
+ * trace_init
+ *	  DESCRIPTION: Adds "dev/trace"
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None
+ */
+void trace_init(void) {
+	devfs_register((const uint8_t*)"trace", &file_ops_trace);
+}
+
+/*
+ * trace_event
+ *	  DESCRIPTION: Claims the next slot and fills it in. An interrupt during
+ *				   this claims the slot after, so records from nested
+ *				   contexts may be written out of order but never mixed
+ *	  INPUTS: event -- TRACE_*
+ *			  a0, a1, a2, a3 -- its arguments
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: Overwrites the oldest record once the ring is full
+ */
+void trace_event(uint32_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+	trace_record_t* r;
+	uint32_t pos;
+	uint64_t tsc;
+
+	if(!(trace_mask & (1 << event))) return;
+
+	pos = __sync_fetch_and_add(&trace_tail, 1);
+	r = &trace_ring[pos % TRACE_RING_ENTRIES];
+	r->seq = 0;
+	asm volatile ("" : : : "memory");
+
+	tsc = rdtsc();
+	r->tsc_lo = (uint32_t) tsc;
+	r->tsc_hi = (uint32_t) (tsc >> 32);
+	r->event = event;
+	r->pid = ((uint32_t) current_pcb < KERNEL_MEM_END) ? current_pcb->pid : TRACE_NO_PID;
+	r->args[0] = a0;
+	r->args[1] = a1;
+	r->args[2] = a2;
+	r->args[3] = a3;
+
+	asm volatile ("" : : : "memory");
+	r->seq = pos + 1;
+}
+
+/*
+ * trace_copy
+ *	  DESCRIPTION: Copies records from *pos on. Each is checked to still
+ *				   hold the same position after the copy, so one being
+ *				   written or overwritten meanwhile is skipped
+ *	  INPUTS: out -- filled in
+ *			  n -- entries in out
+ *			  pos -- position to start at, moved past what was copied
+ *	  OUTPUTS: records copied
+ *	  SIDE EFFECTS: None
+ */
+uint32_t trace_copy(trace_record_t* out, uint32_t n, uint32_t* pos) {
+	uint32_t tail = trace_tail, i = 0;
+	volatile trace_record_t* r;
+
+	if((int32_t) (trace_start - *pos) > 0) *pos = trace_start;
+	if(tail - *pos > TRACE_RING_ENTRIES) *pos = tail - TRACE_RING_ENTRIES;
+
+	for(; *pos != tail && i < n; ++*pos) {
+		r = &trace_ring[*pos % TRACE_RING_ENTRIES];
+		if(r->seq != *pos + 1) continue;
+		out[i] = *(trace_record_t*) r;
+		asm volatile ("" : : : "memory");
+		if(r->seq == *pos + 1 && out[i].seq == *pos + 1) i++;
+	}
+	return i;
+}
+
+/*
+ * trace_position
+ *	  DESCRIPTION: Reports how far the trace has got
+ *	  INPUTS: None
+ *	  OUTPUTS: records claimed since boot
+ *	  SIDE EFFECTS: None
+ */
+uint32_t trace_position(void) {
+	return trace_tail;
+}
+
+/*
+ * trace_clear
+ *	  DESCRIPTION: Makes readers start after every record written so far
+ *	  INPUTS: None
+ *	  OUTPUTS: None
+ *	  SIDE EFFECTS: None, the records stay in the ring for a debugger
+ */
+void trace_clear(void) {
+	trace_start = trace_tail;
+}
+
+/*
+ * trace_open
+ *	  DESCRIPTION: open for "dev/trace"
+ *	  INPUTS: filename -- the fd, as for the rtc
+ *	  OUTPUTS: 0
+ *	  SIDE EFFECTS: Starts reading at the oldest record kept
+ */
+static int32_t trace_open(const uint8_t* filename) {
+	fd_table[(int32_t) filename].file_pos = trace_start;
+	return 0;
+}
+
+/*
+ * trace_close
+ *	  DESCRIPTION: close for "dev/trace"
+ *	  INPUTS: fd -- file descriptor
+ *	  OUTPUTS: 0
+ *	  SIDE EFFECTS: None
+ */
+static int32_t trace_close(int32_t fd) {
+	return 0;
+}
+
+/*
+ * trace_read
+ *	  DESCRIPTION: Reads whole trace_record_t's from the file position on.
+ *				   Records stay in the ring, so any number of readers each
+ *				   see all of them
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- filled in
+ *			  nbytes -- size of buf
+ *	  OUTPUTS: bytes read, a multiple of sizeof(trace_record_t), 0 once
+ *			   the reader has caught up, -1 for a bad buffer
+ *	  SIDE EFFECTS: Moves the file position, a record position
+ */
+static int32_t trace_read(int32_t fd, void* buf, int32_t nbytes) {
+	if(!buf || nbytes < 0) return -1;
+	return trace_copy(buf, nbytes / sizeof(trace_record_t), &fd_table[fd].file_pos)
+		* sizeof(trace_record_t);
+}
+
+/*
+ * trace_write
+ *	  DESCRIPTION: "on" and "off" turn every event on or off, "mask N"
+ *				   records only the events whose bits are set in N, and
+ *				   "clear" drops what has been recorded
+ *	  INPUTS: fd -- file descriptor
+ *			  buf -- command
+ *			  nbytes -- its length
+ *	  OUTPUTS: nbytes, -1 for an unknown command
+ *	  SIDE EFFECTS: None
+ */
+static int32_t trace_write(int32_t fd, const void* buf, int32_t nbytes) {
+	int8_t cmd[TRACE_CMD_LEN];
+	int mask = 0;
+
+	if(!buf || nbytes <= 0 || nbytes >= TRACE_CMD_LEN) return -1;
+	memcpy(cmd, buf, nbytes);
+	cmd[nbytes] = '\0';
+
+	if(!strncmp(cmd, "on", 2)) {
+		trace_mask = TRACE_ALL;
+	} else if(!strncmp(cmd, "off", 3)) {
+		trace_mask = 0;
+	} else if(!strncmp(cmd, "mask ", 5) && atoi(cmd + 5, &mask)) {
+		trace_mask = mask & TRACE_ALL;
+	} else if(!strncmp(cmd, "clear", 5)) {
+		trace_clear();
+	} else {
+		return -1;
+	}
+	return nbytes;
+}
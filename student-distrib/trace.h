@@ -0,0 +1,71 @@
+/* trace.h - Defines static tracepoints: fixed-size records with a TSC
+ * timestamp written to a ring at scheduler, process, IRQ, network and file
+ * sites, read through "dev/trace". Built with -DTRACEPOINTS, otherwise the
+ * tracepoints compile to nothing
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "types.h"
+
+/* Records the ring holds, a power of two; the oldest are overwritten */
+#define TRACE_RING_ENTRIES 4096
+
+/* pid of a record made with no process running */
+#define TRACE_NO_PID 0xFFFF
+
+/* Events and their arguments, must match tracedecode.py */
+#define TRACE_SWITCH 1			/* switch_process: old task, new task, new pid */
+#define TRACE_PUSH_PCB 2		/* push_pcb: pid, pcb_num, parent pid */
+#define TRACE_POP_PCB 3			/* pop_pcb: pid, pcb_num, parent pid */
+#define TRACE_IRQ 4				/* do_irq: irq, handlers, cycles from entry through the handlers */
+#define TRACE_RX 5				/* receive_packet: descriptor, length */
+#define TRACE_TCP 6				/* tcp_parse_packet: source port, dest port, flags, seq */
+#define TRACE_FILE_READ 7		/* file_read: inode, offset, nbytes, bytes read */
+#define TRACE_NUM_EVENTS 8
+
+/* Mask of every event, the default */
+#define TRACE_ALL ((1 << TRACE_NUM_EVENTS) - 2)
+
+/* One event, read from "dev/trace" */
+typedef struct trace_record {
+	uint32_t seq;				/* position in the trace + 1, 0 while being written */
+	uint32_t tsc_lo;			/* time-stamp counter when it was written */
+	uint32_t tsc_hi;
+	uint16_t event;				/* TRACE_* */
+	uint16_t pid;				/* running process, TRACE_NO_PID if none */
+	uint32_t args[4];
+} trace_record_t;
+
+#ifdef TRACEPOINTS
+#define tracepoint(event, a0, a1, a2, a3) \
+	trace_event((event), (uint32_t) (a0), (uint32_t) (a1), (uint32_t) (a2), (uint32_t) (a3))
+#else
+/* Never runs, but keeps the arguments used */
+#define tracepoint(event, a0, a1, a2, a3) \
+	do { if(0) trace_event((event), (uint32_t) (a0), (uint32_t) (a1), (uint32_t) (a2), (uint32_t) (a3)); } while(0)
+#endif
+
+/* Events recorded, a bit per TRACE_* */
+extern volatile uint32_t trace_mask;
+
+/* Registers the device file */
+void trace_init(void);
+
+/* Writes a record if event is in trace_mask. Safe from any context,
+ * including an interrupt that arrives while another record is written */
+void trace_event(uint32_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/* Copies out up to n records from position *pos on, skipping ones already
+ * overwritten, and moves *pos past them */
+uint32_t trace_copy(trace_record_t* out, uint32_t n, uint32_t* pos);
+
+/* Records written since boot, including overwritten ones */
+uint32_t trace_position(void);
+
+/* Drops every record */
+void trace_clear(void);
+
+#endif /* _TRACE_H */
@@ -0,0 +1,114 @@
+#! /usr/bin/python3
+# Turns a dump of trace_record_t's into a timeline. The dump is either what
+# was read from dev/trace (e.g. "cp dev/trace trace.bin") or the whole ring
+# taken from gdb, even after a crash:
+#
+#   (gdb) dump binary value trace.bin trace_ring
+#
+# Records are put in order by their position, ones left half written are
+# dropped, and gaps where the ring was overwritten are reported.
+#
+#   ./tracedecode.py trace.bin                 one line per event
+#   ./tracedecode.py --mhz 2400 trace.bin      times in us instead of cycles
+#   ./tracedecode.py --json trace.bin > t.json for chrome://tracing or Perfetto
+
+import argparse
+import json
+import struct
+import sys
+
+# Must match trace.h
+RECORD = struct.Struct('<IIIHH4I')
+NO_PID = 0xFFFF
+EVENTS = {
+    1: ('switch', ('from_task', 'to_task', 'pid')),
+    2: ('push_pcb', ('pid', 'pcb_num', 'parent')),
+    3: ('pop_pcb', ('pid', 'pcb_num', 'parent')),
+    4: ('irq', ('irq', 'handlers', 'cycles')),
+    5: ('rx', ('desc', 'length')),
+    6: ('tcp', ('sport', 'dport', 'flags', 'seq')),
+    7: ('file_read', ('inode', 'offset', 'nbytes', 'got')),
+}
+TCP_FLAGS = ((8, 'FIN'), (9, 'SYN'), (10, 'RST'), (11, 'PSH'), (12, 'ACK'), (13, 'URG'))
+
+
+def read_records(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    records = []
+    for off in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        seq, lo, hi, event, pid, *args = RECORD.unpack_from(data, off)
+        if seq:
+            records.append((seq, (hi << 32) | lo, event, pid, args))
+    records.sort()
+    return records
+
+
+def describe(event, args):
+    name, fields = EVENTS.get(event, ('event%d' % event, ('a0', 'a1', 'a2', 'a3')))
+    values = dict(zip(fields, args))
+    if 'pid' in values and values['pid'] == NO_PID:
+        values['pid'] = '-'
+    if 'parent' in values and values['parent'] == NO_PID:
+        values['parent'] = '-'
+    if name == 'tcp':
+        values['flags'] = '|'.join(f for bit, f in TCP_FLAGS if values['flags'] & (1 << bit)) or '0'
+    if name == 'file_read':
+        values['got'] = struct.unpack('<i', struct.pack('<I', values['got']))[0]
+    return name, values
+
+
+def timeline(records, mhz):
+    start = records[0][1]
+    last_seq = records[0][0] - 1
+    for seq, tsc, event, pid, args in records:
+        if seq != last_seq + 1:
+            print('  ... %d records lost' % (seq - last_seq - 1))
+        last_seq = seq
+        name, values = describe(event, args)
+        when = '%14.3f us' % ((tsc - start) / mhz) if mhz else '%14d cyc' % (tsc - start)
+        who = '-' if pid == NO_PID else str(pid)
+        print('%s  pid %-3s %-10s %s' % (when, who, name,
+              ' '.join('%s=%s' % kv for kv in values.items())))
+
+
+def chrome(records, mhz):
+    # Without --mhz the "us" are cycles / 1000, still in proportion
+    scale = mhz if mhz else 1000.0
+    start = records[0][1]
+    events = []
+    for seq, tsc, event, pid, args in records:
+        name, values = describe(event, args)
+        e = {'name': name, 'cat': name, 'pid': 0, 'tid': 'kernel' if pid == NO_PID else pid,
+             'ts': (tsc - start) / scale, 'args': values}
+        if name == 'irq':
+            # Written after the handlers, so it ends at its timestamp
+            e['name'] = 'irq %d' % values['irq']
+            e['ph'] = 'X'
+            e['dur'] = values['cycles'] / scale
+            e['ts'] -= e['dur']
+        else:
+            e['ph'] = 'i'
+            e['s'] = 't'
+        events.append(e)
+    json.dump({'traceEvents': events, 'displayTimeUnit': 'ns'}, sys.stdout)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode a kernel trace dump')
+    parser.add_argument('dump', help='records from dev/trace or the trace_ring array')
+    parser.add_argument('--mhz', type=float, default=0, help='TSC rate, to print times in us')
+    parser.add_argument('--json', action='store_true', help='write Chrome trace event JSON')
+    opts = parser.parse_args()
+
+    records = read_records(opts.dump)
+    if not records:
+        sys.exit('%s: no records' % opts.dump)
+    if opts.json:
+        chrome(records, opts.mhz)
+    else:
+        timeline(records, opts.mhz)
+
+
+if __name__ == '__main__':
+    main()
@@ -9,6 +9,7 @@
 #include "tasks/screen.h"
 #include "tasks/tasks.h"
 #include "syscalls/syscalls.h"
+#include "devices/uart.h"
 
 #define VIDEO_CTRL_PORT 0x3D4
 #define VIDEO_DATA_PORT 0x3D5
@@ -38,7 +39,8 @@ static int history_curr;
 
 #define TAB_WIDTH 8
 
-file_ops_t file_ops_tty = {tty_read, tty_write, tty_open, tty_close};
+file_ops_t file_ops_tty = {tty_read, tty_write, tty_open, tty_close,
+						NULL, NULL, NULL, NULL, NULL, NULL, NULL, tty_poll};
 
 /* 
  * void scroll(void);
@@ -131,13 +133,13 @@ uint8_t tty_putc(uint8_t c) {
 }
 
 /* 
- * uint8_t tty_putc_nocursor(uint8_t c);
+ * static uint8_t tty_putc_screen(uint8_t c);
  * Inputs: uint8_t c = character to print
  * Return Value: width of character printed (e.g. tab prints more than one character)
- * Function: Output a character to the console and does not set cursor
+ * Function: Output a character to video memory and does not set cursor
  *           (Does change logical cursor)
  */
-uint8_t tty_putc_nocursor(uint8_t c) {
+static uint8_t tty_putc_screen(uint8_t c) {
     uint8_t n = 1;
     if (c == '\n') {
         // '\n' moves cursor down and left
@@ -150,9 +152,9 @@ uint8_t tty_putc_nocursor(uint8_t c) {
         if (caret) screen_y++;
     } else if (c == '\t') {
         // '\t' prints up to TAB_WIDTH spaces and at least 1
-        tty_putc_nocursor(' ');
+        tty_putc_screen(' ');
         while ((screen_x % TAB_WIDTH) != 0) {
-            tty_putc_nocursor(' ');
+            tty_putc_screen(' ');
             n++;
         }
     } else {
@@ -168,8 +170,8 @@ uint8_t tty_putc_nocursor(uint8_t c) {
             }
         } else if (caret && is_printable(c ^ CARET)) {
             n = 2;
-            tty_putc_nocursor('^');
-            tty_putc_nocursor(c ^ CARET);
+            tty_putc_screen('^');
+            tty_putc_screen(c ^ CARET);
         } else if (!caret && c) {
             *(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
             *(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = attrib;
@@ -191,6 +193,36 @@ uint8_t tty_putc_nocursor(uint8_t c) {
     return n;
 }
 
+/*
+ * static void tty_putc_serial(uint8_t c);
+ * Inputs: uint8_t c = character to print
+ * Return Value: none
+ * Function: Sends a character shown on the screen being viewed to the serial
+ *           console too, where the terminal expands tabs and ends lines
+ */
+static void tty_putc_serial(uint8_t c) {
+    if (!uart_console || process_screen != view_screen) return;
+    if (c == '\n') {
+        uart_putc('\r');
+    } else if (caret && c != '\t' && c != '\r' && !is_printable(c) && is_printable(c ^ CARET)) {
+        uart_putc('^');
+        c ^= CARET;
+    }
+    uart_putc(c);
+}
+
+/* 
+ * uint8_t tty_putc_nocursor(uint8_t c);
+ * Inputs: uint8_t c = character to print
+ * Return Value: width of character printed (e.g. tab prints more than one character)
+ * Function: Output a character to the console and does not set cursor
+ *           (Does change logical cursor)
+ */
+uint8_t tty_putc_nocursor(uint8_t c) {
+    tty_putc_serial(c);
+    return tty_putc_screen(c);
+}
+
 /* 
  * int32_t tty_puts(int8_t* s);
  * Inputs: int_8* s = pointer to a string of characters
@@ -246,6 +278,8 @@ void tty_cls(void) {
     }
     screen_x = 0;
     screen_y = 0;
+    // ANSI clear screen and home
+    if (uart_console && process_screen == view_screen) uart_puts("\033[2J\033[H");
     if (in_shell) tty_puts("391OS> ");
     for (i = 0; i < buffer_size; i++) {
         width_buffer[i] = tty_echo_nocursor(input_buffer[i]);
@@ -271,6 +305,7 @@ void tty_backspace(void) {
                 screen_x += NUM_COLS;
                 screen_y -= 1;
             }
+            if (uart_console && process_screen == view_screen) uart_puts("\b \b");
             // clear position
             *(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
             *(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = attrib;
@@ -329,7 +364,7 @@ void tty_sendchar(uint8_t c) {
  * Prints a string to the screen
  */
 int32_t tty_write(int32_t fd, const void* buf, int32_t nbytes) {
-    if (fd == STDIN) return -1;
+    if (fd_table[fd].inode_num == STDIN) return -1;
     if (buf == 0) return -1; // can't read from null
     int32_t i;
     const uint8_t* buf_c = buf;
@@ -369,14 +404,16 @@ static void shift_buffer(uint8_t i) {
  * int32_t tty_read(int32_t fd, void* buf, int32_t nbytes);
  * Inputs: void* buf -- buffer to write bytes to
  *         int32_t nbytes -- number of bytes to read
- * Return Value: number of bytes read
+ * Return Value: number of bytes read, -EAGAIN if fd is O_NONBLOCK and no
+ *               line has been typed
  * Reads either up to a newline or 128 or nbytes bytes from the keyboard,
  * whichever comes first
  * will wait for newline (not if there is already a newline in buffer)
  */
 int32_t tty_read(int32_t fd, void* buf, int32_t nbytes) {
-    if (fd == STDOUT) return -1;
+    if (fd_table[fd].inode_num == STDOUT) return -1;
     if (buf == 0) return -1; // can't write to null
+    if ((fd_table[fd].flags & O_NONBLOCK) && !ready) return -EAGAIN;
     int32_t i;
     uint8_t* buf_c = buf;
     for (i = 0; i < buffer_size; i++) {
@@ -398,6 +435,30 @@ int32_t tty_read(int32_t fd, void* buf, int32_t nbytes) {
     return i;
 }
 
+/*
+ * int32_t tty_read_ready(void);
+ * Inputs: none
+ * Return Value: 1 if a line is waiting, 0 otherwise
+ * Tells whether tty_read would return without waiting for a newline
+ */
+int32_t tty_read_ready(void) {
+    return ready;
+}
+
+/*
+ * int32_t tty_poll(int32_t fd, int32_t events);
+ * Inputs: fd -- open file whose inode_num is STDIN or STDOUT
+ *         events -- POLLIN and/or POLLOUT
+ * Return Value: the events that wouldn't wait
+ * Writes never wait, reads from stdin wait for a line
+ */
+int32_t tty_poll(int32_t fd, int32_t events) {
+    int32_t revents = events & POLLOUT;
+
+    if (fd_table[fd].inode_num != STDOUT && ready) revents |= events & POLLIN;
+    return revents;
+}
+
 /*
  * int32_t tty_open(const uint8_t* filename);
  * Inputs: none
@@ -21,6 +21,8 @@ void tty_backspace(void);
 void tty_sendchar(uint8_t c);
 int32_t tty_write(int32_t fd, const void* buf, int32_t nbytes);
 int32_t tty_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t tty_read_ready(void);
+int32_t tty_poll(int32_t fd, int32_t events);
 int32_t tty_open(const uint8_t* filename);
 int32_t tty_close(int32_t fd);
 void tty_clear_buf(void);
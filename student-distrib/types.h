@@ -21,6 +21,10 @@ typedef unsigned short uint16_t;
 typedef char int8_t;
 typedef unsigned char uint8_t;
 
+/* NOTE: no libgcc, so never divide or take the modulus of these */
+typedef long long int64_t;
+typedef unsigned long long uint64_t;
+
 #endif /* ASM */
 
 #endif /* _TYPES_H */
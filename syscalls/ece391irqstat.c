@@ -0,0 +1,164 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+#define BUFSIZE 1024
+#define NUMSIZE 16
+
+/* Must match the kernel's irqstat.h and i8259.h */
+#define NUM_IRQS 17
+#define MAX_CHAIN 16
+#define HIST_BUCKETS 32
+#define WINDOWS 8
+
+typedef struct line {
+    uint32_t count;
+    uint32_t dispatch_max;
+    uint32_t eoi_max;
+    uint32_t cycles_lo;
+    uint32_t cycles_hi;
+    uint32_t buckets[HIST_BUCKETS];
+    uint32_t handler[MAX_CHAIN];
+    uint32_t handler_cycles[MAX_CHAIN];
+    uint32_t handler_max[MAX_CHAIN];
+} line_t;
+
+typedef struct window {
+    uint32_t cycles;
+    uint32_t cli_site;
+    uint32_t restore_site;
+    uint32_t reserved;
+} window_t;
+
+typedef struct stats {
+    uint32_t windows;
+    uint32_t reserved[3];
+    window_t longest[WINDOWS];
+    line_t irq[NUM_IRQS];
+} stats_t;
+
+static stats_t stats;
+
+static void put (const char* s)
+{
+    ece391_fdputs (1, (uint8_t*)s);
+}
+
+static void put_num (uint32_t n, int32_t radix)
+{
+    uint8_t buf[NUMSIZE];
+
+    if (16 == radix)
+        put ("0x");
+    ece391_fdputs (1, ece391_itoa (n, buf, radix));
+}
+
+/* Left-justify n in a column of width characters */
+static void put_num_col (uint32_t n, uint32_t width)
+{
+    uint8_t buf[NUMSIZE];
+    uint32_t len;
+
+    ece391_itoa (n, buf, 10);
+    len = ece391_strlen (buf);
+    ece391_fdputs (1, buf);
+    while (len++ < width)
+        put (" ");
+}
+
+/* Count, mean, worst and log2 histogram of each IRQ, then its handlers */
+static void print_irqs (void)
+{
+    uint32_t irq, b, h;
+    line_t* l;
+
+    put ("irq  count     cycles/irq  max-eoi   max-dispatch  histogram (log2 cycles:irqs)\n");
+    for (irq = 0; irq < NUM_IRQS; irq++) {
+        l = &stats.irq[irq];
+        if (!l->count)
+            continue;
+        put_num_col (irq, 5);
+        put_num_col (l->count, 10);
+        if (l->cycles_hi)
+            put (">4G         ");
+        else
+            put_num_col (l->cycles_lo / l->count, 12);
+        put_num_col (l->eoi_max, 10);
+        put_num_col (l->dispatch_max, 14);
+        for (b = 0; b < HIST_BUCKETS; b++) {
+            if (!l->buckets[b])
+                continue;
+            put_num (b, 10);
+            put (":");
+            put_num (l->buckets[b], 10);
+            put (" ");
+        }
+        put ("\n");
+        for (h = 0; h < MAX_CHAIN && l->handler[h]; h++) {
+            put ("     handler ");
+            put_num (l->handler[h], 16);
+            put (" mean ");
+            put_num (l->handler_cycles[h] / l->count, 10);
+            put (" max ");
+            put_num (l->handler_max[h], 10);
+            put ("\n");
+        }
+    }
+}
+
+/* Longest cli_and_save to restore_flags windows, by call site */
+static void print_windows (void)
+{
+    uint32_t i;
+
+    put ("\nlongest interrupts-off windows of ");
+    put_num (stats.windows, 10);
+    put (":\n");
+    for (i = 0; i < WINDOWS && stats.longest[i].cycles; i++) {
+        put_num_col (stats.longest[i].cycles, 10);
+        put ("cycles  cli at ");
+        put_num (stats.longest[i].cli_site, 16);
+        put ("  restore at ");
+        put_num (stats.longest[i].restore_site, 16);
+        put ("\n");
+    }
+}
+
+int main ()
+{
+    uint8_t cmd[BUFSIZE];
+    int32_t fd, cnt, got, status = 0, ran = 0;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"dev/irqstat"))) {
+        put ("no dev/irqstat\n");
+        return 2;
+    }
+
+    /* With a command, measure just while it runs, otherwise since boot */
+    if (0 == ece391_getargs (cmd, BUFSIZE)) {
+        ece391_write (fd, "clear", 5);
+        status = ece391_execute (cmd);
+        ran = 1;
+    }
+
+    for (got = 0; got < sizeof (stats); got += cnt) {
+        if (0 >= (cnt = ece391_read (fd, (uint8_t*)&stats + got, sizeof (stats) - got)))
+            break;
+    }
+    ece391_close (fd);
+    if (got != sizeof (stats)) {
+        put ("short read from dev/irqstat\n");
+        return 2;
+    }
+
+    print_irqs ();
+    print_windows ();
+    if (ran) {
+        put ("exit status ");
+        put_num (status, 10);
+        put ("\n");
+    }
+    return 0;
+}
@@ -3,26 +3,42 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-#define SBUFSIZE 33
+/* Entries fetched per getdents call, enough for a whole directory */
+#define NUM_DIRENTS 64
+#define NAME_WIDTH 34
+
+static ece391_dirent_t ents[NUM_DIRENTS];
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, i;
+    uint32_t j;
+    uint8_t line[80];
+    uint8_t num[11];
+    static const char* types[] = { "rtc ", "dir ", "file" };
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
-	        return 3;
+	    for (i = 0; i < cnt / (int32_t)sizeof (ece391_dirent_t); i++) {
+	        /* name padded to a column, then type and size */
+	        ece391_strcpy (line, ents[i].name);
+	        for (j = ece391_strlen (line); j < NAME_WIDTH; j++)
+	            line[j] = ' ';
+	        line[j] = '\0';
+	        ece391_fdputs (1, line);
+	        ece391_fdputs (1, (uint8_t*)(ents[i].file_type <= 2 ? types[ents[i].file_type] : "?   "));
+	        ece391_fdputs (1, (uint8_t*)" ");
+	        ece391_fdputs (1, ece391_itoa (ents[i].length, num, 10));
+	        ece391_fdputs (1, (uint8_t*)"\n");
+	    }
     }
 
     return 0;
@@ -0,0 +1,120 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+/* Bytes moved by each measurement */
+#define TOTAL (4 * 1024 * 1024)
+/* Buffer used across processes, large enough to take the direct path */
+#define BIG_CHUNK (16 * 1024)
+#define NUM_SIZES 3
+#define ARGSIZE 32
+#define NUMSIZE 16
+
+static uint8_t buf[BIG_CHUNK];
+
+static void put (const char* s)
+{
+    ece391_fdputs (1, (uint8_t*)s);
+}
+
+static void put_num (uint32_t n)
+{
+    uint8_t num[NUMSIZE];
+
+    ece391_fdputs (1, ece391_itoa (n, num, 10));
+}
+
+/* bytes/us is MB/s, printed with one decimal */
+static void put_rate (uint32_t bytes, uint32_t us)
+{
+    uint32_t tenths;
+
+    if (0 == us)
+        us = 1;
+    tenths = (bytes / us) * 10 + (bytes % us) * 10 / us;
+    put_num (tenths / 10);
+    put (".");
+    put_num (tenths % 10);
+    put (" MB/s");
+}
+
+/* One process writing and reading back each chunk size through a pipe */
+static int32_t self (void)
+{
+    static const uint32_t sizes[NUM_SIZES] = {64, 512, 4096};
+    int32_t fds[2];
+    uint32_t i, done;
+    uint64_t start;
+
+    if (-1 == ece391_pipe (fds)) {
+        put ("pipe failed\n");
+        return 2;
+    }
+    for (i = 0; i < NUM_SIZES; i++) {
+        start = ece391_monotonic_us ();
+        for (done = 0; done < TOTAL; done += sizes[i]) {
+            if (sizes[i] != ece391_write (fds[1], buf, sizes[i]) ||
+                sizes[i] != ece391_read (fds[0], buf, sizes[i])) {
+                put ("pipe lost data\n");
+                return 2;
+            }
+        }
+        put_num (sizes[i]);
+        put (" byte writes and reads: ");
+        put_rate (TOTAL, (uint32_t)(ece391_monotonic_us () - start));
+        put ("\n");
+    }
+    ece391_close (fds[0]);
+    ece391_close (fds[1]);
+    return 0;
+}
+
+/* Pipeline source, writes TOTAL bytes to stdout */
+static int32_t src (void)
+{
+    uint32_t done;
+
+    for (done = 0; done < TOTAL; done += BIG_CHUNK) {
+        if (BIG_CHUNK != ece391_write (1, buf, BIG_CHUNK))
+            return 1;
+    }
+    return 0;
+}
+
+/* Pipeline sink, reads stdin to end of file and reports the rate */
+static int32_t sink (void)
+{
+    uint32_t total = 0, reads = 0;
+    uint64_t start = 0;
+    int32_t cnt;
+
+    while (0 < (cnt = ece391_read (0, buf, BIG_CHUNK))) {
+        if (0 == total)
+            start = ece391_monotonic_us ();
+        total += cnt;
+        reads++;
+    }
+    put_num (total);
+    put (" bytes in ");
+    put_num (reads);
+    put (" reads: ");
+    put_rate (total, (uint32_t)(ece391_monotonic_us () - start));
+    put ("\n");
+    return (TOTAL == total) ? 0 : 1;
+}
+
+int main ()
+{
+    uint8_t arg[ARGSIZE];
+
+    if (0 != ece391_getargs (arg, ARGSIZE))
+        return self ();
+    if (0 == ece391_strcmp (arg, (uint8_t*)"src"))
+        return src ();
+    if (0 == ece391_strcmp (arg, (uint8_t*)"sink"))
+        return sink ();
+    put ("usage: pipebench [src | sink], e.g. pipebench src | pipebench sink\n");
+    return 2;
+}
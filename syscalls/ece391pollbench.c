@@ -0,0 +1,148 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+/* Each loop runs this long, waking for the rtc at RTC_HZ and for lines typed */
+#define SECONDS 3
+#define RTC_HZ 8
+#define TIMEOUT_MS 250
+#define BUFSIZE 128
+#define NUMSIZE 16
+
+static uint64_t rdtsc (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void put (const char* s)
+{
+    ece391_fdputs (1, (uint8_t*)s);
+}
+
+static void put_num (uint32_t n)
+{
+    uint8_t buf[NUMSIZE];
+
+    ece391_fdputs (1, ece391_itoa (n, buf, 10));
+}
+
+/* Prints a loop's counts and the share of cycles since tsc and idle that
+ * the CPU was not halted */
+static void report (const char* name, uint32_t wakeups, uint32_t ticks,
+                    uint32_t lines, uint64_t tsc, uint64_t idle)
+{
+    uint64_t dt, di;
+    uint32_t busy;
+
+    dt = rdtsc () - tsc;
+    di = ece391_idle_cycles () - idle;
+
+    /* Scale down so the percentage needs no 64-bit division */
+    while (dt >> 22) {
+        dt >>= 1;
+        di >>= 1;
+    }
+    busy = di < dt ? (uint32_t)(dt - di) * 100 / (uint32_t)dt : 0;
+
+    put (name);
+    put_num (wakeups);
+    put (" returns, ");
+    put_num (ticks);
+    put (" rtc ticks, ");
+    put_num (lines);
+    put (" lines, CPU busy ");
+    put_num (busy);
+    put ("%\n");
+}
+
+/* Waits on stdin and the rtc for SECONDS with the given poll timeout */
+static int32_t run (const char* name, ece391_pollfd_t* fds, int32_t timeout)
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t wakeups = 0, ticks = 0, lines = 0, stop;
+    uint64_t tsc, idle;
+    int32_t n;
+
+    tsc = rdtsc ();
+    idle = ece391_idle_cycles ();
+    stop = ece391_monotonic_ms () + SECONDS * 1000;
+    while (ece391_monotonic_ms () < stop) {
+        if (-1 == (n = ece391_poll (fds, 2, timeout)))
+            return -1;
+        wakeups++;
+        if (fds[0].revents & POLLIN) {
+            ece391_read (fds[0].fd, buf, BUFSIZE);
+            lines++;
+        }
+        if (fds[1].revents & POLLIN) {
+            ece391_read (fds[1].fd, buf, 0);
+            ticks++;
+        }
+    }
+    report (name, wakeups, ticks, lines, tsc, idle);
+    return 0;
+}
+
+/* The same loop without poll: stdin and the rtc are switched to O_NONBLOCK
+ * and read in turn, a read with nothing ready returning -EAGAIN */
+static int32_t run_nonblock (const char* name, int32_t rtc)
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t reads = 0, ticks = 0, lines = 0, stop;
+    uint64_t tsc, idle;
+    int32_t in_flags;
+
+    in_flags = ece391_fcntl (0, F_GETFL, 0);
+    if (-1 == in_flags || -1 == ece391_fcntl (0, F_SETFL, in_flags | O_NONBLOCK) ||
+        -1 == ece391_fcntl (rtc, F_SETFL, O_NONBLOCK))
+        return -1;
+
+    tsc = rdtsc ();
+    idle = ece391_idle_cycles ();
+    stop = ece391_monotonic_ms () + SECONDS * 1000;
+    while (ece391_monotonic_ms () < stop) {
+        reads++;
+        if (-EAGAIN != ece391_read (0, buf, BUFSIZE))
+            lines++;
+        if (-EAGAIN != ece391_read (rtc, buf, 0))
+            ticks++;
+    }
+    report (name, reads, ticks, lines, tsc, idle);
+
+    ece391_fcntl (0, F_SETFL, in_flags);
+    ece391_fcntl (rtc, F_SETFL, 0);
+    return 0;
+}
+
+int main ()
+{
+    ece391_pollfd_t fds[2];
+    int32_t rtc, rate = RTC_HZ;
+
+    if (-1 == (rtc = ece391_open ((uint8_t*)"rtc")) ||
+        -1 == ece391_write (rtc, &rate, sizeof (rate))) {
+        put ("can't open rtc\n");
+        return 2;
+    }
+
+    fds[0].fd = 0;
+    fds[0].events = POLLIN;
+    fds[1].fd = rtc;
+    fds[1].events = POLLIN;
+
+    /* Sleeping in poll, then spinning on it like a read loop would, then
+     * spinning on non-blocking reads */
+    if (-1 == run ("poll, sleeping: ", fds, TIMEOUT_MS) ||
+        -1 == run ("poll, spinning: ", fds, 0) ||
+        -1 == run_nonblock ("O_NONBLOCK reads: ", rtc)) {
+        put ("poll or fcntl failed\n");
+        return 2;
+    }
+    ece391_close (rtc);
+    return 0;
+}
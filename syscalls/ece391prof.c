@@ -0,0 +1,400 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+#define BUFSIZE 1024
+#define NUMSIZE 16
+#define BATCH 32
+
+/* Samples per second asked for */
+#define HZ 1000
+
+/* Distinct stacks kept, a power of two; samples past it are only counted */
+#define MAX_STACKS 2048
+/* Functions in the flat profile, and how many are printed */
+#define MAX_FLAT 512
+#define TOP 20
+
+/* Symbols of one program or the kernel, from "nm -n" output */
+#define MAX_SYMS 4096
+#define SYM_POOL (64 * 1024)
+#define SYM_LINE 128
+#define NAMESIZE 48
+
+/* Where the collapsed stacks go, one "prog;outer;...;inner count" a line */
+#define FOLDED "prof.folded"
+
+/* Must match the kernel's profile.h */
+#define PROFILE_DEPTH 6
+#define PROFILE_COMM_LEN 16
+
+typedef struct sample {
+    uint32_t eip;
+    uint16_t pid;
+    uint8_t user;
+    uint8_t depth;
+    uint32_t frames[PROFILE_DEPTH];
+    uint8_t comm[PROFILE_COMM_LEN];
+} sample_t;
+
+typedef struct stats {
+    uint32_t timer;
+    uint32_t hz;
+    uint32_t samples;
+    uint32_t dropped;
+    uint32_t user;
+    uint32_t reserved[3];
+} stats_t;
+
+/* Samples with the same program, mode, EIP and backtrace */
+typedef struct stack {
+    sample_t s;
+    uint32_t count;             /* 0 for a free slot */
+    uint32_t done;              /* reported */
+} stack_t;
+
+typedef struct flat {
+    uint8_t comm[PROFILE_COMM_LEN];
+    uint32_t user;
+    uint8_t name[NAMESIZE];
+    uint32_t count;
+} flat_t;
+
+typedef struct symtab {
+    uint32_t n;
+    uint32_t used;              /* bytes of pool */
+    uint32_t addr[MAX_SYMS];    /* ascending */
+    uint32_t name[MAX_SYMS];    /* offset in pool */
+    uint8_t pool[SYM_POOL];
+} symtab_t;
+
+static sample_t batch[BATCH];
+static stats_t stats;
+static stack_t stacks[MAX_STACKS];
+static uint32_t lost;
+static flat_t flat[MAX_FLAT];
+static uint32_t num_flat;
+static symtab_t ksyms, usyms;
+static uint8_t buf[BUFSIZE];
+
+static void put (const char* s)
+{
+    ece391_fdputs (1, (uint8_t*)s);
+}
+
+static void put_num (uint32_t n)
+{
+    uint8_t num[NUMSIZE];
+
+    ece391_fdputs (1, ece391_itoa (n, num, 10));
+}
+
+/* Left-justify s in a column of width characters */
+static void put_col (const char* s, uint32_t width)
+{
+    uint32_t len = ece391_strlen ((uint8_t*)s);
+
+    put (s);
+    while (len++ < width)
+        put (" ");
+}
+
+static void put_num_col (uint32_t n, uint32_t width)
+{
+    uint8_t num[NUMSIZE];
+
+    put_col ((char*)ece391_itoa (n, num, 10), width);
+}
+
+static int32_t hex_digit (uint8_t c)
+{
+    if ('0' <= c && c <= '9')
+        return c - '0';
+    if ('a' <= c && c <= 'f')
+        return c - 'a' + 10;
+    if ('A' <= c && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* One line of "nm -n": address, type and name. Only text symbols are kept */
+static void add_sym (symtab_t* t, const uint8_t* line)
+{
+    uint32_t i, addr = 0, len;
+    int32_t d;
+
+    for (i = 0; 0 <= (d = hex_digit (line[i])); i++)
+        addr = addr * 16 + d;
+    if (0 == i || ' ' != line[i] || ('t' != line[i + 1] && 'T' != line[i + 1]) || ' ' != line[i + 2])
+        return;
+    line += i + 3;
+    len = ece391_strlen (line);
+    if (t->n == MAX_SYMS || t->used + len + 1 > SYM_POOL)
+        return;
+    t->addr[t->n] = addr;
+    t->name[t->n++] = t->used;
+    ece391_strcpy (t->pool + t->used, line);
+    t->used += len + 1;
+}
+
+/* Reads a symbol file, leaving t empty if there is none */
+static int32_t load_syms (symtab_t* t, const uint8_t* file)
+{
+    uint8_t line[SYM_LINE];
+    uint32_t len = 0;
+    int32_t fd, cnt, i;
+
+    t->n = t->used = 0;
+    if (-1 == (fd = ece391_open (file)))
+        return -1;
+    while (0 < (cnt = ece391_read (fd, buf, BUFSIZE))) {
+        for (i = 0; i < cnt; i++) {
+            if ('\n' == buf[i]) {
+                line[len] = '\0';
+                add_sym (t, line);
+                len = 0;
+            } else if (len < SYM_LINE - 1) {
+                line[len++] = buf[i];
+            }
+        }
+    }
+    ece391_close (fd);
+    return 0;
+}
+
+/* Names addr with the symbol at or below it, or in hex without one */
+static void symbolize (const symtab_t* t, uint32_t addr, uint8_t* name)
+{
+    uint32_t lo = 0, hi = t->n, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (t->addr[mid] <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (0 == lo) {
+        ece391_strcpy (name, (uint8_t*)"0x");
+        ece391_itoa (addr, name + 2, 16);
+        return;
+    }
+    for (mid = 0; mid < NAMESIZE - 1 && t->pool[t->name[lo - 1] + mid]; mid++)
+        name[mid] = t->pool[t->name[lo - 1] + mid];
+    name[mid] = '\0';
+}
+
+static uint32_t same_stack (const sample_t* a, const sample_t* b)
+{
+    uint32_t i;
+
+    if (a->eip != b->eip || a->user != b->user || a->depth != b->depth)
+        return 0;
+    for (i = 0; i < a->depth; i++)
+        if (a->frames[i] != b->frames[i])
+            return 0;
+    return 0 == ece391_strncmp (a->comm, b->comm, PROFILE_COMM_LEN);
+}
+
+/* Counts a sample under its stack, in an open addressed hash table */
+static void add_sample (const sample_t* s)
+{
+    uint32_t h = s->eip * 31 + s->user, i;
+
+    for (i = 0; i < s->depth; i++)
+        h = h * 31 + s->frames[i];
+    for (i = 0; i < PROFILE_COMM_LEN && s->comm[i]; i++)
+        h = h * 31 + s->comm[i];
+    for (i = 0; i < MAX_STACKS; i++) {
+        stack_t* st = &stacks[(h + i) % MAX_STACKS];
+        if (0 == st->count) {
+            st->s = *s;
+            st->s.comm[PROFILE_COMM_LEN - 1] = '\0';
+            st->count = 1;
+            st->done = 0;
+            return;
+        }
+        if (same_stack (&st->s, s)) {
+            st->count++;
+            return;
+        }
+    }
+    lost++;
+}
+
+static void add_flat (const uint8_t* comm, uint32_t user, const uint8_t* name, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < num_flat; i++) {
+        if (flat[i].user == user && 0 == ece391_strcmp (flat[i].name, name) &&
+            0 == ece391_strcmp (flat[i].comm, comm)) {
+            flat[i].count += count;
+            return;
+        }
+    }
+    if (num_flat == MAX_FLAT)
+        return;
+    ece391_strcpy (flat[num_flat].comm, comm);
+    ece391_strcpy (flat[num_flat].name, name);
+    flat[num_flat].user = user;
+    flat[num_flat++].count = count;
+}
+
+/* Appends one frame to a folded line, kernel frames marked "_[k]" */
+static void fold (int32_t out, const symtab_t* t, uint32_t addr, uint32_t user)
+{
+    uint8_t name[NAMESIZE];
+
+    symbolize (t, addr, name);
+    ece391_write (out, ";", 1);
+    ece391_write (out, name, ece391_strlen (name));
+    if (!user)
+        ece391_write (out, "_[k]", 4);
+}
+
+/* Writes the folded line of every stack of one program and adds its
+ * samples to the flat profile, with the program's symbols loaded */
+static void report_program (int32_t out, const uint8_t* comm)
+{
+    uint8_t name[NAMESIZE], num[NUMSIZE];
+    const symtab_t* t;
+    stack_t* st;
+    uint32_t i, f;
+
+    for (i = 0; i < MAX_STACKS; i++) {
+        st = &stacks[i];
+        if (0 == st->count || st->done || 0 != ece391_strcmp (st->s.comm, comm))
+            continue;
+        st->done = 1;
+        t = st->s.user ? &usyms : &ksyms;
+
+        symbolize (t, st->s.eip, name);
+        add_flat (comm, st->s.user, name, st->count);
+
+        if (-1 == out)
+            continue;
+        ece391_write (out, comm, ece391_strlen (comm));
+        for (f = st->s.depth; f > 0; f--)
+            fold (out, t, st->s.frames[f - 1], st->s.user);
+        fold (out, t, st->s.eip, st->s.user);
+        ece391_write (out, " ", 1);
+        ece391_itoa (st->count, num, 10);
+        ece391_write (out, num, ece391_strlen (num));
+        ece391_write (out, "\n", 1);
+    }
+}
+
+/* Symbolizes every stack one program at a time, loading "<program>.sym" */
+static void report (int32_t out)
+{
+    uint8_t file[PROFILE_COMM_LEN + 8];
+    uint32_t i;
+
+    for (i = 0; i < MAX_STACKS; i++) {
+        if (0 == stacks[i].count || stacks[i].done)
+            continue;
+        ece391_strcpy (file, stacks[i].s.comm);
+        ece391_strcpy (file + ece391_strlen (file), (uint8_t*)".sym");
+        load_syms (&usyms, file);
+        report_program (out, stacks[i].s.comm);
+    }
+}
+
+/* The TOP functions with the most samples */
+static void print_flat (uint32_t total)
+{
+    uint32_t i, j, best;
+    flat_t tmp;
+
+    put ("samples    %  program         function\n");
+    for (i = 0; i < num_flat && i < TOP; i++) {
+        for (best = i, j = i + 1; j < num_flat; j++)
+            if (flat[j].count > flat[best].count)
+                best = j;
+        tmp = flat[i];
+        flat[i] = flat[best];
+        flat[best] = tmp;
+
+        put_num_col (flat[i].count, 8);
+        put_num_col (flat[i].count * 100 / total, 4);
+        put_col ((char*)flat[i].comm, 16);
+        put (flat[i].user ? "" : "[k] ");
+        put ((char*)flat[i].name);
+        put ("\n");
+    }
+}
+
+int main ()
+{
+    uint8_t cmd[BUFSIZE], ctl[NUMSIZE];
+    int32_t fd, sfd, out, cnt, got, status;
+    uint32_t i, total = 0;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE)) {
+        put ("usage: prof command [args]\n");
+        return 3;
+    }
+    if (-1 == (fd = ece391_open ((uint8_t*)"dev/profile")) ||
+        -1 == (sfd = ece391_open ((uint8_t*)"dev/profile_stats"))) {
+        put ("no dev/profile\n");
+        return 2;
+    }
+
+    for (i = 0; i < MAX_STACKS; i++)
+        stacks[i].count = 0;
+    lost = num_flat = 0;
+
+    ece391_strcpy (ctl, (uint8_t*)"start ");
+    ece391_itoa (HZ, ctl + 6, 10);
+    ece391_write (fd, "clear", 5);
+    if (-1 == ece391_write (fd, ctl, ece391_strlen (ctl))) {
+        put ("can't start sampling\n");
+        return 2;
+    }
+    status = ece391_execute (cmd);
+    ece391_write (fd, "stop", 4);
+
+    while (0 < (cnt = ece391_read (fd, batch, sizeof (batch)))) {
+        for (i = 0; i < cnt / sizeof (sample_t); i++)
+            add_sample (&batch[i]);
+        total += cnt / sizeof (sample_t);
+    }
+    for (got = 0; got < sizeof (stats); got += cnt) {
+        if (0 >= (cnt = ece391_read (sfd, (uint8_t*)&stats + got, sizeof (stats) - got)))
+            break;
+    }
+    ece391_close (fd);
+    ece391_close (sfd);
+
+    put_num (total);
+    put (" samples at ");
+    put_num (stats.hz);
+    put (" Hz, ");
+    put_num (stats.user);
+    put (" in user mode, ");
+    put_num (stats.dropped);
+    put (" dropped\n");
+    if (0 == total)
+        return 0;
+
+    if (-1 == load_syms (&ksyms, (uint8_t*)"kernel.sym"))
+        put ("no kernel.sym, kernel addresses are in hex\n");
+    ece391_unlink ((uint8_t*)FOLDED);
+    out = ece391_creat ((uint8_t*)FOLDED);
+    report (out);
+    if (-1 != out)
+        ece391_close (out);
+
+    print_flat (total);
+    if (lost) {
+        put_num (lost);
+        put (" samples past the stack table are only in the total\n");
+    }
+    put ("collapsed stacks in " FOLDED ", exit status ");
+    put_num (status);
+    put ("\n");
+    return 0;
+}
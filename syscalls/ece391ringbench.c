@@ -0,0 +1,130 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+/* File read in CHUNK byte pieces, BATCH submissions per ring_enter */
+#define FILE_NAME "fish"
+#define CHUNK 512
+#define BATCH 16
+#define MAX_CHUNKS 256
+#define NOPS 8192
+#define BUFSIZE 16
+
+static uint8_t data[MAX_CHUNKS][CHUNK];
+
+/* Low half of the time-stamp counter */
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void report (const char* what, uint32_t cycles, uint32_t ops, uint32_t traps)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)what);
+    ece391_fdputs (1, ece391_itoa (cycles / ops, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles/op, ");
+    ece391_fdputs (1, ece391_itoa (ops / traps, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" ops/trap\n");
+}
+
+/* Queue one submission, the caller made sure the sq has room */
+static void queue (ece391_ring_t* ring, uint32_t op, int32_t fd, void* buf,
+                   uint32_t len, uint32_t offset, uint32_t user_data)
+{
+    ece391_ring_sqe_t* sqe = &ring->sq[ring->sq_tail % RING_SQ_ENTRIES];
+
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->buf = buf;
+    sqe->len = len;
+    sqe->offset = offset;
+    sqe->user_data = user_data;
+    asm volatile ("" : : : "memory");
+    ring->sq_tail++;
+}
+
+/* Consume every completion, returns the number of failed ones */
+static uint32_t reap (ece391_ring_t* ring)
+{
+    uint32_t bad = 0;
+
+    while (ring->cq_head != ring->cq_tail) {
+        if (ring->cq[ring->cq_head % RING_CQ_ENTRIES].res < 0)
+            bad++;
+        ring->cq_head++;
+    }
+    return bad;
+}
+
+int main ()
+{
+    ece391_ring_t* ring;
+    ece391_stat_t st;
+    int32_t fd;
+    uint32_t i, j, n, chunks, start, cycles, traps, bad = 0;
+
+    if (0 != ece391_ring_setup (&ring)) {
+        ece391_fdputs (1, (uint8_t*)"ring_setup failed\n");
+        return 2;
+    }
+    if (-1 == (fd = ece391_open ((uint8_t*)FILE_NAME)) ||
+        0 != ece391_fstat (fd, &st)) {
+        ece391_fdputs (1, (uint8_t*)"can't open " FILE_NAME "\n");
+        return 2;
+    }
+    chunks = (st.length + CHUNK - 1) / CHUNK;
+    if (chunks > MAX_CHUNKS)
+        chunks = MAX_CHUNKS;
+
+    /* One pread per trap */
+    start = rdtsc_lo ();
+    for (i = 0; i < chunks; i++)
+        ece391_pread (fd, data[i], CHUNK, i * CHUNK);
+    report ("pread:        ", rdtsc_lo () - start, chunks, chunks);
+
+    /* BATCH preads per trap */
+    traps = 0;
+    start = rdtsc_lo ();
+    for (i = 0; i < chunks; i += n) {
+        n = chunks - i < BATCH ? chunks - i : BATCH;
+        for (j = 0; j < n; j++)
+            queue (ring, RING_OP_READ, fd, data[i + j], CHUNK, (i + j) * CHUNK, i + j);
+        ece391_ring_enter (n, n);
+        bad += reap (ring);
+        traps++;
+    }
+    report ("ring read:    ", rdtsc_lo () - start, chunks, traps);
+
+    /* Pure entry cost: getpid against batches of no-ops */
+    start = rdtsc_lo ();
+    for (i = 0; i < NOPS; i++)
+        ece391_getpid ();
+    report ("getpid:       ", rdtsc_lo () - start, NOPS, NOPS);
+
+    cycles = 0;
+    traps = 0;
+    for (i = 0; i < NOPS; i += RING_SQ_ENTRIES) {
+        start = rdtsc_lo ();
+        for (j = 0; j < RING_SQ_ENTRIES; j++)
+            queue (ring, RING_OP_NOP, 0, 0, 0, 0, j);
+        ece391_ring_enter (RING_SQ_ENTRIES, RING_SQ_ENTRIES);
+        bad += reap (ring);
+        cycles += rdtsc_lo () - start;
+        traps++;
+    }
+    report ("ring nop:     ", cycles, NOPS, traps);
+
+    ece391_close (fd);
+    if (bad) {
+        ece391_fdputs (1, (uint8_t*)"some ring operations failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -5,6 +5,15 @@
 
 #define BUFSIZE 1024
 
+static int32_t is_pipeline (const uint8_t* cmd)
+{
+    for (; '\0' != *cmd; cmd++) {
+        if ('|' == *cmd)
+            return 1;
+    }
+    return 0;
+}
+
 int main ()
 {
     int32_t cnt, rval;
@@ -24,8 +33,11 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
+	/* "a | b | c" runs as a pipeline, the kernel connects the stages */
 	rval = ece391_execute (buf);
-	if (-1 == rval)
+	if (-1 == rval && is_pipeline (buf))
+	    ece391_fdputs (1, (uint8_t*)"bad pipeline: empty stage, no such command or too many programs\n");
+	else if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
 	    ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
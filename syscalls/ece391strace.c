@@ -0,0 +1,200 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+#define BUFSIZE 1024
+#define NUMSIZE 16
+#define BATCH 32
+
+/* Must match the kernel's strace.h */
+#define MAX_SYSCALLS 32
+#define HIST_BUCKETS 32
+
+typedef struct record {
+    uint32_t tsc_lo;
+    uint32_t tsc_hi;
+    uint16_t pid;
+    uint16_t nr;
+    uint32_t args[4];
+    int32_t result;
+    uint32_t cycles;
+} record_t;
+
+typedef struct hist {
+    uint32_t calls;
+    uint32_t errors;
+    uint32_t cycles_lo;
+    uint32_t cycles_hi;
+    uint32_t buckets[HIST_BUCKETS];
+} hist_t;
+
+typedef struct stats {
+    uint32_t enabled;
+    uint32_t filter;
+    uint32_t filter_pid;
+    uint32_t recorded;
+    uint32_t dropped;
+    uint32_t reserved[3];
+    hist_t hist[MAX_SYSCALLS];
+} stats_t;
+
+/* Names and argument counts by syscall number */
+static const struct {
+    const char* name;
+    uint32_t argc;
+} calls[] = {
+    {"?", 0}, {"halt", 1}, {"execute", 1}, {"read", 3}, {"write", 3},
+    {"open", 1}, {"close", 1}, {"getargs", 2}, {"vidmap", 1},
+    {"set_handler", 2}, {"sigreturn", 0}, {"creat", 1}, {"unlink", 1},
+    {"lseek", 3}, {"pread", 4}, {"pwrite", 4}, {"getdents", 3},
+    {"stat", 2}, {"fstat", 2}, {"readv", 3}, {"writev", 3},
+    {"getpid", 0}, {"ring_setup", 1}, {"ring_enter", 2}, {"poll", 3},
+    {"pipe", 1}, {"fcntl", 3}, {"dup", 1}, {"dup2", 2},
+};
+#define NUM_NAMED (sizeof (calls) / sizeof (calls[0]))
+
+static record_t records[BATCH];
+static stats_t stats;
+
+static void put (const char* s)
+{
+    ece391_fdputs (1, (uint8_t*)s);
+}
+
+static void put_num (uint32_t n, int32_t radix)
+{
+    uint8_t buf[NUMSIZE];
+
+    if (16 == radix)
+        put ("0x");
+    ece391_fdputs (1, ece391_itoa (n, buf, radix));
+}
+
+static const char* name_of (uint32_t nr)
+{
+    return nr < NUM_NAMED ? calls[nr].name : "?";
+}
+
+/* Left-justify s in a column of width characters */
+static void put_col (const char* s, uint32_t width)
+{
+    uint32_t len = ece391_strlen ((uint8_t*)s);
+
+    put (s);
+    while (len++ < width)
+        put (" ");
+}
+
+static void put_num_col (uint32_t n, uint32_t width)
+{
+    uint8_t buf[NUMSIZE];
+
+    put_col ((char*)ece391_itoa (n, buf, 10), width);
+}
+
+/* One line per call: [pid] name(args) = result <cycles> */
+static void print_record (const record_t* r)
+{
+    uint32_t i, argc = r->nr < NUM_NAMED ? calls[r->nr].argc : 4;
+
+    put ("[");
+    put_num (r->pid, 10);
+    put ("] ");
+    put (name_of (r->nr));
+    put ("(");
+    for (i = 0; i < argc; i++) {
+        if (i)
+            put (", ");
+        put_num (r->args[i], 16);
+    }
+    put (") = ");
+    if (r->result < 0) {
+        put ("-");
+        put_num (-r->result, 10);
+    } else {
+        put_num (r->result, 10);
+    }
+    put (" <");
+    put_num (r->cycles, 10);
+    put (">\n");
+}
+
+/* calls, errors, mean and the log2 latency histogram of each syscall */
+static void print_summary (void)
+{
+    uint32_t nr, b;
+    hist_t* h;
+
+    put ("\nsyscall     calls   errors  cycles/call  histogram (log2 cycles:calls)\n");
+    for (nr = 0; nr < MAX_SYSCALLS; nr++) {
+        h = &stats.hist[nr];
+        if (!h->calls)
+            continue;
+        put_col (name_of (nr), 12);
+        put_num_col (h->calls, 8);
+        put_num_col (h->errors, 8);
+        if (h->cycles_hi)
+            put_col (">4G", 13);
+        else
+            put_num_col (h->cycles_lo / h->calls, 13);
+        for (b = 0; b < HIST_BUCKETS; b++) {
+            if (!h->buckets[b])
+                continue;
+            put_num (b, 10);
+            put (":");
+            put_num (h->buckets[b], 10);
+            put (" ");
+        }
+        put ("\n");
+    }
+    put_num (stats.recorded, 10);
+    put (" recorded, ");
+    put_num (stats.dropped, 10);
+    put (" dropped\n");
+}
+
+int main ()
+{
+    uint8_t cmd[BUFSIZE], ctl[NUMSIZE + 8];
+    int32_t fd, hfd, cnt, got, status;
+    uint32_t i;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE)) {
+        put ("usage: strace command [args]\n");
+        return 3;
+    }
+    if (-1 == (fd = ece391_open ((uint8_t*)"dev/strace")) ||
+        -1 == (hfd = ece391_open ((uint8_t*)"dev/strace_hist"))) {
+        put ("no dev/strace\n");
+        return 2;
+    }
+
+    /* Trace what the command starts, not this program */
+    ece391_strcpy (ctl, (uint8_t*)"kids ");
+    ece391_itoa (ece391_getpid (), ctl + 5, 10);
+    ece391_write (fd, "clear", 5);
+    ece391_write (fd, ctl, ece391_strlen (ctl));
+    status = ece391_execute (cmd);
+    ece391_write (fd, "off", 3);
+
+    while (0 < (cnt = ece391_read (fd, records, sizeof (records)))) {
+        for (i = 0; i < cnt / sizeof (record_t); i++)
+            print_record (&records[i]);
+    }
+
+    for (got = 0; got < sizeof (stats); got += cnt) {
+        if (0 >= (cnt = ece391_read (hfd, (uint8_t*)&stats + got, sizeof (stats) - got)))
+            break;
+    }
+    if (got == sizeof (stats))
+        print_summary ();
+
+    put ("exit status ");
+    put_num (status, 10);
+    put ("\n");
+    ece391_close (fd);
+    ece391_close (hfd);
+    return 0;
+}
@@ -102,3 +102,78 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+/* Opens filename with status flags set, closing it again if they can't be */
+int32_t ece391_open_flags(const uint8_t* filename, int32_t flags)
+{
+    int32_t fd = ece391_open (filename);
+
+    if (-1 == fd || 0 == flags)
+        return fd;
+    if (-1 == ece391_fcntl (fd, F_SETFL, flags)) {
+        ece391_close (fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+/* Copy the time page, retrying if the kernel updated it meanwhile */
+static void ece391_time_snapshot(ece391_time_page_t* t)
+{
+    const volatile uint32_t* page = (const volatile uint32_t*)ECE391_TIME_PAGE_ADDR;
+    uint32_t* dst = (uint32_t*)t;
+    uint32_t seq, i;
+
+    /* Word by word, seq is word 0 */
+    do {
+        seq = page[0];
+        for (i = 0; i < sizeof (*t) / 4; i++)
+            dst[i] = page[i];
+    } while ((seq & 1) || seq != page[0]);
+}
+
+uint64_t ece391_monotonic_us(void)
+{
+    ece391_time_page_t t;
+    uint32_t lo, hi, since_tick;
+    uint64_t us;
+
+    ece391_time_snapshot (&t);
+
+    /* 1000000 / 1024 = 15625 / 16 microseconds per tick */
+    us = ((uint64_t)t.ticks * 15625) >> 4;
+    if (!t.tsc_hz)
+        return us;
+
+    /* Interpolate with the TSC, never past the next tick */
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    since_tick = (uint32_t)(((uint64_t)(lo - t.tsc_lo) * t.tsc_us_mult) >> 32);
+    if (since_tick > 976)
+        since_tick = 976;
+    return us + since_tick;
+}
+
+uint32_t ece391_monotonic_ms(void)
+{
+    ece391_time_page_t t;
+
+    ece391_time_snapshot (&t);
+    /* 1000 / 1024 = 125 / 128 milliseconds per tick */
+    return (uint32_t)(((uint64_t)t.ticks * 125) >> 7);
+}
+
+uint32_t ece391_wall_time(void)
+{
+    ece391_time_page_t t;
+
+    ece391_time_snapshot (&t);
+    return t.wall_sec;
+}
+
+uint64_t ece391_idle_cycles(void)
+{
+    ece391_time_page_t t;
+
+    ece391_time_snapshot (&t);
+    return ((uint64_t)t.idle_hi << 32) | t.idle_lo;
+}
@@ -8,6 +8,37 @@ extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
+/* ece391_open, then ece391_fcntl to set flags such as O_NONBLOCK */
+extern int32_t ece391_open_flags(const uint8_t* filename, int32_t flags);
+
+/* Time page the kernel maps read-only into every program, must match the
+ * kernel's time_page.h */
+#define ECE391_TIME_PAGE_ADDR 0x43FF000
+
+typedef struct ece391_time_page {
+    volatile uint32_t seq;      /* odd while the kernel is updating the page */
+    uint32_t tick_hz;
+    uint32_t ticks;             /* RTC interrupts since boot */
+    uint32_t tsc_lo;            /* time-stamp counter at the last tick */
+    uint32_t tsc_hi;
+    uint32_t tsc_hz;            /* 0 until the kernel has measured it */
+    uint32_t tsc_us_mult;       /* microseconds = (cycles * tsc_us_mult) >> 32 */
+    uint32_t wall_sec;          /* seconds since 1970, UTC */
+    uint32_t wall_tick;
+    uint32_t idle_lo;           /* cycles the CPU spent halted in poll */
+    uint32_t idle_hi;
+    uint32_t features;          /* ECE391_TIME_PAGE_* */
+} ece391_time_page_t;
+
+/* Bits of features */
+#define ECE391_TIME_PAGE_SYSENTER 0x1   /* syscalls may use sysenter */
+
+/* Clock reads that are a few loads, no syscall */
+extern uint64_t ece391_monotonic_us(void);
+extern uint32_t ece391_monotonic_ms(void);
+extern uint32_t ece391_wall_time(void);
+/* TSC cycles the CPU has spent halted, waiting in poll, since boot */
+extern uint64_t ece391_idle_cycles(void);
 
 #endif /* ECE391SUPPORT_H */
 
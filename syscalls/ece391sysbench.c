@@ -0,0 +1,69 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+/* Round trips timed per entry path */
+#define CALLS 10000
+#define BUFSIZE 16
+
+/* Low half of the time-stamp counter, enough for CALLS round trips */
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* getpid through the interrupt gate, like the stubs used to */
+static int32_t getpid_int80 (void)
+{
+    int32_t ret;
+
+    asm volatile ("int $0x80" : "=a"(ret) : "a"(SYS_GETPID) : "memory");
+    return ret;
+}
+
+static void report (const char* path, uint32_t cycles, const char* what)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)path);
+    ece391_fdputs (1, ece391_itoa (cycles / CALLS, buf, 10));
+    ece391_fdputs (1, (uint8_t*)what);
+}
+
+int main ()
+{
+    uint32_t i, start, int80, fast, clock;
+
+    /* Warm up both paths first */
+    getpid_int80 ();
+    ece391_getpid ();
+
+    start = rdtsc_lo ();
+    for (i = 0; i < CALLS; i++)
+        getpid_int80 ();
+    int80 = rdtsc_lo () - start;
+
+    start = rdtsc_lo ();
+    for (i = 0; i < CALLS; i++)
+        ece391_getpid ();
+    fast = rdtsc_lo () - start;
+
+    /* The clock from the time page, no kernel entry at all */
+    start = rdtsc_lo ();
+    for (i = 0; i < CALLS; i++)
+        ece391_monotonic_us ();
+    clock = rdtsc_lo () - start;
+
+    report ("int $0x80: ", int80, " cycles per getpid\n");
+    if (((const volatile ece391_time_page_t*)ECE391_TIME_PAGE_ADDR)->features & ECE391_TIME_PAGE_SYSENTER)
+        report ("sysenter:  ", fast, " cycles per getpid\n");
+    else
+        report ("stubs:     ", fast, " cycles per getpid (no sysenter, int $0x80)\n");
+    report ("time page: ", clock, " cycles per monotonic_us\n");
+    return 0;
+}
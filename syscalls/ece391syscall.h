@@ -23,6 +23,136 @@ extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 extern int32_t ece391_creat(const uint8_t* filename);
 extern int32_t ece391_unlink(const uint8_t* filename);
+extern int32_t ece391_lseek(int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+extern int32_t ece391_pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+
+/* Directory record filled in by ece391_getdents, must match the kernel's dirent_t */
+typedef struct ece391_dirent {
+	uint32_t inode_num;
+	uint32_t length;		/* file size in bytes, 0 unless a regular file */
+	uint32_t file_type;		/* 0 RTC, 1 directory, 2 regular file */
+	uint8_t name[33];		/* always NUL terminated */
+	uint8_t reserved[3];
+} ece391_dirent_t;
+
+/* File information filled in by ece391_stat and ece391_fstat */
+typedef struct ece391_stat {
+	uint32_t inode_num;
+	uint32_t file_type;
+	uint32_t length;
+	uint32_t blocks;
+} ece391_stat_t;
+
+/* Returns bytes filled in buf (a multiple of sizeof(ece391_dirent_t)), 0 at the end */
+extern int32_t ece391_getdents(int32_t fd, ece391_dirent_t* buf, int32_t nbytes);
+extern int32_t ece391_stat(const uint8_t* filename, ece391_stat_t* buf);
+extern int32_t ece391_fstat(int32_t fd, ece391_stat_t* buf);
+
+/* One buffer of ece391_readv / ece391_writev, must match the kernel's iovec_t */
+typedef struct ece391_iovec {
+	void* base;
+	uint32_t len;
+} ece391_iovec_t;
+
+/* Read into / write from up to 16 buffers with one call */
+extern int32_t ece391_readv(int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+extern int32_t ece391_writev(int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+
+/* Returns the caller's process id */
+extern int32_t ece391_getpid(void);
+
+/* I/O ring shared with the kernel, must match the kernel's ring.h */
+#define RING_SQ_ENTRIES 64
+#define RING_CQ_ENTRIES 128
+
+#define RING_OP_NOP 0			/* completes with 0 */
+#define RING_OP_READ 1			/* read, or pread unless offset is RING_OFFSET_CUR */
+#define RING_OP_WRITE 2			/* write, or pwrite unless offset is RING_OFFSET_CUR */
+#define RING_OP_UDP_RECV 3		/* one datagram from UDP port fd, at most 4 kB */
+
+#define RING_OFFSET_CUR 0xFFFFFFFF
+
+typedef struct ece391_ring_sqe {
+	uint32_t opcode;
+	int32_t fd;
+	void* buf;
+	uint32_t len;
+	uint32_t offset;
+	uint32_t user_data;		/* handed back in the completion */
+} ece391_ring_sqe_t;
+
+typedef struct ece391_ring_cqe {
+	uint32_t user_data;
+	int32_t res;			/* what the equivalent call would have returned */
+} ece391_ring_cqe_t;
+
+/* The program fills sq[sq_tail % RING_SQ_ENTRIES] and bumps sq_tail, and
+ * consumes cq[cq_head % RING_CQ_ENTRIES] and bumps cq_head */
+typedef struct ece391_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	uint32_t sq_entries;
+	uint32_t cq_entries;
+	uint32_t reserved[2];
+	ece391_ring_sqe_t sq[RING_SQ_ENTRIES];
+	ece391_ring_cqe_t cq[RING_CQ_ENTRIES];
+} ece391_ring_t;
+
+/* Maps the process' ring and stores its address in *ring */
+extern int32_t ece391_ring_setup(ece391_ring_t** ring);
+/* Starts up to to_submit queued entries and waits for min_complete
+ * completions, returns the number started */
+extern int32_t ece391_ring_enter(uint32_t to_submit, uint32_t min_complete);
+
+/* One entry of ece391_poll, must match the kernel's pollfd_t */
+typedef struct ece391_pollfd {
+	int32_t fd;				/* negative to skip the entry */
+	int16_t events;
+	int16_t revents;		/* filled in */
+} ece391_pollfd_t;
+
+#define POLLIN    0x0001	/* read wouldn't block */
+#define POLLOUT   0x0004	/* write wouldn't block */
+#define POLLERR   0x0008
+#define POLLHUP   0x0010	/* the other end closed */
+#define POLLNVAL  0x0020	/* fd isn't open */
+#define POLL_UDP  0x1000	/* fd is a UDP port: POLLIN when a datagram is queued */
+#define POLL_TCP  0x2000	/* fd is a TCP connection */
+
+#define POLL_MAX_FDS 32
+#define POLL_FOREVER -1
+
+/* Waits up to timeout_ms (0 to only check, POLL_FOREVER for no limit) for
+ * an entry to be ready, returns how many are, 0 on timeout */
+extern int32_t ece391_poll(ece391_pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+
+/* Makes a pipe, fds[0] reads what is written to fds[1]. Reads return 0
+ * once every write end is closed, writes -1 once every read end is */
+extern int32_t ece391_pipe(int32_t fds[2]);
+
+/* File status flag: reads with nothing ready return -EAGAIN instead of waiting */
+#define O_NONBLOCK 0x00010000
+#define EAGAIN 11
+
+/* cmd values for ece391_fcntl */
+#define F_GETFL 3
+#define F_SETFL 4
+
+/* F_GETFL returns fd's status flags, F_SETFL replaces them with arg */
+extern int32_t ece391_fcntl(int32_t fd, int32_t cmd, int32_t arg);
+
+/* New descriptors sharing fd's open file: the lowest free one, or new_fd
+ * (closed first if open), which may be 0 or 1 to redirect stdin/stdout */
+extern int32_t ece391_dup(int32_t fd);
+extern int32_t ece391_dup2(int32_t fd, int32_t new_fd);
+
+/* whence values for ece391_lseek */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
 
 enum signums {
 	DIV_ZERO = 0,
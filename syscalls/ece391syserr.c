@@ -5,6 +5,7 @@
 
 #define NEG_FD -1073741823
 #define BIG_FD 1073741823
+#define OPEN_LOTS 32
 #define BIG_NUM 1073741823
 #define NEG_NUM -1073741823
 
@@ -91,7 +92,7 @@ int err_big_fd(void) {
 
 
 /* TEST 3 err_open_lots
- * calls open correctly seven times
+ * calls open correctly OPEN_LOTS times
  * prints "[TEST_NAME]: PASS" if behavior is EXPECTED
  *     and then returns 0
  * prints "[TEST_NAME]: FAIL" if behavior is UNEXPECTED
@@ -100,20 +101,20 @@ int err_big_fd(void) {
 int err_open_lots(void) {
     int32_t i, cnt = 0;
 	
-	// fd = 0,1 taken, so we should be able to open 6 files (2,3,4,5,6,7)
-	// the last file open should fail
-    for (i = 0; i < 7; i++) {
+	// fd = 0,1 taken, the table grows past its 8 inline slots
+	// so every open should succeed (2 .. OPEN_LOTS + 1)
+    for (i = 0; i < OPEN_LOTS; i++) {
 	    if (-1 == ece391_open ((uint8_t*)".")) {
 			cnt++;
         }
     }
     //close all fds that were just opened.
-    for(i = 2; i < 8; i++)
+    for(i = 2; i < OPEN_LOTS + 2; i++)
     {
     	ece391_close(i);
     }
     
-	if (cnt == 1) {
+	if (cnt == 0) {
 		ece391_fdputs(1, (uint8_t*)"err_open_lots: PASS\n");
 		return 0;
 	} else {
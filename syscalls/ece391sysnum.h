@@ -13,5 +13,21 @@
 #define SYS_SIGRETURN  10
 #define SYS_CREAT 11
 #define SYS_UNLINK 12
+#define SYS_LSEEK 13
+#define SYS_PREAD 14
+#define SYS_PWRITE 15
+#define SYS_GETDENTS 16
+#define SYS_STAT 17
+#define SYS_FSTAT 18
+#define SYS_READV 19
+#define SYS_WRITEV 20
+#define SYS_GETPID 21
+#define SYS_RING_SETUP 22
+#define SYS_RING_ENTER 23
+#define SYS_POLL 24
+#define SYS_PIPE 25
+#define SYS_FCNTL 26
+#define SYS_DUP 27
+#define SYS_DUP2 28
 
 #endif /* ECE391SYSNUM_H */